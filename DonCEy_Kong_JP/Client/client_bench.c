@@ -0,0 +1,454 @@
+#include "client_constants.h"
+#include "raylib.h"
+#include <stdarg.h>
+
+/* ============================
+ *  M I C R O - B E N C H M A R K S
+ * ============================
+ *
+ * Ejecutable aparte que mide, sobre flujos sintéticos en memoria y
+ * siempre con los mismos datos (semilla fija):
+ *
+ *   recv      : recv_line() sobre líneas STATE.
+ *   map       : protocol_receive_map() con mapas completos.
+ *   dispatch  : protocol_drain() con ticks STATE + frutas + enemigos.
+ *   render    : render_game_scene() sobre una RenderTexture oculta.
+ *
+ * Los flujos se arman con el formato de las grabaciones (client_replay.c)
+ * y se leen con replay_open_memory(), así que el camino es el mismo que
+ * con un socket: LineReader, protocolo de texto y render.
+ *
+ * Uso:
+ *   client_bench [-f frutas] [-e enemigos] [-t ticks] [-w ancho] [-h alto]
+ *                [-r mapas] [-F frames] [-s semilla] [-R]
+ *
+ * -R omite el render (no abre ventana). El tiempo de render es el de CPU
+ * para armar y enviar el frame; la GPU trabaja en paralelo.
+ */
+
+/** Bytes por registro sintético: imita un recv() grande. */
+#define BENCH_CHUNK 4096
+
+/** Cantidad de líneas STATE del benchmark de recv_line(). */
+#define BENCH_RECV_LINES 200000
+
+/** Opciones de la línea de comandos. */
+typedef struct {
+    int      fruits;
+    int      enemies;
+    int      ticks;
+    int      mapWidth;
+    int      mapHeight;
+    int      maps;
+    int      frames;
+    unsigned seed;
+    int      render;
+} BenchOptions;
+
+/**
+ * Flujo sintético: cabecera de grabación y registros de hasta
+ * BENCH_CHUNK bytes con el texto que se va agregando.
+ */
+typedef struct {
+    unsigned char *data;
+    size_t         length;
+    size_t         capacity;
+    size_t         chunkStart; /* inicio del registro abierto */
+    unsigned       rng;
+} BenchStream;
+
+
+/* ============================
+ *  F L U J O S   S I N T É T I C O S
+ * ============================ */
+
+static unsigned bench_random(BenchStream *bs)
+{
+    bs->rng = bs->rng * 1103515245u + 12345u;
+    return (bs->rng >> 16) & 0x7fff;
+}
+
+static void stream_reserve(BenchStream *bs, size_t extra)
+{
+    if (bs->length + extra <= bs->capacity) {
+        return;
+    }
+    size_t capacity = bs->capacity ? bs->capacity : 64 * 1024;
+    while (capacity < bs->length + extra) {
+        capacity *= 2;
+    }
+    unsigned char *data = realloc(bs->data, capacity);
+    if (data == NULL) {
+        printf("[BENCH] Sin memoria para el flujo sintético\n");
+        exit(1);
+    }
+    bs->data     = data;
+    bs->capacity = capacity;
+}
+
+/** Escribe el largo del registro abierto en su cabecera. */
+static void stream_close_chunk(BenchStream *bs)
+{
+    size_t len = bs->length - bs->chunkStart - REPLAY_RECORD_HEADER;
+    unsigned char *h = bs->data + bs->chunkStart;
+    memset(h, 0, 4); /* ms = 0: todo llega "ya" */
+    h[4] = (unsigned char)(len);
+    h[5] = (unsigned char)(len >> 8);
+    h[6] = (unsigned char)(len >> 16);
+    h[7] = (unsigned char)(len >> 24);
+}
+
+static void stream_open_chunk(BenchStream *bs)
+{
+    stream_reserve(bs, REPLAY_RECORD_HEADER);
+    bs->chunkStart = bs->length;
+    bs->length    += REPLAY_RECORD_HEADER;
+}
+
+static void stream_init(BenchStream *bs, unsigned seed)
+{
+    memset(bs, 0, sizeof(*bs));
+    bs->rng = seed;
+
+    stream_reserve(bs, REPLAY_HEADER_SIZE);
+    memcpy(bs->data, "DKREC1", REPLAY_MAGIC_LENGTH);
+    bs->data[REPLAY_MAGIC_LENGTH]     = ROLE_PLAYER;
+    bs->data[REPLAY_MAGIC_LENGTH + 1] = 0;
+    bs->length = REPLAY_HEADER_SIZE;
+    stream_open_chunk(bs);
+}
+
+/** Agrega texto; corta registros cada BENCH_CHUNK bytes aunque parta una línea. */
+static void stream_text(BenchStream *bs, const char *text, int len)
+{
+    while (len > 0) {
+        size_t used  = bs->length - bs->chunkStart - REPLAY_RECORD_HEADER;
+        int    space = BENCH_CHUNK - (int)used;
+        if (space == 0) {
+            stream_close_chunk(bs);
+            stream_open_chunk(bs);
+            continue;
+        }
+        int n = len < space ? len : space;
+        stream_reserve(bs, (size_t)n);
+        memcpy(bs->data + bs->length, text, (size_t)n);
+        bs->length += (size_t)n;
+        text += n;
+        len  -= n;
+    }
+}
+
+static void stream_printf(BenchStream *bs, const char *fmt, ...)
+{
+    char    line[LINE_READER_CAPACITY];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len > 0) {
+        stream_text(bs, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+    }
+}
+
+static void stream_finish(BenchStream *bs)
+{
+    stream_close_chunk(bs);
+}
+
+/** Un mapa completo como lo manda el servidor (MAP_SIZE, MAP_ROW, MAP_END). */
+static void stream_map(BenchStream *bs, int width, int height)
+{
+    static const char TILES[] = "...T=|WG";
+    char row[MAX_MAP_WIDTH + 1];
+
+    stream_printf(bs, "MAP_SIZE %d %d\n", width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            row[x] = (y == 0) ? 'T' : TILES[bench_random(bs) % (sizeof(TILES) - 1)];
+        }
+        row[width] = '\0';
+        stream_printf(bs, "MAP_ROW %d %s\n", y, row);
+    }
+    stream_printf(bs, "MAP_END\n");
+}
+
+/** Un tick completo del servidor: STATE y listas de frutas y enemigos. */
+static void stream_tick(BenchStream *bs, const BenchOptions *opts, int seq)
+{
+    int w = opts->mapWidth, h = opts->mapHeight;
+
+    stream_printf(bs, "STATE %d 1 %u %u %d 1 3 false %d\n",
+                  seq, bench_random(bs) % w, bench_random(bs) % h, seq, seq);
+
+    stream_printf(bs, "FRUITS_BEGIN 1 %d %d\n", seq, opts->fruits);
+    for (int i = 0; i < opts->fruits; i++) {
+        stream_printf(bs, "FRUIT %u %u %d %d\n",
+                      bench_random(bs) % w, bench_random(bs) % h, 100, i + 1);
+    }
+    stream_printf(bs, "FRUITS_END 1\n");
+
+    stream_printf(bs, "ENEMIES_BEGIN 1 %d %d\n", seq, opts->enemies);
+    for (int i = 0; i < opts->enemies; i++) {
+        stream_printf(bs, "ENEMY %s %u %u %d\n", (i & 1) ? "BLUE" : "RED",
+                      bench_random(bs) % w, bench_random(bs) % h, i + 1);
+    }
+    stream_printf(bs, "ENEMIES_END 1\n");
+}
+
+
+/* ============================
+ *  M E D I C I O N E S
+ * ============================ */
+
+/** Conecta el lector del estado al flujo, con todo "ya llegado". */
+static void attach_stream(ClientState *state, ReplaySource *src, const BenchStream *bs)
+{
+    if (replay_open_memory(src, bs->data, bs->length) != 0) {
+        printf("[BENCH] Flujo sintético inválido\n");
+        exit(1);
+    }
+    src->clockMs = src->durationMs;
+    line_reader_init(&state->reader, INVALID_SOCKET);
+    state->reader.replay = src;
+    send_queue_init(&state->outbox, INVALID_SOCKET);
+}
+
+/** Líneas contadas por las estadísticas del protocolo. */
+static long counted_lines(const ClientStats *stats)
+{
+    long total = 0;
+    for (int t = 0; t < STATS_TAG_COUNT; t++) {
+        total += stats->lines[t];
+    }
+    return total;
+}
+
+static void report_lines(const char *name, long lines, size_t bytes, double ms)
+{
+    double seconds = ms / 1000.0;
+    printf("bench %-9s lines=%-9ld ns/line=%8.1f  lines/s=%11.0f  MB/s=%7.1f\n",
+           name, lines,
+           lines > 0 ? ms * 1e6 / lines : 0.0,
+           seconds > 0.0 ? lines / seconds : 0.0,
+           seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+}
+
+/** recv_line() sobre BENCH_RECV_LINES líneas STATE. */
+static void bench_recv(ClientState *state, const BenchOptions *opts)
+{
+    BenchStream  bs;
+    ReplaySource src;
+    char         line[256];
+
+    stream_init(&bs, opts->seed);
+    for (int i = 0; i < BENCH_RECV_LINES; i++) {
+        stream_printf(&bs, "STATE %d 1 %d %d %d 1 3 false %d\n", i, i % 14, i % 13, i, i);
+    }
+    stream_finish(&bs);
+    attach_stream(state, &src, &bs);
+
+    long   lines = 0;
+    double t0    = client_now_ms();
+    while (recv_line(&state->reader, line, sizeof(line)) >= 0) {
+        lines++;
+    }
+    report_lines("recv", lines, bs.length, client_now_ms() - t0);
+    free(bs.data);
+}
+
+/** protocol_receive_map() con opts->maps mapas seguidos. */
+static void bench_map(ClientState *state, const BenchOptions *opts)
+{
+    BenchStream  bs;
+    ReplaySource src;
+
+    stream_init(&bs, opts->seed);
+    for (int i = 0; i < opts->maps; i++) {
+        stream_map(&bs, opts->mapWidth, opts->mapHeight);
+    }
+    stream_finish(&bs);
+    attach_stream(state, &src, &bs);
+
+    long   lines = 0;
+    double t0    = client_now_ms();
+    for (int i = 0; i < opts->maps; i++) {
+        stats_reset(&state->stats);
+        if (protocol_receive_map(state) != 0) {
+            printf("[BENCH] map: falló el mapa %d\n", i);
+            break;
+        }
+        lines += counted_lines(&state->stats);
+    }
+    report_lines("map", lines, bs.length, client_now_ms() - t0);
+    free(bs.data);
+}
+
+/** protocol_drain() con opts->ticks ticks de keyframes completos. */
+static void bench_dispatch(ClientState *state, const BenchOptions *opts)
+{
+    BenchStream  bs;
+    ReplaySource src;
+
+    stream_init(&bs, opts->seed);
+    for (int i = 0; i < opts->ticks; i++) {
+        stream_tick(&bs, opts, i + 1);
+    }
+    stream_finish(&bs);
+    attach_stream(state, &src, &bs);
+
+    state->playerId = 1;
+    protocol_reset(state, 1);
+    prediction_reset(state, 0);
+    stats_reset(&state->stats);
+
+    double t0 = client_now_ms();
+    for (;;) {
+        long before = counted_lines(&state->stats);
+        if (protocol_drain(state) != 0) {
+            break;
+        }
+        if (counted_lines(&state->stats) == before && !replay_due(&src)) {
+            break; /* todo procesado */
+        }
+    }
+    report_lines("dispatch", counted_lines(&state->stats), bs.length, client_now_ms() - t0);
+    free(bs.data);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/** render_game_scene() en una RenderTexture oculta, opts->frames veces. */
+static void bench_render(ClientState *state, const BenchOptions *opts)
+{
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "DonCEy Kong Jr - Bench");
+
+    RenderTexture2D target = LoadRenderTexture(WINDOW_WIDTH, WINDOW_HEIGHT);
+    double *times = malloc(sizeof(double) * (size_t)opts->frames);
+    if (!IsRenderTextureValid(target) || times == NULL) {
+        printf("[BENCH] render: no se pudo crear la RenderTexture\n");
+        free(times);
+        CloseWindow();
+        return;
+    }
+
+    interp_reset(&state->interp, CLIENT_INTERP_DELAY_MS, CLIENT_PLAYER_SMOOTH_MS);
+    interp_update(state, 0.0);
+
+    /* Calentamiento: genera la capa de tiles y el atlas */
+    BeginTextureMode(target);
+        render_game_scene(state);
+    EndTextureMode();
+
+    for (int i = 0; i < opts->frames; i++) {
+        interp_update(state, i * 1000.0 / 60.0);
+
+        double t0 = client_now_ms();
+        BeginTextureMode(target);
+            render_game_scene(state);
+        EndTextureMode();
+        times[i] = client_now_ms() - t0;
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < opts->frames; i++) {
+        sum += times[i];
+    }
+    qsort(times, (size_t)opts->frames, sizeof(double), compare_double);
+    printf("bench %-9s frames=%-8d avg=%.3f ms  p50=%.3f  p99=%.3f  max=%.3f  "
+           "(frutas=%d enemigos=%d)\n",
+           "render", opts->frames, sum / opts->frames,
+           times[opts->frames / 2], times[(opts->frames * 99) / 100],
+           times[opts->frames - 1], state->numFruits, state->numEnemies);
+
+    free(times);
+    UnloadRenderTexture(target);
+    render_shutdown();
+    CloseWindow();
+}
+
+
+/* ============================
+ *  P U N T O   D E   E N T R A D A
+ * ============================ */
+
+static int parse_args(BenchOptions *opts, int argc, char **argv)
+{
+    opts->fruits    = 20;
+    opts->enemies   = 20;
+    opts->ticks     = 20000;
+    opts->mapWidth  = WORLD_MAX_X + 1;
+    opts->mapHeight = WORLD_MAX_Y + 1;
+    opts->maps      = 2000;
+    opts->frames    = 600;
+    opts->seed      = 1;
+    opts->render    = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-R") == 0) {
+            opts->render = 0;
+            continue;
+        }
+        if (i + 1 >= argc || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            printf("[BENCH] Opción inválida: %s\n", arg);
+            return -1;
+        }
+        int value = atoi(argv[++i]);
+        switch (arg[1]) {
+            case 'f': opts->fruits    = value; break;
+            case 'e': opts->enemies   = value; break;
+            case 't': opts->ticks     = value; break;
+            case 'w': opts->mapWidth  = value; break;
+            case 'h': opts->mapHeight = value; break;
+            case 'r': opts->maps      = value; break;
+            case 'F': opts->frames    = value; break;
+            case 's': opts->seed      = (unsigned)value; break;
+            default:
+                printf("[BENCH] Opción desconocida: %s\n", arg);
+                return -1;
+        }
+    }
+
+    if (opts->fruits < 0 || opts->enemies < 0 ||
+        opts->fruits > MAX_ENTITIES || opts->enemies > MAX_ENTITIES ||
+        opts->ticks <= 0 || opts->maps <= 0 || opts->frames <= 0 ||
+        opts->mapWidth <= 0 || opts->mapWidth > MAX_MAP_WIDTH ||
+        opts->mapHeight <= 0 || opts->mapHeight > MAX_MAP_HEIGHT) {
+        printf("[BENCH] Valores fuera de rango\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opts;
+    if (parse_args(&opts, argc, argv) != 0) {
+        return 1;
+    }
+
+    static ClientState state;
+    state.socket_fd = INVALID_SOCKET;
+    state.role      = ROLE_PLAYER;
+
+    printf("bench config    frutas=%d enemigos=%d ticks=%d mapa=%dx%d mapas=%d semilla=%u\n",
+           opts.fruits, opts.enemies, opts.ticks, opts.mapWidth, opts.mapHeight,
+           opts.maps, opts.seed);
+
+    /* El orden importa: dispatch deja el último mapa y las listas que dibuja render */
+    bench_recv(&state, &opts);
+    bench_map(&state, &opts);
+    bench_dispatch(&state, &opts);
+    if (opts.render) {
+        bench_render(&state, &opts);
+    }
+
+    arena_release(&state.arena);
+    return 0;
+}
@@ -13,52 +13,134 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+// ---------------- Memoria por partida (arena) ----------------
+
+/** Tamaño mínimo de cada bloque que la arena pide con malloc(). */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/** Bloque de la arena; los datos van a continuación de la cabecera. */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t             used;
+    size_t             capacity;
+} ArenaBlock;
+
+/**
+ * Arena de reserva lineal: mapa, listas de entidades y de jugadores se
+ * piden aquí y se liberan todas juntas con arena_reset() al cargar el
+ * siguiente mapa. Un Arena puesto a cero es una arena vacía válida.
+ */
+typedef struct {
+    ArenaBlock *head;
+} Arena;
 
 // ---------------- Mapa lógico recibido del servidor ----------------
 
+/**
+ * Límites de cordura para el tamaño del mapa (no de memoria: el mapa se
+ * reserva según MAP_SIZE). Descartan tramas o líneas corruptas.
+ */
+#define MAX_MAP_WIDTH   1024
+#define MAX_MAP_HEIGHT  1024
+
+/**
+ * Caché local de mapas (ver map_cache_contains()): cuántos mapas distintos
+ * se guardan en memoria y el archivo en disco de cada uno, nombrado con su
+ * huella en hexadecimal. Sobrevive a reconexiones y a reinicios del cliente.
+ */
+#define MAP_CACHE_SLOTS 4
+#ifndef MAP_CACHE_FILE_FORMAT
+#define MAP_CACHE_FILE_FORMAT "mapcache_%08x.txt"
+#endif
 
-#define MAX_MAP_WIDTH   32
-#define MAX_MAP_HEIGHT  32
 /**
  * Representa el mapa lógico enviado por el servidor.
  *
- * - width  : número de columnas válidas.
- * - height : número de filas válidas.
- * - tiles  : matriz de caracteres con el contenido por celda.
- *            Cada carácter coincide con los usados por el servidor:
- *            'W', 'T', '=', '|', 'S', 'G' o '.'.
+ * - width   : número de columnas válidas.
+ * - height  : número de filas válidas.
+ * - capacity: celdas reservadas en tiles y flags (>= width * height).
+ * - tiles   : celdas en un único búfer, fila por fila empezando por y=0
+ *             (ver MAP_TILE). Cada carácter coincide con los usados por
+ *             el servidor: 'W', 'T', '=', '|', 'S', 'G' o '.'.
+ * - flags   : TILE_FLAG_* de cada celda, mismo orden que tiles; se
+ *             calcula una vez con map_build_flags() al recibir el mapa.
+ * - version : sube cada vez que se recibe un mapa.
+ * - hash    : huella del contenido (tamaño y tiles), calculada por
+ *             map_build_flags(). Dos sesiones con el mismo mapa comparten
+ *             la capa de tiles ya dibujada (ver render_tile_layer()).
  */
 typedef struct {
-    int width;
-    int height;
-    char tiles[MAX_MAP_HEIGHT][MAX_MAP_WIDTH + 1]; /* +1 por seguridad con '\0' */
+    int            width;
+    int            height;
+    int            version;
+    unsigned int   hash;
+    int            capacity;
+    char          *tiles;
+    unsigned char *flags;
 } GameMap;
 
-#define MAX_FRUITS  32
+/** Celda (x, y) del mapa; no valida límites. */
+#define MAP_TILE(map, x, y)  ((map)->tiles[(size_t)(y) * (map)->width + (x)])
+
+/** Flags de la celda (x, y); no valida límites (ver map_flags_at()). */
+#define MAP_FLAGS(map, x, y) ((map)->flags[(size_t)(y) * (map)->width + (x)])
+
+/*
+ * Propiedades de cada tipo de tile. Deben coincidir con Server/TileFlags.java.
+ *
+ *  SOLID   : se puede estar de pie o colgado ('T', '=', '|', 'S').
+ *  LIANA   : se puede trepar ('|').
+ *  WATER   : quita una vida ('W').
+ *  CEILING : no deja subir a través ('T', '=', 'S'; 'G' a propósito no).
+ *  GOAL    : meta del nivel ('G').
+ *  SPAWN   : punto de aparición ('S').
+ *  WALL    : no se puede entrar al moverse ('T', '=').
+ */
+#define TILE_FLAG_SOLID    0x01
+#define TILE_FLAG_LIANA    0x02
+#define TILE_FLAG_WATER    0x04
+#define TILE_FLAG_CEILING  0x08
+#define TILE_FLAG_GOAL     0x10
+#define TILE_FLAG_SPAWN    0x20
+#define TILE_FLAG_WALL     0x40
+
+/**
+ * Capacidad de las listas de frutas y enemigos: se reservan al cargar el
+ * mapa (ENTITY_MIN_CAPACITY o una entidad cada ENTITY_TILES_PER_SLOT
+ * tiles) y crecen al doble si un bloque anuncia más. MAX_ENTITIES es el
+ * tope de los ids u16 del protocolo.
+ */
+#define ENTITY_MIN_CAPACITY   32
+#define ENTITY_TILES_PER_SLOT 8
+#define MAX_ENTITIES          65535
 
 /** 
  * Representa la información de la fruta
  * 
+ * id: identificador estable asignado por el servidor (para los deltas)
  * x: la posición horizontal de la fruta
  * y: la posición vertical de la fruta
  * points: La cantidad de puntaje que dará la fruta
  */
 typedef struct {
+    int id;
     int x;
     int y;
     int points;
 } FruitInfo;
 
-#define MAX_ENEMIES 32
-
 /** 
  * Representa la información de los enemigos
  * 
+ * id: identificador estable asignado por el servidor (para los deltas)
  * x: la posición horizontal del enemigo
  * y: la posición vertical del enemigo
  * type: El tipo de enemigo, cocodrilo rojo o azul
  */
 typedef struct {
+    int id;
     int x;
     int y;
     int type; /* 1 = RED, 2 = BLUE, 0 = desconocido/genérico */
@@ -67,7 +149,8 @@ typedef struct {
 
 
 
-#define MAX_PLAYERS 16
+/** Capacidad inicial de la lista de jugadores (crece si hace falta). */
+#define PLAYER_MIN_CAPACITY 16
 
 /** 
  * Representa la información del jugador 
@@ -93,6 +176,17 @@ typedef struct {
  */
 #define WINDOW_HEIGHT  650
 
+/**
+ * Tamaño en píxeles de cada tile del mapa al dibujarlo.
+ */
+#define TILE_SIZE      40
+
+/**
+ * Máximo de jugadores que un espectador sigue a la vez en la vista de
+ * varias sesiones (una conexión y un ClientState por jugador).
+ */
+#define MAX_WATCH_SESSIONS 9
+
 // ---------------- Constantes de conexión al servidor ----------------
 
 /**
@@ -105,6 +199,60 @@ typedef struct {
  */
 #define SERVER_PORT    5000
 
+/**
+ * Máximo de líneas del servidor que se procesan en un mismo frame.
+ * Evita que una ráfaga muy grande congele el render; lo que sobre se
+ * procesa en el frame siguiente.
+ */
+#define MAX_LINES_PER_FRAME 512
+
+/**
+ * Si vale 1, el cliente pide el protocolo binario (+BIN) en JOIN/SPECTATE.
+ * Si el servidor no lo confirma, se sigue usando el protocolo de texto.
+ * Se puede desactivar al compilar con -DCLIENT_USE_BINARY_PROTOCOL=0.
+ */
+#ifndef CLIENT_USE_BINARY_PROTOCOL
+#define CLIENT_USE_BINARY_PROTOCOL 1
+#endif
+
+/**
+ * Si vale 1, el cliente pide deltas de enemigos/frutas (+DELTA): el servidor
+ * solo envía lo que cambió desde el snapshot anterior. Si se detecta un
+ * hueco en la secuencia, el cliente pide listas completas con RESYNC.
+ */
+#ifndef CLIENT_USE_DELTA_UPDATES
+#define CLIENT_USE_DELTA_UPDATES 1
+#endif
+
+// ---------------- Protocolo binario (+BIN) ----------------
+// Debe coincidir con Server/BinaryProtocol.java.
+// Trama: u16 longitud (tipo + carga) | u8 tipo | carga. Todo big-endian.
+
+#define BIN_MSG_TEXT     1  /* línea de texto encapsulada               */
+#define BIN_MSG_STATE    2  /* u32 seq, u16 id, i16 x, i16 y, i32 score,
+                               u16 nivel, u16 vidas, u8 gameOver        */
+#define BIN_MSG_MAP      3  /* u16 ancho, u16 alto, ancho*alto bytes    */
+#define BIN_MSG_FRUITS   4  /* u16 id, u32 seq, u16 n,
+                               n*(u16 eid, i16 x, i16 y, i32 pts)       */
+#define BIN_MSG_ENEMIES  5  /* u16 id, u32 seq, u16 n,
+                               n*(u16 eid, u8 tipo, i16 x, i16 y)       */
+#define BIN_MSG_FRUITS_DELTA  6  /* u16 id, u32 seq, u16 n,
+                                    n*(u8 op, u16 eid, i16 x, i16 y, i32 pts) */
+#define BIN_MSG_ENEMIES_DELTA 7  /* u16 id, u32 seq, u16 n,
+                                    n*(u8 op, u16 eid, u8 tipo, i16 x, i16 y) */
+
+// ---------------- Deltas de enemigos/frutas ----------------
+// Deben coincidir con GameSession.OP_* del servidor.
+
+#define DELTA_OP_ADD     1  /* la entidad aparece (o se reenvía completa) */
+#define DELTA_OP_MOVE    2  /* la entidad cambió de posición              */
+#define DELTA_OP_REMOVE  3  /* la entidad desapareció                     */
+
+/* Estado del bloque de texto en curso (listas completas o deltas) */
+#define BLOCK_NONE   0
+#define BLOCK_FULL   1
+#define BLOCK_DELTA  2
+
 // ---------------- Roles del cliente ----------------
 
 /**
@@ -123,13 +271,396 @@ typedef struct {
 #define ROLE_SPECTATOR  2
 
 
+// ---------------- Grabación y reproducción ----------------
+
+/** Largo de la firma "DKREC1" al inicio de cada grabación. */
+#define REPLAY_MAGIC_LENGTH  6
+
+/** Cabecera del archivo: firma, rol y un byte reservado. */
+#define REPLAY_HEADER_SIZE   8
+
+/** Cabecera de cada registro: u32 ms + u32 largo. */
+#define REPLAY_RECORD_HEADER 8
+
+/**
+ * Grabación en curso de lo que llega del servidor (ver client_replay.c).
+ *
+ * - file    : archivo abierto, NULL si no se está grabando.
+ * - startMs : client_now_ms() al abrir; los registros guardan ms desde ahí.
+ */
+typedef struct {
+    FILE  *file;
+    double startMs;
+} Recorder;
+
+/**
+ * Grabación mapeada en memoria que reemplaza al socket de un LineReader.
+ *
+ * - file, mapping : handles de Windows del archivo y de su mapeo.
+ * - base, size    : vista de solo lectura del archivo completo.
+ * - end           : fin del último registro completo.
+ * - pos, partial  : registro actual y bytes ya entregados de él.
+ * - role          : ROLE_* de la sesión grabada.
+ * - durationMs    : marca de tiempo del último registro.
+ * - clockMs       : reloj de reproducción; llegan los registros con
+ *                   marca <= clockMs.
+ * - speed, paused : control de la reproducción (lo maneja la interfaz).
+ */
+typedef struct {
+    HANDLE               file;
+    HANDLE               mapping;
+    const unsigned char *base;
+    size_t               size;
+    size_t               end;
+    size_t               pos;
+    size_t               partial;
+    int                  role;
+    double               durationMs;
+    double               clockMs;
+    double               speed;
+    int                  paused;
+} ReplaySource;
+
+
+// ---------------- Lectura con búfer ----------------
+
+/**
+ * Capacidad del búfer de lectura por socket. Un bloque MAP o ENEMIES
+ * completo cabe en una sola llamada a recv().
+ */
+#define LINE_READER_CAPACITY 8192
+
+/**
+ * Valor devuelto por line_reader_next() en modo no bloqueante cuando aún
+ * no hay una línea completa disponible.
+ */
+#define LINE_PENDING (-2)
+
+/**
+ * Lector de líneas con búfer propio para un socket.
+ *
+ * Se hace un recv() grande y luego se buscan los '\n' con memchr(); las
+ * líneas se entregan como vistas dentro de data[]. Los bytes consumidos
+ * se compactan hacia el inicio solo cuando hace falta espacio.
+ *
+ * - socket_fd : socket del que se lee.
+ * - start     : primer byte aún no entregado.
+ * - end       : fin de los datos válidos.
+ * - blockedMs : tiempo acumulado dentro de recv() (estadísticas).
+ * - recorder  : si no es NULL, cada recv() se agrega a la grabación.
+ * - replay    : si no es NULL, se lee de la grabación en vez del socket.
+ * - data      : búfer (+1 para poder terminar siempre en '\0').
+ */
+typedef struct {
+    SOCKET        socket_fd;
+    int           start;
+    int           end;
+    double        blockedMs;
+    Recorder     *recorder;
+    ReplaySource *replay;
+    char          data[LINE_READER_CAPACITY + 1];
+} LineReader;
+
+
+// ---------------- Envío agrupado ----------------
+
+/**
+ * Capacidad de la cola de salida. Sobra para todos los INPUT y comandos
+ * de control que se generan en un frame.
+ */
+#define SEND_QUEUE_CAPACITY 4096
+
+/**
+ * Cola de salida por socket.
+ *
+ * Las líneas se acumulan durante el frame con send_queue_push() y se
+ * escriben juntas con un único send_queue_flush(), en vez de un send()
+ * por línea.
+ *
+ * - socket_fd : socket destino.
+ * - length    : bytes pendientes en data.
+ * - data      : contenido acumulado (sin terminador).
+ */
+typedef struct {
+    SOCKET socket_fd;
+    int    length;
+    char   data[SEND_QUEUE_CAPACITY];
+} SendQueue;
+
+
+// ---------------- Predicción local del jugador ----------------
+
+/**
+ * Si vale 1, el jugador se mueve en pantalla apenas se presiona la tecla
+ * (predicción local) y se corrige cuando llega el STATE del servidor.
+ */
+#ifndef CLIENT_USE_PREDICTION
+#define CLIENT_USE_PREDICTION 1
+#endif
+
+/**
+ * Periodo del tick del servidor (scheduleAtFixedRate en Server.start).
+ * El servidor aplica a lo sumo un INPUT por tick, así que el cliente
+ * envía a ese mismo ritmo.
+ */
+#define SERVER_TICK_MS 125
+
+/**
+ * STATE por segundo como máximo: uno por tick. Es lo que anuncia el
+ * jugador con +RATE (todos los cambios, nada si la sesión está quieta).
+ */
+#define STATE_RATE_MAX (1000 / SERVER_TICK_MS)
+
+/**
+ * Límites lógicos de movimiento; deben coincidir con
+ * Server.MIN_X/MAX_X/MIN_Y/MAX_Y.
+ */
+#define WORLD_MIN_X 0
+#define WORLD_MAX_X 13
+#define WORLD_MIN_Y 0
+#define WORLD_MAX_Y 13
+
+/**
+ * Cantidad de INPUT sin confirmar que se recuerdan (potencia de 2).
+ * A un INPUT por tick alcanza para 8 s de latencia.
+ */
+#define PREDICTION_HISTORY 64
+
+/** Un INPUT enviado y aún no reconocido por el servidor. */
+typedef struct {
+    int    seq;
+    int    dx;
+    int    dy;
+    double sentMs; /* client_now_ms() al enviarlo, para medir el RTT */
+} InputRecord;
+
+/**
+ * Estado de la predicción del jugador local.
+ *
+ * - enabled      : 0 en modo espectador o si el servidor no envía acks.
+ * - lastSentSeq  : seq del último INPUT enviado.
+ * - lastAckSeq   : último seq reconocido por el servidor (campo final de STATE).
+ * - serverX/Y    : última posición autoritativa recibida.
+ * - lastSendMs   : momento del último envío (para un INPUT por tick).
+ * - hasQueued    : hay un input esperando su turno de envío.
+ * - queuedDx/Dy  : ese input (combinado con la misma regla que el servidor).
+ * - history      : anillo de INPUT enviados, indexado por seq.
+ */
+typedef struct {
+    int    enabled;
+    int    lastSentSeq;
+    int    lastAckSeq;
+    int    serverX;
+    int    serverY;
+    double lastSendMs;
+    int    hasQueued;
+    int    queuedDx;
+    int    queuedDy;
+    InputRecord history[PREDICTION_HISTORY];
+} Prediction;
+
+
+// ---------------- Interpolación de entidades ----------------
+
+/**
+ * Retardo de interpolación en ms para enemigos y jugador espectado: cada
+ * cambio de posición se recorre en este tiempo en vez de saltar de tile.
+ * Conviene que sea al menos el periodo de difusión del servidor.
+ */
+#ifndef CLIENT_INTERP_DELAY_MS
+#define CLIENT_INTERP_DELAY_MS SERVER_TICK_MS
+#endif
+
+/**
+ * Suavizado del jugador local cuando hay predicción. Es más corto que el
+ * retardo general para no devolverle la latencia que quita la predicción.
+ */
+#ifndef CLIENT_PLAYER_SMOOTH_MS
+#define CLIENT_PLAYER_SMOOTH_MS 60
+#endif
+
+/** Saltos mayores a estos tiles (respawn, meta) se dibujan sin interpolar. */
+#define INTERP_SNAP_TILES 3
+
+/**
+ * Trayectoria de una entidad entre dos snapshots con marca de tiempo.
+ *
+ * - id      : id estable de la entidad (EnemyInfo.id).
+ * - used    : la pista está asignada.
+ * - touched : se vio en la última actualización (las demás se liberan).
+ * - x0,y0,t0: posición de partida (la que se dibujaba al llegar el cambio).
+ * - x1,y1,t1: posición del servidor y momento en que se alcanza.
+ */
+typedef struct {
+    int    id;
+    int    used;
+    int    touched;
+    float  x0, y0;
+    float  x1, y1;
+    double t0, t1;
+} InterpTrack;
+
+/**
+ * Búfer de interpolación del render.
+ *
+ * - delayMs / playerDelayMs : retardos configurables (ver arriba).
+ * - capacity                : tamaño de enemies/enemyX/enemyY (igual a
+ *                             ClientState.enemyCapacity).
+ * - player  / enemies       : pistas por entidad.
+ * - playerX/Y, enemyX/Y     : posiciones a dibujar en este frame (en
+ *                             tiles, con decimales); enemyX/Y va en el
+ *                             mismo orden que ClientState.enemies.
+ */
+typedef struct {
+    double       delayMs;
+    double       playerDelayMs;
+    int          capacity;
+    InterpTrack  player;
+    InterpTrack *enemies;
+    float        playerX, playerY;
+    float       *enemyX;
+    float       *enemyY;
+} Interpolator;
+
+
+// ---------------- Estadísticas (overlay F3 / CSV F4) ----------------
+
+/** Frames recordados para los percentiles de tiempo de frame. */
+#define STATS_FRAME_SAMPLES 256
+
+/** Muestras de RTT INPUT→ack recordadas. */
+#define STATS_RTT_SAMPLES   64
+
+/** Archivo donde se agrega una fila por segundo con F4. */
+#define STATS_CSV_PATH "client_stats.csv"
+
+/* Categorías de mensajes recibidos (por tag de texto o tipo de trama) */
+#define STATS_TAG_STATE  0
+#define STATS_TAG_FRUIT  1
+#define STATS_TAG_ENEMY  2
+#define STATS_TAG_MAP    3
+#define STATS_TAG_OTHER  4
+#define STATS_TAG_COUNT  5
+
+/* Fases del tick del servidor, en el orden del mensaje STATS */
+#define SERVER_PHASE_INPUT     0
+#define SERVER_PHASE_GRAVITY   1
+#define SERVER_PHASE_ENEMIES   2
+#define SERVER_PHASE_BROADCAST 3
+#define SERVER_PHASE_COUNT     4
+
+/**
+ * Resumen de un segundo del servidor (bloque STATS ... STATS_END que
+ * llega tras "STATS ON"). Tiempos en milisegundos.
+ *
+ * - ticks / overruns      : totales desde que arrancó el servidor.
+ * - windowOverruns        : ticks más largos que el período en el segundo.
+ * - lateMaxMs             : mayor atraso de un tick respecto del calendario.
+ * - tickAvgMs / tickMaxMs : duración del tick.
+ * - phaseMs               : promedio por tick de cada SERVER_PHASE_*.
+ * - clients               : clientes conectados.
+ * - worst*                : el cliente con el envío más lento del segundo
+ *                           (id de sesión, mensajes en cola, tiempos).
+ * - coalescedStates       : STATE reemplazados en colas de salida lentas.
+ * - droppedMessages       : mensajes de juego descartados por cola llena.
+ * - inputLines            : líneas INPUT recibidas por el servidor en el segundo.
+ * - logLines / logDropped : líneas de registro escritas y descartadas (buffer
+ *                           lleno) en el segundo; -1 si el servidor no las envía.
+ */
+typedef struct {
+    int    valid;
+    long   ticks;
+    long   overruns;
+    int    windowOverruns;
+    double lateMaxMs;
+    double tickAvgMs;
+    double tickMaxMs;
+    double phaseMs[SERVER_PHASE_COUNT];
+    int    clients;
+    int    worstId;
+    int    worstDepthMax;
+    double worstSendAvgMs;
+    double worstSendMaxMs;
+    int    coalescedStates;
+    int    droppedMessages;
+    int    inputLines;
+    int    logLines;
+    int    logDropped;
+} ServerStats;
+
+/**
+ * Contadores de rendimiento del cliente. Se acumulan durante una ventana
+ * de un segundo y al cerrarla se publican en los campos "último segundo".
+ *
+ * - overlay / csv        : overlay visible / archivo CSV abierto.
+ * - frameMs, rttMs       : anillos de tiempos de frame y de RTT INPUT→ack.
+ * - windowStartMs        : inicio de la ventana actual.
+ * - lastFrameMs          : marca del frame anterior.
+ * - blockedAtStart       : LineReader.blockedMs al abrir la ventana.
+ * - lines / bytes        : mensajes y bytes por categoría en la ventana.
+ * - frameP50/P95/P99     : percentiles del tiempo de frame (ms).
+ * - rttP50 / rttMax      : RTT mediano y máximo (ms), -1 si no hay datos.
+ * - blockedMsPerSec      : ms por segundo dentro de recv().
+ * - linesPerSec/bytesPerSec : por categoría, del último segundo.
+ * - linesTotal/bytesTotal : por categoría, desde stats_reset() (no se
+ *                           reinician por ventana; los usa el soak).
+ * - rttTotal              : muestras de RTT registradas desde stats_reset();
+ *                           las últimas min(rttTotal, rttCount) siguen en rttMs.
+ * - serverSubscribed     : ya se envió "STATS ON" en esta conexión.
+ * - server / pendingServer : último bloque STATS completo / en recepción.
+ */
+typedef struct {
+    int    overlay;
+    FILE  *csv;
+
+    double frameMs[STATS_FRAME_SAMPLES];
+    int    frameCount;
+    int    frameNext;
+    double rttMs[STATS_RTT_SAMPLES];
+    int    rttCount;
+    int    rttNext;
+
+    double windowStartMs;
+    double lastFrameMs;
+    double blockedAtStart;
+    long   lines[STATS_TAG_COUNT];
+    long   bytes[STATS_TAG_COUNT];
+
+    double frameP50, frameP95, frameP99;
+    double rttP50, rttMax;
+    double blockedMsPerSec;
+    long   linesPerSec[STATS_TAG_COUNT];
+    long   bytesPerSec[STATS_TAG_COUNT];
+    long   linesTotal[STATS_TAG_COUNT];
+    long   bytesTotal[STATS_TAG_COUNT];
+    long   rttTotal;
+
+    int         serverSubscribed;
+    ServerStats server;
+    ServerStats pendingServer;
+} ClientStats;
+
+
 // ---------------- Estado del cliente ----------------
 
+/** Largo máximo (con el '\0') del token de REJOIN que manda JOINED. */
+#define REJOIN_TOKEN_MAX 32
+
 /**
  * Estructura que representa el estado lógico del cliente.
  * 
  * Campos:
  *  - socket_fd : descriptor de socket WinSock asociado al servidor.
+ *  - reader    : lector con búfer asociado a socket_fd.
+ *  - outbox    : cola de salida que se vacía una vez por frame.
+ *  - binaryProtocol: 1 si el servidor confirmó el protocolo binario (+BIN).
+ *  - serverMapHash : huella del mapa anunciada en WELCOME (0 = desconocida).
+ *  - rejoinToken   : token de JOINED para volver a la misma sesión con
+ *                    REJOIN ("" = no hay; la próxima partida hace JOIN).
+ *  - stateRate     : STATE por segundo que se anuncia con +RATE=<n> en
+ *                    JOIN/SPECTATE (1..STATE_RATE_MAX); el servidor manda
+ *                    solo los que cambian, sin pasarse de ese ritmo. 0 =
+ *                    no se anuncia: un STATE por tick, cambie o no.
  *  - role      : rol actual del cliente (ROLE_PLAYER o ROLE_SPECTATOR).
  *  - connected : indica si el socket está conectado (1) o no (0).
  *  - map       : copia local del mapa lógico enviado por el servidor.
@@ -138,15 +669,32 @@ typedef struct {
  *  - playerY   : coordenada Y lógica del jugador (en tiles).
  *  - score     : puntuación actual del jugador.
  *  - gameOver  : indica si el servidor marca la partida como terminada.
+ *  - arena     : memoria del mapa y de las listas (se vacía por mapa).
  *  - numPlayers: cantidad de jugadores en la partida
  *  - numFruits : cantidad de frutas en la partida
  *  - numEnemies: cantidad de enemigos en la partida
+ *  - *Capacity : elementos reservados en cada lista (ver storage_reserve_*)
+ *  - pending*  : copias en construcción de frutas/enemigos (doble búfer)
+ *  - fruitSeq / enemySeq : último snapshot aplicado (-1 = esperando keyframe)
+ *  - in*Block  : bloque de texto en curso (BLOCK_*)
+ *  - resyncRequested : ya se envió RESYNC y se espera el keyframe
+ *  - prediction: INPUT sin confirmar y última posición del servidor;
+ *                playerX/playerY son la posición predicha.
+ *  - interp    : posiciones suavizadas entre ticks (las que se dibujan).
+ *  - stats     : contadores del overlay de depuración.
  */
 typedef struct {
-    SOCKET socket_fd;
-    int    role;
-    int    connected;
+    SOCKET     socket_fd;
+    LineReader reader;
+    SendQueue  outbox;
+    int        role;
+    int        connected;
+    int        binaryProtocol;
+    unsigned int serverMapHash;
+    char       rejoinToken[REJOIN_TOKEN_MAX];
+    int        stateRate;
 
+    Arena   arena;
     GameMap map;
 
     int playerId;
@@ -157,14 +705,41 @@ typedef struct {
     int lives;   /* vidas restantes */
     int gameOver;
 
-    int        numPlayers;
-    PlayerInfo players[MAX_PLAYERS];
+    int         numPlayers;
+    int         playerCapacity;
+    PlayerInfo *players;
+
+    int        numFruits;
+    int        fruitCapacity;
+    FruitInfo *fruits;
+
+    int        numEnemies;
+    int        enemyCapacity;
+    EnemyInfo *enemies;
+
+    /* Búfer trasero: los bloques *_BEGIN ... *_END se arman aquí y solo se
+     * copian a fruits/enemies al llegar *_END, para que el render nunca
+     * dibuje una lista a medio recibir. Misma capacidad que el frontal. */
+    int        pendingNumFruits;
+    FruitInfo *pendingFruits;
+
+    int        pendingNumEnemies;
+    EnemyInfo *pendingEnemies;
+
+    /* Secuencia de snapshots para los deltas (+DELTA) */
+    int fruitSeq;
+    int enemySeq;
+    int pendingFruitSeq;
+    int pendingEnemySeq;
+    int inFruitBlock;
+    int inEnemyBlock;
+    int resyncRequested;
+
+    Prediction prediction;
 
-    int numFruits;
-    FruitInfo fruits[MAX_FRUITS];
+    Interpolator interp;
 
-    int numEnemies;
-    EnemyInfo enemies[MAX_ENEMIES];
+    ClientStats stats;
 
     int spectateId;
 
@@ -184,6 +759,33 @@ typedef struct {
  */
 SOCKET create_and_connect_socket(const char *ip, int port);
 
+/**
+ * Crea un socket TCP que escucha en 127.0.0.1 (relay de espectadores).
+ *
+ * @param port Puerto TCP local.
+ * @return     SOCKET en escucha, o INVALID_SOCKET en caso de error.
+ */
+SOCKET create_listen_socket(int port);
+
+/**
+ * Pone el socket en modo no bloqueante (send/recv devuelven WSAEWOULDBLOCK).
+ *
+ * @param socket_fd Socket a modificar.
+ * @return 0 en éxito, -1 en error.
+ */
+int socket_set_nonblocking(SOCKET socket_fd);
+
+/**
+ * Un send() sobre un socket no bloqueante: envía lo que el kernel acepte.
+ *
+ * @param socket_fd Socket no bloqueante.
+ * @param data      Bytes a enviar.
+ * @param len       Cantidad de bytes.
+ * @return Bytes enviados (0 si el búfer del socket está lleno), o -1 si
+ *         la conexión falló.
+ */
+int socket_send_some(SOCKET socket_fd, const char *data, int len);
+
 /**
  * Envía una línea de texto al servidor a través del socket indicado.
  *
@@ -193,6 +795,37 @@ SOCKET create_and_connect_socket(const char *ip, int port);
  */
 void send_line(SOCKET socket_fd, const char *line);
 
+/**
+ * Inicializa una cola de salida vacía asociada a un socket.
+ *
+ * @param queue     Cola a inicializar.
+ * @param socket_fd Socket al que se escribirá.
+ */
+void send_queue_init(SendQueue *queue, SOCKET socket_fd);
+
+/**
+ * Agrega una línea a la cola de salida sin enviarla todavía.
+ *
+ * Si la línea no cabe, primero se vacía la cola.
+ *
+ * @param queue Cola de salida.
+ * @param line  Línea a encolar (debe incluir '\n').
+ * @return 0 en éxito, -1 si hubo que vaciar la cola y el envío falló.
+ */
+int send_queue_push(SendQueue *queue, const char *line);
+
+/**
+ * Escribe todo el contenido de la cola en una sola ráfaga.
+ *
+ * Reintenta hasta que send() haya aceptado todos los bytes (envíos
+ * parciales) y deja la cola vacía. Con socket_fd == INVALID_SOCKET
+ * (reproducción de una grabación) el contenido se descarta.
+ *
+ * @param queue Cola de salida.
+ * @return 0 en éxito (o si no había nada), -1 en error de socket.
+ */
+int send_queue_flush(SendQueue *queue);
+
 /**
  * Cierra un socket WinSock de forma segura.
  *
@@ -204,16 +837,616 @@ void close_socket(SOCKET socket_fd);
 /**
  * Recibe una línea de texto desde el servidor (terminada en '\n').
  *
- * La función lee del socket carácter por carácter hasta encontrar
- * un '\n' o hasta llenar el búfer (dejando siempre espacio para '\0').
+ * Envoltorio con copia sobre line_reader_next(): conserva el contrato
+ * histórico (se elimina el '\r' final y se devuelve -1 al cerrarse la
+ * conexión). Si la línea no cabe en el búfer se entrega truncada.
  *
- * @param socket_fd  Descriptor de socket WinSock desde el que se lee.
+ * @param reader     Lector con búfer asociado al socket.
  * @param buffer     Búfer de destino donde se almacenará la línea.
  * @param bufferSize Tamaño total del búfer en bytes.
  * @return Número de caracteres leídos (sin contar el '\0') en caso de éxito,
  *         o -1 si la conexión se cerró o hubo un error.
  */
-int recv_line(SOCKET socket_fd, char *buffer, int bufferSize);
+int recv_line(LineReader *reader, char *buffer, int bufferSize);
+
+/**
+ * Inicializa un lector de líneas vacío asociado a un socket.
+ *
+ * @param reader    Lector a inicializar.
+ * @param socket_fd Socket del que leerá.
+ */
+void line_reader_init(LineReader *reader, SOCKET socket_fd);
+
+/**
+ * Entrega la siguiente línea completa como vista sin copia.
+ *
+ * El puntero devuelto apunta dentro del búfer del lector (terminado en
+ * '\0', sin '\r\n') y solo es válido hasta la próxima llamada
+ * sobre el mismo lector.
+ *
+ * @param reader   Lector con búfer asociado al socket.
+ * @param line     Salida: inicio de la línea dentro del búfer.
+ * @param blocking 1 para esperar hasta tener una línea; 0 para devolver
+ *                 LINE_PENDING si todavía no hay una línea completa.
+ * @return Longitud de la línea, LINE_PENDING, o -1 si la conexión se
+ *         cerró o hubo un error.
+ */
+int line_reader_next(LineReader *reader, char **line, int blocking);
+
+/**
+ * Entrega la siguiente trama binaria completa como vista sin copia.
+ *
+ * Solo se usa cuando se negoció el protocolo binario. La vista empieza en
+ * el byte de tipo (sin el prefijo de longitud) y es válida hasta la
+ * próxima llamada sobre el mismo lector.
+ *
+ * @param reader   Lector con búfer asociado al socket.
+ * @param frame    Salida: inicio de la trama (byte de tipo).
+ * @param blocking 1 para esperar; 0 para devolver LINE_PENDING si la trama
+ *                 todavía no llegó completa.
+ * @return Longitud de la trama (tipo + carga), LINE_PENDING, o -1 si la
+ *         conexión se cerró, hubo un error o la trama es inválida.
+ */
+int line_reader_next_frame(LineReader *reader, unsigned char **frame, int blocking);
+
+/**
+ * Indica si el socket tiene datos listos para leer, sin consumirlos.
+ *
+ * @param socket_fd Descriptor de socket WinSock.
+ * @param timeoutMs Tiempo máximo de espera en milisegundos (0 = no esperar).
+ * @return 1 si hay datos (o el servidor cerró la conexión), 0 si no hay
+ *         nada pendiente, o -1 en caso de error.
+ */
+int socket_wait_readable(SOCKET socket_fd, int timeoutMs);
+
+
+// ---------------- Prototipos: grabación y reproducción ----------------
+
+/**
+ * Crea el archivo de grabación y escribe su cabecera.
+ *
+ * @param rec  Grabación a abrir.
+ * @param path Ruta del archivo (se trunca si existe).
+ * @param role ROLE_* de la sesión, para saber cómo reproducirla.
+ * @return 0 en éxito, -1 si no se pudo crear.
+ */
+int recorder_open(Recorder *rec, const char *path, int role);
+
+/**
+ * Ruta de la grabación de la partida número `game` de --record: la
+ * primera usa `path` tal cual y las siguientes le agregan "-<n>" antes de
+ * la extensión ("partida.rec" -> "partida-2.rec"), para que una partida
+ * nueva no pise la anterior.
+ *
+ * @param out  Destino de la ruta.
+ * @param size Tamaño de out (se recorta si no alcanza).
+ * @param path Ruta indicada en --record.
+ * @param game Número de partida, desde 1.
+ */
+void recorder_game_path(char *out, size_t size, const char *path, int game);
+
+/**
+ * Agrega a la grabación un bloque recibido, con su marca de tiempo.
+ *
+ * @param rec  Grabación abierta (si no lo está, no hace nada).
+ * @param data Bytes tal como los devolvió recv().
+ * @param len  Cantidad de bytes.
+ */
+void recorder_write(Recorder *rec, const char *data, int len);
+
+/**
+ * Cierra la grabación.
+ *
+ * @param rec Grabación a cerrar (puede no estar abierta).
+ */
+void recorder_close(Recorder *rec);
+
+/**
+ * Abre y mapea una grabación para reproducirla.
+ *
+ * @param src  Fuente a inicializar (reloj en 0, velocidad 1x).
+ * @param path Ruta del archivo.
+ * @return 0 en éxito, -1 si no existe o no es una grabación.
+ */
+int replay_open(ReplaySource *src, const char *path);
+
+/**
+ * Reproduce una grabación que ya está en memoria (mismo formato que el
+ * archivo). El búfer sigue siendo del llamador y debe vivir mientras se use.
+ *
+ * @param src  Fuente a inicializar.
+ * @param data Cabecera y registros.
+ * @param size Bytes en data.
+ * @return 0 en éxito, -1 si data no es una grabación.
+ */
+int replay_open_memory(ReplaySource *src, const unsigned char *data, size_t size);
+
+/**
+ * Desmapea y cierra la grabación.
+ *
+ * @param src Fuente abierta con replay_open().
+ */
+void replay_close(ReplaySource *src);
+
+/**
+ * Vuelve al inicio de la grabación con el reloj en 0.
+ *
+ * @param src Fuente abierta.
+ */
+void replay_rewind(ReplaySource *src);
+
+/**
+ * Indica si el próximo registro ya corresponde según src->clockMs.
+ *
+ * @param src Fuente abierta.
+ * @return 1 si hay un registro pendiente de entregar, 0 si no.
+ */
+int replay_due(const ReplaySource *src);
+
+/**
+ * Entrega el siguiente registro como si fuera un recv(). Si era del
+ * futuro, adelanta el reloj hasta su marca.
+ *
+ * @param src      Fuente abierta.
+ * @param dest     Búfer de destino.
+ * @param capacity Espacio en dest.
+ * @return Bytes copiados, o 0 al final de la grabación.
+ */
+int replay_read(ReplaySource *src, char *dest, int capacity);
+
+
+// ---------------- Prototipos: memoria (arena y listas) ----------------
+
+/**
+ * Reserva memoria en la arena, alineada a 16 bytes y puesta a cero.
+ *
+ * @param arena Arena de la que se reserva.
+ * @param size  Bytes pedidos.
+ * @return Puntero válido hasta el próximo arena_reset(), o NULL si
+ *         malloc() falló.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * Libera de golpe todo lo reservado. Si la arena había crecido a varios
+ * bloques, se reemplazan por uno solo con la capacidad total, para que la
+ * próxima carga de un mapa igual no vuelva a pedir memoria.
+ *
+ * @param arena Arena a vaciar.
+ */
+void arena_reset(Arena *arena);
+
+/**
+ * Devuelve toda la memoria de la arena al sistema (al salir).
+ *
+ * @param arena Arena a liberar; queda vacía y reutilizable.
+ */
+void arena_release(Arena *arena);
+
+/**
+ * Vacía la arena y deja mapa, jugadores, frutas, enemigos y pistas de
+ * interpolación sin memoria ni elementos. Se llama al empezar a recibir
+ * un mapa nuevo.
+ *
+ * @param state Estado del cliente.
+ */
+void storage_reset(ClientState *state);
+
+/**
+ * Prepara el mapa para width x height celdas (todas '.') y reserva las
+ * listas de entidades según el área del mapa.
+ *
+ * Si el búfer actual alcanza se reutiliza, por lo que un MSG_MAP a mitad
+ * de partida no pide memoria nueva salvo que el mapa crezca.
+ *
+ * @return 0 en éxito, -1 si las dimensiones son inválidas o no hay memoria
+ *         (el mapa queda vacío).
+ */
+int storage_reserve_map(ClientState *state, int width, int height);
+
+/**
+ * Garantiza espacio para al menos `count` frutas en fruits y
+ * pendingFruits, conservando su contenido.
+ *
+ * @return 0 si hay espacio, -1 si count supera MAX_ENTITIES o no hay memoria.
+ */
+int storage_reserve_fruits(ClientState *state, int count);
+
+/**
+ * Igual que storage_reserve_fruits() para enemies, pendingEnemies y las
+ * pistas de interpolación de enemigos.
+ */
+int storage_reserve_enemies(ClientState *state, int count);
+
+/**
+ * Garantiza espacio para al menos `count` jugadores en players.
+ *
+ * @return 0 si hay espacio, -1 si no hay memoria.
+ */
+int storage_reserve_players(ClientState *state, int count);
+
+/**
+ * Indica si el mapa con esa huella está en la caché local. Si solo está en
+ * disco se carga a memoria (y se verifica su huella) en este momento.
+ *
+ * @param hash Huella anunciada por el servidor.
+ * @return 1 si está, 0 si no.
+ */
+int map_cache_contains(unsigned int hash);
+
+/**
+ * Copia a state->map el mapa guardado con esa huella, como si hubiera
+ * llegado por la red (flags y huella recalculados). Llamar después de
+ * storage_reset().
+ *
+ * @return 0 en éxito, -1 si no está en caché o no hay memoria.
+ */
+int map_cache_load(ClientState *state, unsigned int hash);
+
+/**
+ * Guarda un mapa recién recibido en la caché en memoria y, si es nuevo,
+ * en su archivo en disco (si no se puede escribir, solo queda en memoria).
+ *
+ * @param map Mapa completo, con map_build_flags() ya aplicado.
+ */
+void map_cache_store(const GameMap *map);
+
+
+// ---------------- Prototipos: protocolo ----------------
+
+/**
+ * Decodifica una trama binaria y la aplica sobre el estado del cliente.
+ *
+ * La decodificación es por tabla (un manejador por tipo de mensaje) y lee
+ * los campos de ancho fijo directamente, sin sscanf.
+ *
+ * @param state Estado del cliente a actualizar.
+ * @param frame Trama devuelta por line_reader_next_frame().
+ * @param len   Longitud de la trama.
+ * @return Tipo de mensaje procesado (BIN_MSG_*), o -1 si la trama está
+ *         vacía, es de un tipo desconocido o viene truncada.
+ */
+int protocol_handle_frame(ClientState *state, const unsigned char *frame, int len);
+
+/**
+ * Interpreta una línea del protocolo de texto (STATE, listas completas de
+ * frutas/enemigos y sus deltas) y la aplica sobre el estado del cliente.
+ *
+ * @param state Estado del cliente a actualizar.
+ * @param line  Línea sin '\n' (por ejemplo, la vista de line_reader_next()).
+ */
+void protocol_handle_line(ClientState *state, char *line);
+
+/**
+ * Deja frutas, enemigos y secuencias listos para una nueva partida.
+ *
+ * @param state  Estado del cliente.
+ * @param synced 1 si el cliente parte sincronizado con la sesión (jugador
+ *               recién unido, sesión vacía); 0 si debe esperar un keyframe
+ *               antes de aplicar deltas (espectador).
+ */
+void protocol_reset(ClientState *state, int synced);
+
+/**
+ * Lee el saludo "WELCOME [MAP_HASH <hex>]" con el que el servidor abre
+ * cada conexión y deja serverMapHash (0 si no anuncia huella). Llamar una
+ * vez justo después de conectar, antes de JOIN o SPECTATE.
+ *
+ * @param state Estado del cliente con el socket conectado.
+ * @return 0 en éxito, -1 si se cerró la conexión.
+ */
+int protocol_welcome(ClientState *state);
+
+/**
+ * Envía "JOIN <name>" (con +BIN / +DELTA según la compilación,
+ * +MAPCACHE=<hex> si el mapa anunciado ya está en caché y no se está
+ * grabando, y +RATE=<n> si state->stateRate no es 0) y espera
+ * "JOINED <id>". Deja playerId y binaryProtocol listos.
+ *
+ * @param state Estado del cliente con el socket conectado.
+ * @param name  Nombre del jugador (sin espacios).
+ * @return 0 en éxito, -1 si se cerró la conexión.
+ */
+int protocol_join(ClientState *state, const char *name);
+
+/**
+ * Vuelve a jugar con la sesión anterior: envía "REJOIN <token>" (con las
+ * mismas opciones que JOIN) y espera "JOINED <id>". El servidor reinicia
+ * la sesión guardada en vez de crear una nueva.
+ *
+ * @param state Estado del cliente con el socket conectado y rejoinToken.
+ * @return 0 con JOINED, 1 si no hay token o el servidor lo rechazó (hay
+ *         que usar protocol_join()), -1 si se cerró la conexión.
+ */
+int protocol_rejoin(ClientState *state);
+
+/**
+ * Deja la partida o la sesión observada sin cerrar la conexión: envía
+ * "LEAVE" y descarta lo que siga llegando hasta "LEFT". Después la conexión
+ * vuelve a texto, lista para otro JOIN, REJOIN o SPECTATE.
+ *
+ * @param state Estado del cliente.
+ * @return 0 si la conexión sigue abierta y en texto, -1 si se cerró o el
+ *         servidor no entiende LEAVE (hay que reconectar).
+ */
+int protocol_leave(ClientState *state);
+
+/**
+ * Envía "SPECTATE <targetId>" y espera la respuesta del servidor.
+ *
+ * @param state    Estado del cliente con el socket conectado.
+ * @param targetId Jugador a observar.
+ * @return 0 con SPECTATE_OK, 1 con SPECTATE_WAIT (el jugador no existe),
+ *         -1 si se cerró la conexión.
+ */
+int protocol_spectate(ClientState *state, int targetId);
+
+/**
+ * Recibe el mapa inicial (MAP_SIZE/MAP_ROW/MAP_END o una trama MSG_MAP, o
+ * "MAP_CACHED <hex>" si el servidor aceptó la copia local), ignorando
+ * cualquier otra línea previa. Vacía primero la memoria de la
+ * partida anterior (storage_reset()).
+ *
+ * @param state Estado del cliente ya conectado.
+ * @return 0 si el mapa se recibió correctamente, -1 en caso de error.
+ */
+int protocol_receive_map(ClientState *state);
+
+/**
+ * Tras el mapa de un espectador: aplica la foto de la sesión (frutas,
+ * enemigos y último STATE) como keyframe, hasta recibir el STATE.
+ *
+ * @param state Estado del cliente, ya reiniciado para espectar.
+ * @return 0 con la foto aplicada (o END), -1 si se cerró la conexión.
+ */
+int protocol_receive_snapshot(ClientState *state);
+
+/**
+ * Procesa sin bloquear todo lo que ya llegó del servidor (hasta
+ * MAX_LINES_PER_FRAME mensajes), en texto o binario según lo negociado.
+ *
+ * @param state Estado del cliente.
+ * @return 0 si la conexión sigue abierta, -1 si se cerró o hubo error.
+ */
+int protocol_drain(ClientState *state);
+
+
+// ---------------- Prototipos: reglas del mapa ----------------
+
+/**
+ * Flags TILE_FLAG_* de un carácter de tile.
+ *
+ * @param tile Carácter del mapa.
+ * @return Máscara de flags (0 para vacío o desconocido).
+ */
+int tile_flags(char tile);
+
+/**
+ * Recalcula map->flags y map->hash a partir de map->tiles. Se llama una
+ * vez por mapa recibido; después cada consulta de vecinos es una prueba
+ * de bits.
+ *
+ * @param map Mapa con tiles ya completos.
+ */
+void map_build_flags(GameMap *map);
+
+/**
+ * Flags de la celda (x, y) con las mismas reglas que Server.flagsAt():
+ * fuera de los límites lógicos (WORLD_*) o del mapa es vacío (0).
+ *
+ * @param map Mapa con flags calculados.
+ * @param x   Columna.
+ * @param y   Fila (y=0 abajo).
+ * @return Máscara TILE_FLAG_*.
+ */
+int map_flags_at(const GameMap *map, int x, int y);
+
+
+// ---------------- Prototipos: predicción ----------------
+
+/**
+ * Reinicia la predicción al entrar a un modo de juego.
+ *
+ * @param state   Estado del cliente.
+ * @param enabled 1 para el jugador local, 0 para espectadores.
+ */
+void prediction_reset(ClientState *state, int enabled);
+
+/**
+ * Registra el input del frame actual. Si en el mismo periodo de tick se
+ * generan varios, se conserva el que el servidor elegiría (salto antes que
+ * paso, luego el de mayor |dx|).
+ *
+ * @param state Estado del cliente.
+ * @param dx    Desplazamiento horizontal pedido.
+ * @param dy    Desplazamiento vertical pedido.
+ */
+void prediction_queue_input(ClientState *state, int dx, int dy);
+
+/**
+ * Si ya pasó un tick desde el último envío, encola el INPUT pendiente en
+ * state->outbox y lo aplica de inmediato sobre playerX/playerY.
+ *
+ * @param state Estado del cliente.
+ * @param nowMs Tiempo actual en milisegundos.
+ * @return 1 si se envió un INPUT, 0 si no.
+ */
+int prediction_send_due(ClientState *state, double nowMs);
+
+/**
+ * Aplica un STATE autoritativo: parte de la posición del servidor y vuelve
+ * a simular los INPUT que aún no reconoce.
+ *
+ * @param state  Estado del cliente.
+ * @param x      Posición X del servidor.
+ * @param y      Posición Y del servidor.
+ * @param ackSeq Último INPUT reconocido, o -1 si el servidor no lo informa.
+ */
+void prediction_on_state(ClientState *state, int x, int y, int ackSeq);
+
+
+// ---------------- Prototipos: interpolación ----------------
+
+/**
+ * Vacía el búfer de interpolación y fija sus retardos.
+ *
+ * @param interp        Búfer a reiniciar.
+ * @param delayMs       Retardo para enemigos y jugador espectado.
+ * @param playerDelayMs Retardo para el jugador local.
+ */
+void interp_reset(Interpolator *interp, double delayMs, double playerDelayMs);
+
+/**
+ * Registra las posiciones actuales de jugador y enemigos y calcula dónde
+ * dibujarlos en este frame (state->interp.playerX/Y, enemyX/Y).
+ *
+ * @param state Estado del cliente (se actualiza solo state->interp).
+ * @param nowMs Tiempo actual en milisegundos.
+ */
+void interp_update(ClientState *state, double nowMs);
+
+
+// ---------------- Prototipos: estadísticas ----------------
+
+/**
+ * Reloj monótono de alta resolución (QueryPerformanceCounter).
+ *
+ * @return Milisegundos desde un origen arbitrario.
+ */
+double client_now_ms(void);
+
+/**
+ * Reinicia los contadores (conserva el overlay y el CSV abiertos).
+ *
+ * @param stats Estadísticas a reiniciar.
+ */
+void stats_reset(ClientStats *stats);
+
+/**
+ * Cuenta un mensaje recibido.
+ *
+ * @param stats Estadísticas.
+ * @param tag   Categoría STATS_TAG_*.
+ * @param bytes Bytes del mensaje en el cable.
+ */
+void stats_count(ClientStats *stats, int tag, int bytes);
+
+/**
+ * Registra una muestra de RTT INPUT→ack.
+ *
+ * @param stats Estadísticas.
+ * @param ms    RTT en milisegundos.
+ */
+void stats_rtt(ClientStats *stats, double ms);
+
+/**
+ * Marca el fin de un frame: guarda su duración y, una vez por segundo,
+ * recalcula percentiles y tasas (y escribe la fila CSV si está activo).
+ *
+ * @param state Estado del cliente (usa stats y reader.blockedMs).
+ */
+void stats_frame(ClientState *state);
+
+/**
+ * Activa o desactiva el volcado CSV en STATS_CSV_PATH. Agrega al final
+ * del archivo; el encabezado se escribe solo si está vacío.
+ *
+ * @param stats Estadísticas.
+ */
+void stats_toggle_csv(ClientStats *stats);
+
+/**
+ * Mantiene la suscripción a STATS del servidor igual al overlay: encola
+ * "STATS ON"/"STATS OFF" en state->outbox cuando cambia (o tras reconectar).
+ *
+ * @param state Estado del cliente.
+ */
+void stats_sync_subscription(ClientState *state);
+
+
+// ---------------- Prototipos: render ----------------
+
+/**
+ * Mapas distintos cuya capa de tiles se mantiene dibujada a la vez
+ * (varias sesiones en niveles distintos no se pisan la textura).
+ */
+#define TILE_LAYER_SLOTS 4
+
+/**
+ * Dibuja el mapa estático. Se guarda ya dibujado en una RenderTexture
+ * identificada por map->hash, así que las sesiones que ven el mismo mapa
+ * comparten una sola textura; solo se vuelve a generar para un mapa nuevo.
+ *
+ * @param map      Mapa a dibujar.
+ * @param offsetX  Posición X en pantalla de la esquina superior izquierda.
+ * @param offsetY  Posición Y en pantalla de la esquina superior izquierda.
+ * @param tileSize Lado en pantalla de cada tile (TILE_SIZE = tamaño real).
+ */
+void render_tile_layer(const GameMap *map, float offsetX, float offsetY, float tileSize);
+
+/* Sprites del atlas de entidades. Los tres primeros coinciden con
+ * EnemyInfo.type para poder usar el tipo directamente. */
+#define SPRITE_ENEMY_GENERIC 0
+#define SPRITE_ENEMY_RED     1
+#define SPRITE_ENEMY_BLUE    2
+#define SPRITE_FRUIT         3
+#define SPRITE_PLAYER        4
+#define SPRITE_COUNT         5
+
+/**
+ * Abre un lote de sprites. Todos los render_sprite() hasta
+ * render_sprites_end() salen en un solo draw call.
+ *
+ * @param count Cantidad de quads que se van a agregar.
+ */
+void render_sprites_begin(int count);
+
+/**
+ * Agrega un quad al lote abierto.
+ *
+ * @param sprite Uno de SPRITE_*.
+ * @param x      Esquina superior izquierda en pantalla (X).
+ * @param y      Esquina superior izquierda en pantalla (Y).
+ * @param w      Ancho en píxeles.
+ * @param h      Alto en píxeles.
+ */
+void render_sprite(int sprite, float x, float y, float w, float h);
+
+/**
+ * Cierra el lote abierto con render_sprites_begin().
+ */
+void render_sprites_end(void);
+
+/**
+ * Dibuja mapa y entidades de una sesión en la posición y escala dadas
+ * (posiciones interpoladas: llamar a interp_update() antes).
+ *
+ * @param state    Estado de la sesión.
+ * @param offsetX  Esquina superior izquierda del mapa en pantalla (X).
+ * @param offsetY  Esquina superior izquierda del mapa en pantalla (Y).
+ * @param tileSize Lado en pantalla de cada tile.
+ */
+void render_world(const ClientState *state, float offsetX, float offsetY, float tileSize);
+
+/**
+ * Dibuja la escena completa de una sesión: fondo, mapa centrado,
+ * entidades, HUD y, si corresponde, el overlay de GAME OVER.
+ *
+ * @param state Estado de la sesión.
+ */
+void render_game_scene(const ClientState *state);
+
+/**
+ * Dibuja el overlay de estadísticas (F3) en la esquina superior derecha.
+ *
+ * @param stats Estadísticas a mostrar.
+ */
+void render_stats_overlay(const ClientStats *stats);
+
+/**
+ * Libera los recursos de GPU del render. Llamar antes de CloseWindow().
+ */
+void render_shutdown(void);
 
 
 // ---------------- Prototipos: funciones de interfaz ----------------
@@ -234,8 +1467,10 @@ int run_role_selection_screen(void);
  *
  * @param state Puntero al estado del cliente ya inicializado y con el socket
  *              conectado al servidor.
+ * @return 1 si el jugador pidió "Volver a jugar", 0 si salió al menú o se
+ *         perdió la conexión.
  */
-void run_player_mode(ClientState *state);
+int run_player_mode(ClientState *state);
 
 /**
  * Ejecuta el bucle principal del cliente en modo espectador.
@@ -245,4 +1480,13 @@ void run_player_mode(ClientState *state);
  */
 void run_spectator_mode(ClientState *state);
 
+/**
+ * Reproduce una grabación hecha con --record por el mismo camino de
+ * parseo y dibujo que una sesión en vivo (1x, avance rápido o tick a tick).
+ *
+ * @param state Estado del cliente, sin socket conectado.
+ * @param path  Archivo de la grabación.
+ */
+void run_replay_mode(ClientState *state, const char *path);
+
 #endif //CLIENT_CONSTANTS_H
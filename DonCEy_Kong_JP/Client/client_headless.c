@@ -0,0 +1,965 @@
+/* WinSock limita select() a 64 sockets por defecto; se amplía antes de incluirlo */
+#define FD_SETSIZE 1024
+
+#include "client_constants.h"
+
+/* ============================
+ *  C L I E N T E   S I N   V E N T A N A
+ * ============================
+ *
+ * Ejecutable aparte (sin raylib) para pruebas de carga: abre N jugadores
+ * y M espectadores desde un solo proceso, reutilizando los mismos módulos
+ * de sockets, protocolo y predicción que el cliente con ventana. Cada
+ * segundo imprime cuántos STATE recibe cada sesión: con el tick de
+ * 125 ms del servidor deberían ser 8; si bajan, el tick se está atrasando.
+ *
+ * Uso:
+ *   client_headless [-p jugadores] [-s espectadores] [-t segundos]
+ *                   [-h ip] [-P puerto] [-i guion.txt] [-r semilla]
+ *                   [-T id_a_espectar] [-m patrones] [-R rate_espectadores]
+ *                   [-o reporte.txt] [-L slo_p99_ms]
+ *
+ * El guion (-i) tiene una línea "dx dy" por INPUT ('#' comenta) y se
+ * repite en bucle. Sin guion cada jugador sigue uno de los patrones de -m
+ * (lista separada por comas, repartida en orden entre los jugadores):
+ *   random : al azar entre los movimientos válidos (por defecto).
+ *   jump   : camina de pared a pared saltando cada vez que está apoyado.
+ *   climb  : busca la liana más cercana y la recorre entera, subiendo y
+ *            bajando.
+ *   fruit  : va hacia la fruta más cercana (trepa o salta si está arriba).
+ *
+ * Soak: durante toda la corrida se juntan en histogramas el RTT de cada
+ * INPUT hasta el STATE que lo reconoce y el desvío entre STATE de un
+ * jugador respecto del período del tick (jitter de llegada, con la
+ * resolución de una pasada del bucle), más los bytes recibidos por sesión.
+ * La primera sesión se suscribe a STATS para anotar overruns y atraso del
+ * tick del servidor. Al terminar se imprime un resumen "clave=valor" y,
+ * con -o, se escribe ese mismo texto en un archivo para comparar corridas.
+ * Con -L el p99 del RTT se compara contra ese objetivo: si lo supera (o no
+ * hubo muestras) el proceso termina con código 3. -R pide +RATE=n a los
+ * espectadores, para medir el ahorro de bytes del STATE por cambio.
+ */
+
+/** Pasos de un guion de INPUT. */
+#define HEADLESS_MAX_SCRIPT 1024
+
+/** Espera máxima entre pasadas cuando ningún socket tiene datos (ms). */
+#define HEADLESS_POLL_MS 10
+
+/** STATE por segundo esperados con el tick del servidor. */
+#define HEADLESS_EXPECTED_STATES (1000 / SERVER_TICK_MS)
+
+/** Patrones distintos que admite -m. */
+#define HEADLESS_MAX_PATTERNS 8
+
+/** Baldes de 1 ms de los histogramas del soak; el último junta lo que sobra. */
+#define SOAK_HIST_BUCKETS 4000
+
+/** Patrones de movimiento de los jugadores sin guion (-m). */
+enum {
+    PATTERN_RANDOM,
+    PATTERN_JUMP,
+    PATTERN_CLIMB,
+    PATTERN_FRUIT,
+    PATTERN_COUNT
+};
+
+/** Nombre de cada patrón en -m y en el reporte, en el orden de PATTERN_*. */
+static const char *PATTERN_NAMES[PATTERN_COUNT] = {
+    [PATTERN_RANDOM] = "random",
+    [PATTERN_JUMP]   = "jump",
+    [PATTERN_CLIMB]  = "climb",
+    [PATTERN_FRUIT]  = "fruit",
+};
+
+/** Un paso del guion de INPUT. */
+typedef struct {
+    int dx;
+    int dy;
+} ScriptStep;
+
+/** Opciones de la línea de comandos. */
+typedef struct {
+    int         players;
+    int         spectators;
+    int         seconds;
+    const char *ip;
+    int         port;
+    int         spectateId;   /* -T: objetivo fijo para los espectadores */
+    unsigned    seed;
+    int         spectatorRate; /* -R: +RATE de los espectadores (0 = todos los tick) */
+    const char *reportPath;    /* -o: archivo del reporte, o NULL */
+    double      sloP99Ms;      /* -L: objetivo de RTT p99 (0 = sin chequeo) */
+
+    ScriptStep  script[HEADLESS_MAX_SCRIPT];
+    int         scriptLength;
+
+    int         patterns[HEADLESS_MAX_PATTERNS];
+    int         patternCount;
+    char        patternList[64]; /* -m tal cual, para el reporte */
+} HeadlessOptions;
+
+/**
+ * Una sesión simulada.
+ *
+ * - state      : el mismo estado que usa el cliente con ventana.
+ * - role       : ROLE_PLAYER o ROLE_SPECTATOR.
+ * - alive      : la conexión sigue abierta.
+ * - scriptPos  : próximo paso del guion (jugadores).
+ * - rng        : generador propio, para que cada jugador sea reproducible.
+ * - rejoins    : veces que volvió a entrar tras un game over.
+ * - pattern    : PATTERN_* del jugador (sin guion).
+ * - dir        : sentido de la caminata (+1 derecha, -1 izquierda).
+ * - climbDir   : sentido en la liana (+1 sube, -1 baja).
+ * - rttSeen / statesSeen : stats.rttTotal y STATE ya volcados al soak en
+ *                esta conexión.
+ * - lastStateMs: llegada del último STATE (0 = todavía ninguno).
+ * - bytesDone  : bytes de conexiones anteriores (stats_reset() los borra).
+ */
+typedef struct {
+    ClientState state;
+    int         role;
+    int         alive;
+    int         scriptPos;
+    unsigned    rng;
+    int         rejoins;
+    int         pattern;
+    int         dir;
+    int         climbDir;
+    long        rttSeen;
+    long        statesSeen;
+    double      lastStateMs;
+    long        bytesDone;
+} SimClient;
+
+/**
+ * Distribución de una medida en baldes de 1 ms, para percentiles sobre
+ * toda la corrida sin guardar cada muestra.
+ */
+typedef struct {
+    long   counts[SOAK_HIST_BUCKETS + 1];
+    long   total;
+    double sum;
+    double max;
+} SoakHistogram;
+
+/**
+ * Lo que junta el soak en toda la corrida.
+ *
+ * - latency     : RTT INPUT→ack de todos los jugadores (ms).
+ * - jitter      : |separación entre STATE - SERVER_TICK_MS| de los jugadores.
+ * - serverBlocks: bloques STATS recibidos del servidor.
+ * - overrunsFirst / overrunsLast : contador total de overruns del servidor
+ *                 al empezar y en el último bloque.
+ * - lateMaxMs / tickMaxMs : peor atraso y peor duración de tick vistos.
+ * - lastTicks   : ticks del último bloque (para no contarlo dos veces).
+ * - disconnects : sesiones que el servidor cerró durante la corrida.
+ */
+typedef struct {
+    SoakHistogram latency;
+    SoakHistogram jitter;
+    int           serverBlocks;
+    long          overrunsFirst;
+    long          overrunsLast;
+    double        lateMaxMs;
+    double        tickMaxMs;
+    long          lastTicks;
+    int           disconnects;
+} SoakTotals;
+
+
+/* ============================
+ *  O P C I O N E S
+ * ============================ */
+
+/**
+ * Carga un guion "dx dy" por línea.
+ *
+ * @return 0 en éxito, -1 si no se pudo abrir o no tiene pasos.
+ */
+static int load_script(HeadlessOptions *opts, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("[HEADLESS] No se pudo abrir el guion %s\n", path);
+        return -1;
+    }
+
+    char line[128];
+    opts->scriptLength = 0;
+    while (fgets(line, sizeof(line), f) != NULL &&
+           opts->scriptLength < HEADLESS_MAX_SCRIPT) {
+        ScriptStep step;
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%d %d", &step.dx, &step.dy) == 2) {
+            opts->script[opts->scriptLength++] = step;
+        }
+    }
+    fclose(f);
+
+    return opts->scriptLength > 0 ? 0 : -1;
+}
+
+/**
+ * Carga la lista de patrones de -m ("jump,climb,fruit").
+ *
+ * @return 0 en éxito, -1 si algún nombre no es un patrón.
+ */
+static int parse_patterns(HeadlessOptions *opts, const char *list)
+{
+    char copy[sizeof(opts->patternList)];
+    snprintf(copy, sizeof(copy), "%s", list);
+    snprintf(opts->patternList, sizeof(opts->patternList), "%s", list);
+
+    opts->patternCount = 0;
+    for (char *name = strtok(copy, ","); name != NULL; name = strtok(NULL, ",")) {
+        int found = -1;
+        for (int p = 0; p < PATTERN_COUNT; p++) {
+            if (strcmp(name, PATTERN_NAMES[p]) == 0) {
+                found = p;
+            }
+        }
+        if (found < 0 || opts->patternCount == HEADLESS_MAX_PATTERNS) {
+            printf("[HEADLESS] Patrón inválido: %s\n", name);
+            return -1;
+        }
+        opts->patterns[opts->patternCount++] = found;
+    }
+    return opts->patternCount > 0 ? 0 : -1;
+}
+
+/**
+ * Lee las opciones; lo que no se indica queda con un valor razonable.
+ *
+ * @return 0 en éxito, -1 si hay una opción inválida.
+ */
+static int parse_args(HeadlessOptions *opts, int argc, char **argv)
+{
+    opts->players      = 1;
+    opts->spectators   = 0;
+    opts->seconds      = 30;
+    opts->ip           = SERVER_IP;
+    opts->port         = SERVER_PORT;
+    opts->spectateId   = 0;
+    opts->seed         = 1;
+    opts->scriptLength = 0;
+    opts->spectatorRate = 0;
+    opts->reportPath   = NULL;
+    opts->sloP99Ms     = 0.0;
+    opts->patterns[0]  = PATTERN_RANDOM;
+    opts->patternCount = 1;
+    snprintf(opts->patternList, sizeof(opts->patternList), "%s", PATTERN_NAMES[PATTERN_RANDOM]);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg   = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (value == NULL || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            printf("[HEADLESS] Opción inválida: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        switch (arg[1]) {
+            case 'p': opts->players    = atoi(value); break;
+            case 's': opts->spectators = atoi(value); break;
+            case 't': opts->seconds    = atoi(value); break;
+            case 'h': opts->ip         = value;       break;
+            case 'P': opts->port       = atoi(value); break;
+            case 'T': opts->spectateId = atoi(value); break;
+            case 'r': opts->seed       = (unsigned)strtoul(value, NULL, 10); break;
+            case 'R': opts->spectatorRate = atoi(value); break;
+            case 'o': opts->reportPath = value;       break;
+            case 'L': opts->sloP99Ms   = atof(value); break;
+            case 'm':
+                if (parse_patterns(opts, value) != 0) {
+                    return -1;
+                }
+                break;
+            case 'i':
+                if (load_script(opts, value) != 0) {
+                    return -1;
+                }
+                break;
+            default:
+                printf("[HEADLESS] Opción desconocida: %s\n", arg);
+                return -1;
+        }
+    }
+
+    if (opts->players < 0 || opts->spectators < 0 || opts->seconds <= 0 ||
+        opts->players + opts->spectators <= 0 ||
+        opts->players + opts->spectators > FD_SETSIZE) {
+        printf("[HEADLESS] Cantidades inválidas (máximo %d sesiones)\n", FD_SETSIZE);
+        return -1;
+    }
+    if (opts->spectatorRate < 0 || opts->spectatorRate > STATE_RATE_MAX || opts->sloP99Ms < 0.0) {
+        printf("[HEADLESS] -R va de 0 a %d y -L no puede ser negativo\n", STATE_RATE_MAX);
+        return -1;
+    }
+    if (opts->spectators > 0 && opts->players == 0 && opts->spectateId <= 0) {
+        printf("[HEADLESS] Espectadores sin jugadores propios: falta -T <id>\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+/* ============================
+ *  S E S I O N E S
+ * ============================ */
+
+/** Generador congruencial lineal (rand() es global y no reproducible por sesión). */
+static unsigned next_random(unsigned *rng)
+{
+    *rng = *rng * 1103515245u + 12345u;
+    return (*rng >> 16) & 0x7fff;
+}
+
+/**
+ * Conecta una sesión y la deja lista para el bucle: JOIN o SPECTATE,
+ * mapa inicial y reinicio de protocolo, predicción y estadísticas.
+ *
+ * @return 0 en éxito, -1 si algo falló (la sesión queda cerrada).
+ */
+static int sim_connect(SimClient *sim, const HeadlessOptions *opts, int index, int targetId)
+{
+    ClientState *state = &sim->state;
+    char name[32];
+
+    state->socket_fd = create_and_connect_socket(opts->ip, opts->port);
+    if (state->socket_fd == INVALID_SOCKET) {
+        return -1;
+    }
+    state->connected = 1;
+    line_reader_init(&state->reader, state->socket_fd);
+    send_queue_init(&state->outbox, state->socket_fd);
+
+    int ok = protocol_welcome(state) == 0;
+    if (sim->role == ROLE_PLAYER) {
+        snprintf(name, sizeof(name), "Bot%d", index);
+        ok = ok && protocol_join(state, name) == 0;
+    } else {
+        state->spectateId = targetId;
+        state->stateRate  = opts->spectatorRate;
+        ok = ok && protocol_spectate(state, targetId) == 0;
+    }
+
+    stats_reset(&state->stats);
+    if (!ok || protocol_receive_map(state) != 0) {
+        close_socket(state->socket_fd);
+        state->socket_fd = INVALID_SOCKET;
+        state->connected = 0;
+        return -1;
+    }
+
+    state->playerX  = 0;
+    state->playerY  = 0;
+    state->score    = 0;
+    state->gameOver = 0;
+
+    protocol_reset(state, sim->role == ROLE_PLAYER);
+    prediction_reset(state, sim->role == ROLE_PLAYER && CLIENT_USE_PREDICTION);
+
+    /* Espectador: la foto que sigue al mapa es su keyframe */
+    if (sim->role != ROLE_PLAYER && protocol_receive_snapshot(state) != 0) {
+        close_socket(state->socket_fd);
+        state->socket_fd = INVALID_SOCKET;
+        state->connected = 0;
+        return -1;
+    }
+
+    /* La primera sesión trae los STATS del servidor para el soak */
+    if (index == 0) {
+        state->stats.overlay = 1;
+        stats_sync_subscription(state);
+    }
+    sim->rttSeen     = 0;
+    sim->statesSeen  = 0;
+    sim->lastStateMs = 0.0;
+    sim->alive = 1;
+    return 0;
+}
+
+/** Bytes recibidos por la conexión actual de una sesión. */
+static long sim_connection_bytes(const SimClient *sim)
+{
+    long bytes = 0;
+    for (int t = 0; t < STATS_TAG_COUNT; t++) {
+        bytes += sim->state.stats.bytesTotal[t];
+    }
+    return bytes;
+}
+
+/** Cierra la conexión de una sesión (sus bytes quedan en bytesDone). */
+static void sim_close(SimClient *sim)
+{
+    ClientState *state = &sim->state;
+    sim->bytesDone += sim_connection_bytes(sim);
+    memset(state->stats.bytesTotal, 0, sizeof(state->stats.bytesTotal));
+    if (state->connected && state->socket_fd != INVALID_SOCKET) {
+        close_socket(state->socket_fd);
+    }
+    state->socket_fd = INVALID_SOCKET;
+    state->connected = 0;
+    sim->alive       = 0;
+}
+
+static int sign_of(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+/**
+ * Paso de caminata en el sentido actual; da la vuelta en los bordes, las
+ * paredes y antes de meterse al agua.
+ */
+static int patrol_dx(SimClient *sim)
+{
+    const ClientState *state = &sim->state;
+    int nx = state->playerX + sim->dir;
+    int ahead = map_flags_at(&state->map, nx, state->playerY);
+
+    if (nx < WORLD_MIN_X || nx > WORLD_MAX_X ||
+        (ahead & (TILE_FLAG_WALL | TILE_FLAG_WATER)) != 0) {
+        sim->dir = -sim->dir;
+    }
+    return sim->dir;
+}
+
+/** Columna con liana más cercana en la fila y, o -1 si no hay. */
+static int nearest_liana_x(const GameMap *map, int x, int y)
+{
+    for (int d = 0; d <= WORLD_MAX_X - WORLD_MIN_X; d++) {
+        if (map_flags_at(map, x - d, y) & TILE_FLAG_LIANA) return x - d;
+        if (map_flags_at(map, x + d, y) & TILE_FLAG_LIANA) return x + d;
+    }
+    return -1;
+}
+
+/** Fruta más cercana (distancia Manhattan), o NULL si no queda ninguna. */
+static const FruitInfo *nearest_fruit(const ClientState *state)
+{
+    const FruitInfo *best = NULL;
+    int bestDist = 0;
+    for (int i = 0; i < state->numFruits; i++) {
+        const FruitInfo *f = &state->fruits[i];
+        int dist = abs(f->x - state->playerX) + abs(f->y - state->playerY);
+        if (best == NULL || dist < bestDist) {
+            best     = f;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+/**
+ * Patrón climb: en una liana la recorre entera (da la vuelta arriba del
+ * todo o donde se corta); fuera de ella camina hacia la más cercana o, si
+ * la tiene encima, se cuelga.
+ */
+static void pattern_climb(SimClient *sim, int current, int above, int supported, int ceiling,
+                          int *dx, int *dy)
+{
+    const ClientState *state = &sim->state;
+
+    if (current & TILE_FLAG_LIANA) {
+        int next = map_flags_at(&state->map, state->playerX, state->playerY + sim->climbDir);
+        if (!(next & TILE_FLAG_LIANA) || (sim->climbDir > 0 && ceiling)) {
+            sim->climbDir = -sim->climbDir;
+        }
+        *dy = sim->climbDir;
+        return;
+    }
+    if ((above & TILE_FLAG_LIANA) && supported && !ceiling) {
+        *dy = +1;
+        return;
+    }
+    int lx = nearest_liana_x(&state->map, state->playerX, state->playerY);
+    *dx = lx < 0 ? patrol_dx(sim) : sign_of(lx - state->playerX);
+}
+
+/**
+ * Patrón fruit: sube o baja por la liana hasta la altura de la fruta, se
+ * acerca en horizontal y salta si quedó justo debajo. Sin frutas, climb.
+ */
+static void pattern_fruit(SimClient *sim, int current, int above, int supported, int ceiling,
+                          int *dx, int *dy)
+{
+    const ClientState *state = &sim->state;
+    const FruitInfo   *fruit = nearest_fruit(state);
+
+    if (fruit == NULL) {
+        pattern_climb(sim, current, above, supported, ceiling, dx, dy);
+        return;
+    }
+
+    int fx = fruit->x - state->playerX;
+    int fy = fruit->y - state->playerY;
+    if (fy != 0 && (current & TILE_FLAG_LIANA)) {
+        *dy = sign_of(fy);
+    } else if (fx != 0) {
+        int ahead = map_flags_at(&state->map, state->playerX + sign_of(fx), state->playerY);
+        if ((ahead & TILE_FLAG_WATER) && supported && !ceiling) {
+            *dy = +1;           /* agua adelante: saltarla */
+            *dx = sign_of(fx) * 3;
+        } else {
+            *dx = sign_of(fx);
+        }
+    } else if (fy > 0 && supported && !ceiling) {
+        *dy = +1;
+    } else {
+        pattern_climb(sim, current, above, supported, ceiling, dx, dy);
+    }
+}
+
+/**
+ * Elige el INPUT de este tick: el siguiente paso del guion o, sin guion,
+ * el del patrón del jugador. random elige al azar entre los movimientos
+ * que las mismas reglas del cliente con ventana permitirían (caminar,
+ * saltar si está apoyado, trepar en liana).
+ */
+static void sim_choose_input(SimClient *sim, const HeadlessOptions *opts, int *dx, int *dy)
+{
+    const ClientState *state = &sim->state;
+
+    if (opts->scriptLength > 0) {
+        *dx = opts->script[sim->scriptPos].dx;
+        *dy = opts->script[sim->scriptPos].dy;
+        sim->scriptPos = (sim->scriptPos + 1) % opts->scriptLength;
+        return;
+    }
+
+    int current = map_flags_at(&state->map, state->playerX, state->playerY);
+    int below   = map_flags_at(&state->map, state->playerX, state->playerY - 1);
+    int above   = map_flags_at(&state->map, state->playerX, state->playerY + 1);
+    int supported = ((current | below) & TILE_FLAG_SOLID) != 0;
+    int ceiling   = (above & TILE_FLAG_CEILING) != 0;
+
+    *dx = 0;
+    *dy = 0;
+    switch (sim->pattern) {
+        case PATTERN_JUMP:
+            if (supported && !ceiling && next_random(&sim->rng) % 2 == 0) {
+                *dy = +1;
+                *dx = patrol_dx(sim) * 3;
+            } else {
+                *dx = patrol_dx(sim);
+            }
+            return;
+        case PATTERN_CLIMB:
+            pattern_climb(sim, current, above, supported, ceiling, dx, dy);
+            return;
+        case PATTERN_FRUIT:
+            pattern_fruit(sim, current, above, supported, ceiling, dx, dy);
+            return;
+        default:
+            break;
+    }
+
+    switch (next_random(&sim->rng) % 6) {
+        case 0: *dx = -1; break;
+        case 1: *dx = +1; break;
+        case 2:
+            if (supported && !ceiling) {
+                *dy = +1;
+                *dx = (int)(next_random(&sim->rng) % 3) * 3 - 3; /* -3, 0, +3 */
+            }
+            break;
+        case 3:
+            if ((current & TILE_FLAG_LIANA) && !ceiling) *dy = +1;
+            break;
+        case 4:
+            if (current & TILE_FLAG_LIANA) *dy = -1;
+            break;
+        default:
+            break; /* quieto */
+    }
+}
+
+/**
+ * Una pasada de una sesión: drena lo recibido, manda el INPUT del tick y
+ * vacía la cola de salida.
+ *
+ * @return 0 si sigue viva, -1 si se cerró la conexión.
+ */
+static int sim_step(SimClient *sim, const HeadlessOptions *opts, double nowMs)
+{
+    ClientState *state = &sim->state;
+
+    if (protocol_drain(state) != 0) {
+        return -1;
+    }
+
+    if (sim->role == ROLE_PLAYER && !state->gameOver) {
+        int dx, dy;
+        sim_choose_input(sim, opts, &dx, &dy);
+        prediction_queue_input(state, dx, dy);
+        prediction_send_due(state, nowMs);
+    }
+
+    if (send_queue_flush(&state->outbox) != 0) {
+        return -1;
+    }
+    stats_frame(state);
+    return 0;
+}
+
+/**
+ * Espera hasta HEADLESS_POLL_MS a que algún socket tenga datos, para no
+ * girar en vacío entre ticks del servidor.
+ *
+ * @return 1 si hay al menos una sesión viva, 0 si no queda ninguna.
+ */
+static int wait_any_readable(const SimClient *sims, int count)
+{
+    fd_set readSet;
+    FD_ZERO(&readSet);
+
+    int any = 0;
+    for (int i = 0; i < count; i++) {
+        if (sims[i].alive) {
+            FD_SET(sims[i].state.socket_fd, &readSet);
+            any = 1;
+        }
+    }
+    if (!any) {
+        return 0;
+    }
+
+    struct timeval tv;
+    tv.tv_sec  = 0;
+    tv.tv_usec = HEADLESS_POLL_MS * 1000;
+    select(FD_SETSIZE, &readSet, NULL, NULL, &tv); /* WinSock ignora nfds */
+    return 1;
+}
+
+
+/* ============================
+ *  S O A K
+ * ============================ */
+
+/** Agrega una muestra (ms) al histograma. */
+static void hist_add(SoakHistogram *h, double ms)
+{
+    int bucket = ms <= 0.0 ? 0 : (int)ms;
+    if (bucket > SOAK_HIST_BUCKETS) {
+        bucket = SOAK_HIST_BUCKETS;
+    }
+    h->counts[bucket]++;
+    h->total++;
+    h->sum += ms;
+    if (ms > h->max) {
+        h->max = ms;
+    }
+}
+
+/**
+ * Percentil p (0..1), con la resolución de un balde: el borde superior
+ * del balde donde cae (nunca más que el máximo visto).
+ *
+ * @return ms, o -1 si no hay muestras.
+ */
+static double hist_percentile(const SoakHistogram *h, double p)
+{
+    if (h->total == 0) {
+        return -1.0;
+    }
+    long rank = (long)(p * (double)(h->total - 1)) + 1;
+    long seen = 0;
+    for (int b = 0; b <= SOAK_HIST_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            double upper = (b < SOAK_HIST_BUCKETS) ? b + 1.0 : h->max;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * Vuelca al soak lo que trajo la última pasada de una sesión: RTT nuevos,
+ * separación entre STATE (jugadores) y, en la suscrita, el bloque STATS
+ * del servidor si llegó uno nuevo.
+ */
+static void soak_collect(SoakTotals *soak, SimClient *sim, double nowMs)
+{
+    const ClientStats *st = &sim->state.stats;
+
+    /* Las muestras nuevas siguen en el anillo: son pocas por pasada */
+    long fresh = st->rttTotal - sim->rttSeen;
+    if (fresh > st->rttCount) {
+        fresh = st->rttCount;
+    }
+    for (long k = fresh; k >= 1; k--) {
+        int i = (int)((st->rttNext - k + STATS_RTT_SAMPLES) % STATS_RTT_SAMPLES);
+        hist_add(&soak->latency, st->rttMs[i]);
+    }
+    sim->rttSeen = st->rttTotal;
+
+    long states = st->linesTotal[STATS_TAG_STATE];
+    if (sim->role == ROLE_PLAYER && states > sim->statesSeen) {
+        if (sim->lastStateMs > 0.0) {
+            double gap = nowMs - sim->lastStateMs - SERVER_TICK_MS;
+            hist_add(&soak->jitter, gap < 0.0 ? -gap : gap);
+            /* Los demás de la misma pasada llegaron pegados: separación 0 */
+            for (long k = 1; k < states - sim->statesSeen; k++) {
+                hist_add(&soak->jitter, SERVER_TICK_MS);
+            }
+        }
+        sim->lastStateMs = nowMs;
+    }
+    sim->statesSeen = states;
+
+    const ServerStats *server = &st->server;
+    if (server->valid && server->ticks != soak->lastTicks) {
+        if (soak->serverBlocks == 0) {
+            soak->overrunsFirst = server->overruns - server->windowOverruns;
+        }
+        soak->serverBlocks++;
+        soak->lastTicks    = server->ticks;
+        soak->overrunsLast = server->overruns;
+        if (server->lateMaxMs > soak->lateMaxMs) soak->lateMaxMs = server->lateMaxMs;
+        if (server->tickMaxMs > soak->tickMaxMs) soak->tickMaxMs = server->tickMaxMs;
+    }
+}
+
+/**
+ * Escribe el resumen de la corrida, una "clave=valor" por línea, para
+ * comparar dos corridas con diff. Tiempos en ms, tasas por segundo.
+ *
+ * @return 1 si se cumplió el SLO de -L (o no se pidió), 0 si no.
+ */
+static int write_soak_report(FILE *out, const HeadlessOptions *opts, const SimClient *sims,
+                             int count, const SoakTotals *soak, double elapsedMs,
+                             int lagSeconds, int seconds)
+{
+    double elapsedS = elapsedMs > 0.0 ? elapsedMs / 1000.0 : 1.0;
+    long   bytesAll = 0, bytesPlayers = 0, bytesSpectators = 0, bytesMax = 0;
+    int    alive = 0, rejoins = 0;
+
+    for (int i = 0; i < count; i++) {
+        long bytes = sims[i].bytesDone + sim_connection_bytes(&sims[i]);
+        bytesAll += bytes;
+        if (sims[i].role == ROLE_PLAYER) bytesPlayers += bytes;
+        else                             bytesSpectators += bytes;
+        if (bytes > bytesMax) bytesMax = bytes;
+        alive   += sims[i].alive;
+        rejoins += sims[i].rejoins;
+    }
+
+    const SoakHistogram *lat = &soak->latency;
+    const SoakHistogram *jit = &soak->jitter;
+    double p99 = hist_percentile(lat, 0.99);
+    int    sloOk = opts->sloP99Ms <= 0.0 || (p99 >= 0.0 && p99 <= opts->sloP99Ms);
+
+    fprintf(out, "# DonCEy Kong soak (client_headless)\n");
+    fprintf(out, "players=%d\nspectators=%d\nspectator_rate=%d\npatterns=%s\n",
+            opts->players, opts->spectators, opts->spectatorRate,
+            opts->scriptLength > 0 ? "script" : opts->patternList);
+    fprintf(out, "seed=%u\nseconds=%.1f\nlagging_seconds=%d/%d\n",
+            opts->seed, elapsedS, lagSeconds, seconds);
+    fprintf(out, "sessions_alive=%d/%d\ndisconnects=%d\nrejoins=%d\n",
+            alive, count, soak->disconnects, rejoins);
+
+    fprintf(out, "latency_samples=%ld\n", lat->total);
+    fprintf(out, "latency_avg_ms=%.1f\n", lat->total > 0 ? lat->sum / lat->total : -1.0);
+    fprintf(out, "latency_p50_ms=%.0f\nlatency_p90_ms=%.0f\nlatency_p99_ms=%.0f\n"
+                 "latency_p999_ms=%.0f\nlatency_max_ms=%.1f\n",
+            hist_percentile(lat, 0.50), hist_percentile(lat, 0.90), p99,
+            hist_percentile(lat, 0.999), lat->total > 0 ? lat->max : -1.0);
+
+    fprintf(out, "jitter_samples=%ld\n", jit->total);
+    fprintf(out, "jitter_p50_ms=%.0f\njitter_p99_ms=%.0f\njitter_max_ms=%.1f\n",
+            hist_percentile(jit, 0.50), hist_percentile(jit, 0.99),
+            jit->total > 0 ? jit->max : -1.0);
+
+    fprintf(out, "bytes_per_client_per_sec_avg=%.0f\nbytes_per_client_per_sec_max=%.0f\n",
+            count > 0 ? bytesAll / elapsedS / count : 0.0, bytesMax / elapsedS);
+    fprintf(out, "bytes_per_player_per_sec_avg=%.0f\nbytes_per_spectator_per_sec_avg=%.0f\n",
+            opts->players > 0 ? bytesPlayers / elapsedS / opts->players : 0.0,
+            opts->spectators > 0 ? bytesSpectators / elapsedS / opts->spectators : 0.0);
+
+    fprintf(out, "server_stats_blocks=%d\nserver_overruns=%ld\n"
+                 "server_tick_max_ms=%.2f\nserver_late_max_ms=%.1f\n",
+            soak->serverBlocks,
+            soak->serverBlocks > 0 ? soak->overrunsLast - soak->overrunsFirst : 0L,
+            soak->tickMaxMs, soak->lateMaxMs);
+
+    if (opts->sloP99Ms > 0.0) {
+        fprintf(out, "slo_latency_p99_ms=%.0f\nslo_result=%s\n",
+                opts->sloP99Ms, sloOk ? "PASS" : "FAIL");
+    }
+    fflush(out);
+    return sloOk;
+}
+
+
+/* ============================
+ *  R E P O R T E
+ * ============================ */
+
+/**
+ * Imprime una línea con el último segundo de todas las sesiones.
+ *
+ * @return cantidad de sesiones vivas que recibieron menos STATE de lo
+ *         esperado (tick del servidor atrasado).
+ */
+static int print_report(const SimClient *sims, int count, int second)
+{
+    int    alive = 0, lagging = 0, rejoins = 0;
+    long   minStates = -1, sumStates = 0, msgs = 0, bytes = 0;
+    double worstRttP50 = -1.0, worstRttMax = -1.0;
+
+    for (int i = 0; i < count; i++) {
+        const ClientStats *st = &sims[i].state.stats;
+        rejoins += sims[i].rejoins;
+        if (!sims[i].alive) {
+            continue;
+        }
+        alive++;
+
+        long states = st->linesPerSec[STATS_TAG_STATE];
+        sumStates += states;
+        if (minStates < 0 || states < minStates) {
+            minStates = states;
+        }
+        if (states < HEADLESS_EXPECTED_STATES - 1) {
+            lagging++;
+        }
+
+        for (int t = 0; t < STATS_TAG_COUNT; t++) {
+            msgs  += st->linesPerSec[t];
+            bytes += st->bytesPerSec[t];
+        }
+        if (st->rttP50 > worstRttP50) worstRttP50 = st->rttP50;
+        if (st->rttMax > worstRttMax) worstRttMax = st->rttMax;
+    }
+
+    printf("[HEADLESS] t=%3ds vivas=%d/%d STATE/s min=%ld prom=%.1f (esperado %d) "
+           "atrasadas=%d msg/s=%ld B/s=%ld RTT p50=%.0f max=%.0f ms reingresos=%d\n",
+           second, alive, count, minStates < 0 ? 0 : minStates,
+           alive > 0 ? (double)sumStates / alive : 0.0, HEADLESS_EXPECTED_STATES,
+           lagging, msgs, bytes, worstRttP50, worstRttMax, rejoins);
+    fflush(stdout);
+    return lagging;
+}
+
+
+/* ============================
+ *  P U N T O   D E   E N T R A D A
+ * ============================ */
+
+int main(int argc, char **argv)
+{
+    static HeadlessOptions opts;
+    if (parse_args(&opts, argc, argv) != 0) {
+        return 1;
+    }
+
+    WSADATA wsa;
+    int wsaResult = WSAStartup(MAKEWORD(2, 2), &wsa);
+    if (wsaResult != 0) {
+        printf("WSAStartup fallo: %d\n", wsaResult);
+        return 1;
+    }
+
+    int count = opts.players + opts.spectators;
+    SimClient *sims = calloc((size_t)count, sizeof(SimClient));
+    if (sims == NULL) {
+        WSACleanup();
+        return 1;
+    }
+
+    /* Primero los jugadores: los espectadores se reparten entre ellos */
+    for (int i = 0; i < count; i++) {
+        SimClient *sim = &sims[i];
+        sim->state.socket_fd = INVALID_SOCKET;
+        sim->role = (i < opts.players) ? ROLE_PLAYER : ROLE_SPECTATOR;
+        sim->rng  = opts.seed + (unsigned)i * 7919u;
+        sim->pattern  = opts.patterns[i % opts.patternCount];
+        sim->dir      = (i % 2 == 0) ? +1 : -1;
+        sim->climbDir = +1;
+
+        int target = opts.spectateId;
+        if (sim->role == ROLE_SPECTATOR && target <= 0) {
+            target = sims[(i - opts.players) % opts.players].state.playerId;
+        }
+        if (sim_connect(sim, &opts, i, target) != 0) {
+            printf("[HEADLESS] La sesión %d no pudo conectarse\n", i);
+        }
+    }
+
+    static SoakTotals soak;
+    double startMs      = client_now_ms();
+    double nextReportMs = startMs + 1000.0;
+    int    second       = 0;
+    int    lagSeconds   = 0;
+
+    while (client_now_ms() - startMs < opts.seconds * 1000.0) {
+        if (!wait_any_readable(sims, count)) {
+            printf("[HEADLESS] No queda ninguna sesión conectada\n");
+            break;
+        }
+        double now = client_now_ms();
+
+        for (int i = 0; i < count; i++) {
+            SimClient *sim = &sims[i];
+            if (!sim->alive) {
+                continue;
+            }
+            if (sim_step(sim, &opts, now) != 0) {
+                printf("[HEADLESS] La sesión %d se desconectó\n", i);
+                soak.disconnects++;
+                sim_close(sim);
+                continue;
+            }
+            soak_collect(&soak, sim, now);
+
+            /* Jugador sin vidas: vuelve a entrar como hace el botón del GUI */
+            if (sim->role == ROLE_PLAYER && sim->state.gameOver) {
+                sim_close(sim);
+                sim->rejoins++;
+                sim_connect(sim, &opts, i, 0);
+            }
+        }
+
+        if (now >= nextReportMs) {
+            second++;
+            if (print_report(sims, count, second) > 0) {
+                lagSeconds++;
+            }
+            nextReportMs += 1000.0;
+        }
+    }
+
+    printf("[HEADLESS] Fin: %d sesiones, %d de %d segundos con sesiones atrasadas\n",
+           count, lagSeconds, second);
+
+    double elapsedMs = client_now_ms() - startMs;
+    int    sloOk = write_soak_report(stdout, &opts, sims, count, &soak, elapsedMs,
+                                     lagSeconds, second);
+    if (opts.reportPath != NULL) {
+        FILE *report = fopen(opts.reportPath, "w");
+        if (report == NULL) {
+            printf("[HEADLESS] No se pudo escribir el reporte %s\n", opts.reportPath);
+        } else {
+            write_soak_report(report, &opts, sims, count, &soak, elapsedMs, lagSeconds, second);
+            fclose(report);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        sim_close(&sims[i]);
+        arena_release(&sims[i].state.arena);
+    }
+    free(sims);
+    WSACleanup();
+
+    if (!sloOk) {
+        return 3;
+    }
+    return lagSeconds > 0 ? 2 : 0;
+}
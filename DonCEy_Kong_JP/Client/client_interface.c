@@ -21,98 +21,22 @@ static void draw_button(Rectangle rect, const char *text, bool hovered)
     DrawText(text, textX, textY, 24, RAYWHITE);
 }
 
-/* ============================
- *  H E L P E R S   D E   M A P A
- * ============================ */
-
 /**
- * Recibe el mapa lógico inicial desde el servidor y lo almacena en state->map.
- *
- * Protocolo esperado (en cualquier orden mezclado con otras líneas):
- *  - "MAP_SIZE <ancho> <alto>"  (obligatorio una vez)
- *  - "MAP_ROW <y> <fila_completa>" para cada fila
- *  - "MAP_END"                  (marca el final de la descripción del mapa)
- *
- * Esta función es robusta ante líneas adicionales (por ejemplo "STATE ..."):
- * las ignora hasta haber recibido "MAP_SIZE" y "MAP_END".
- *
- * @param state Puntero al estado del cliente ya conectado.
- * @return 0 si el mapa se recibió correctamente, -1 en caso de error.
+ * Teclas de depuración comunes a ambos modos:
+ * F3 muestra u oculta las estadísticas (y con ellas la suscripción al
+ * STATS del servidor), F4 activa o cierra el CSV.
  */
-static int receive_initial_map(ClientState *state)
+static void handle_debug_keys(ClientState *state)
 {
-    char line[256];
-
-    int width  = 0;
-    int height = 0;
-    int gotSize = 0;
-
-    /* --- 1) Esperar MAP_SIZE --- */
-    for (;;) {
-        int len = recv_line(state->socket_fd, line, sizeof(line));
-        if (len <= 0) {
-            return -1;
-        }
-
-        if (sscanf(line, "MAP_SIZE %d %d", &width, &height) == 2) {
-            gotSize = 1;
-            break;
-        }
-
-        /* Cualquier otra cosa (por ej. STATE) se ignora aquí */
+    if (IsKeyPressed(KEY_F3)) {
+        state->stats.overlay = !state->stats.overlay;
     }
-
-    if (!gotSize ||
-        width <= 0 || height <= 0 ||
-        width > MAX_MAP_WIDTH || height > MAX_MAP_HEIGHT) {
-        return -1;
+    if (IsKeyPressed(KEY_F4)) {
+        stats_toggle_csv(&state->stats);
     }
-
-    state->map.width  = width;
-    state->map.height = height;
-
-    /* Inicializamos la matriz a vacío por si faltan filas */
-    for (int y = 0; y < height; y++) {
-        memset(state->map.tiles[y], '.', width);
-        state->map.tiles[y][width] = '\0';
-    }
-
-    /* --- 2) Leer hasta MAP_END, recogiendo MAP_ROW --- */
-    for (;;) {
-        int len = recv_line(state->socket_fd, line, sizeof(line));
-        if (len <= 0) {
-            return -1;
-        }
-
-        if (strncmp(line, "MAP_END", 7) == 0) {
-            break; /* ya terminamos */
-        }
-
-        int y = -1;
-        char row[MAX_MAP_WIDTH + 1];
-
-        if (sscanf(line, "MAP_ROW %d %s", &y, row) == 2) {
-            if (y >= 0 && y < state->map.height) {
-                strncpy(state->map.tiles[y], row, state->map.width);
-                state->map.tiles[y][state->map.width] = '\0';
-            }
-        }
-        /* Si no era MAP_ROW, se ignora (por ej. STATE) */
-    }
-
-    return 0;
-}
-
-/* Tile sólido donde el jugador puede apoyarse / estar de pie */
-static int is_solid_tile_char(char t)
-{
-    return t == 'T' || t == '=' || t == '|' || t == 'S';
+    stats_sync_subscription(state);
 }
 
-static int is_liana_char(char t)
-{
-    return t == '|';
-}
 
 
 
@@ -120,7 +44,7 @@ static int is_liana_char(char t)
  * Solicita al servidor la lista de jugadores activos y la almacena en state->players.
  *
  * Protocolo esperado del servidor:
- *  - "PLAYERS_BEGIN"
+ *  - "PLAYERS_BEGIN [n]" (n: cantidad anunciada, opcional)
  *  - "PLAYER <id> <name>"  (cero o más líneas)
  *  - "PLAYERS_END"
  *
@@ -132,21 +56,26 @@ static int is_liana_char(char t)
  */
 static int fetch_player_list(ClientState *state)
 {
-    char line[256];
+    char *line;
     int gotBegin = 0;
 
     state->numPlayers = 0;
 
     /* Enviar la solicitud al servidor */
-    send_line(state->socket_fd, "LIST_PLAYERS\n");
+    send_queue_push(&state->outbox, "LIST_PLAYERS\n");
+    send_queue_flush(&state->outbox);
 
     for (;;) {
-        int len = recv_line(state->socket_fd, line, sizeof(line));
+        int len = line_reader_next(&state->reader, &line, 1);
         if (len <= 0) {
             return -1;
         }
 
         if (strncmp(line, "PLAYERS_BEGIN", 13) == 0) {
+            /* "PLAYERS_BEGIN <n>": se reserva de una vez (n es opcional) */
+            int n = 0;
+            sscanf(line, "PLAYERS_BEGIN %d", &n);
+            storage_reserve_players(state, n);
             gotBegin = 1;
             continue;
         }
@@ -166,7 +95,7 @@ static int fetch_player_list(ClientState *state)
         char name[32];
 
         if (sscanf(line, "PLAYER %d %31s", &id, name) == 2) {
-            if (state->numPlayers < MAX_PLAYERS) {
+            if (storage_reserve_players(state, state->numPlayers + 1) == 0) {
                 state->players[state->numPlayers].id = id;
                 strncpy(state->players[state->numPlayers].name, name, 31);
                 state->players[state->numPlayers].name[31] = '\0';
@@ -180,21 +109,25 @@ static int fetch_player_list(ClientState *state)
 }
 
 /**
- * Muestra una pantalla de selección de jugador para modo espectador.
+ * Muestra una pantalla de selección de jugadores para modo espectador.
  *
  * - Internamente llama a fetch_player_list() para pedir la lista al servidor.
- * - Si no hay jugadores activos, devuelve -1.
- * - El usuario puede moverse con flechas ARRIBA/ABAJO y confirmar con ENTER.
- * - Con ESC se cancela y se devuelve -1 (volver al menú principal).
+ * - Si no hay jugadores activos, devuelve 0.
+ * - El usuario puede moverse con flechas ARRIBA/ABAJO, marcar varios con
+ *   ESPACIO (hasta maxTargets) y confirmar con ENTER; sin marcas, ENTER
+ *   escoge solo el resaltado.
+ * - Con ESC se cancela y se devuelve 0 (volver al menú principal).
  *
- * @param state Puntero al estado del cliente (usa el socket para pedir la lista).
- * @return ID del jugador seleccionado en caso de éxito, o -1 si se cancela
- *         o no hay jugadores activos.
+ * @param state      Puntero al estado del cliente (usa el socket para pedir la lista).
+ * @param targets    Arreglo donde se dejan los IDs escogidos.
+ * @param maxTargets Capacidad de targets.
+ * @return Cantidad de jugadores escogidos, o 0 si se cancela o no hay
+ *         jugadores activos.
  */
-static int select_spectator_target(ClientState *state)
+static int select_spectator_targets(ClientState *state, int *targets, int maxTargets)
 {
     if (fetch_player_list(state) != 0) {
-        return -1;
+        return 0;
     }
 
     if (state->numPlayers == 0) {
@@ -212,10 +145,11 @@ static int select_spectator_target(ClientState *state)
                 break;
             }
         }
-        return -1;
+        return 0;
     }
 
     int selected = 0;
+    int count    = 0;
 
     while (!WindowShouldClose()) {
         if (IsKeyPressed(KEY_UP)) {
@@ -227,13 +161,30 @@ static int select_spectator_target(ClientState *state)
             if (selected >= state->numPlayers) selected = 0;
         }
 
+        if (IsKeyPressed(KEY_SPACE)) {
+            /* Marcar / desmarcar el resaltado */
+            int id    = state->players[selected].id;
+            int found = -1;
+            for (int i = 0; i < count; i++) {
+                if (targets[i] == id) found = i;
+            }
+            if (found >= 0) {
+                targets[found] = targets[--count];
+            } else if (count < maxTargets) {
+                targets[count++] = id;
+            }
+        }
+
         if (IsKeyPressed(KEY_ENTER)) {
-            return state->players[selected].id;
+            if (count == 0) {
+                targets[count++] = state->players[selected].id;
+            }
+            return count;
         }
 
         if (IsKeyPressed(KEY_ESCAPE)) {
             /* Cancelar selección y volver al menú principal */
-            return -1;
+            return 0;
         }
 
         BeginDrawing();
@@ -243,13 +194,21 @@ static int select_spectator_target(ClientState *state)
                      60, 60, 24, RAYWHITE);
             DrawText("Flechas ARRIBA/ABAJO para moverte, ENTER para escoger, ESC para volver",
                      60, 100, 16, LIGHTGRAY);
+            DrawText(TextFormat("ESPACIO marca varios para verlos a la vez (hasta %d)", maxTargets),
+                     60, 120, 16, LIGHTGRAY);
 
             for (int i = 0; i < state->numPlayers; i++) {
                 int y = 150 + i * 30;
                 Color color = (i == selected) ? YELLOW : RAYWHITE;
 
+                int marked = 0;
+                for (int j = 0; j < count; j++) {
+                    if (targets[j] == state->players[i].id) marked = 1;
+                }
+
                 char line[128];
-                snprintf(line, sizeof(line), "ID %d - %s",
+                snprintf(line, sizeof(line), "%s ID %d - %s",
+                         marked ? "[x]" : "[ ]",
                          state->players[i].id,
                          state->players[i].name);
 
@@ -259,169 +218,10 @@ static int select_spectator_target(ClientState *state)
         EndDrawing();
     }
 
-    return -1;
-}
-
-
-/* ============================
- *  D I B U J A R   E S C E N A
- * ============================ */
-
-/**
- * Dibuja el mapa y la posición del jugador utilizando raylib.
- *
- * - Cada celda del mapa se representa como un rectángulo de color distinto
- *   según el carácter recibido del servidor.
- * - El jugador se dibuja como un rectángulo de color destacado encima.
- *
- * @param state Puntero al estado actual del cliente (mapa + posición jugador).
- */
-static void
-draw_game_scene(const ClientState *state)
-{
-    const int tileSize = 40;  /* tamaño en píxeles de cada tile */
-
-    /* Calcular offset para centrar el mapa en la ventana */
-    int mapPixelWidth  = state->map.width  * tileSize;
-    int mapPixelHeight = state->map.height * tileSize;
-
-    int offsetX = (WINDOW_WIDTH  - mapPixelWidth)  / 2;
-    int offsetY = (WINDOW_HEIGHT - mapPixelHeight) / 2;
-
-    /* Dibujar fondo */
-    ClearBackground((Color){ 10, 10, 30, 255 });
-
-    /* Dibujar tiles */
-    for (int y = 0; y < state->map.height; y++) {
-        for (int x = 0; x < state->map.width; x++) {
-            char t = state->map.tiles[y][x];
-            Color c;
-
-            switch (t) {
-                case 'W': c = (Color){ 30, 60, 200, 255 }; break;  /* Agua */
-                case 'T': c = (Color){ 56, 40, 18, 255 }; break;  /* Tierra */
-                case '=': c = (Color){ 100, 100, 100, 255 }; break;/* Plataforma */
-                case '|': c = (Color){ 50, 150, 60, 255 }; break;  /* Liana */
-                case 'S': c = (Color){ 200, 200, 50, 255 }; break; /* Spawn */
-                case 'G': c = (Color){ 200, 120, 50, 255 }; break; /* Meta */
-                default:  c = (Color){ 20, 20, 30, 255 }; break;   /* Vacío */
-            }
-
-            /* OJO: en el servidor y=0 es la fila inferior, aquí invertimos Y */
-            int drawX = offsetX + x * tileSize;
-            int drawY = offsetY + (state->map.height - 1 - y) * tileSize;
-
-            DrawRectangle(drawX, drawY, tileSize, tileSize, c);
-            DrawRectangleLines(drawX, drawY, tileSize, tileSize, (Color){ 10, 10, 10, 255 });
-        }
-    }
-
-    /* ===== Dibujar enemigos (cocodrilos) ===== */
-    for (int i = 0; i < state->numEnemies; i++) {
-        int ex = state->enemies[i].x;
-        int ey = state->enemies[i].y;
-
-        int drawX = offsetX + ex * tileSize;
-        int drawY = offsetY + (state->map.height - 1 - ey) * tileSize;
-
-        Color col;
-        if (state->enemies[i].type == 1) {          /* RED */
-            col = (Color){ 220, 50, 50, 255 };
-        } else if (state->enemies[i].type == 2) {   /* BLUE */
-            col = (Color){ 60, 80, 220, 255 };
-        } else {
-            col = (Color){ 180, 180, 180, 255 };    /* genérico */
-        }
-
-        /* Rectángulo más “alargado” para sugerir un cocodrilo horizontal */
-        DrawRectangle(drawX + 4, drawY + 10,
-                      tileSize - 8, tileSize - 20,
-                      col);
-    }
-
-
-    /* ===== Dibujar frutas ===== */
-    for (int i = 0; i < state->numFruits; i++) {
-        int fx = state->fruits[i].x;
-        int fy = state->fruits[i].y;
-
-        int drawX = offsetX + fx * tileSize;
-        int drawY = offsetY + (state->map.height - 1 - fy) * tileSize;
-
-        /* Cuadrado más pequeño, color llamativo (ej. magenta) */
-        DrawRectangle(drawX + 8, drawY + 8,
-                      tileSize - 16, tileSize - 16,
-                      (Color){ 230, 0, 230, 255 });
-    }
-
-    /* Dibujar jugador (si tenemos posición válida) */
-    if (state->playerId != 0) {
-        int px = state->playerX;
-        int py = state->playerY;
-
-        int drawX = offsetX + px * tileSize;
-        int drawY = offsetY + (state->map.height - 1 - py) * tileSize;
-
-        DrawRectangle(drawX + 5, drawY + 5,
-                      tileSize - 10, tileSize - 10,
-                      (Color){ 110, 70, 20, 255 });
-    }
-
-    /* HUD sencillo (abajo a la izquierda) */
-    DrawText("DonCEy Kong Jr - Cliente", 10, 10, 20, RAYWHITE);
-
-    char hud[128];
-    snprintf(hud, sizeof(hud),
-             "ID: %d  Nivel: %d  Vidas: %d  Score: %d  GameOver: %s",
-             state->playerId,
-             state->level,
-             state->lives,
-             state->score,
-             state->gameOver ? "SI" : "NO");
-    DrawText(hud, 10, WINDOW_HEIGHT - 30, 16, LIGHTGRAY);
-    /* === Overlay de GAME OVER === */
-    if (state->gameOver) {
-        /* Fondo oscuro semitransparente encima de todo */
-        DrawRectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
-                    (Color){ 0, 0, 0, 200 });
-
-        /* Título grande "Perdiste" */
-        const char *msg     = "¡HAS PERDIDO!";
-        int         titleFont = 40;
-        int         msgWidth  = MeasureText(msg, titleFont);
-        int         msgX      = (WINDOW_WIDTH - msgWidth) / 2;
-        int         msgY      = WINDOW_HEIGHT / 2 - 100;
-        DrawText(msg, msgX, msgY, titleFont, RAYWHITE);
-
-        /* Score final en grande debajo del título */
-        const char *scoreMsg = TextFormat("Puntuación final: %d", state->score);
-        int         scoreFont  = 30;
-        int         scoreWidth = MeasureText(scoreMsg, scoreFont);
-        int         scoreX     = (WINDOW_WIDTH - scoreWidth) / 2;
-        int         scoreY     = msgY + titleFont + 10;
-        DrawText(scoreMsg, scoreX, scoreY, scoreFont, RAYWHITE);
-
-        /* Botón "Volver a jugar" debajo del score */
-        const char *btnText   = "Volver a jugar";
-        int         btnFont   = 24;
-        int         btnWidth  = MeasureText(btnText, btnFont) + 40;
-        int         btnHeight = 50;
-        int         btnX      = (WINDOW_WIDTH - btnWidth) / 2;
-        int         btnY      = scoreY + scoreFont + 30;
-
-        DrawRectangle(btnX, btnY, btnWidth, btnHeight,
-                    (Color){ 50, 80, 130, 255 });
-        DrawRectangleLines(btnX, btnY, btnWidth, btnHeight, RAYWHITE);
-
-        int textX = btnX + (btnWidth  - MeasureText(btnText, btnFont)) / 2;
-        int textY = btnY + (btnHeight - btnFont) / 2;
-        DrawText(btnText, textX, textY, btnFont, RAYWHITE);
-    }
-
+    return 0;
 }
 
 
-
 /* ============================
  *  P A N T A L L A  I N I C I A L
  * ============================ */
@@ -479,13 +279,17 @@ int run_role_selection_screen(void)
  * Bucle principal del cliente en modo jugador.
  *
  * Flujo:
- *  1) Envía un comando JOIN con un nombre fijo.
+ *  1) Si hay token de una partida anterior envía REJOIN (el servidor
+ *     reinicia la misma sesión); si no, o si lo rechaza, JOIN con un
+ *     nombre fijo.
  *  2) Busca en las líneas del servidor una respuesta "JOINED <id>" y
- *     guarda el playerId asociado.
- *  3) Recibe el mapa inicial mediante receive_initial_map(), que también
+ *     guarda el playerId asociado (y el token para la próxima).
+ *  3) Recibe el mapa inicial mediante protocol_receive_map(), que también
  *     es robusta ante líneas extra.
  *  4) Entra en un bucle donde:
- *      - Lee líneas del tipo "STATE seq id x y score gameOver".
+ *      - Drena, sin bloquear, todas las líneas pendientes del servidor
+ *        (STATE, FRUITS_*, ENEMIES_*), de modo que el render siempre va a
+ *        60 FPS aunque el servidor esté en silencio o mande ráfagas.
  *      - Actualiza la posición y puntuación del jugador.
  *      - Envía inputs al servidor según las teclas pulsadas.
  *      - Dibuja el mapa y la posición del jugador con raylib.
@@ -493,35 +297,24 @@ int run_role_selection_screen(void)
  * @param state Puntero al estado del cliente ya inicializado y con el socket
  *              conectado al servidor.
  */
-void run_player_mode(ClientState *state)
+int run_player_mode(ClientState *state)
 {
-    char line[256];
-    char cmd[128];
-
-    /* 1) Enviar JOIN con un nombre de jugador fijo por ahora */
-    snprintf(cmd, sizeof(cmd), "JOIN Jugador1\n");
-    send_line(state->socket_fd, cmd);
-
-    /* 2) Buscar "JOINED <id>" en lo que vaya mandando el servidor */
-    state->playerId = 0;
-    for (;;) {
-        int len = recv_line(state->socket_fd, line, sizeof(line));
-        if (len <= 0) {
-            return;
-        }
+    int playAgain = 0;
 
-        int id = 0;
-        if (sscanf(line, "JOINED %d", &id) == 1) {
-            state->playerId = id;
-            break;
-        }
-
-        /* Cualquier otra línea antes de JOINED se ignora */
+    /* 1-2) REJOIN con el token anterior o JOIN con un nombre fijo por ahora,
+     *      y esperar JOINED */
+    int joined = protocol_rejoin(state);
+    if (joined == 1) {
+        joined = protocol_join(state, "Jugador1");
+    }
+    if (joined != 0) {
+        return 0;
     }
 
     /* 3) Recibir mapa inicial */
-    if (receive_initial_map(state) != 0) {
-        return;
+    stats_reset(&state->stats);
+    if (protocol_receive_map(state) != 0) {
+        return 0;
     }
 
     /* Inicializar HUD / estado básico */
@@ -530,13 +323,10 @@ void run_player_mode(ClientState *state)
     state->score    = 0;
     state->gameOver = 0;
 
-    state->numFruits = 0;
-    state->numEnemies = 0;
-
-    int inFruitBlock = 0;
-    int inEnemyBlock = 0;
-
-    int seq = 0;  /* número de secuencia para INPUT */
+    /* La sesión recién creada está vacía: los deltas parten de seq 0 */
+    protocol_reset(state, 1);
+    prediction_reset(state, CLIENT_USE_PREDICTION);
+    interp_reset(&state->interp, CLIENT_INTERP_DELAY_MS, CLIENT_PLAYER_SMOOTH_MS);
     
     
 
@@ -547,151 +337,36 @@ void run_player_mode(ClientState *state)
         if (IsKeyPressed(KEY_ESCAPE)) {
             break;
         }
+        handle_debug_keys(state);
 
-         /* --- Leer estado del servidor --- */
-        int len = recv_line(state->socket_fd, line, sizeof(line));
-        if (len <= 0) {
+        /* --- Drenar TODAS las líneas pendientes del servidor ---
+         * Nunca se bloquea: si el servidor está en silencio se dibuja con el
+         * último estado conocido y el bucle sigue a SetTargetFPS(60). */
+        if (protocol_drain(state) != 0) {
             break; /* desconexión o error */
         }
 
-        char tag[16];
-        if (sscanf(line, "%15s", tag) != 1) {
-            continue;
-        }
-
-        /* ====== STATE: posición, score, nivel, vidas, gameOver ====== */
-        if (strcmp(tag, "STATE") == 0) {
-            int  s, pid, x, y, score, level, lives;
-            char gameOverStr[8];
-
-            if (sscanf(line, "%15s %d %d %d %d %d %d %d %7s",
-                       tag, &s, &pid, &x, &y, &score, &level, &lives, gameOverStr) == 9) {
-
-                if (pid == state->playerId) {
-                    state->playerX  = x;
-                    state->playerY  = y;
-                    state->score    = score;
-                    state->level    = level;
-                    state->lives    = lives;
-                    state->gameOver = (strcmp(gameOverStr, "true") == 0);
-                }
-            }
-        }
-        /* ====== FRUITS_BEGIN: comienza lista de frutas ====== */
-        else if (strcmp(tag, "FRUITS_BEGIN") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inFruitBlock      = 1;
-                state->numFruits  = 0;
-            }
-        }
-        /* ====== FRUIT x y pts ====== */
-        else if (strcmp(tag, "FRUIT") == 0) {
-            if (inFruitBlock) {
-                int fx, fy, pts;
-                if (sscanf(line, "%*s %d %d %d", &fx, &fy, &pts) == 3) {
-                    if (state->numFruits < MAX_FRUITS) {
-                        FruitInfo *f = &state->fruits[state->numFruits++];
-                        f->x      = fx;
-                        f->y      = fy;
-                        f->points = pts;
-                    }
-                }
-            }
-        }
-        /* ====== FRUITS_END ====== */
-        else if (strcmp(tag, "FRUITS_END") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inFruitBlock = 0;
-            }
-        }
-
-        /* ====== ENEMIES_BEGIN: comienza lista de enemigos ====== */
-        else if (strcmp(tag, "ENEMIES_BEGIN") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inEnemyBlock      = 1;
-                state->numEnemies = 0;
-            }
-        }
-        /* ====== ENEMY <type> <x> <y> ====== */
-        else if (strcmp(tag, "ENEMY") == 0) {
-            if (inEnemyBlock) {
-                char typeStr[16];
-                int  ex, ey;
-
-                if (sscanf(line, "%*s %15s %d %d", typeStr, &ex, &ey) == 3) {
-                    if (state->numEnemies < MAX_ENEMIES) {
-                        EnemyInfo *e = &state->enemies[state->numEnemies++];
-                        e->x = ex;
-                        e->y = ey;
-
-                        if (strcmp(typeStr, "RED") == 0) {
-                            e->type = 1;
-                        } else if (strcmp(typeStr, "BLUE") == 0) {
-                            e->type = 2;
-                        } else {
-                            e->type = 0;
-                        }
-                    }
-                }
-            }
-        }
-        /* ====== ENEMIES_END ====== */
-        else if (strcmp(tag, "ENEMIES_END") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inEnemyBlock = 0;
-            }
-        }
-
-
         /* --- Procesar input local y enviarlo al servidor --- */
         
                 
         int dx = 0;
         int dy = 0;
 
-        /* === Leer tiles alrededor del jugador === */
-        char current = '.';  /* tile donde está el jugador */
-        char below   = '.';  /* tile justo debajo (y-1)     */
-        char above   = '.';  /* tile justo arriba (y+1)     */
-
         if(!state->gameOver){
 
-            
-            if (state->playerY >= 0 && state->playerY < state->map.height &&
-                state->playerX >= 0 && state->playerX < state->map.width) {
-                current = state->map.tiles[state->playerY][state->playerX];
-            }
-            if (state->playerY - 1 >= 0 &&
-                state->playerY - 1 < state->map.height &&
-                state->playerX >= 0 && state->playerX < state->map.width) {
-                below = state->map.tiles[state->playerY - 1][state->playerX];
-            }
-            if (state->playerY + 1 >= 0 &&
-                state->playerY + 1 < state->map.height &&
-                state->playerX >= 0 && state->playerX < state->map.width) {
-                above = state->map.tiles[state->playerY + 1][state->playerX];
-            }
-
-            int solid_current =
-                (current == 'T' || current == '=' || current == '|' ||
-                current == 'S');
-            int solid_below =
-                (below   == 'T' || below   == '=' || below   == '|' ||
-                below   == 'S');
+            /* === Flags de los tiles alrededor del jugador (fuera = vacío) === */
+            int current = map_flags_at(&state->map, state->playerX, state->playerY);
+            int below   = map_flags_at(&state->map, state->playerX, state->playerY - 1);
+            int above   = map_flags_at(&state->map, state->playerX, state->playerY + 1);
 
             /* "Apoyado" = estoy en un tile sólido O tengo un sólido justo debajo
             (caso de estar visualmente sobre la plataforma/liana). */
-            int supported = solid_current || solid_below;
+            int supported = ((current | below) & TILE_FLAG_SOLID) != 0;
 
-            /* Hay "techo" si justo arriba hay plataforma/tierra/spawn/meta */
-            int hasCeilingAbove =
-                (above == 'T' || above == '=' || above == 'S');
+            /* Hay "techo" si justo arriba hay plataforma/tierra/spawn */
+            int hasCeilingAbove = (above & TILE_FLAG_CEILING) != 0;
 
-            int onLianaTile = (current == '|');  /* para trepar con ↑/↓ */
+            int onLianaTile = (current & TILE_FLAG_LIANA) != 0;  /* para trepar con ↑/↓ */
 
             /* === SALTO CON ESPACIO ===
             * - SPACE solo       -> (dx = 0, dy = +1)
@@ -727,19 +402,28 @@ void run_player_mode(ClientState *state)
                 }
             }
 
-            /* Enviamos INPUT solo si realmente hay movimiento */
-            if (dx != 0 || dy != 0) {
-                seq++;
-                snprintf(cmd, sizeof(cmd), "INPUT %d %d %d\n", seq, dx, dy);
-                send_line(state->socket_fd, cmd);
-            }
+            /* El INPUT se aplica en pantalla al enviarse (predicción) y se
+             * corrige con el STATE; se envía a lo sumo uno por tick */
+            prediction_queue_input(state, dx, dy);
+            prediction_send_due(state, GetTime() * 1000.0);
+
+        }
 
+        /* Una sola escritura por frame con todo lo encolado, antes de que
+         * EndDrawing() espere al siguiente frame */
+        if (send_queue_flush(&state->outbox) != 0) {
+            break;
         }
 
-        /* --- Dibujar escena --- */
+        /* --- Dibujar escena (posiciones suavizadas entre ticks) --- */
+        interp_update(state, GetTime() * 1000.0);
         BeginDrawing();
-            draw_game_scene(state);
+            render_game_scene(state);
+            if (state->stats.overlay) {
+                render_stats_overlay(&state->stats);
+            }
         EndDrawing();
+        stats_frame(state);
 
         /* Si la partida terminó, revisar clic en el botón "Volver a jugar" */
         if (state->gameOver) {
@@ -768,15 +452,16 @@ void run_player_mode(ClientState *state)
             if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) &&
                 CheckCollisionPointRec(mouse, btnRect)) {
 
-                /* Salimos del bucle de juego.
-                 * En main() se cerrará el socket y se volverá al menú,
-                 * desde donde el usuario puede entrar otra vez como JUGADOR.
-                 */
+                /* Salimos del bucle de juego. main() deja la partida con
+                 * LEAVE y, sin pasar por el menú ni reconectar, vuelve a
+                 * entrar con REJOIN a la misma sesión reiniciada. */
+                playAgain = 1;
                 break;
             }
         }
 
     }
+    return playAgain;
 }
 
 
@@ -785,19 +470,279 @@ void run_player_mode(ClientState *state)
  *  M O D O   E S P E C T A D O R
  * ============================ */
 
+/**
+ * Pide SPECTATE de un jugador por la conexión de `state` y deja la sesión
+ * lista para dibujar: mapa inicial y foto de la sesión recibidos y
+ * protocolo, predicción e interpolación reiniciados.
+ *
+ * @param state    Sesión con el socket ya conectado.
+ * @param targetId Jugador a observar.
+ * @return 0 en éxito, distinto de 0 si el servidor no aceptó o se cortó.
+ */
+static int start_spectating(ClientState *state, int targetId)
+{
+    state->spectateId = targetId;
+
+    /* SPECTATE y esperar SPECTATE_OK (SPECTATE_WAIT: el jugador no existe) */
+    if (protocol_spectate(state, targetId) != 0) {
+        return -1;
+    }
+
+    /* Recibir mapa inicial (robusto ante líneas extra) */
+    stats_reset(&state->stats);
+    if (protocol_receive_map(state) != 0) {
+        return -1;
+    }
+
+    state->playerX  = 0;
+    state->playerY  = 0;
+    state->score    = 0;
+    state->gameOver = 0;
+
+    /* Un espectador llega a mitad de partida: la foto que sigue al mapa es
+     * su keyframe, y se aplica antes del primer frame para no dibujar un
+     * tablero vacío ni interpolar desde (0,0) */
+    protocol_reset(state, 0);
+    prediction_reset(state, 0);
+    if (protocol_receive_snapshot(state) != 0) {
+        return -1;
+    }
+
+    /* Con un ritmo menor al del tick cada cambio se recorre en lo que tarda
+     * en llegar el siguiente, para que el jugador observado no avance a saltos */
+    double delayMs = CLIENT_INTERP_DELAY_MS;
+    if (state->stateRate > 0 && 1000.0 / state->stateRate > delayMs) {
+        delayMs = 1000.0 / state->stateRate;
+    }
+    interp_reset(&state->interp, delayMs, CLIENT_PLAYER_SMOOTH_MS);
+    return 0;
+}
+
+/**
+ * Rectángulo de pantalla de la vista `index` entre `count` sesiones.
+ *
+ * - Sin foco (focus < 0): grilla de columnas x filas lo más cuadrada posible.
+ * - Con foco: la sesión enfocada ocupa la ventana y el resto va en
+ *   miniaturas sobre el borde derecho (imagen en imagen).
+ */
+static Rectangle multi_view_cell(int index, int count, int focus)
+{
+    if (focus < 0) {
+        int cols = 1;
+        while (cols * cols < count) cols++;
+        int rows = (count + cols - 1) / cols;
+
+        float w = (float)WINDOW_WIDTH  / cols;
+        float h = (float)WINDOW_HEIGHT / rows;
+        return (Rectangle){ (index % cols) * w, (index / cols) * h, w, h };
+    }
+
+    if (index == focus) {
+        return (Rectangle){ 0.0f, 0.0f, (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT };
+    }
+
+    /* Miniaturas de 1/4 de la ventana, de arriba hacia abajo y de derecha a izquierda */
+    int   slot = (index < focus) ? index : index - 1;
+    float w    = WINDOW_WIDTH  / 4.0f;
+    float h    = WINDOW_HEIGHT / 4.0f;
+    return (Rectangle){ WINDOW_WIDTH - (slot / 4 + 1) * w, (slot % 4) * h, w, h };
+}
+
+/**
+ * Dibuja una sesión escalada dentro de su rectángulo, con una etiqueta
+ * corta (ID, score, vidas) en lugar del HUD completo.
+ */
+static void draw_multi_view(const ClientState *view, int alive, Rectangle cell, int focused)
+{
+    BeginScissorMode((int)cell.x, (int)cell.y, (int)cell.width, (int)cell.height);
+        DrawRectangleRec(cell, (Color){ 10, 10, 30, 255 });
+
+        if (view->map.width > 0 && view->map.height > 0) {
+            float tileW = cell.width  / view->map.width;
+            float tileH = cell.height / view->map.height;
+            float tile  = (tileW < tileH) ? tileW : tileH;
+            if (tile > TILE_SIZE) tile = TILE_SIZE;
+
+            float offsetX = cell.x + (cell.width  - view->map.width  * tile) / 2;
+            float offsetY = cell.y + (cell.height - view->map.height * tile) / 2;
+            render_world(view, offsetX, offsetY, tile);
+        }
+
+        char label[96];
+        snprintf(label, sizeof(label), "ID %d  Score %d  Vidas %d%s",
+                 view->spectateId, view->score, view->lives,
+                 !alive ? "  DESCONECTADO" : (view->gameOver ? "  GAME OVER" : ""));
+        DrawRectangle((int)cell.x, (int)cell.y, MeasureText(label, 14) + 12, 20,
+                      (Color){ 0, 0, 0, 160 });
+        DrawText(label, (int)cell.x + 6, (int)cell.y + 3, 14, alive ? RAYWHITE : RED);
+    EndScissorMode();
+
+    DrawRectangleLinesEx(cell, focused ? 2.0f : 1.0f, focused ? YELLOW : GRAY);
+}
+
+/**
+ * Bucle del espectador que sigue a varios jugadores a la vez.
+ *
+ * - Una conexión y un ClientState por jugador; la primera reutiliza la
+ *   de `first`, que ya pidió la lista de jugadores.
+ * - Un único bucle de eventos: cada frame un select() sin espera indica
+ *   qué sockets tienen datos y solo esas sesiones se drenan.
+ * - Las sesiones que ven el mismo mapa comparten la capa de tiles.
+ * - TAB o 1-9 enfocan una sesión (imagen en imagen), 0 vuelve a la
+ *   grilla, F3/F4 aplican a la sesión enfocada y ESC sale.
+ *
+ * @param first   Estado con el socket conectado (lo cierra main()).
+ * @param targets IDs de los jugadores a seguir.
+ * @param count   Cantidad de IDs (2..MAX_WATCH_SESSIONS).
+ */
+static void run_multi_spectator_mode(ClientState *first, const int *targets, int count)
+{
+    ClientState *extra = calloc((size_t)(count - 1), sizeof(ClientState));
+    if (extra == NULL) {
+        return;
+    }
+
+    ClientState *views[MAX_WATCH_SESSIONS];
+    int          alive[MAX_WATCH_SESSIONS];
+    int          live = 0;
+
+    for (int i = 0; i < count; i++) {
+        ClientState *view = (i == 0) ? first : &extra[i - 1];
+        views[i] = view;
+        alive[i] = 0;
+
+        if (i > 0) {
+            view->socket_fd = create_and_connect_socket(SERVER_IP, SERVER_PORT);
+            if (view->socket_fd == INVALID_SOCKET) {
+                continue;
+            }
+            view->connected = 1;
+            view->role      = ROLE_SPECTATOR;
+            view->stateRate = first->stateRate;
+            line_reader_init(&view->reader, view->socket_fd);
+            send_queue_init(&view->outbox, view->socket_fd);
+            if (protocol_welcome(view) != 0) {
+                continue;
+            }
+        }
+
+        if (start_spectating(view, targets[i]) == 0) {
+            alive[i] = 1;
+            live++;
+        }
+    }
+
+    int focus = -1;
+
+    while (live > 0 && !WindowShouldClose()) {
+
+        if (IsKeyPressed(KEY_ESCAPE)) {
+            break;
+        }
+        if (IsKeyPressed(KEY_TAB)) {
+            focus = (focus + 2) % (count + 1) - 1; /* -1, 0, ..., count-1, -1 */
+        }
+        if (IsKeyPressed(KEY_ZERO)) {
+            focus = -1;
+        }
+        for (int i = 0; i < count && i < 9; i++) {
+            if (IsKeyPressed(KEY_ONE + i)) {
+                focus = i;
+            }
+        }
+        handle_debug_keys(views[focus < 0 ? 0 : focus]);
+
+        /* ¿Qué sockets tienen algo? (sin esperar: el frame lo marca raylib) */
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        for (int i = 0; i < count; i++) {
+            if (alive[i]) {
+                FD_SET(views[i]->socket_fd, &readSet);
+            }
+        }
+        struct timeval tv = { 0, 0 };
+        if (select(FD_SETSIZE, &readSet, NULL, NULL, &tv) < 0) {
+            FD_ZERO(&readSet);
+        }
+
+        for (int i = 0; i < count; i++) {
+            ClientState *view = views[i];
+            if (!alive[i]) {
+                continue;
+            }
+
+            /* También si quedaron líneas en el búfer (tope por frame) */
+            int pending = FD_ISSET(view->socket_fd, &readSet) ||
+                          view->reader.end > view->reader.start;
+
+            if ((pending && protocol_drain(view) != 0) ||
+                send_queue_flush(&view->outbox) != 0) {
+                alive[i] = 0; /* desconexión: queda dibujada como tal */
+                live--;
+                continue;
+            }
+            interp_update(view, GetTime() * 1000.0);
+        }
+
+        const ClientState *statsView = views[focus < 0 ? 0 : focus];
+
+        BeginDrawing();
+            ClearBackground((Color){ 10, 10, 30, 255 });
+
+            /* La enfocada primero: las miniaturas van encima */
+            if (focus >= 0) {
+                draw_multi_view(views[focus], alive[focus],
+                                multi_view_cell(focus, count, focus), 1);
+            }
+            for (int i = 0; i < count; i++) {
+                if (i != focus) {
+                    draw_multi_view(views[i], alive[i],
+                                    multi_view_cell(i, count, focus), 0);
+                }
+            }
+
+            DrawText("TAB/1-9 enfocar, 0 grilla, ESC salir",
+                     10, WINDOW_HEIGHT - 20, 14, LIGHTGRAY);
+            if (statsView->stats.overlay) {
+                render_stats_overlay(&statsView->stats);
+            }
+        EndDrawing();
+
+        for (int i = 0; i < count; i++) {
+            if (alive[i]) {
+                stats_frame(views[i]);
+            }
+        }
+    }
+
+    /* La primera sesión la cierra main(); las demás se cierran aquí */
+    for (int i = 0; i < count - 1; i++) {
+        ClientState *view = &extra[i];
+        if (view->connected && view->socket_fd != INVALID_SOCKET) {
+            close_socket(view->socket_fd);
+        }
+        if (view->stats.csv != NULL) {
+            stats_toggle_csv(&view->stats); /* cierra el CSV */
+        }
+        arena_release(&view->arena);
+    }
+    free(extra);
+}
+
 /**
  * Bucle principal del cliente en modo espectador.
  *
  * Flujo:
- *  1) Envía "SPECTATE <playerId>" (por ahora un ID fijo, p.ej. 1).
- *  2) Busca en las líneas del servidor una respuesta "SPECTATE_OK <playerId>"
- *     e inicializa state->playerId con ese valor.
+ *  1) Muestra la lista de jugadores activos para escoger a quién observar.
+ *     Si se marcan varios, pasa a run_multi_spectator_mode().
+ *  2) Envía "SPECTATE <playerId>" y busca la respuesta "SPECTATE_OK".
  *     - Si recibe "SPECTATE_WAIT <playerId>", devuelve y finaliza el modo
  *       espectador (el jugador aún no existe).
- *  3) Recibe el mapa inicial mediante receive_initial_map(), que es robusta
+ *  3) Recibe el mapa inicial mediante protocol_receive_map(), que es robusta
  *     ante líneas adicionales.
  *  4) Entra en un bucle donde:
- *      - Lee líneas "STATE seq id x y score gameOver".
+ *      - Drena sin bloquear las líneas pendientes ("STATE ...", listas de
+ *        frutas y enemigos).
  *      - Si el id coincide con state->playerId, actualiza la posición y
  *        puntuación del jugador observado.
  *      - Dibuja el mapa y la posición del jugador usando raylib.
@@ -807,48 +752,88 @@ void run_player_mode(ClientState *state)
  */
 void run_spectator_mode(ClientState *state)
 {
-    char line[256];
-    char cmd[128];
 
     /* 1) Dejar que el usuario escoja a quién espectar */
-    int targetId = select_spectator_target(state);
-    if (targetId < 0) {
+    int targets[MAX_WATCH_SESSIONS];
+    int count = select_spectator_targets(state, targets, MAX_WATCH_SESSIONS);
+    if (count <= 0) {
         /* Usuario canceló o no hay jugadores activos */
         return;
     }
+    if (count > 1) {
+        run_multi_spectator_mode(state, targets, count);
+        return;
+    }
 
-    state->spectateId=targetId;
+    /* 2-4) SPECTATE, mapa inicial y reinicio del estado */
+    if (start_spectating(state, targets[0]) != 0) {
+        return;
+    }
 
-    /* 2) Enviar SPECTATE <targetId> al servidor */
-    snprintf(cmd, sizeof(cmd), "SPECTATE %d\n", targetId);
-    send_line(state->socket_fd, cmd);
+    /* 5) Bucle de renderizado en modo espectador */
+    while (!WindowShouldClose()) {
 
-    /* 3) Esperar "SPECTATE_OK <id>" o "SPECTATE_WAIT <id>" */
-    state->playerId = 0;
-    for (;;) {
-        int len = recv_line(state->socket_fd, line, sizeof(line));
-        if (len <= 0) {
-            /* Desconexión / error */
-            return;
+        /* Permitir salir al menú principal con ESC */
+        if (IsKeyPressed(KEY_ESCAPE)) {
+            break;
         }
+        handle_debug_keys(state);
 
-        int id = 0;
-        if (sscanf(line, "SPECTATE_OK %d", &id) == 1) {
-            state->playerId = id;
-            break; /* listo, seguimos con el mapa */
+        /* Drenar todo lo pendiente sin bloquear el render */
+        if (protocol_drain(state) != 0) {
+            break; /* desconexión o error */
         }
 
-        if (sscanf(line, "SPECTATE_WAIT %d", &id) == 1) {
-            /* El jugador todavía no existe o se fue justo ahora */
-            return;
+        /* Enviar lo encolado (p.ej. RESYNC) en una sola escritura */
+        if (send_queue_flush(&state->outbox) != 0) {
+            break;
         }
 
-        /* Cualquier otra línea se ignora en esta fase */
+        /* --- Dibujar escena igual que en modo jugador --- */
+        interp_update(state, GetTime() * 1000.0);
+        BeginDrawing();
+            render_game_scene(state);
+            if (state->stats.overlay) {
+                render_stats_overlay(&state->stats);
+            }
+        EndDrawing();
+        stats_frame(state);
     }
 
-    /* 4) Recibir mapa inicial (robusto ante líneas extra) */
-    if (receive_initial_map(state) != 0) {
-        return;
+
+    /* Al salir del bucle, simplemente volvemos al menú principal */
+}
+
+
+/* ============================
+ *  M O D O   R E P R O D U C C I Ó N
+ * ============================ */
+
+/** Salto de LEFT/RIGHT durante la reproducción (ms). */
+#define REPLAY_SEEK_MS 5000.0
+
+/** Límites de la velocidad de reproducción (UP/DOWN la duplican o dividen). */
+#define REPLAY_MIN_SPEED 0.25
+#define REPLAY_MAX_SPEED 64.0
+
+/**
+ * Conecta el estado a la grabación en lugar de un socket y repite el
+ * handshake grabado (JOINED o SPECTATE_OK y el mapa inicial).
+ *
+ * @return 0 en éxito, -1 si la grabación no tiene un inicio válido.
+ */
+static int replay_start(ClientState *state, ReplaySource *src)
+{
+    line_reader_init(&state->reader, INVALID_SOCKET);
+    state->reader.replay = src;
+    send_queue_init(&state->outbox, INVALID_SOCKET); /* lo que se "envía" se descarta */
+    state->role = src->role;
+
+    int ok = (src->role == ROLE_PLAYER) ? protocol_join(state, "Replay") == 0
+                                        : protocol_spectate(state, 0) == 0;
+    stats_reset(&state->stats);
+    if (!ok || protocol_receive_map(state) != 0) {
+        return -1;
     }
 
     state->playerX  = 0;
@@ -856,124 +841,147 @@ void run_spectator_mode(ClientState *state)
     state->score    = 0;
     state->gameOver = 0;
 
-    state->numFruits = 0;
-    state->numEnemies = 0;
-    int inFruitBlock = 0;
-    int inEnemyBlock = 0;
-    /* 5) Bucle de renderizado en modo espectador */
+    /* El jugador grabado se ve tal como lo confirmó el servidor */
+    protocol_reset(state, src->role == ROLE_PLAYER);
+    prediction_reset(state, 0);
+    interp_reset(&state->interp, CLIENT_INTERP_DELAY_MS, CLIENT_PLAYER_SMOOTH_MS);
+    return 0;
+}
+
+/**
+ * Procesa todo lo grabado hasta src->clockMs, con el mismo drenado que
+ * una sesión en vivo.
+ *
+ * @return 0 en éxito, -1 si la grabación está corrupta.
+ */
+static int replay_catch_up(ClientState *state, ReplaySource *src)
+{
+    while (replay_due(src)) {
+        if (protocol_drain(state) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Salta a targetMs. Hacia atrás no hay estado que deshacer, así que se
+ * vuelve al inicio y se procesa todo de nuevo sin dibujar: con el
+ * archivo mapeado es solo parseo en memoria.
+ */
+static int replay_seek(ClientState *state, ReplaySource *src, double targetMs)
+{
+    if (targetMs < 0.0)             targetMs = 0.0;
+    if (targetMs > src->durationMs) targetMs = src->durationMs;
+
+    if (targetMs < src->clockMs) {
+        replay_rewind(src);
+        if (replay_start(state, src) != 0) {
+            return -1;
+        }
+    }
+
+    /* Tras repetir el handshake el reloj puede ir ya más adelante */
+    if (targetMs > src->clockMs) {
+        src->clockMs = targetMs;
+    }
+    if (replay_catch_up(state, src) != 0) {
+        return -1;
+    }
+    interp_reset(&state->interp, CLIENT_INTERP_DELAY_MS, CLIENT_PLAYER_SMOOTH_MS);
+    return 0;
+}
+
+/**
+ * Reproduce una grabación por el mismo camino de parseo y dibujo que una
+ * sesión en vivo.
+ *
+ * Controles: ESPACIO pausa, RIGHT avanza un tick en pausa (o salta 5 s),
+ * LEFT retrocede 5 s, UP/DOWN cambian la velocidad, HOME vuelve al inicio
+ * y ESC sale. La interpolación usa el reloj de la grabación, así que se
+ * ve igual a cualquier velocidad.
+ *
+ * @param state Estado del cliente (sin socket).
+ * @param path  Archivo grabado con --record.
+ */
+void run_replay_mode(ClientState *state, const char *path)
+{
+    ReplaySource src;
+    if (replay_open(&src, path) != 0) {
+        return;
+    }
+    if (replay_start(state, &src) != 0) {
+        printf("[REPLAY] La grabación no empieza con un handshake válido\n");
+        replay_close(&src);
+        return;
+    }
+
+    double lastMs = GetTime() * 1000.0;
+
     while (!WindowShouldClose()) {
+        double nowMs = GetTime() * 1000.0;
+        double dtMs  = nowMs - lastMs;
+        lastMs = nowMs;
 
-        /* Permitir salir al menú principal con ESC */
         if (IsKeyPressed(KEY_ESCAPE)) {
             break;
         }
+        handle_debug_keys(state);
 
-        int len = recv_line(state->socket_fd, line, sizeof(line));
-        if (len <= 0) {
-            break; /* desconexión o error */
-        }
+        double target = src.clockMs;
+        int    seek   = 0;
 
-        char tag[16];
-        if (sscanf(line, "%15s", tag) != 1) {
-            continue;
+        if (IsKeyPressed(KEY_SPACE)) {
+            src.paused = !src.paused;
         }
-
-        /* ====== STATE: posición, score, nivel, vidas, gameOver ====== */
-        if (strcmp(tag, "STATE") == 0) {
-            int  s, pid, x, y, score, level, lives;
-            char gameOverStr[8];
-
-            if (sscanf(line, "%15s %d %d %d %d %d %d %d %7s",
-                       tag, &s, &pid, &x, &y, &score, &level, &lives, gameOverStr) == 9) {
-
-                if (pid == state->playerId) {
-                    state->playerX  = x;
-                    state->playerY  = y;
-                    state->score    = score;
-                    state->level    = level;
-                    state->lives    = lives;
-                    state->gameOver = (strcmp(gameOverStr, "true") == 0);
-                }
-            }
+        if (IsKeyPressed(KEY_UP) && src.speed < REPLAY_MAX_SPEED) {
+            src.speed *= 2.0;
         }
-
-        /* ====== FRUITS_BEGIN: comienza lista de frutas ====== */
-        else if (strcmp(tag, "FRUITS_BEGIN") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inFruitBlock     = 1;
-                state->numFruits = 0;
-            }
+        if (IsKeyPressed(KEY_DOWN) && src.speed > REPLAY_MIN_SPEED) {
+            src.speed /= 2.0;
         }
-        /* ====== FRUIT x y pts ====== */
-        else if (strcmp(tag, "FRUIT") == 0) {
-            if (inFruitBlock) {
-                int fx, fy, pts;
-                if (sscanf(line, "%*s %d %d %d", &fx, &fy, &pts) == 3) {
-                    if (state->numFruits < MAX_FRUITS) {
-                        FruitInfo *f = &state->fruits[state->numFruits++];
-                        f->x      = fx;
-                        f->y      = fy;
-                        f->points = pts;
-                    }
-                }
-            }
+        if (IsKeyPressed(KEY_RIGHT)) {
+            target += src.paused ? SERVER_TICK_MS : REPLAY_SEEK_MS;
+            seek = 1;
         }
-        /* ====== FRUITS_END ====== */
-        else if (strcmp(tag, "FRUITS_END") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inFruitBlock = 0;
-            }
+        if (IsKeyPressed(KEY_LEFT)) {
+            target -= REPLAY_SEEK_MS;
+            seek = 1;
         }
-
-        /* ====== ENEMIES_BEGIN: comienza lista de enemigos ====== */
-        else if (strcmp(tag, "ENEMIES_BEGIN") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inEnemyBlock     = 1;
-                state->numEnemies = 0;
-            }
+        if (IsKeyPressed(KEY_HOME)) {
+            target = 0.0;
+            seek = 1;
         }
-        /* ====== ENEMY <type> <x> <y> ====== */
-        else if (strcmp(tag, "ENEMY") == 0) {
-            if (inEnemyBlock) {
-                char typeStr[16];
-                int  ex, ey;
-
-                if (sscanf(line, "%*s %15s %d %d", typeStr, &ex, &ey) == 3) {
-                    if (state->numEnemies < MAX_ENEMIES) {
-                        EnemyInfo *e = &state->enemies[state->numEnemies++];
-                        e->x = ex;
-                        e->y = ey;
-
-                        if (strcmp(typeStr, "RED") == 0) {
-                            e->type = 1;
-                        } else if (strcmp(typeStr, "BLUE") == 0) {
-                            e->type = 2;
-                        } else {
-                            e->type = 0;
-                        }
-                    }
-                }
+
+        if (seek) {
+            if (replay_seek(state, &src, target) != 0) {
+                break;
             }
-        }
-        /* ====== ENEMIES_END ====== */
-        else if (strcmp(tag, "ENEMIES_END") == 0) {
-            int pid = 0;
-            if (sscanf(line, "%*s %d", &pid) == 1 && pid == state->playerId) {
-                inEnemyBlock = 0;
+        } else if (!src.paused) {
+            src.clockMs += dtMs * src.speed;
+            if (replay_catch_up(state, &src) != 0) {
+                break;
             }
         }
 
-        /* --- Dibujar escena igual que en modo jugador --- */
+        interp_update(state, src.clockMs);
         BeginDrawing();
-            draw_game_scene(state);
+            render_game_scene(state);
+
+            char hud[96];
+            snprintf(hud, sizeof(hud), "REPLAY %.1f / %.1f s  x%g%s",
+                     src.clockMs / 1000.0, src.durationMs / 1000.0, src.speed,
+                     src.paused ? "  [PAUSA]" : "");
+            DrawText(hud, WINDOW_WIDTH - MeasureText(hud, 16) - 10, WINDOW_HEIGHT - 30, 16, YELLOW);
+
+            if (state->stats.overlay) {
+                render_stats_overlay(&state->stats);
+            }
         EndDrawing();
+        stats_frame(state);
     }
 
-
-    /* Al salir del bucle, simplemente volvemos al menú principal */
+    replay_close(&src);
 }
 
 
@@ -984,22 +992,30 @@ void run_spectator_mode(ClientState *state)
 /**
  * Punto de entrada principal del cliente.
  *
+ * Opciones:
+ *  - --record <archivo> : graba todo lo que llega del servidor; cada
+ *                         partida va a su propio archivo (archivo,
+ *                         archivo-2, ...; ver recorder_game_path()).
+ *  - --replay <archivo> : reproduce una grabación en vez de conectarse.
+ *  - --rate <n>         : STATE por segundo que pide el espectador
+ *                         (1..STATE_RATE_MAX; por defecto el máximo).
+ *
  * Flujo:
  *  1. Inicializar WinSock (WSAStartup).
  *  2. Crear ventana de Raylib.
  *  3. Entrar en un bucle principal donde:
  *      3.1. Se muestra la pantalla de selección de rol.
  *      3.2. Si se elige JUGADOR o ESPECTADOR:
- *           - Se crea una conexión al servidor.
+ *           - Se crea una conexión al servidor (o se reusa la anterior).
  *           - Se ejecuta el modo correspondiente (jugador / espectador).
- *           - Al salir de ese modo (por ejemplo con ESC), se cierra el socket
- *             y se regresa a la pantalla de selección.
+ *           - Al salir de ese modo (por ejemplo con ESC), LEAVE deja la
+ *             conexión abierta y se regresa a la pantalla de selección.
  *      3.3. Si se cierra la ventana o no se elige ningún rol, se sale del bucle.
  *  4. Cerrar ventana y limpiar WinSock.
  *
  * @return 0 en salida normal, 1 en caso de error de WinSock o conexión.
  */
-int main(void)
+int main(int argc, char **argv)
 {
     ClientState state;
     // Inicializamos toda la estructura a cero por seguridad
@@ -1008,6 +1024,23 @@ int main(void)
     state.role      = ROLE_NONE;
     state.connected = 0;
 
+    const char *recordPath    = NULL;
+    int         recordedGames = 0;
+    const char *replayPath    = NULL;
+    int         spectatorRate = STATE_RATE_MAX;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--record") == 0) {
+            recordPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            replayPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            spectatorRate = atoi(argv[i + 1]);
+            if (spectatorRate < 1)              spectatorRate = 1;
+            if (spectatorRate > STATE_RATE_MAX) spectatorRate = STATE_RATE_MAX;
+        }
+    }
+    Recorder recorder = { NULL, 0.0 };
+
     // --- Inicializar WinSock ---
     WSADATA wsa;
     int wsaResult = WSAStartup(MAKEWORD(2, 2), &wsa);
@@ -1022,41 +1055,80 @@ int main(void)
     // Evitar que ESC cierre la ventana automáticamente
     SetExitKey(KEY_NULL);
 
-    int running = 1;
+    int running   = 1;
+    int playAgain = 0;
+
+    // Reproducción: sin servidor ni pantalla de rol
+    if (replayPath != NULL) {
+        run_replay_mode(&state, replayPath);
+        running = 0;
+    }
 
     while (running && !WindowShouldClose()) {
 
         // 1) Mostrar pantalla inicial: escoger Jugador o Espectador
-        state.role = run_role_selection_screen();
+        //    ("Volver a jugar" entra directo otra vez como jugador)
+        if (!playAgain) {
+            state.role = run_role_selection_screen();
+        }
+        playAgain = 0;
 
         // Si se cerró la ventana dentro de la pantalla de rol o no se eligió nada:
         if (state.role == ROLE_NONE || WindowShouldClose()) {
             break;
         }
 
-        // 2) Conectar al servidor Java
-        state.socket_fd = create_and_connect_socket(SERVER_IP, SERVER_PORT);
-        if (state.socket_fd == INVALID_SOCKET) {
-            printf("No se pudo conectar al servidor.\n");
-            // Si quieres, puedes mostrar un texto en pantalla en vez de salir
-            running = 0;
-            break;
+        // 2) Conectar al servidor Java, salvo que siga abierta la conexión
+        //    de la partida anterior (sin handshake TCP, WELCOME ni mapa nuevo)
+        if (!state.connected) {
+            state.socket_fd = create_and_connect_socket(SERVER_IP, SERVER_PORT);
+            if (state.socket_fd == INVALID_SOCKET) {
+                printf("No se pudo conectar al servidor.\n");
+                // Si quieres, puedes mostrar un texto en pantalla en vez de salir
+                running = 0;
+                break;
+            }
+            state.connected = 1;
+            line_reader_init(&state.reader, state.socket_fd);
+            send_queue_init(&state.outbox, state.socket_fd);
+
+            // Saludo del servidor: trae la huella del mapa para la caché local
+            if (protocol_welcome(&state) != 0) {
+                printf("El servidor cerró la conexión.\n");
+                running = 0;
+                break;
+            }
+        }
+        if (recordPath != NULL) {
+            char gamePath[512];
+            recorder_game_path(gamePath, sizeof(gamePath), recordPath, ++recordedGames);
+            if (recorder_open(&recorder, gamePath, state.role) == 0) {
+                state.reader.recorder = &recorder;
+            }
         }
-        state.connected = 1;
 
-        // 3) Ejecutar modo según rol seleccionado
+        // 3) Ejecutar modo según rol seleccionado. Con +RATE el servidor
+        //    manda solo los STATE que cambian: el jugador los quiere todos,
+        //    el espectador al ritmo de --rate
+        state.stateRate = (state.role == ROLE_PLAYER) ? STATE_RATE_MAX : spectatorRate;
         if (state.role == ROLE_PLAYER) {
-            run_player_mode(&state);
+            playAgain = run_player_mode(&state);
         } else if (state.role == ROLE_SPECTATOR) {
             run_spectator_mode(&state);
         }
 
-        // 4) Al salir del modo (por ESC o por desconexión), cerramos socket
-        if (state.connected && state.socket_fd != INVALID_SOCKET) {
+        // 4) Al salir del modo, LEAVE deja la conexión abierta para la
+        //    próxima partida; si falla (desconexión o servidor sin LEAVE)
+        //    se cierra y la próxima vuelta reconecta
+        if (state.connected && state.socket_fd != INVALID_SOCKET &&
+            protocol_leave(&state) != 0) {
             close_socket(state.socket_fd);
             state.socket_fd = INVALID_SOCKET;
             state.connected = 0;
+            playAgain = 0;
         }
+        recorder_close(&recorder);
+        state.reader.recorder = NULL;
 
         // Importante: aquí NO cerramos la ventana.
         // El while se repite y volvemos a mostrar el menú.
@@ -1067,6 +1139,14 @@ int main(void)
         // Si sales del while por una condición propia, igual cerramos la ventana
         // (si ya está cerrada, Raylib lo maneja internamente).
     }
+    if (state.connected && state.socket_fd != INVALID_SOCKET) {
+        close_socket(state.socket_fd);
+    }
+    if (state.stats.csv != NULL) {
+        stats_toggle_csv(&state.stats); /* cierra el CSV */
+    }
+    arena_release(&state.arena);
+    render_shutdown();
     CloseWindow();
     WSACleanup();
 
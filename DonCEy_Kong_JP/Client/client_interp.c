@@ -0,0 +1,153 @@
+#include "client_constants.h"
+
+/* ============================
+ *  I N T E R P O L A C I Ó N
+ * ============================
+ *
+ * El servidor mueve todo de a un tile por tick; el render va a 60 FPS.
+ * Cada vez que cambia la posición de una entidad se guarda de dónde sale
+ * (lo que se estaba dibujando) y a dónde va, y durante el retardo
+ * configurado se dibuja en el punto intermedio según el tiempo del frame.
+ */
+
+/**
+ * Posición de la pista en el instante nowMs.
+ */
+static void track_sample(const InterpTrack *t, double nowMs, float *x, float *y)
+{
+    if (t->t1 <= t->t0 || nowMs >= t->t1) {
+        *x = t->x1;
+        *y = t->y1;
+        return;
+    }
+
+    float a = (float)((nowMs - t->t0) / (t->t1 - t->t0));
+    if (a < 0.0f) {
+        a = 0.0f;
+    }
+    *x = t->x0 + (t->x1 - t->x0) * a;
+    *y = t->y0 + (t->y1 - t->y0) * a;
+}
+
+/**
+ * Registra la posición del servidor de una entidad. Si cambió, la pista
+ * parte desde donde se estaba dibujando y llega a la nueva en delayMs.
+ */
+static void track_observe(InterpTrack *t, int x, int y, double nowMs, double delayMs)
+{
+    t->touched = 1;
+
+    if (!t->used) {
+        t->used = 1;
+        t->x0 = t->x1 = (float)x;
+        t->y0 = t->y1 = (float)y;
+        t->t0 = t->t1 = nowMs;
+        return;
+    }
+
+    if ((float)x == t->x1 && (float)y == t->y1) {
+        return;
+    }
+
+    float cx, cy;
+    track_sample(t, nowMs, &cx, &cy);
+
+    float ddx = (float)x - cx;
+    float ddy = (float)y - cy;
+    if (ddx < 0.0f) ddx = -ddx;
+    if (ddy < 0.0f) ddy = -ddy;
+
+    if (ddx > INTERP_SNAP_TILES || ddy > INTERP_SNAP_TILES) {
+        /* Teletransporte (respawn, meta): no se dibuja el recorrido */
+        cx = (float)x;
+        cy = (float)y;
+    }
+
+    t->x0 = cx;
+    t->y0 = cy;
+    t->t0 = nowMs;
+    t->x1 = (float)x;
+    t->y1 = (float)y;
+    t->t1 = nowMs + delayMs;
+}
+
+/**
+ * Busca la pista de un enemigo por id o le asigna una libre.
+ */
+static InterpTrack *enemy_track(Interpolator *interp, int id)
+{
+    InterpTrack *free_slot = NULL;
+
+    for (int i = 0; i < interp->capacity; i++) {
+        InterpTrack *t = &interp->enemies[i];
+        if (t->used && t->id == id) {
+            return t;
+        }
+        if (!t->used && free_slot == NULL) {
+            free_slot = t;
+        }
+    }
+
+    if (free_slot != NULL) {
+        free_slot->id   = id;
+        free_slot->used = 0; /* track_observe la inicializa */
+    }
+    return free_slot;
+}
+
+/**
+ * Vacía el búfer de interpolación y fija sus retardos. Las pistas de
+ * enemigos viven en la arena (storage_reserve_enemies()): se limpian,
+ * no se liberan.
+ */
+void interp_reset(Interpolator *interp, double delayMs, double playerDelayMs)
+{
+    memset(&interp->player, 0, sizeof(interp->player));
+    if (interp->capacity > 0) {
+        memset(interp->enemies, 0, sizeof(InterpTrack) * interp->capacity);
+    }
+    interp->playerX       = 0.0f;
+    interp->playerY       = 0.0f;
+    interp->delayMs       = delayMs;
+    interp->playerDelayMs = playerDelayMs;
+}
+
+/**
+ * Registra las posiciones actuales y calcula las de este frame.
+ */
+void interp_update(ClientState *state, double nowMs)
+{
+    Interpolator *interp = &state->interp;
+
+    /* Jugador: con predicción el cambio ya es local, se suaviza menos */
+    double playerDelay = state->prediction.enabled ? interp->playerDelayMs
+                                                   : interp->delayMs;
+    track_observe(&interp->player, state->playerX, state->playerY, nowMs, playerDelay);
+    track_sample(&interp->player, nowMs, &interp->playerX, &interp->playerY);
+
+    /* Enemigos: emparejados por id estable (servidores sin id: por índice) */
+    for (int i = 0; i < interp->capacity; i++) {
+        interp->enemies[i].touched = 0;
+    }
+
+    for (int i = 0; i < state->numEnemies; i++) {
+        const EnemyInfo *e = &state->enemies[i];
+        int id = e->id != 0 ? e->id : -(i + 1);
+
+        InterpTrack *t = enemy_track(interp, id);
+        if (t == NULL) {
+            interp->enemyX[i] = (float)e->x;
+            interp->enemyY[i] = (float)e->y;
+            continue;
+        }
+        track_observe(t, e->x, e->y, nowMs, interp->delayMs);
+        track_sample(t, nowMs, &interp->enemyX[i], &interp->enemyY[i]);
+    }
+
+    /* Liberar pistas de enemigos que ya no existen */
+    for (int i = 0; i < interp->capacity; i++) {
+        if (!interp->enemies[i].touched) {
+            interp->enemies[i].used = 0;
+        }
+    }
+}
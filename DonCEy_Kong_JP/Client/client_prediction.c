@@ -0,0 +1,228 @@
+#include "client_constants.h"
+
+/* ============================
+ *  R E G L A S   D E L   S E R V I D O R
+ * ============================
+ *
+ * Copia de las reglas de movimiento de Server.onInput() y Server.tick()
+ * (flagsAt, hasSolidBelow, isSupported, gravedad). Si cambian
+ * allá, hay que cambiarlas aquí también o la predicción se desvía: no se
+ * rompe el juego, pero el jugador "salta" al corregirse con cada STATE.
+ */
+
+/* Propiedades de cada carácter de tile (el resto queda en 0 = vacío) */
+static const unsigned char TILE_FLAGS[256] = {
+    ['T'] = TILE_FLAG_SOLID | TILE_FLAG_CEILING | TILE_FLAG_WALL,
+    ['='] = TILE_FLAG_SOLID | TILE_FLAG_CEILING | TILE_FLAG_WALL,
+    ['|'] = TILE_FLAG_SOLID | TILE_FLAG_LIANA,
+    ['S'] = TILE_FLAG_SOLID | TILE_FLAG_CEILING | TILE_FLAG_SPAWN,
+    ['W'] = TILE_FLAG_WATER,
+    ['G'] = TILE_FLAG_GOAL,
+};
+
+int tile_flags(char tile)
+{
+    return TILE_FLAGS[(unsigned char)tile];
+}
+
+/**
+ * Precalcula los flags de todo el mapa y, en la misma pasada, su huella
+ * (FNV-1a sobre tamaño y tiles).
+ */
+void map_build_flags(GameMap *map)
+{
+    unsigned int hash = 2166136261u;
+    hash = (hash ^ (unsigned int)map->width)  * 16777619u;
+    hash = (hash ^ (unsigned int)map->height) * 16777619u;
+
+    int cells = map->width * map->height;
+    for (int i = 0; i < cells; i++) {
+        unsigned char t = (unsigned char)map->tiles[i];
+        map->flags[i] = TILE_FLAGS[t];
+        hash = (hash ^ t) * 16777619u;
+    }
+    map->hash = hash;
+}
+
+/** Igual que Server.flagsAt(): fuera de los límites lógicos es vacío. */
+int map_flags_at(const GameMap *map, int x, int y)
+{
+    if (x < WORLD_MIN_X || x > WORLD_MAX_X || y < WORLD_MIN_Y || y > WORLD_MAX_Y) {
+        return 0;
+    }
+    if (x >= map->width || y >= map->height) {
+        return 0;
+    }
+    return MAP_FLAGS(map, x, y);
+}
+
+static int has_solid_below(const GameMap *map, int x, int y)
+{
+    if (y <= WORLD_MIN_Y) {
+        return 0;
+    }
+    return (map_flags_at(map, x, y - 1) & TILE_FLAG_SOLID) != 0;
+}
+
+static int is_supported(const GameMap *map, int x, int y)
+{
+    return (map_flags_at(map, x, y) & TILE_FLAG_SOLID) || has_solid_below(map, x, y);
+}
+
+/**
+ * Simula un tick del servidor con un INPUT: validación de onInput(),
+ * movimiento con límites y paredes, y gravedad si no subió.
+ */
+static void simulate_input(const GameMap *map, int *x, int *y, int dx, int dy)
+{
+    /* --- Server.onInput() --- */
+    if (abs(dx) == 2 && dy != 1) {
+        dx = 0;
+    }
+    if (dy > 0) {
+        if (!is_supported(map, *x, *y) ||
+            (map_flags_at(map, *x, *y + 1) & TILE_FLAG_CEILING)) {
+            dx = 0;
+            dy = 0;
+        }
+    }
+
+    /* --- Server.tick(): movimiento --- */
+    int oldY = *y;
+    if (dx != 0 || dy != 0) {
+        int nx = *x + dx;
+        int ny = *y + dy;
+
+        if (nx < WORLD_MIN_X) nx = WORLD_MIN_X;
+        if (nx > WORLD_MAX_X) nx = WORLD_MAX_X;
+        if (ny < WORLD_MIN_Y) ny = WORLD_MIN_Y;
+        if (ny > WORLD_MAX_Y) ny = WORLD_MAX_Y;
+
+        if (!(map_flags_at(map, nx, ny) & TILE_FLAG_WALL)) {
+            *x = nx;
+            *y = ny;
+        }
+    }
+
+    /* --- Server.tick(): gravedad (no aplica en el tick en que subió) --- */
+    if (*y <= oldY) {
+        if (!(map_flags_at(map, *x, *y) & TILE_FLAG_LIANA) && *y > WORLD_MIN_Y &&
+            !has_solid_below(map, *x, *y)) {
+            *y -= 1;
+        }
+    }
+}
+
+
+/* ============================
+ *  P R E D I C C I Ó N   Y   R E C O N C I L I A C I Ó N
+ * ============================ */
+
+/**
+ * Reinicia la predicción al entrar a un modo de juego.
+ */
+void prediction_reset(ClientState *state, int enabled)
+{
+    Prediction *p = &state->prediction;
+
+    p->enabled     = enabled;
+    p->lastSentSeq = 0;
+    p->lastAckSeq  = 0;
+    p->serverX     = state->playerX;
+    p->serverY     = state->playerY;
+    p->lastSendMs  = -SERVER_TICK_MS; /* el primer INPUT sale de inmediato */
+    p->hasQueued   = 0;
+    p->queuedDx    = 0;
+    p->queuedDy    = 0;
+}
+
+/**
+ * Registra el input del frame actual con la misma preferencia que el
+ * servidor usa al elegir un INPUT por tick.
+ */
+void prediction_queue_input(ClientState *state, int dx, int dy)
+{
+    Prediction *p = &state->prediction;
+
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+
+    if (!p->hasQueued ||
+        dy > p->queuedDy ||
+        (dy == p->queuedDy && abs(dx) > abs(p->queuedDx))) {
+        p->hasQueued = 1;
+        p->queuedDx  = dx;
+        p->queuedDy  = dy;
+    }
+}
+
+/**
+ * Envía el INPUT pendiente si ya pasó un tick y lo aplica localmente.
+ */
+int prediction_send_due(ClientState *state, double nowMs)
+{
+    Prediction *p = &state->prediction;
+    char cmd[64];
+
+    if (!p->hasQueued || nowMs - p->lastSendMs < SERVER_TICK_MS) {
+        return 0;
+    }
+
+    int seq = ++p->lastSentSeq;
+    snprintf(cmd, sizeof(cmd), "INPUT %d %d %d\n", seq, p->queuedDx, p->queuedDy);
+    send_queue_push(&state->outbox, cmd);
+
+    InputRecord *rec = &p->history[seq & (PREDICTION_HISTORY - 1)];
+    rec->seq    = seq;
+    rec->dx     = p->queuedDx;
+    rec->dy     = p->queuedDy;
+    rec->sentMs = client_now_ms();
+
+    if (p->enabled) {
+        simulate_input(&state->map, &state->playerX, &state->playerY,
+                       p->queuedDx, p->queuedDy);
+    }
+
+    p->lastSendMs = nowMs;
+    p->hasQueued  = 0;
+    return 1;
+}
+
+/**
+ * Aplica un STATE: posición del servidor + INPUT aún no reconocidos.
+ */
+void prediction_on_state(ClientState *state, int x, int y, int ackSeq)
+{
+    Prediction *p = &state->prediction;
+
+    p->serverX = x;
+    p->serverY = y;
+    state->playerX = x;
+    state->playerY = y;
+
+    if (!p->enabled || ackSeq < 0) {
+        return; /* espectador o servidor sin acks: se dibuja lo autoritativo */
+    }
+
+    if (ackSeq > p->lastAckSeq) {
+        /* RTT INPUT→ack del más reciente reconocido (si sigue en el anillo) */
+        const InputRecord *acked = &p->history[ackSeq & (PREDICTION_HISTORY - 1)];
+        if (acked->seq == ackSeq && ackSeq <= p->lastSentSeq) {
+            stats_rtt(&state->stats, client_now_ms() - acked->sentMs);
+        }
+        p->lastAckSeq = ackSeq;
+    }
+
+    /* Si hay más pendientes que historial no se puede reproducir con
+     * fidelidad; se espera a que los acks alcancen */
+    if (p->lastSentSeq - p->lastAckSeq > PREDICTION_HISTORY) {
+        return;
+    }
+
+    for (int seq = p->lastAckSeq + 1; seq <= p->lastSentSeq; seq++) {
+        const InputRecord *rec = &p->history[seq & (PREDICTION_HISTORY - 1)];
+        simulate_input(&state->map, &state->playerX, &state->playerY,
+                       rec->dx, rec->dy);
+    }
+}
@@ -0,0 +1,1344 @@
+#include "client_constants.h"
+
+/* ============================
+ *  D E L T A S   D E   E N T I D A D E S
+ * ============================ */
+
+/* Busca una entidad por id; devuelve su índice o -1 */
+
+static int find_fruit(const FruitInfo *fruits, int count, int id)
+{
+    for (int i = 0; i < count; i++) {
+        if (fruits[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int find_enemy(const EnemyInfo *enemies, int count, int id)
+{
+    for (int i = 0; i < count; i++) {
+        if (enemies[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Aplica una operación de delta sobre una lista de frutas con espacio para
+ * `capacity` elementos (reservado antes con storage_reserve_fruits()).
+ * Las operaciones son absolutas: aplicar dos veces la misma no cambia nada.
+ */
+static void apply_fruit_op(FruitInfo *fruits, int *count, int capacity,
+                           int op, int id, int x, int y, int points)
+{
+    int i = find_fruit(fruits, *count, id);
+
+    if (op == DELTA_OP_REMOVE) {
+        if (i >= 0) {
+            fruits[i] = fruits[--(*count)]; /* el orden no importa al dibujar */
+        }
+        return;
+    }
+
+    if (i < 0) {
+        if (*count >= capacity) {
+            return;
+        }
+        i = (*count)++;
+    }
+    fruits[i].id     = id;
+    fruits[i].x      = x;
+    fruits[i].y      = y;
+    fruits[i].points = points;
+}
+
+/**
+ * Aplica una operación de delta sobre una lista de enemigos.
+ * MOVE sobre un id desconocido se ignora (llegará en el próximo keyframe).
+ */
+static void apply_enemy_op(EnemyInfo *enemies, int *count, int capacity,
+                           int op, int id, int type, int x, int y)
+{
+    int i = find_enemy(enemies, *count, id);
+
+    if (op == DELTA_OP_REMOVE) {
+        if (i >= 0) {
+            enemies[i] = enemies[--(*count)];
+        }
+        return;
+    }
+
+    if (op == DELTA_OP_MOVE) {
+        if (i >= 0) {
+            enemies[i].x = x;
+            enemies[i].y = y;
+        }
+        return;
+    }
+
+    if (i < 0) {
+        if (*count >= capacity) {
+            return;
+        }
+        i = (*count)++;
+    }
+    enemies[i].id   = id;
+    enemies[i].type = type;
+    enemies[i].x    = x;
+    enemies[i].y    = y;
+}
+
+/**
+ * Decide si un delta con número de snapshot `seq` se puede aplicar sobre
+ * el último snapshot conocido `*lastSeq`.
+ *
+ * - seq == last+1 : se aplica.
+ * - seq <= last   : repetido o viejo, se ignora.
+ * - hueco         : se descarta el estado (lastSeq = -1) y se pide RESYNC
+ *                   una sola vez; los deltas se ignoran hasta el keyframe.
+ *
+ * @return 1 si el delta se debe aplicar, 0 si no.
+ */
+static int accept_delta(ClientState *state, int *lastSeq, int seq)
+{
+    if (*lastSeq < 0) {
+        return 0; /* esperando keyframe */
+    }
+    if (seq == *lastSeq + 1) {
+        return 1;
+    }
+    if (seq <= *lastSeq) {
+        return 0;
+    }
+
+    *lastSeq = -1;
+    if (!state->resyncRequested) {
+        state->resyncRequested = 1;
+        send_queue_push(&state->outbox, "RESYNC\n");
+    }
+    return 0;
+}
+
+/**
+ * Deja frutas, enemigos y secuencias listos para una nueva partida.
+ */
+void protocol_reset(ClientState *state, int synced)
+{
+    state->numFruits         = 0;
+    state->numEnemies        = 0;
+    state->pendingNumFruits  = 0;
+    state->pendingNumEnemies = 0;
+    state->fruitSeq          = synced ? 0 : -1;
+    state->enemySeq          = synced ? 0 : -1;
+    state->pendingFruitSeq   = -1;
+    state->pendingEnemySeq   = -1;
+    state->inFruitBlock      = BLOCK_NONE;
+    state->inEnemyBlock      = BLOCK_NONE;
+    state->resyncRequested   = 0;
+}
+
+/* ============================
+ *  P R O T O C O L O   B I N A R I O
+ * ============================ */
+
+/* Lectores big-endian de ancho fijo sobre la carga útil de una trama */
+
+static int rd_u8(const unsigned char *p)
+{
+    return p[0];
+}
+
+static int rd_u16(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static int rd_i16(const unsigned char *p)
+{
+    return (short)((p[0] << 8) | p[1]);
+}
+
+static int rd_i32(const unsigned char *p)
+{
+    return (int)(((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+                 ((unsigned int)p[2] << 8)  |  (unsigned int)p[3]);
+}
+
+/** Tope de una línea de MSG_TEXT que se interpreta (las de STATS caben). */
+#define TEXT_FRAME_LINE_MAX 256
+
+static void dispatch_line(ClientState *state, char *line, int count);
+
+/**
+ * MSG_TEXT: líneas de control (END, BYE, ERR ...) que los bucles de juego
+ * no necesitan; se ignoran igual que en el protocolo de texto. La
+ * excepción es el bloque STATS del servidor, que solo existe como texto.
+ */
+static int on_text_frame(ClientState *state, const unsigned char *p, int len)
+{
+    char line[TEXT_FRAME_LINE_MAX];
+
+    if (len < 5 || len >= (int)sizeof(line) || memcmp(p, "STATS", 5) != 0) {
+        return 0;
+    }
+    memcpy(line, p, (size_t)len);
+    line[len] = '\0';
+    dispatch_line(state, line, 0); /* la trama ya se contó como MSG_TEXT */
+    return 0;
+}
+
+/**
+ * MSG_STATE: posición, score, nivel, vidas y gameOver del jugador, y desde
+ * la predicción local el último INPUT reconocido (u32 al final).
+ */
+static int on_state_frame(ClientState *state, const unsigned char *p, int len)
+{
+    if (len < 19) {
+        return -1;
+    }
+
+    int pid = rd_u16(p + 4);
+    if (pid != state->playerId) {
+        return 0;
+    }
+
+    state->score    = rd_i32(p + 10);
+    state->level    = rd_u16(p + 14);
+    state->lives    = rd_u16(p + 16);
+    state->gameOver = rd_u8(p + 18) != 0;
+    prediction_on_state(state, rd_i16(p + 6), rd_i16(p + 8),
+                        len >= 23 ? rd_i32(p + 19) : -1);
+    return 0;
+}
+
+/**
+ * MSG_MAP: mapa completo en una sola trama (fila y=0 primero).
+ */
+static int on_map_frame(ClientState *state, const unsigned char *p, int len)
+{
+    if (len < 4) {
+        return -1;
+    }
+
+    int width  = rd_u16(p);
+    int height = rd_u16(p + 2);
+
+    if (width > MAX_MAP_WIDTH || height > MAX_MAP_HEIGHT ||
+        len < 4 + width * height ||
+        storage_reserve_map(state, width, height) != 0) {
+        state->map.width  = 0;
+        state->map.height = 0;
+        return -1;
+    }
+
+    /* Mismo orden fila por fila que GameMap.tiles: una sola copia */
+    memcpy(state->map.tiles, p + 4, (size_t)width * height);
+    map_build_flags(&state->map);
+    state->map.version++;
+    return 0;
+}
+
+/**
+ * MSG_FRUITS: keyframe, la lista llega completa y se publica directamente.
+ */
+static int on_fruits_frame(ClientState *state, const unsigned char *p, int len)
+{
+    if (len < 8) {
+        return -1;
+    }
+
+    int pid   = rd_u16(p);
+    int seq   = rd_i32(p + 2);
+    int count = rd_u16(p + 6);
+    if (len < 8 + count * 10) {
+        return -1;
+    }
+    if (pid != state->playerId) {
+        return 0;
+    }
+    if (storage_reserve_fruits(state, count) != 0) {
+        count = state->fruitCapacity;
+    }
+
+    const unsigned char *it = p + 8;
+    for (int i = 0; i < count; i++, it += 10) {
+        state->fruits[i].id     = rd_u16(it);
+        state->fruits[i].x      = rd_i16(it + 2);
+        state->fruits[i].y      = rd_i16(it + 4);
+        state->fruits[i].points = rd_i32(it + 6);
+    }
+    state->numFruits       = count;
+    state->fruitSeq        = seq;
+    state->resyncRequested = 0;
+    return 0;
+}
+
+/**
+ * MSG_ENEMIES: igual que las frutas, la lista llega completa.
+ */
+static int on_enemies_frame(ClientState *state, const unsigned char *p, int len)
+{
+    if (len < 8) {
+        return -1;
+    }
+
+    int pid   = rd_u16(p);
+    int seq   = rd_i32(p + 2);
+    int count = rd_u16(p + 6);
+    if (len < 8 + count * 7) {
+        return -1;
+    }
+    if (pid != state->playerId) {
+        return 0;
+    }
+    if (storage_reserve_enemies(state, count) != 0) {
+        count = state->enemyCapacity;
+    }
+
+    const unsigned char *it = p + 8;
+    for (int i = 0; i < count; i++, it += 7) {
+        state->enemies[i].id   = rd_u16(it);
+        state->enemies[i].type = rd_u8(it + 2);
+        state->enemies[i].x    = rd_i16(it + 3);
+        state->enemies[i].y    = rd_i16(it + 5);
+    }
+    state->numEnemies      = count;
+    state->enemySeq        = seq;
+    state->resyncRequested = 0;
+    return 0;
+}
+
+/**
+ * MSG_FRUITS_DELTA: altas y bajas desde el snapshot anterior. La trama
+ * llega completa, así que se aplica directamente sobre la lista visible.
+ */
+static int on_fruits_delta_frame(ClientState *state, const unsigned char *p, int len)
+{
+    if (len < 8) {
+        return -1;
+    }
+
+    int pid   = rd_u16(p);
+    int seq   = rd_i32(p + 2);
+    int count = rd_u16(p + 6);
+    if (len < 8 + count * 11) {
+        return -1;
+    }
+    if (pid != state->playerId || !accept_delta(state, &state->fruitSeq, seq)) {
+        return 0;
+    }
+    storage_reserve_fruits(state, state->numFruits + count); /* peor caso: todo altas */
+
+    const unsigned char *it = p + 8;
+    for (int i = 0; i < count; i++, it += 11) {
+        apply_fruit_op(state->fruits, &state->numFruits, state->fruitCapacity,
+                       rd_u8(it), rd_u16(it + 1),
+                       rd_i16(it + 3), rd_i16(it + 5), rd_i32(it + 7));
+    }
+    state->fruitSeq = seq;
+    return 0;
+}
+
+/**
+ * MSG_ENEMIES_DELTA: altas, movimientos y bajas de enemigos.
+ */
+static int on_enemies_delta_frame(ClientState *state, const unsigned char *p, int len)
+{
+    if (len < 8) {
+        return -1;
+    }
+
+    int pid   = rd_u16(p);
+    int seq   = rd_i32(p + 2);
+    int count = rd_u16(p + 6);
+    if (len < 8 + count * 8) {
+        return -1;
+    }
+    if (pid != state->playerId || !accept_delta(state, &state->enemySeq, seq)) {
+        return 0;
+    }
+    storage_reserve_enemies(state, state->numEnemies + count);
+
+    const unsigned char *it = p + 8;
+    for (int i = 0; i < count; i++, it += 8) {
+        apply_enemy_op(state->enemies, &state->numEnemies, state->enemyCapacity,
+                       rd_u8(it), rd_u16(it + 1), rd_u8(it + 3),
+                       rd_i16(it + 4), rd_i16(it + 6));
+    }
+    state->enemySeq = seq;
+    return 0;
+}
+
+/** Categoría de estadísticas de cada tipo de trama. */
+static int frame_stats_tag(int type)
+{
+    switch (type) {
+        case BIN_MSG_STATE:         return STATS_TAG_STATE;
+        case BIN_MSG_FRUITS:
+        case BIN_MSG_FRUITS_DELTA:  return STATS_TAG_FRUIT;
+        case BIN_MSG_ENEMIES:
+        case BIN_MSG_ENEMIES_DELTA: return STATS_TAG_ENEMY;
+        case BIN_MSG_MAP:           return STATS_TAG_MAP;
+        default:                    return STATS_TAG_OTHER;
+    }
+}
+
+/** Manejador de un tipo de trama: recibe la carga útil (sin el tipo). */
+typedef int (*FrameHandler)(ClientState *state, const unsigned char *payload, int len);
+
+/** Tabla de decodificación indexada por el byte de tipo. */
+static const FrameHandler FRAME_HANDLERS[256] = {
+    [BIN_MSG_TEXT]    = on_text_frame,
+    [BIN_MSG_STATE]   = on_state_frame,
+    [BIN_MSG_MAP]     = on_map_frame,
+    [BIN_MSG_FRUITS]  = on_fruits_frame,
+    [BIN_MSG_ENEMIES] = on_enemies_frame,
+    [BIN_MSG_FRUITS_DELTA]  = on_fruits_delta_frame,
+    [BIN_MSG_ENEMIES_DELTA] = on_enemies_delta_frame,
+};
+
+/**
+ * Decodifica una trama binaria y la aplica sobre el estado del cliente.
+ *
+ * @param state Estado del cliente a actualizar.
+ * @param frame Trama (byte de tipo + carga útil).
+ * @param len   Longitud de la trama.
+ * @return Tipo procesado (BIN_MSG_*) o -1 si la trama es inválida.
+ */
+int protocol_handle_frame(ClientState *state, const unsigned char *frame, int len)
+{
+    if (len < 1) {
+        return -1;
+    }
+
+    int type = frame[0];
+    stats_count(&state->stats, frame_stats_tag(type), len + 2);
+
+    FrameHandler handler = FRAME_HANDLERS[type];
+    if (handler == NULL) {
+        return -1; /* tipo desconocido: se ignora */
+    }
+
+    if (handler(state, frame + 1, len - 1) != 0) {
+        return -1;
+    }
+    return type;
+}
+
+
+/* ============================
+ *  P R O T O C O L O   D E   T E X T O
+ * ============================
+ *
+ * Igual que el binario, por tabla: el tag se ubica con un switch sobre su
+ * primer byte más una comparación de largo, y los campos se leen a mano
+ * sobre la propia línea, sin sscanf() ni copias.
+ */
+
+/** Dígitos máximos de un campo entero: 9 caben en un int sin desbordar. */
+#define PARSE_INT_MAX_DIGITS 9
+
+/**
+ * Lee un entero decimal (con signo) saltando los espacios previos. Un
+ * número de más de PARSE_INT_MAX_DIGITS dígitos no es válido: ningún campo
+ * del protocolo llega a eso y acumularlo desbordaría el int.
+ *
+ * @return 1 y avanza *p si había un número, 0 si no (sin avanzar).
+ */
+static int parse_int(const char **p, int *out)
+{
+    const char *s = *p;
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+
+    int negative = (*s == '-');
+    if (*s == '-' || *s == '+') {
+        s++;
+    }
+    if (*s < '0' || *s > '9') {
+        return 0;
+    }
+
+    int value  = 0;
+    int digits = 0;
+    while (*s >= '0' && *s <= '9') {
+        if (++digits > PARSE_INT_MAX_DIGITS) {
+            return 0;
+        }
+        value = value * 10 + (*s - '0');
+        s++;
+    }
+    *out = negative ? -value : value;
+    *p   = s;
+    return 1;
+}
+
+/**
+ * Lee hasta `max` enteros seguidos.
+ *
+ * @return Cantidad leída (se detiene en el primer campo que no es número).
+ */
+static int parse_ints(const char **p, int *out, int max)
+{
+    int count = 0;
+    while (count < max && parse_int(p, &out[count])) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Lee una palabra (hasta espacio o fin de línea) saltando los espacios previos.
+ *
+ * @return Largo de la palabra (0 si no había) y su inicio en *word.
+ */
+static int parse_word(const char **p, const char **word)
+{
+    const char *s = *p;
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    *word = s;
+    while (*s != '\0' && *s != ' ' && *s != '\t') {
+        s++;
+    }
+    *p = s;
+    return (int)(s - *word);
+}
+
+/** Traduce "RED"/"BLUE" al código de EnemyInfo.type. */
+static int enemy_type_from_name(const char *name, int length)
+{
+    if (length == 3 && memcmp(name, "RED", 3) == 0) {
+        return 1;
+    }
+    if (length == 4 && memcmp(name, "BLUE", 4) == 0) {
+        return 2;
+    }
+    return 0;
+}
+
+/* Cada manejador recibe lo que sigue al tag. Listas completas (keyframes)
+ * y deltas se arman en el búfer trasero (pending*) y solo se publican al
+ * llegar su línea final, para que el render nunca dibuje un bloque a
+ * medio recibir. */
+
+/** STATE <seq> <pid> <x> <y> <score> <nivel> <vidas> <gameOver> [ack] */
+static void on_state_line(ClientState *state, const char *args)
+{
+    int         v[7];
+    const char *word;
+    int         ack = -1;
+
+    if (parse_ints(&args, v, 7) != 7) {
+        return;
+    }
+    int length = parse_word(&args, &word);
+    if (length == 0) {
+        return;
+    }
+    parse_int(&args, &ack);
+
+    if (v[1] == state->playerId) {
+        state->score    = v[4];
+        state->level    = v[5];
+        state->lives    = v[6];
+        state->gameOver = (length == 4 && memcmp(word, "true", 4) == 0);
+        prediction_on_state(state, v[2], v[3], ack);
+    }
+}
+
+/** FRUITS_BEGIN <pid> [seq] [n]: comienza lista de frutas */
+static void on_fruits_begin_line(ClientState *state, const char *args)
+{
+    int v[3] = { 0, -1, 0 };
+    if (parse_ints(&args, v, 3) >= 1 && v[0] == state->playerId) {
+        storage_reserve_fruits(state, v[2]);
+        state->inFruitBlock     = BLOCK_FULL;
+        state->pendingNumFruits = 0;
+        state->pendingFruitSeq  = v[1];
+    }
+}
+
+/** FRUIT <x> <y> <pts> [id] */
+static void on_fruit_line(ClientState *state, const char *args)
+{
+    int v[4] = { 0, 0, 0, 0 };
+    if (state->inFruitBlock != BLOCK_FULL || parse_ints(&args, v, 4) < 3) {
+        return;
+    }
+
+    /* Sin n en FRUITS_BEGIN (servidor anterior): crecer aquí */
+    if (storage_reserve_fruits(state, state->pendingNumFruits + 1) == 0) {
+        FruitInfo *f = &state->pendingFruits[state->pendingNumFruits++];
+        f->id     = v[3];
+        f->x      = v[0];
+        f->y      = v[1];
+        f->points = v[2];
+    }
+}
+
+/** FRUITS_DELTA <pid> <seq> [n]: cambios desde el snapshot anterior */
+static void on_fruits_delta_line(ClientState *state, const char *args)
+{
+    int v[3] = { 0, 0, 0 };
+    if (parse_ints(&args, v, 3) >= 2 && v[0] == state->playerId &&
+        accept_delta(state, &state->fruitSeq, v[1])) {
+        storage_reserve_fruits(state, state->numFruits + v[2]);
+        /* Se parte de la lista visible y se le aplican las operaciones */
+        memcpy(state->pendingFruits, state->fruits,
+               sizeof(FruitInfo) * state->numFruits);
+        state->pendingNumFruits = state->numFruits;
+        state->pendingFruitSeq  = v[1];
+        state->inFruitBlock     = BLOCK_DELTA;
+    }
+}
+
+/** FRUIT_ADD <id> <x> <y> <pts> */
+static void on_fruit_add_line(ClientState *state, const char *args)
+{
+    int v[4];
+    if (state->inFruitBlock == BLOCK_DELTA && parse_ints(&args, v, 4) == 4) {
+        /* n del encabezado ya reservó; esto solo crece si venía mal */
+        storage_reserve_fruits(state, state->pendingNumFruits + 1);
+        apply_fruit_op(state->pendingFruits, &state->pendingNumFruits,
+                       state->fruitCapacity, DELTA_OP_ADD, v[0], v[1], v[2], v[3]);
+    }
+}
+
+/** FRUIT_REMOVE <id> */
+static void on_fruit_remove_line(ClientState *state, const char *args)
+{
+    int id;
+    if (state->inFruitBlock == BLOCK_DELTA && parse_int(&args, &id)) {
+        apply_fruit_op(state->pendingFruits, &state->pendingNumFruits,
+                       state->fruitCapacity, DELTA_OP_REMOVE, id, 0, 0, 0);
+    }
+}
+
+/** FRUITS_END <pid> / FRUITS_DELTA_END <pid> */
+static void on_fruits_end_line(ClientState *state, const char *args)
+{
+    int pid;
+    if (state->inFruitBlock == BLOCK_NONE ||
+        !parse_int(&args, &pid) || pid != state->playerId) {
+        return;
+    }
+    if (state->inFruitBlock == BLOCK_FULL) {
+        state->resyncRequested = 0;
+    }
+    state->inFruitBlock = BLOCK_NONE;
+    /* Lista completa: se publica de una sola vez */
+    memcpy(state->fruits, state->pendingFruits,
+           sizeof(FruitInfo) * state->pendingNumFruits);
+    state->numFruits = state->pendingNumFruits;
+    state->fruitSeq  = state->pendingFruitSeq;
+}
+
+/** ENEMIES_BEGIN <pid> [seq] [n]: comienza lista de enemigos */
+static void on_enemies_begin_line(ClientState *state, const char *args)
+{
+    int v[3] = { 0, -1, 0 };
+    if (parse_ints(&args, v, 3) >= 1 && v[0] == state->playerId) {
+        storage_reserve_enemies(state, v[2]);
+        state->inEnemyBlock      = BLOCK_FULL;
+        state->pendingNumEnemies = 0;
+        state->pendingEnemySeq   = v[1];
+    }
+}
+
+/** ENEMY <type> <x> <y> [id] */
+static void on_enemy_line(ClientState *state, const char *args)
+{
+    const char *type;
+    int         v[3] = { 0, 0, 0 };
+
+    if (state->inEnemyBlock != BLOCK_FULL) {
+        return;
+    }
+    int length = parse_word(&args, &type);
+    if (length == 0 || parse_ints(&args, v, 3) < 2) {
+        return;
+    }
+
+    if (storage_reserve_enemies(state, state->pendingNumEnemies + 1) == 0) {
+        EnemyInfo *e = &state->pendingEnemies[state->pendingNumEnemies++];
+        e->id   = v[2];
+        e->x    = v[0];
+        e->y    = v[1];
+        e->type = enemy_type_from_name(type, length);
+    }
+}
+
+/** ENEMIES_DELTA <pid> <seq> [n] */
+static void on_enemies_delta_line(ClientState *state, const char *args)
+{
+    int v[3] = { 0, 0, 0 };
+    if (parse_ints(&args, v, 3) >= 2 && v[0] == state->playerId &&
+        accept_delta(state, &state->enemySeq, v[1])) {
+        storage_reserve_enemies(state, state->numEnemies + v[2]);
+        memcpy(state->pendingEnemies, state->enemies,
+               sizeof(EnemyInfo) * state->numEnemies);
+        state->pendingNumEnemies = state->numEnemies;
+        state->pendingEnemySeq   = v[1];
+        state->inEnemyBlock      = BLOCK_DELTA;
+    }
+}
+
+/** ENEMY_ADD <id> <type> <x> <y> */
+static void on_enemy_add_line(ClientState *state, const char *args)
+{
+    const char *type;
+    int         id, v[2];
+
+    if (state->inEnemyBlock != BLOCK_DELTA || !parse_int(&args, &id)) {
+        return;
+    }
+    int length = parse_word(&args, &type);
+    if (length == 0 || parse_ints(&args, v, 2) != 2) {
+        return;
+    }
+    storage_reserve_enemies(state, state->pendingNumEnemies + 1);
+    apply_enemy_op(state->pendingEnemies, &state->pendingNumEnemies,
+                   state->enemyCapacity, DELTA_OP_ADD, id,
+                   enemy_type_from_name(type, length), v[0], v[1]);
+}
+
+/** ENEMY_MOVE <id> <x> <y> */
+static void on_enemy_move_line(ClientState *state, const char *args)
+{
+    int v[3];
+    if (state->inEnemyBlock == BLOCK_DELTA && parse_ints(&args, v, 3) == 3) {
+        apply_enemy_op(state->pendingEnemies, &state->pendingNumEnemies,
+                       state->enemyCapacity, DELTA_OP_MOVE, v[0], 0, v[1], v[2]);
+    }
+}
+
+/** ENEMY_REMOVE <id> */
+static void on_enemy_remove_line(ClientState *state, const char *args)
+{
+    int id;
+    if (state->inEnemyBlock == BLOCK_DELTA && parse_int(&args, &id)) {
+        apply_enemy_op(state->pendingEnemies, &state->pendingNumEnemies,
+                       state->enemyCapacity, DELTA_OP_REMOVE, id, 0, 0, 0);
+    }
+}
+
+/** ENEMIES_END <pid> / ENEMIES_DELTA_END <pid> */
+static void on_enemies_end_line(ClientState *state, const char *args)
+{
+    int pid;
+    if (state->inEnemyBlock == BLOCK_NONE ||
+        !parse_int(&args, &pid) || pid != state->playerId) {
+        return;
+    }
+    if (state->inEnemyBlock == BLOCK_FULL) {
+        state->resyncRequested = 0;
+    }
+    state->inEnemyBlock = BLOCK_NONE;
+    memcpy(state->enemies, state->pendingEnemies,
+           sizeof(EnemyInfo) * state->pendingNumEnemies);
+    state->numEnemies = state->pendingNumEnemies;
+    state->enemySeq   = state->pendingEnemySeq;
+}
+
+/** Microsegundos del servidor a milisegundos. */
+static double us_to_ms(int us)
+{
+    return (double)us / 1000.0;
+}
+
+/**
+ * STATS <ticks> <overruns> <overrunsSeg> <atrasoMax> <tickProm> <tickMax>
+ *       <input> <gravedad> <enemigos> <broadcast> <clientes>
+ *       [inputsRecibidos lineasLog lineasLogDescartadas]
+ * (tiempos en µs): abre el bloque del segundo.
+ */
+static void on_server_stats_line(ClientState *state, const char *args)
+{
+    ServerStats *s = &state->stats.pendingServer;
+    int          v[14];
+    int          n = parse_ints(&args, v, 14);
+
+    if (n < 11) {
+        return;
+    }
+    memset(s, 0, sizeof(*s));
+    s->ticks          = v[0];
+    s->overruns       = v[1];
+    s->windowOverruns = v[2];
+    s->lateMaxMs      = us_to_ms(v[3]);
+    s->tickAvgMs      = us_to_ms(v[4]);
+    s->tickMaxMs      = us_to_ms(v[5]);
+    for (int i = 0; i < SERVER_PHASE_COUNT; i++) {
+        s->phaseMs[i] = us_to_ms(v[6 + i]);
+    }
+    s->clients    = v[10];
+    s->inputLines = n >= 14 ? v[11] : -1;
+    s->logLines   = n >= 14 ? v[12] : -1;
+    s->logDropped = n >= 14 ? v[13] : -1;
+    s->worstId    = -1;
+}
+
+/**
+ * STATS_CLIENT <id> <cola> <colaMax> <lotes> <loteProm> <loteMax> <bytes>
+ *              [statesFusionados descartados]: se queda con el envío más
+ *              lento y suma fusiones y descartes de todos los clientes.
+ */
+static void on_server_stats_client_line(ClientState *state, const char *args)
+{
+    ServerStats *s = &state->stats.pendingServer;
+    int          v[9] = { 0 };
+
+    if (parse_ints(&args, v, 9) < 7) {
+        return;
+    }
+    s->coalescedStates += v[7];
+    s->droppedMessages += v[8];
+    if (s->worstId < 0 || us_to_ms(v[5]) > s->worstSendMaxMs) {
+        s->worstId        = v[0];
+        s->worstDepthMax  = v[2];
+        s->worstSendAvgMs = us_to_ms(v[4]);
+        s->worstSendMaxMs = us_to_ms(v[5]);
+    }
+}
+
+/** STATS_END: publica el bloque para el overlay. */
+static void on_server_stats_end_line(ClientState *state, const char *args)
+{
+    (void)args;
+    state->stats.server       = state->stats.pendingServer;
+    state->stats.server.valid = 1;
+}
+
+/** Manejador de un tag de texto: recibe lo que sigue al tag. */
+typedef void (*LineHandler)(ClientState *state, const char *args);
+
+/** Un tag conocido del protocolo de texto. */
+typedef struct {
+    const char *name;
+    int         length;
+    int         statsTag;
+    LineHandler handle;
+} LineTag;
+
+#define LINE_TAG(name, tag, handler) { name, (int)sizeof(name) - 1, tag, handler }
+
+static const LineTag STATE_TAGS[] = {
+    LINE_TAG("STATE",        STATS_TAG_STATE, on_state_line),
+    LINE_TAG("STATS",        STATS_TAG_OTHER, on_server_stats_line),
+    LINE_TAG("STATS_CLIENT", STATS_TAG_OTHER, on_server_stats_client_line),
+    LINE_TAG("STATS_END",    STATS_TAG_OTHER, on_server_stats_end_line),
+};
+
+static const LineTag FRUIT_TAGS[] = {
+    LINE_TAG("FRUIT",            STATS_TAG_FRUIT, on_fruit_line),
+    LINE_TAG("FRUITS_BEGIN",     STATS_TAG_FRUIT, on_fruits_begin_line),
+    LINE_TAG("FRUITS_END",       STATS_TAG_FRUIT, on_fruits_end_line),
+    LINE_TAG("FRUITS_DELTA",     STATS_TAG_FRUIT, on_fruits_delta_line),
+    LINE_TAG("FRUIT_ADD",        STATS_TAG_FRUIT, on_fruit_add_line),
+    LINE_TAG("FRUIT_REMOVE",     STATS_TAG_FRUIT, on_fruit_remove_line),
+    LINE_TAG("FRUITS_DELTA_END", STATS_TAG_FRUIT, on_fruits_end_line),
+};
+
+static const LineTag ENEMY_TAGS[] = {
+    LINE_TAG("ENEMY",             STATS_TAG_ENEMY, on_enemy_line),
+    LINE_TAG("ENEMIES_BEGIN",     STATS_TAG_ENEMY, on_enemies_begin_line),
+    LINE_TAG("ENEMIES_END",       STATS_TAG_ENEMY, on_enemies_end_line),
+    LINE_TAG("ENEMY_MOVE",        STATS_TAG_ENEMY, on_enemy_move_line),
+    LINE_TAG("ENEMIES_DELTA",     STATS_TAG_ENEMY, on_enemies_delta_line),
+    LINE_TAG("ENEMY_ADD",         STATS_TAG_ENEMY, on_enemy_add_line),
+    LINE_TAG("ENEMY_REMOVE",      STATS_TAG_ENEMY, on_enemy_remove_line),
+    LINE_TAG("ENEMIES_DELTA_END", STATS_TAG_ENEMY, on_enemies_end_line),
+};
+
+#define TAG_COUNT(tags) ((int)(sizeof(tags) / sizeof((tags)[0])))
+
+/**
+ * Busca el tag de los primeros `length` bytes de la línea: el primer byte
+ * elige el grupo y dentro de él basta comparar largo y bytes (los más
+ * frecuentes van primero).
+ */
+static const LineTag *find_line_tag(const char *tag, int length)
+{
+    const LineTag *tags;
+    int            count;
+
+    switch (tag[0]) {
+        case 'S': tags = STATE_TAGS; count = TAG_COUNT(STATE_TAGS); break;
+        case 'F': tags = FRUIT_TAGS; count = TAG_COUNT(FRUIT_TAGS); break;
+        case 'E': tags = ENEMY_TAGS; count = TAG_COUNT(ENEMY_TAGS); break;
+        default:  return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (tags[i].length == length && memcmp(tags[i].name, tag, (size_t)length) == 0) {
+            return &tags[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Busca el tag de la línea y llama a su manejador; con `count` la cuenta
+ * además en las estadísticas.
+ */
+static void dispatch_line(ClientState *state, char *line, int count)
+{
+    const char *args = line;
+    const char *tag;
+    int length = parse_word(&args, &tag);
+    int bytes  = (int)(args - line) + (int)strlen(args) + 1;
+
+    const LineTag *entry = (length > 0) ? find_line_tag(tag, length) : NULL;
+    if (entry == NULL) {
+        /* MAP_* fuera del handshake, END, ERR ...: solo se cuentan */
+        int statsTag = (length >= 3 && memcmp(tag, "MAP", 3) == 0) ? STATS_TAG_MAP
+                                                                   : STATS_TAG_OTHER;
+        if (count) {
+            stats_count(&state->stats, statsTag, bytes);
+        }
+        return;
+    }
+
+    if (count) {
+        stats_count(&state->stats, entry->statsTag, bytes);
+    }
+    entry->handle(state, args);
+}
+
+/**
+ * Interpreta una línea del protocolo de texto y la aplica sobre el estado.
+ */
+void protocol_handle_line(ClientState *state, char *line)
+{
+    dispatch_line(state, line, 1);
+}
+
+
+/* ============================
+ *  H A N D S H A K E   Y   M A P A
+ * ============================ */
+
+/**
+ * Recibe el mapa lógico inicial desde el servidor y lo almacena en state->map.
+ *
+ * Protocolo esperado (en cualquier orden mezclado con otras líneas):
+ *  - "MAP_SIZE <ancho> <alto>"  (obligatorio una vez)
+ *  - "MAP_ROW <y> <fila_completa>" para cada fila
+ *  - "MAP_END"                  (marca el final de la descripción del mapa)
+ *
+ * Esta función es robusta ante líneas adicionales (por ejemplo "STATE ..."):
+ * las ignora hasta haber recibido "MAP_SIZE" y "MAP_END".
+ *
+ * Con el protocolo binario negociado, espera en cambio una trama MSG_MAP.
+ *
+ * @param state Puntero al estado del cliente ya conectado.
+ * @return 0 si el mapa se recibió correctamente, -1 en caso de error.
+ */
+int protocol_receive_map(ClientState *state)
+{
+    char *line;
+
+    int width  = 0;
+    int height = 0;
+    int gotSize = 0;
+
+    /* Mapa nuevo: lo del anterior (y la lista de jugadores) se libera junto */
+    storage_reset(state);
+
+    /* --- Protocolo binario: el mapa llega en una sola trama MSG_MAP --- */
+    if (state->binaryProtocol) {
+        for (;;) {
+            unsigned char *frame;
+            int len = line_reader_next_frame(&state->reader, &frame, 1);
+            if (len < 0) {
+                return -1;
+            }
+            if (frame[0] == BIN_MSG_MAP) {
+                if (protocol_handle_frame(state, frame, len) != BIN_MSG_MAP) {
+                    return -1;
+                }
+                map_cache_store(&state->map);
+                return 0;
+            }
+            if (len > 11 && frame[0] == BIN_MSG_TEXT && memcmp(frame + 1, "MAP_CACHED ", 11) == 0) {
+                return map_cache_load(state, (unsigned int)strtoul((const char *)frame + 12, NULL, 16));
+            }
+            /* Otras tramas previas al mapa se aplican normalmente */
+            protocol_handle_frame(state, frame, len);
+        }
+    }
+
+    /* --- 1) Esperar MAP_SIZE --- */
+    for (;;) {
+        int len = line_reader_next(&state->reader, &line, 1);
+        if (len <= 0) {
+            return -1;
+        }
+
+        if (sscanf(line, "MAP_SIZE %d %d", &width, &height) == 2) {
+            gotSize = 1;
+            break;
+        }
+
+        /* El servidor aceptó la copia local: no vienen filas */
+        if (strncmp(line, "MAP_CACHED ", 11) == 0) {
+            return map_cache_load(state, (unsigned int)strtoul(line + 11, NULL, 16));
+        }
+
+        /* Cualquier otra cosa (por ej. STATE) se ignora aquí */
+    }
+
+    /* Reserva el mapa (a vacío por si faltan filas) y las listas, una vez */
+    if (!gotSize || storage_reserve_map(state, width, height) != 0) {
+        return -1;
+    }
+
+    /* --- 2) Leer hasta MAP_END, recogiendo MAP_ROW --- */
+    for (;;) {
+        int len = line_reader_next(&state->reader, &line, 1);
+        if (len <= 0) {
+            return -1;
+        }
+
+        stats_count(&state->stats, STATS_TAG_MAP, len + 1);
+
+        if (strncmp(line, "MAP_END", 7) == 0) {
+            map_build_flags(&state->map);
+            state->map.version++; /* mapa nuevo: hay que redibujar la capa de tiles */
+            map_cache_store(&state->map);
+            break; /* ya terminamos */
+        }
+
+        int y = -1;
+        int rowAt = 0;
+
+        /* La fila se copia desde la línea misma: no hay búfer de ancho fijo */
+        if (sscanf(line, "MAP_ROW %d %n", &y, &rowAt) == 1 && rowAt > 0) {
+            if (y >= 0 && y < state->map.height) {
+                const char *row = line + rowAt;
+                int n = (int)strcspn(row, " \t");
+                if (n > state->map.width) {
+                    n = state->map.width;
+                }
+                memcpy(&MAP_TILE(&state->map, 0, y), row, (size_t)n);
+            }
+        }
+        /* Si no era MAP_ROW, se ignora (por ej. STATE) */
+    }
+
+    return 0;
+}
+
+/**
+ * Aplica la foto que sigue al mapa de un espectador nuevo (listas completas
+ * de frutas y enemigos y el último STATE), bloqueando hasta su STATE.
+ *
+ * El servidor la manda en la misma ráfaga que SPECTATE_OK; uno anterior
+ * manda el STATE en el próximo tick y las listas poco después, así que la
+ * espera es corta en los dos casos. Un "END" (el jugador se fue) también
+ * termina la espera.
+ */
+int protocol_receive_snapshot(ClientState *state)
+{
+    if (state->binaryProtocol) {
+        for (;;) {
+            unsigned char *frame;
+            int len = line_reader_next_frame(&state->reader, &frame, 1);
+            if (len < 0) {
+                return -1;
+            }
+            if (len >= 4 && frame[0] == BIN_MSG_TEXT && memcmp(frame + 1, "END", 3) == 0) {
+                return 0;
+            }
+            if (protocol_handle_frame(state, frame, len) == BIN_MSG_STATE) {
+                return 0;
+            }
+        }
+    }
+
+    for (;;) {
+        char *line;
+        int len = line_reader_next(&state->reader, &line, 1);
+        if (len < 0) {
+            return -1;
+        }
+
+        /* El tag se mira antes: el manejador puede tocar la línea */
+        int done = strncmp(line, "STATE ", 6) == 0 || strncmp(line, "END ", 4) == 0;
+        protocol_handle_line(state, line);
+        if (done) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Lee el WELCOME inicial y guarda la huella del mapa que anuncia.
+ */
+int protocol_welcome(ClientState *state)
+{
+    char *line;
+
+    state->serverMapHash = 0;
+    for (;;) {
+        int len = line_reader_next(&state->reader, &line, 1);
+        if (len < 0) {
+            return -1;
+        }
+        if (strncmp(line, "WELCOME", 7) != 0) {
+            continue; /* no debería haber nada antes, pero no molesta */
+        }
+
+        /* WELCOME MAP_HASH <hex>; un servidor anterior manda solo WELCOME */
+        const char *hash = strstr(line, "MAP_HASH ");
+        if (hash != NULL) {
+            state->serverMapHash = (unsigned int)strtoul(hash + 9, NULL, 16);
+        }
+        return 0;
+    }
+}
+
+/**
+ * Opciones del cliente para JOIN/SPECTATE: +BIN y +DELTA según la
+ * compilación, +MAPCACHE=<hex> si el mapa que anunció el servidor ya está
+ * en la caché local y +RATE=<n> si hay un ritmo de STATE elegido.
+ * Con --record no se pide la caché: la grabación tiene que traer el mapa
+ * completo para reproducirse en otra máquina, no solo "MAP_CACHED <hash>".
+ */
+static void handshake_options(const ClientState *state, char *opts, size_t size)
+{
+    char cached[24] = "";
+    char rate[16]   = "";
+    if (state->reader.recorder == NULL && map_cache_contains(state->serverMapHash)) {
+        snprintf(cached, sizeof(cached), " +MAPCACHE=%08x", state->serverMapHash);
+    }
+    if (state->stateRate > 0) {
+        snprintf(rate, sizeof(rate), " +RATE=%d", state->stateRate);
+    }
+    snprintf(opts, size, "%s%s%s%s",
+             CLIENT_USE_BINARY_PROTOCOL ? " +BIN" : "",
+             CLIENT_USE_DELTA_UPDATES ? " +DELTA" : "",
+             cached, rate);
+}
+
+/**
+ * Espera "JOINED <id> [+BIN] [TOKEN <token>]" y deja playerId,
+ * binaryProtocol y rejoinToken listos. Las demás líneas se ignoran salvo
+ * "ERR ...", que con stopOnError termina la espera (REJOIN rechazado).
+ *
+ * @return 0 con JOINED, 1 con ERR, -1 si se cerró la conexión.
+ */
+static int await_joined(ClientState *state, int stopOnError)
+{
+    char *line;
+
+    state->playerId = 0;
+    for (;;) {
+        int len = line_reader_next(&state->reader, &line, 1);
+        if (len <= 0) {
+            return -1;
+        }
+
+        int id = 0;
+        if (sscanf(line, "JOINED %d", &id) == 1) {
+            state->playerId = id;
+            /* Desde aquí el servidor habla binario si confirmó "+BIN" */
+            state->binaryProtocol = (strstr(line, "+BIN") != NULL);
+
+            /* Token para volver a esta sesión con REJOIN (servidores
+             * anteriores no lo mandan) */
+            const char *token = strstr(line, " TOKEN ");
+            size_t      n     = 0;
+            if (token != NULL) {
+                token += 7;
+                n = strcspn(token, " \t\r");
+                if (n >= sizeof(state->rejoinToken)) {
+                    n = 0;
+                }
+                memcpy(state->rejoinToken, token, n);
+            }
+            state->rejoinToken[n] = '\0';
+            return 0;
+        }
+
+        if (stopOnError && strncmp(line, "ERR ", 4) == 0) {
+            return 1;
+        }
+        /* Cualquier otra línea antes de JOINED se ignora */
+    }
+}
+
+/**
+ * Envía JOIN (con las opciones que el cliente soporta) y espera JOINED.
+ */
+int protocol_join(ClientState *state, const char *name)
+{
+    char cmd[128];
+    char opts[64];
+
+    state->binaryProtocol = 0;
+    handshake_options(state, opts, sizeof(opts));
+    snprintf(cmd, sizeof(cmd), "JOIN %s%s\n", name, opts);
+    send_queue_push(&state->outbox, cmd);
+    if (send_queue_flush(&state->outbox) != 0) {
+        return -1;
+    }
+
+    /* Buscar "JOINED <id>" en lo que vaya mandando el servidor */
+    return await_joined(state, 0);
+}
+
+/**
+ * Envía REJOIN con el token de la partida anterior y espera JOINED.
+ */
+int protocol_rejoin(ClientState *state)
+{
+    char cmd[128];
+    char opts[64];
+
+    if (state->rejoinToken[0] == '\0') {
+        return 1;
+    }
+
+    state->binaryProtocol = 0;
+    handshake_options(state, opts, sizeof(opts));
+    snprintf(cmd, sizeof(cmd), "REJOIN %s%s\n", state->rejoinToken, opts);
+    send_queue_push(&state->outbox, cmd);
+    if (send_queue_flush(&state->outbox) != 0) {
+        return -1;
+    }
+
+    int result = await_joined(state, 1);
+    if (result == 1) {
+        /* Token vencido o desconocido: la próxima vez, JOIN directamente */
+        state->rejoinToken[0] = '\0';
+    }
+    return result;
+}
+
+/**
+ * Envía LEAVE y descarta lo que falte de la partida hasta el LEFT.
+ */
+int protocol_leave(ClientState *state)
+{
+    send_queue_push(&state->outbox, "LEAVE\n");
+    if (send_queue_flush(&state->outbox) != 0) {
+        return -1;
+    }
+
+    for (;;) {
+        const char *text;
+        int         len;
+
+        if (state->binaryProtocol) {
+            unsigned char *frame;
+            len = line_reader_next_frame(&state->reader, &frame, 1);
+            if (len < 0) {
+                return -1;
+            }
+            if (len < 1 || frame[0] != BIN_MSG_TEXT) {
+                continue; /* STATE y listas que ya venían en camino */
+            }
+            text = (const char *)frame + 1;
+            len--;
+        } else {
+            char *line;
+            len = line_reader_next(&state->reader, &line, 1);
+            if (len < 0) {
+                return -1;
+            }
+            text = line;
+        }
+
+        if (len >= 4 && memcmp(text, "LEFT", 4) == 0) {
+            /* El servidor volvió a texto: la conexión queda como recién abierta */
+            state->binaryProtocol = 0;
+            return 0;
+        }
+        if (len >= 11 && memcmp(text, "ERR UNKNOWN", 11) == 0) {
+            return -1; /* servidor (o relay) sin LEAVE: hay que reconectar */
+        }
+    }
+}
+
+/**
+ * Envía SPECTATE <targetId> y espera SPECTATE_OK o SPECTATE_WAIT.
+ */
+int protocol_spectate(ClientState *state, int targetId)
+{
+    char *line;
+    char  cmd[128];
+    char  opts[64];
+
+    state->binaryProtocol = 0;
+    handshake_options(state, opts, sizeof(opts));
+    snprintf(cmd, sizeof(cmd), "SPECTATE %d%s\n", targetId, opts);
+    send_queue_push(&state->outbox, cmd);
+    if (send_queue_flush(&state->outbox) != 0) {
+        return -1;
+    }
+
+    state->playerId = 0;
+    for (;;) {
+        int len = line_reader_next(&state->reader, &line, 1);
+        if (len <= 0) {
+            return -1; /* desconexión / error */
+        }
+
+        int id = 0;
+        if (sscanf(line, "SPECTATE_OK %d", &id) == 1) {
+            state->playerId = id;
+            state->binaryProtocol = (strstr(line, "+BIN") != NULL);
+            return 0; /* listo, sigue el mapa */
+        }
+
+        if (sscanf(line, "SPECTATE_WAIT %d", &id) == 1) {
+            /* El jugador todavía no existe o se fue justo ahora */
+            return 1;
+        }
+
+        /* Cualquier otra línea se ignora en esta fase */
+    }
+}
+
+/**
+ * Procesa sin bloquear todo lo que ya llegó del servidor.
+ */
+int protocol_drain(ClientState *state)
+{
+    char *line;
+
+    /* Como mucho MAX_LINES_PER_FRAME: lo que sobre queda para la próxima */
+    for (int processed = 0; processed < MAX_LINES_PER_FRAME; processed++) {
+        if (state->binaryProtocol) {
+            /* Protocolo binario: decodificación por tabla, sin sscanf */
+            unsigned char *frame;
+            int len = line_reader_next_frame(&state->reader, &frame, 0);
+            if (len == LINE_PENDING) {
+                return 0;
+            }
+            if (len < 0) {
+                return -1;
+            }
+            protocol_handle_frame(state, frame, len);
+            continue;
+        }
+
+        int len = line_reader_next(&state->reader, &line, 0);
+        if (len == LINE_PENDING) {
+            return 0; /* no hay ninguna línea completa por ahora */
+        }
+        if (len < 0) {
+            return -1; /* desconexión o error */
+        }
+
+        protocol_handle_line(state, line);
+    }
+    return 0;
+}
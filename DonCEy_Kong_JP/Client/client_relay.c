@@ -0,0 +1,984 @@
+/* WinSock limita select() a 64 sockets por defecto; se amplía antes de incluirlo */
+#define FD_SETSIZE 1024
+
+#include "client_constants.h"
+
+/* ============================
+ *  R E L A Y   D E   E S P E C T A D O R E S
+ * ============================
+ *
+ * Ejecutable aparte (sin raylib) que se pone entre el servidor y los
+ * espectadores. Habla con ellos el mismo protocolo de texto que el
+ * servidor (WELCOME, SPECTATE, LIST_PLAYERS, PING, QUIT ...), pero por
+ * cada jugador observado abre UNA sola conexión SPECTATE hacia el servidor
+ * y reparte lo que recibe a todos sus espectadores. El tick del servidor
+ * solo ve un espectador por jugador, tenga el relay 1 o 500.
+ *
+ * De cada sesión se guarda el mapa, el último bloque FRUITS y ENEMIES
+ * completos y el último STATE: un espectador que llega tarde recibe esa
+ * foto del caché en lugar de que el servidor le mande sendMapTo() y un
+ * keyframe nuevos.
+ *
+ * Hacia el servidor se piden listas completas (sin +BIN ni +DELTA) y hacia
+ * los espectadores tampoco se confirma +BIN: el texto se reenvía tal cual,
+ * sin volver a codificarlo. Un espectador que no lee a tiempo pierde lo
+ * pendiente y recibe otra foto cuando vuelve a tener lugar, igual que la
+ * cola de salida del servidor.
+ *
+ * La sesión hacia el servidor no pide +RATE (llega un STATE por tick) y el
+ * +RATE=<n> de cada espectador se aplica acá: recibe uno de cada
+ * STATE_RATE_MAX / n STATE, con el mismo redondeo que el servidor, así que
+ * el retardo de interpolación que eligió su cliente para ese ritmo vale.
+ *
+ * Uso:
+ *   client_relay [-l puerto_local] [-h ip_servidor] [-P puerto_servidor]
+ *                [-t segundos]
+ */
+
+/** Puerto donde escucha el relay por defecto. */
+#define RELAY_PORT 5001
+
+/** Sesiones (jugadores observados) simultáneas. */
+#define RELAY_MAX_FEEDS 32
+
+/** Espectadores simultáneos: lo que queda del FD_SETSIZE. */
+#define RELAY_MAX_VIEWERS (FD_SETSIZE - RELAY_MAX_FEEDS - 2)
+
+/** Bytes de un bloque cacheado (mapa, FRUITS, ENEMIES o STATE). */
+#define RELAY_BLOCK_CAPACITY 16384
+
+/** Cola de salida de cada espectador. */
+#define RELAY_VIEWER_OUTPUT (64 * 1024)
+
+/** Pedidos de LIST_PLAYERS en vuelo hacia el servidor. */
+#define RELAY_MAX_LIST_REQUESTS 64
+
+/** Espera máxima de select() por pasada (ms). */
+#define RELAY_POLL_MS 50
+
+/** Cada cuánto se imprime el resumen (ms). */
+#define RELAY_REPORT_MS 5000
+
+/* Fases de una sesión observada */
+#define FEED_FREE      0  /* slot libre                            */
+#define FEED_HANDSHAKE 1  /* SPECTATE enviado, esperando la respuesta */
+#define FEED_MAP       2  /* recibiendo MAP_SIZE ... MAP_END        */
+#define FEED_LIVE      3  /* reenviando en vivo                     */
+
+/* Fases de un espectador */
+#define VIEWER_FREE    0  /* slot libre                             */
+#define VIEWER_IDLE    1  /* conectado, sin sesión                  */
+#define VIEWER_WAITING 2  /* pidió SPECTATE, la sesión aún no está en vivo */
+#define VIEWER_LIVE    3  /* recibe la sesión                       */
+
+/** Líneas guardadas tal como se reenvían (cada una con '\n'). */
+typedef struct {
+    char data[RELAY_BLOCK_CAPACITY];
+    int  length;
+} RelayBlock;
+
+/**
+ * Una sesión observada: la conexión hacia el servidor y su caché.
+ *
+ * - fruits / enemies   : último bloque completo (BEGIN ... END).
+ * - pending*           : bloque en recepción; se publica al llegar su END.
+ * - state              : último STATE.
+ * - states             : STATE recibidos (marcan el ritmo de +RATE).
+ * - viewers            : espectadores enganchados (en vivo o esperando).
+ */
+typedef struct {
+    int        phase;
+    int        playerId;
+    SOCKET     sock;
+    LineReader reader;
+
+    RelayBlock map;
+    RelayBlock state;
+    RelayBlock fruits;
+    RelayBlock pendingFruits;
+    RelayBlock enemies;
+    RelayBlock pendingEnemies;
+    int        inFruits;
+    int        inEnemies;
+    long       states;
+
+    int        viewers;
+} RelayFeed;
+
+/**
+ * Un espectador conectado al relay.
+ *
+ * - out / outStart / outEnd : cola de salida no bloqueante.
+ * - midLine    : lo ya enviado terminó a mitad de una línea.
+ * - skip*      : llegó con un bloque a medias; se salta hasta su END.
+ * - closing    : QUIT recibido, se cierra al vaciar la cola.
+ * - rate       : STATE por segundo pedidos con +RATE=<n> (0 = todos).
+ * - nextState  : valor de feed->states desde el que va el próximo STATE.
+ */
+typedef struct {
+    int        phase;
+    SOCKET     sock;
+    LineReader reader;
+    int        feed;
+
+    char      *out;
+    int        outStart;
+    int        outEnd;
+    int        midLine;
+    int        skipFruits;
+    int        skipEnemies;
+    int        closing;
+    int        rate;
+    long       nextState;
+} RelayViewer;
+
+/** Opciones de la línea de comandos. */
+typedef struct {
+    int         listenPort;
+    const char *ip;
+    int         port;
+    int         seconds;    /* 0 = sin límite */
+} RelayOptions;
+
+/**
+ * Estado completo del relay.
+ *
+ * - control     : conexión propia al servidor para LIST_PLAYERS.
+ * - listQueue   : espectadores que esperan su lista, en orden de pedido
+ *                 (-1 si se desconectó); listTarget recibe la actual.
+ * - bytesIn/Out, snapshots, overflows : contadores del resumen.
+ */
+typedef struct {
+    RelayOptions opts;
+    SOCKET       listener;
+    RelayFeed    feeds[RELAY_MAX_FEEDS];
+    RelayViewer *viewers;
+
+    SOCKET       control;
+    LineReader   controlReader;
+    int          listQueue[RELAY_MAX_LIST_REQUESTS];
+    int          listHead;
+    int          listCount;
+    int          listTarget;
+
+    long         bytesIn;
+    long         bytesOut;
+    long         snapshots;
+    long         overflows;
+} Relay;
+
+
+/* ============================
+ *  B L O Q U E S   C A C H E A D O S
+ * ============================ */
+
+/** ¿La línea empieza con esta palabra completa? */
+static int line_is(const char *line, const char *tag)
+{
+    size_t n = strlen(tag);
+    return strncmp(line, tag, n) == 0 && (line[n] == '\0' || line[n] == ' ');
+}
+
+/** Agrega una línea y su '\n'; un bloque lleno se deja como está. */
+static void block_append(RelayBlock *block, const char *line, int len)
+{
+    if (block->length + len + 1 > RELAY_BLOCK_CAPACITY) {
+        return;
+    }
+    memcpy(block->data + block->length, line, (size_t)len);
+    block->length += len;
+    block->data[block->length++] = '\n';
+}
+
+/** Copia un bloque (solo la parte usada). */
+static void block_copy(RelayBlock *dest, const RelayBlock *src)
+{
+    memcpy(dest->data, src->data, (size_t)src->length);
+    dest->length = src->length;
+}
+
+/** Reemplaza el contenido por una sola línea. */
+static void block_set(RelayBlock *block, const char *line, int len)
+{
+    block->length = 0;
+    block_append(block, line, len);
+}
+
+
+/* ============================
+ *  E S P E C T A D O R E S
+ * ============================ */
+
+static void feed_close(Relay *relay, RelayFeed *feed, const char *notice);
+
+/**
+ * Descarta lo pendiente de un espectador en vivo que no lee a tiempo y le
+ * encola una foto nueva. Si lo ya enviado quedó a mitad de línea, se
+ * conserva hasta el fin de esa línea para no romper el protocolo.
+ */
+static void viewer_overflow(Relay *relay, RelayViewer *v)
+{
+    int keep = 0;
+    if (v->midLine) {
+        char *nl = memchr(v->out + v->outStart, '\n', (size_t)(v->outEnd - v->outStart));
+        keep = (nl != NULL) ? (int)(nl - (v->out + v->outStart)) + 1 : 0;
+    }
+    memmove(v->out, v->out + v->outStart, (size_t)keep);
+    v->outStart = 0;
+    v->outEnd   = keep;
+    relay->overflows++;
+}
+
+/**
+ * Encola bytes para un espectador. Si no caben y está en vivo se recurre a
+ * viewer_overflow() seguido de la foto de su sesión; si no está en vivo
+ * (solo hay líneas de control) se lo desconecta.
+ */
+static void viewer_write(Relay *relay, RelayViewer *v, const char *data, int len);
+
+/** Foto del caché: listas completas y último STATE (sin mapa). */
+static void viewer_send_keyframe(Relay *relay, RelayViewer *v)
+{
+    RelayFeed *feed = &relay->feeds[v->feed];
+
+    viewer_write(relay, v, feed->fruits.data, feed->fruits.length);
+    viewer_write(relay, v, feed->enemies.data, feed->enemies.length);
+    viewer_write(relay, v, feed->state.data, feed->state.length);
+
+    /* Si el servidor está a mitad de un bloque, sus líneas restantes no le
+     * sirven a quien no vio el BEGIN */
+    v->skipFruits  = feed->inFruits;
+    v->skipEnemies = feed->inEnemies;
+    relay->snapshots++;
+}
+
+static void viewer_write(Relay *relay, RelayViewer *v, const char *data, int len)
+{
+    if (v->phase == VIEWER_FREE || len <= 0) {
+        return;
+    }
+
+    if (v->outEnd + len > RELAY_VIEWER_OUTPUT && v->outStart > 0) {
+        memmove(v->out, v->out + v->outStart, (size_t)(v->outEnd - v->outStart));
+        v->outEnd  -= v->outStart;
+        v->outStart = 0;
+    }
+    if (v->outEnd + len > RELAY_VIEWER_OUTPUT) {
+        if (v->phase != VIEWER_LIVE) {
+            v->closing = 1;
+            v->outEnd  = v->outStart; /* nada más que enviar: se cierra */
+            return;
+        }
+        viewer_overflow(relay, v);
+        /* La foto reemplaza todo lo descartado, incluido este mensaje */
+        viewer_send_keyframe(relay, v);
+        return;
+    }
+
+    memcpy(v->out + v->outEnd, data, (size_t)len);
+    v->outEnd += len;
+}
+
+/** Encola una línea de control con formato. */
+static void viewer_printf(Relay *relay, RelayViewer *v, const char *fmt, int value)
+{
+    char line[64];
+    int  len = snprintf(line, sizeof(line), fmt, value);
+    viewer_write(relay, v, line, len);
+}
+
+/** Suelta la sesión de un espectador (la cierra si era el último). */
+static void viewer_detach(Relay *relay, RelayViewer *v)
+{
+    if (v->feed < 0) {
+        return;
+    }
+    RelayFeed *feed = &relay->feeds[v->feed];
+    v->feed  = -1;
+    v->phase = VIEWER_IDLE;
+    if (--feed->viewers <= 0) {
+        feed_close(relay, feed, NULL);
+    }
+}
+
+/** Cierra la conexión de un espectador y libera su slot. */
+static void viewer_close(Relay *relay, int index)
+{
+    RelayViewer *v = &relay->viewers[index];
+
+    viewer_detach(relay, v);
+    close_socket(v->sock);
+    free(v->out);
+
+    for (int i = 0; i < relay->listCount; i++) {
+        int *slot = &relay->listQueue[(relay->listHead + i) % RELAY_MAX_LIST_REQUESTS];
+        if (*slot == index) {
+            *slot = -1;
+        }
+    }
+    if (relay->listTarget == index) {
+        relay->listTarget = -1;
+    }
+
+    memset(v, 0, sizeof(*v));
+    v->sock  = INVALID_SOCKET;
+    v->feed  = -1;
+    v->phase = VIEWER_FREE;
+}
+
+/** Engancha a un espectador a una sesión en vivo: SPECTATE_OK + mapa + foto. */
+static void viewer_go_live(Relay *relay, RelayViewer *v)
+{
+    RelayFeed *feed = &relay->feeds[v->feed];
+
+    v->phase = VIEWER_LIVE;
+    viewer_printf(relay, v, "SPECTATE_OK %d\n", feed->playerId);
+    viewer_write(relay, v, feed->map.data, feed->map.length);
+    viewer_send_keyframe(relay, v);
+}
+
+/**
+ * Intenta vaciar la cola de salida sin bloquear.
+ *
+ * @return 0 si sigue conectado, -1 si hay que cerrarlo.
+ */
+static int viewer_flush(Relay *relay, RelayViewer *v)
+{
+    while (v->outStart < v->outEnd) {
+        int sent = socket_send_some(v->sock, v->out + v->outStart, v->outEnd - v->outStart);
+        if (sent < 0) {
+            return -1;
+        }
+        if (sent == 0) {
+            break; /* búfer del socket lleno: se reintenta cuando sea escribible */
+        }
+        v->outStart     += sent;
+        v->midLine       = v->out[v->outStart - 1] != '\n';
+        relay->bytesOut += sent;
+    }
+
+    if (v->outStart == v->outEnd) {
+        v->outStart = 0;
+        v->outEnd   = 0;
+        v->midLine  = 0;
+        return v->closing ? -1 : 0;
+    }
+    return 0;
+}
+
+
+/* ============================
+ *  S E S I O N E S   O B S E R V A D A S
+ * ============================ */
+
+/**
+ * Cierra la conexión hacia el servidor de una sesión. Sus espectadores
+ * quedan sin sesión; si `notice` no es NULL se les envía primero.
+ */
+static void feed_close(Relay *relay, RelayFeed *feed, const char *notice)
+{
+    int index = (int)(feed - relay->feeds);
+
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        RelayViewer *v = &relay->viewers[i];
+        if (v->phase != VIEWER_FREE && v->feed == index) {
+            if (notice != NULL) {
+                viewer_write(relay, v, notice, (int)strlen(notice));
+            }
+            v->feed  = -1;
+            v->phase = VIEWER_IDLE;
+        }
+    }
+
+    if (feed->phase != FEED_FREE) {
+        printf("[RELAY] Sesión %d cerrada\n", feed->playerId);
+        close_socket(feed->sock);
+    }
+    feed->phase    = FEED_FREE;
+    feed->sock     = INVALID_SOCKET;
+    feed->viewers  = 0;
+}
+
+/**
+ * Busca la sesión de un jugador o abre una conexión SPECTATE nueva.
+ *
+ * @return índice de la sesión, o -1 si no hay lugar o el servidor no responde.
+ */
+static int feed_open(Relay *relay, int playerId)
+{
+    int freeSlot = -1;
+    for (int i = 0; i < RELAY_MAX_FEEDS; i++) {
+        RelayFeed *feed = &relay->feeds[i];
+        if (feed->phase != FEED_FREE && feed->playerId == playerId) {
+            return i;
+        }
+        if (feed->phase == FEED_FREE && freeSlot < 0) {
+            freeSlot = i;
+        }
+    }
+    if (freeSlot < 0) {
+        return -1;
+    }
+
+    SOCKET sock = create_and_connect_socket(relay->opts.ip, relay->opts.port);
+    if (sock == INVALID_SOCKET) {
+        return -1;
+    }
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "SPECTATE %d\n", playerId);
+    send_line(sock, cmd);
+
+    RelayFeed *feed = &relay->feeds[freeSlot];
+    memset(feed, 0, sizeof(*feed));
+    feed->phase    = FEED_HANDSHAKE;
+    feed->playerId = playerId;
+    feed->sock     = sock;
+    line_reader_init(&feed->reader, sock);
+    printf("[RELAY] Sesión %d abierta hacia el servidor\n", playerId);
+    return freeSlot;
+}
+
+/**
+ * Reenvía una línea de la sesión a sus espectadores en vivo. `line` debe
+ * terminar en '\n' (line[len]): así cada línea se encola entera. Un STATE
+ * solo va a quien le toca según su +RATE.
+ */
+static void feed_forward(Relay *relay, RelayFeed *feed, const char *line, int len,
+                         int stateLine, int fruitLine, int enemyLine, int blockEnd)
+{
+    int index = (int)(feed - relay->feeds);
+
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        RelayViewer *v = &relay->viewers[i];
+        if (v->phase != VIEWER_LIVE || v->feed != index) {
+            continue;
+        }
+        if ((fruitLine && v->skipFruits) || (enemyLine && v->skipEnemies)) {
+            if (blockEnd) {
+                v->skipFruits  &= !fruitLine;
+                v->skipEnemies &= !enemyLine;
+            }
+            continue;
+        }
+        if (stateLine && v->rate > 0) {
+            if (feed->states < v->nextState) {
+                continue;
+            }
+            v->nextState = feed->states + (STATE_RATE_MAX + v->rate - 1) / v->rate;
+        }
+        viewer_write(relay, v, line, len + 1);
+    }
+}
+
+/**
+ * Procesa una línea recibida del servidor para una sesión: avanza el
+ * handshake, actualiza el caché y la reenvía.
+ */
+static void feed_handle_line(Relay *relay, RelayFeed *feed, char *line, int len)
+{
+    int index = (int)(feed - relay->feeds);
+    relay->bytesIn += len + 1;
+
+    if (feed->phase == FEED_HANDSHAKE) {
+        if (line_is(line, "SPECTATE_OK")) {
+            feed->phase = FEED_MAP;
+        } else if (line_is(line, "SPECTATE_WAIT") || line_is(line, "ERR")) {
+            /* El jugador no existe: los que esperan reciben la misma respuesta */
+            char notice[64];
+            snprintf(notice, sizeof(notice), "SPECTATE_WAIT %d\n", feed->playerId);
+            feed_close(relay, feed, notice);
+        }
+        return; /* WELCOME y demás */
+    }
+
+    if (feed->phase == FEED_MAP) {
+        block_append(&feed->map, line, len);
+        if (line_is(line, "MAP_END")) {
+            feed->phase = FEED_LIVE;
+            for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+                RelayViewer *v = &relay->viewers[i];
+                if (v->phase == VIEWER_WAITING && v->feed == index) {
+                    viewer_go_live(relay, v);
+                }
+            }
+        }
+        return;
+    }
+
+    /* En vivo: primero el caché, después el reenvío */
+    int stateLine = 0, fruitLine = 0, enemyLine = 0, blockEnd = 0;
+    if (line_is(line, "STATE")) {
+        block_set(&feed->state, line, len);
+        feed->states++;
+        stateLine = 1;
+    } else if (line_is(line, "FRUITS_BEGIN")) {
+        feed->pendingFruits.length = 0;
+        block_append(&feed->pendingFruits, line, len);
+        feed->inFruits = 1;
+    } else if (line_is(line, "FRUIT") || line_is(line, "FRUITS_END")) {
+        fruitLine = 1;
+        blockEnd  = line_is(line, "FRUITS_END");
+        if (feed->inFruits) {
+            block_append(&feed->pendingFruits, line, len);
+            if (blockEnd) {
+                block_copy(&feed->fruits, &feed->pendingFruits);
+                feed->inFruits = 0;
+            }
+        }
+    } else if (line_is(line, "ENEMIES_BEGIN")) {
+        feed->pendingEnemies.length = 0;
+        block_append(&feed->pendingEnemies, line, len);
+        feed->inEnemies = 1;
+    } else if (line_is(line, "ENEMY") || line_is(line, "ENEMIES_END")) {
+        enemyLine = 1;
+        blockEnd  = line_is(line, "ENEMIES_END");
+        if (feed->inEnemies) {
+            block_append(&feed->pendingEnemies, line, len);
+            if (blockEnd) {
+                block_copy(&feed->enemies, &feed->pendingEnemies);
+                feed->inEnemies = 0;
+            }
+        }
+    }
+
+    /* El LineReader puso '\0' donde estaba el fin de línea: se restituye
+     * para reenviar la línea tal como llegó */
+    line[len] = '\n';
+    feed_forward(relay, feed, line, len, stateLine, fruitLine, enemyLine, blockEnd);
+    line[len] = '\0';
+
+    if (line_is(line, "END")) {
+        /* El jugador se fue: el END ya se reenvió */
+        feed_close(relay, feed, NULL);
+    }
+}
+
+/**
+ * Procesa todo lo que llegó del servidor para una sesión.
+ */
+static void feed_drain(Relay *relay, RelayFeed *feed)
+{
+    char *line;
+    for (;;) {
+        int len = line_reader_next(&feed->reader, &line, 0);
+        if (len == LINE_PENDING) {
+            return;
+        }
+        if (len < 0) {
+            char notice[32];
+            snprintf(notice, sizeof(notice), "END %d\n", feed->playerId);
+            feed_close(relay, feed, notice);
+            return;
+        }
+        feed_handle_line(relay, feed, line, len);
+        if (feed->phase == FEED_FREE) {
+            return;
+        }
+    }
+}
+
+
+/* ============================
+ *  L I S T A   D E   J U G A D O R E S
+ * ============================ */
+
+/**
+ * Abre (si hace falta) la conexión de control hacia el servidor.
+ *
+ * @return 0 si está conectada, -1 si no.
+ */
+static int control_open(Relay *relay)
+{
+    if (relay->control != INVALID_SOCKET) {
+        return 0;
+    }
+    relay->control = create_and_connect_socket(relay->opts.ip, relay->opts.port);
+    if (relay->control == INVALID_SOCKET) {
+        return -1;
+    }
+    line_reader_init(&relay->controlReader, relay->control);
+    relay->listHead   = 0;
+    relay->listCount  = 0;
+    relay->listTarget = -1;
+    return 0;
+}
+
+/** Pide la lista al servidor en nombre de un espectador. */
+static void control_request_list(Relay *relay, int viewer)
+{
+    RelayViewer *v = &relay->viewers[viewer];
+
+    if (relay->listCount >= RELAY_MAX_LIST_REQUESTS || control_open(relay) != 0) {
+        viewer_write(relay, v, "PLAYERS_BEGIN 0\nPLAYERS_END\n", 28);
+        return;
+    }
+    relay->listQueue[(relay->listHead + relay->listCount) % RELAY_MAX_LIST_REQUESTS] = viewer;
+    relay->listCount++;
+    send_line(relay->control, "LIST_PLAYERS\n");
+}
+
+/**
+ * Reparte las respuestas PLAYERS_BEGIN ... PLAYERS_END en el orden de los
+ * pedidos.
+ */
+static void control_drain(Relay *relay)
+{
+    char *line;
+    for (;;) {
+        int len = line_reader_next(&relay->controlReader, &line, 0);
+        if (len == LINE_PENDING) {
+            return;
+        }
+        if (len < 0) {
+            /* Se cayó: los que esperaban reciben una lista vacía */
+            while (relay->listCount > 0) {
+                int viewer = relay->listQueue[relay->listHead];
+                relay->listHead = (relay->listHead + 1) % RELAY_MAX_LIST_REQUESTS;
+                relay->listCount--;
+                if (viewer >= 0) {
+                    viewer_write(relay, &relay->viewers[viewer],
+                                 "PLAYERS_BEGIN 0\nPLAYERS_END\n", 28);
+                }
+            }
+            close_socket(relay->control);
+            relay->control = INVALID_SOCKET;
+            return;
+        }
+
+        if (line_is(line, "PLAYERS_BEGIN") && relay->listCount > 0) {
+            relay->listTarget = relay->listQueue[relay->listHead];
+            relay->listHead   = (relay->listHead + 1) % RELAY_MAX_LIST_REQUESTS;
+            relay->listCount--;
+        }
+        if (relay->listTarget >= 0 &&
+            (line_is(line, "PLAYERS_BEGIN") || line_is(line, "PLAYER") ||
+             line_is(line, "PLAYERS_END"))) {
+            line[len] = '\n'; /* ver feed_handle_line() */
+            viewer_write(relay, &relay->viewers[relay->listTarget], line, len + 1);
+        }
+        if (line_is(line, "PLAYERS_END")) {
+            relay->listTarget = -1;
+        }
+    }
+}
+
+
+/* ============================
+ *  C O M A N D O S   D E L   E S P E C T A D O R
+ * ============================ */
+
+/**
+ * SPECTATE <id> [+opciones]: de las opciones solo se usa +RATE=<n>; +BIN y
+ * +DELTA se ignoran (siempre texto con listas completas).
+ */
+static void viewer_spectate(Relay *relay, RelayViewer *v, const char *args)
+{
+    char *end;
+    long  id = strtol(args, &end, 10);
+    if (end == args || id <= 0) {
+        viewer_write(relay, v, "ERR BAD_SPECTATE\n", 17);
+        return;
+    }
+
+    const char *rate = strstr(end, "+RATE=");
+    v->rate      = (rate != NULL) ? atoi(rate + 6) : 0;
+    v->nextState = 0;
+    if (v->rate < 0 || v->rate > STATE_RATE_MAX) {
+        v->rate = 0; /* fuera de rango: todos, como sin +RATE */
+    }
+
+    viewer_detach(relay, v);
+
+    int index = feed_open(relay, (int)id);
+    if (index < 0) {
+        viewer_write(relay, v, "ERR RELAY_UPSTREAM\n", 19);
+        return;
+    }
+    relay->feeds[index].viewers++;
+    v->feed = index;
+
+    if (relay->feeds[index].phase == FEED_LIVE) {
+        viewer_go_live(relay, v);
+    } else {
+        v->phase = VIEWER_WAITING;
+    }
+}
+
+/** Interpreta un comando de un espectador. */
+static void viewer_handle_line(Relay *relay, int index, char *line)
+{
+    RelayViewer *v = &relay->viewers[index];
+
+    if (line_is(line, "SPECTATE")) {
+        viewer_spectate(relay, v, line + 8);
+    } else if (line_is(line, "LIST_PLAYERS")) {
+        control_request_list(relay, index);
+    } else if (line_is(line, "RESYNC")) {
+        if (v->phase == VIEWER_LIVE) {
+            viewer_send_keyframe(relay, v);
+        }
+    } else if (line_is(line, "PING")) {
+        viewer_write(relay, v, "PONG\n", 5);
+    } else if (line_is(line, "QUIT")) {
+        viewer_write(relay, v, "BYE\n", 4);
+        v->closing = 1;
+    } else if (line_is(line, "JOIN")) {
+        viewer_write(relay, v, "ERR RELAY_SPECTATE_ONLY\n", 24);
+    } else {
+        viewer_write(relay, v, "ERR UNKNOWN\n", 12);
+    }
+}
+
+/**
+ * Procesa los comandos recibidos de un espectador.
+ *
+ * @return 0 si sigue conectado, -1 si cerró la conexión.
+ */
+static int viewer_drain(Relay *relay, int index)
+{
+    RelayViewer *v = &relay->viewers[index];
+    char *line;
+
+    for (;;) {
+        int len = line_reader_next(&v->reader, &line, 0);
+        if (len == LINE_PENDING) {
+            return 0;
+        }
+        if (len < 0) {
+            return -1;
+        }
+        viewer_handle_line(relay, index, line);
+        if (v->closing) {
+            return 0; /* lo que siga después de QUIT se ignora */
+        }
+    }
+}
+
+/** Acepta un espectador nuevo y le da la bienvenida. */
+static void viewer_accept(Relay *relay)
+{
+    SOCKET sock = accept(relay->listener, NULL, NULL);
+    if (sock == INVALID_SOCKET) {
+        return;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        if (relay->viewers[i].phase == VIEWER_FREE) {
+            slot = i;
+            break;
+        }
+    }
+    char *out = (slot >= 0) ? malloc(RELAY_VIEWER_OUTPUT) : NULL;
+    if (out == NULL) {
+        send_line(sock, "ERR RELAY_FULL\n");
+        close_socket(sock);
+        return;
+    }
+
+    int noDelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+    socket_set_nonblocking(sock);
+
+    RelayViewer *v = &relay->viewers[slot];
+    memset(v, 0, sizeof(*v));
+    v->phase = VIEWER_IDLE;
+    v->sock  = sock;
+    v->feed  = -1;
+    v->out   = out;
+    line_reader_init(&v->reader, sock);
+    viewer_write(relay, v, "WELCOME\n", 8);
+}
+
+
+/* ============================
+ *  B U C L E   P R I N C I P A L
+ * ============================ */
+
+/**
+ * Lee las opciones; lo que no se indica queda con un valor razonable.
+ *
+ * @return 0 en éxito, -1 si hay una opción inválida.
+ */
+static int parse_args(RelayOptions *opts, int argc, char **argv)
+{
+    opts->listenPort = RELAY_PORT;
+    opts->ip         = SERVER_IP;
+    opts->port       = SERVER_PORT;
+    opts->seconds    = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg   = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (value == NULL || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            printf("[RELAY] Opción inválida: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        switch (arg[1]) {
+            case 'l': opts->listenPort = atoi(value); break;
+            case 'h': opts->ip         = value;       break;
+            case 'P': opts->port       = atoi(value); break;
+            case 't': opts->seconds    = atoi(value); break;
+            default:
+                printf("[RELAY] Opción desconocida: %s\n", arg);
+                return -1;
+        }
+    }
+    return (opts->seconds < 0) ? -1 : 0;
+}
+
+/** Imprime sesiones, espectadores y tráfico desde el resumen anterior. */
+static void print_report(Relay *relay, double elapsedMs)
+{
+    int feeds = 0, viewers = 0;
+    for (int i = 0; i < RELAY_MAX_FEEDS; i++) {
+        feeds += relay->feeds[i].phase != FEED_FREE;
+    }
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        viewers += relay->viewers[i].phase != VIEWER_FREE;
+    }
+
+    double scale = 1000.0 / elapsedMs;
+    printf("[RELAY] sesiones=%d espectadores=%d entrada=%.0f B/s salida=%.0f B/s "
+           "fotos=%ld desbordes=%ld\n",
+           feeds, viewers, relay->bytesIn * scale, relay->bytesOut * scale,
+           relay->snapshots, relay->overflows);
+    fflush(stdout);
+
+    relay->bytesIn   = 0;
+    relay->bytesOut  = 0;
+    relay->snapshots = 0;
+    relay->overflows = 0;
+}
+
+/** Una pasada: espera actividad y atiende sockets listos. */
+static void relay_step(Relay *relay)
+{
+    fd_set readSet, writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+
+    FD_SET(relay->listener, &readSet);
+    if (relay->control != INVALID_SOCKET) {
+        FD_SET(relay->control, &readSet);
+    }
+    for (int i = 0; i < RELAY_MAX_FEEDS; i++) {
+        if (relay->feeds[i].phase != FEED_FREE) {
+            FD_SET(relay->feeds[i].sock, &readSet);
+        }
+    }
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        RelayViewer *v = &relay->viewers[i];
+        if (v->phase == VIEWER_FREE) {
+            continue;
+        }
+        if (!v->closing) {
+            FD_SET(v->sock, &readSet);
+        }
+        if (v->outEnd > v->outStart) {
+            FD_SET(v->sock, &writeSet);
+        }
+    }
+
+    struct timeval tv;
+    tv.tv_sec  = 0;
+    tv.tv_usec = RELAY_POLL_MS * 1000;
+    if (select(FD_SETSIZE, &readSet, &writeSet, NULL, &tv) <= 0) { /* WinSock ignora nfds */
+        return;
+    }
+
+    if (FD_ISSET(relay->listener, &readSet)) {
+        viewer_accept(relay);
+    }
+    if (relay->control != INVALID_SOCKET && FD_ISSET(relay->control, &readSet)) {
+        control_drain(relay);
+    }
+    for (int i = 0; i < RELAY_MAX_FEEDS; i++) {
+        RelayFeed *feed = &relay->feeds[i];
+        if (feed->phase != FEED_FREE && FD_ISSET(feed->sock, &readSet)) {
+            feed_drain(relay, feed);
+        }
+    }
+
+    /* Comandos primero y después un solo intento de envío por espectador,
+     * con todo lo que se acumuló en esta pasada */
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        RelayViewer *v = &relay->viewers[i];
+        if (v->phase == VIEWER_FREE) {
+            continue;
+        }
+        if (!v->closing && FD_ISSET(v->sock, &readSet) && viewer_drain(relay, i) != 0) {
+            viewer_close(relay, i);
+            continue;
+        }
+        if (v->outEnd > v->outStart || v->closing) {
+            if (viewer_flush(relay, v) != 0) {
+                viewer_close(relay, i);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static Relay relay;
+    if (parse_args(&relay.opts, argc, argv) != 0) {
+        return 1;
+    }
+
+    WSADATA wsa;
+    int wsaResult = WSAStartup(MAKEWORD(2, 2), &wsa);
+    if (wsaResult != 0) {
+        printf("WSAStartup fallo: %d\n", wsaResult);
+        return 1;
+    }
+
+    relay.viewers = calloc(RELAY_MAX_VIEWERS, sizeof(RelayViewer));
+    relay.listener = create_listen_socket(relay.opts.listenPort);
+    if (relay.viewers == NULL || relay.listener == INVALID_SOCKET) {
+        free(relay.viewers);
+        WSACleanup();
+        return 1;
+    }
+    for (int i = 0; i < RELAY_MAX_FEEDS; i++) {
+        relay.feeds[i].sock = INVALID_SOCKET;
+    }
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        relay.viewers[i].sock = INVALID_SOCKET;
+        relay.viewers[i].feed = -1;
+    }
+    relay.control    = INVALID_SOCKET;
+    relay.listTarget = -1;
+
+    printf("[RELAY] Escuchando en %d, servidor %s:%d\n",
+           relay.opts.listenPort, relay.opts.ip, relay.opts.port);
+
+    double startMs      = client_now_ms();
+    double lastReportMs = startMs;
+    while (relay.opts.seconds == 0 || client_now_ms() - startMs < relay.opts.seconds * 1000.0) {
+        relay_step(&relay);
+
+        double now = client_now_ms();
+        if (now - lastReportMs >= RELAY_REPORT_MS) {
+            print_report(&relay, now - lastReportMs);
+            lastReportMs = now;
+        }
+    }
+
+    for (int i = 0; i < RELAY_MAX_VIEWERS; i++) {
+        if (relay.viewers[i].phase != VIEWER_FREE) {
+            viewer_close(&relay, i);
+        }
+    }
+    for (int i = 0; i < RELAY_MAX_FEEDS; i++) {
+        feed_close(&relay, &relay.feeds[i], NULL);
+    }
+    close_socket(relay.control);
+    close_socket(relay.listener);
+    free(relay.viewers);
+    WSACleanup();
+    return 0;
+}
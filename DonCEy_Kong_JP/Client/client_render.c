@@ -0,0 +1,512 @@
+#include "client_constants.h"
+#include "raylib.h"
+#include "rlgl.h"
+
+/* ============================
+ *  C A P A   D E   T I L E S
+ * ============================
+ *
+ * El mapa solo cambia al recibir uno nuevo, así que se dibuja una vez en
+ * una RenderTexture y cada frame se copia con un único DrawTexture en vez
+ * de dos llamadas de dibujo por tile. Las texturas se identifican por la
+ * huella del mapa (GameMap.hash): varias sesiones viendo el mismo nivel
+ * usan la misma, y hay TILE_LAYER_SLOTS para niveles distintos a la vez.
+ */
+
+/** Una capa de tiles ya dibujada. */
+typedef struct {
+    RenderTexture2D texture;
+    int             loaded;
+    unsigned int    hash;
+    unsigned int    lastUse; /* para reemplazar la menos usada */
+} TileLayer;
+
+static TileLayer    tileLayers[TILE_LAYER_SLOTS];
+static unsigned int tileLayerClock = 0;
+
+/**
+ * Color con el que se dibuja cada tipo de tile.
+ */
+static Color tile_color(char t)
+{
+    switch (t) {
+        case 'W': return (Color){ 30, 60, 200, 255 };   /* Agua */
+        case 'T': return (Color){ 56, 40, 18, 255 };    /* Tierra */
+        case '=': return (Color){ 100, 100, 100, 255 }; /* Plataforma */
+        case '|': return (Color){ 50, 150, 60, 255 };   /* Liana */
+        case 'S': return (Color){ 200, 200, 50, 255 };  /* Spawn */
+        case 'G': return (Color){ 200, 120, 50, 255 };  /* Meta */
+        default:  return (Color){ 20, 20, 30, 255 };    /* Vacío */
+    }
+}
+
+/**
+ * Vuelve a dibujar el mapa completo dentro de la capa indicada.
+ */
+static void rebuild_tile_layer(TileLayer *layer, const GameMap *map)
+{
+    int width  = map->width  * TILE_SIZE;
+    int height = map->height * TILE_SIZE;
+
+    if (layer->loaded &&
+        (layer->texture.texture.width != width || layer->texture.texture.height != height)) {
+        UnloadRenderTexture(layer->texture);
+        layer->loaded = 0;
+    }
+    if (!layer->loaded) {
+        layer->texture = LoadRenderTexture(width, height);
+        layer->loaded  = IsRenderTextureValid(layer->texture);
+        if (!layer->loaded) {
+            return;
+        }
+        /* Las vistas reducidas (varias sesiones) la dibujan escalada */
+        SetTextureFilter(layer->texture.texture, TEXTURE_FILTER_BILINEAR);
+    }
+
+    /* Se puede llamar dentro de BeginDrawing(): EndTextureMode() restaura
+     * el framebuffer y el viewport de la ventana */
+    BeginTextureMode(layer->texture);
+        ClearBackground(BLANK);
+        for (int y = 0; y < map->height; y++) {
+            for (int x = 0; x < map->width; x++) {
+                /* OJO: en el servidor y=0 es la fila inferior, aquí invertimos Y */
+                int drawX = x * TILE_SIZE;
+                int drawY = (map->height - 1 - y) * TILE_SIZE;
+
+                DrawRectangle(drawX, drawY, TILE_SIZE, TILE_SIZE, tile_color(MAP_TILE(map, x, y)));
+                DrawRectangleLines(drawX, drawY, TILE_SIZE, TILE_SIZE, (Color){ 10, 10, 10, 255 });
+            }
+        }
+    EndTextureMode();
+
+    layer->hash = map->hash;
+}
+
+/**
+ * Capa ya dibujada para este mapa; si no hay, reutiliza la menos usada.
+ */
+static TileLayer *find_tile_layer(const GameMap *map)
+{
+    TileLayer *victim = NULL;
+
+    for (int i = 0; i < TILE_LAYER_SLOTS; i++) {
+        TileLayer *layer = &tileLayers[i];
+        if (!layer->loaded) {
+            if (victim == NULL || victim->loaded) {
+                victim = layer; /* un hueco libre gana a cualquier capa usada */
+            }
+            continue;
+        }
+        if (layer->hash == map->hash &&
+            layer->texture.texture.width  == map->width  * TILE_SIZE &&
+            layer->texture.texture.height == map->height * TILE_SIZE) {
+            return layer;
+        }
+        if (victim == NULL || (victim->loaded && layer->lastUse < victim->lastUse)) {
+            victim = layer;
+        }
+    }
+
+    rebuild_tile_layer(victim, map);
+    return victim->loaded ? victim : NULL;
+}
+
+/**
+ * Dibuja la capa estática del mapa, generándola si es un mapa nuevo.
+ */
+void render_tile_layer(const GameMap *map, float offsetX, float offsetY, float tileSize)
+{
+    if (map->width <= 0 || map->height <= 0) {
+        return;
+    }
+
+    TileLayer *layer = find_tile_layer(map);
+    if (layer == NULL) {
+        return;
+    }
+    layer->lastUse = ++tileLayerClock;
+
+    /* Las RenderTexture quedan invertidas en Y (OpenGL): alto negativo */
+    Rectangle src = { 0.0f, 0.0f,
+                      (float)layer->texture.texture.width,
+                      -(float)layer->texture.texture.height };
+    Rectangle dst = { offsetX, offsetY,
+                      map->width * tileSize, map->height * tileSize };
+    DrawTexturePro(layer->texture.texture, src, dst, (Vector2){ 0.0f, 0.0f }, 0.0f, WHITE);
+}
+
+
+/* ============================
+ *  S P R I T E S   E N   L O T E
+ * ============================
+ *
+ * Todas las entidades dinámicas (enemigos, frutas, jugador) salen de un
+ * único atlas, así que una capa completa se arma como un solo lote de
+ * quads con rlgl: un draw call por capa, sin importar cuántas entidades
+ * haya.
+ */
+
+/** Lado en píxeles de cada celda del atlas. */
+#define ATLAS_CELL 16
+
+static Texture2D atlas;
+static int       atlasLoaded = 0;
+
+/** Color de cada sprite, en el orden de SPRITE_*. */
+static const Color SPRITE_COLORS[SPRITE_COUNT] = {
+    [SPRITE_ENEMY_GENERIC] = { 180, 180, 180, 255 },
+    [SPRITE_ENEMY_RED]     = { 220, 50, 50, 255 },
+    [SPRITE_ENEMY_BLUE]    = { 60, 80, 220, 255 },
+    [SPRITE_FRUIT]         = { 230, 0, 230, 255 },
+    [SPRITE_PLAYER]        = { 110, 70, 20, 255 },
+};
+
+/**
+ * Genera el atlas: una fila de celdas, una por sprite.
+ */
+static void load_atlas(void)
+{
+    Image img = GenImageColor(ATLAS_CELL * SPRITE_COUNT, ATLAS_CELL, BLANK);
+    for (int i = 0; i < SPRITE_COUNT; i++) {
+        ImageDrawRectangle(&img, i * ATLAS_CELL, 0, ATLAS_CELL, ATLAS_CELL, SPRITE_COLORS[i]);
+    }
+    atlas = LoadTextureFromImage(img);
+    UnloadImage(img);
+    atlasLoaded = IsTextureValid(atlas);
+}
+
+/**
+ * Abre un lote de sprites para `count` quads.
+ */
+void render_sprites_begin(int count)
+{
+    if (!atlasLoaded) {
+        load_atlas();
+    }
+
+    /* Si el lote no cabe en lo que queda del búfer de rlgl, se vacía
+     * ahora para que esta capa salga en un solo draw call */
+    rlCheckRenderBatchLimit(4 * count);
+
+    rlSetTexture(atlas.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(255, 255, 255, 255);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+}
+
+/**
+ * Agrega un quad del sprite indicado al lote abierto.
+ */
+void render_sprite(int sprite, float x, float y, float w, float h)
+{
+    if (sprite < 0 || sprite >= SPRITE_COUNT) {
+        sprite = SPRITE_ENEMY_GENERIC;
+    }
+
+    /* Centro de la celda: el sprite es de color liso y así no se mezcla
+     * con la celda vecina al filtrar */
+    float u = ((float)sprite + 0.5f) / (float)SPRITE_COUNT;
+    float v = 0.5f;
+
+    rlTexCoord2f(u, v); rlVertex2f(x,     y);
+    rlTexCoord2f(u, v); rlVertex2f(x,     y + h);
+    rlTexCoord2f(u, v); rlVertex2f(x + w, y + h);
+    rlTexCoord2f(u, v); rlVertex2f(x + w, y);
+}
+
+/**
+ * Cierra el lote de sprites.
+ */
+void render_sprites_end(void)
+{
+    rlEnd();
+    rlSetTexture(0);
+}
+
+/* ============================
+ *  E S T A D Í S T I C A S
+ * ============================ */
+
+/** Líneas del overlay dedicadas al bloque STATS del servidor. */
+#define SERVER_STATS_LINES 5
+
+/**
+ * Dibuja el último resumen del servidor: duración del tick y de cada
+ * fase, overruns y el cliente al que más le cuesta enviar. Un tick largo
+ * con broadcast alto y un envío lento apuntan al flush de ese cliente.
+ */
+static void render_server_stats(const ServerStats *server, int x, int y, int font, int lineH)
+{
+    if (!server->valid) {
+        DrawText("servidor: sin STATS", x, y, font, GRAY);
+        return;
+    }
+
+    Color tickColor = server->windowOverruns > 0 ? RED : RAYWHITE;
+    DrawText(TextFormat("tick srv prom/max: %.2f / %.2f ms", server->tickAvgMs, server->tickMaxMs),
+             x, y, font, tickColor);
+    y += lineH;
+
+    DrawText(TextFormat("in %.2f grav %.2f enem %.2f bcast %.2f",
+                        server->phaseMs[SERVER_PHASE_INPUT], server->phaseMs[SERVER_PHASE_GRAVITY],
+                        server->phaseMs[SERVER_PHASE_ENEMIES], server->phaseMs[SERVER_PHASE_BROADCAST]),
+             x, y, font, RAYWHITE);
+    y += lineH;
+
+    DrawText(TextFormat("overruns %d/s (%ld)  atraso %.1f ms  %d cli  %d in/s",
+                        server->windowOverruns, server->overruns, server->lateMaxMs, server->clients,
+                        server->inputLines),
+             x, y, font, tickColor);
+    y += lineH;
+
+    if (server->worstId < 0) {
+        DrawText("envío srv: sin clientes", x, y, font, GRAY);
+    } else {
+        DrawText(TextFormat("envío lento #%d: max %.1f prom %.2f ms cola %d",
+                            server->worstId, server->worstSendMaxMs,
+                            server->worstSendAvgMs, server->worstDepthMax),
+                 x, y, font, server->worstDepthMax > 1 ? ORANGE : RAYWHITE);
+    }
+    y += lineH;
+
+    DrawText(TextFormat("STATE fusionados %d  descartados %d  log %d/%d desc",
+                        server->coalescedStates, server->droppedMessages,
+                        server->logLines, server->logDropped),
+             x, y, font, server->droppedMessages > 0 || server->logDropped > 0 ? RED : RAYWHITE);
+}
+
+/** Nombre de cada categoría, en el orden de STATS_TAG_*. */
+static const char *STATS_TAG_NAMES[STATS_TAG_COUNT] = {
+    [STATS_TAG_STATE] = "STATE",
+    [STATS_TAG_FRUIT] = "FRUIT",
+    [STATS_TAG_ENEMY] = "ENEMY",
+    [STATS_TAG_MAP]   = "MAP",
+    [STATS_TAG_OTHER] = "otros",
+};
+
+/**
+ * Dibuja el panel de estadísticas (F3) en la esquina superior derecha.
+ * Muestra los valores del último segundo cerrado por stats_frame().
+ */
+void render_stats_overlay(const ClientStats *stats)
+{
+    const int font   = 16;
+    const int lineH  = font + 4;
+    const int width  = 340;
+    const int height = lineH * (4 + STATS_TAG_COUNT + SERVER_STATS_LINES) + 12;
+    int x = WINDOW_WIDTH - width - 10;
+    int y = 10;
+
+    DrawRectangle(x, y, width, height, (Color){ 0, 0, 0, 180 });
+    DrawRectangleLines(x, y, width, height, RAYWHITE);
+    x += 8;
+    y += 6;
+
+    DrawText(TextFormat("frame p50/p95/p99: %.1f / %.1f / %.1f ms",
+                        stats->frameP50, stats->frameP95, stats->frameP99),
+             x, y, font, RAYWHITE);
+    y += lineH;
+
+    DrawText(TextFormat("recv bloqueado: %.1f ms/s", stats->blockedMsPerSec),
+             x, y, font, RAYWHITE);
+    y += lineH;
+
+    if (stats->rttP50 < 0.0) {
+        DrawText("RTT INPUT->ack: sin datos", x, y, font, GRAY);
+    } else {
+        DrawText(TextFormat("RTT INPUT->ack p50/max: %.0f / %.0f ms",
+                            stats->rttP50, stats->rttMax),
+                 x, y, font, RAYWHITE);
+    }
+    y += lineH;
+
+    for (int t = 0; t < STATS_TAG_COUNT; t++) {
+        DrawText(TextFormat("%-6s %5ld msg/s  %7ld B/s", STATS_TAG_NAMES[t],
+                            stats->linesPerSec[t], stats->bytesPerSec[t]),
+                 x, y, font, RAYWHITE);
+        y += lineH;
+    }
+
+    DrawText(stats->csv != NULL ? "CSV: grabando (F4)" : "CSV: apagado (F4)",
+             x, y, font, stats->csv != NULL ? RED : GRAY);
+    y += lineH;
+
+    render_server_stats(&stats->server, x, y, font, lineH);
+}
+
+/* ============================
+ *  D I B U J A R   E S C E N A
+ * ============================ */
+
+/**
+ * Dibuja mapa y entidades de una sesión en un rectángulo de la pantalla.
+ *
+ * - Cada celda del mapa se representa como un rectángulo de color distinto
+ *   según el carácter recibido del servidor (capa cacheada en
+ *   render_tile_layer()).
+ * - Jugador y enemigos se dibujan en la posición interpolada de
+ *   state->interp (llamar a interp_update() antes).
+ * - Con tileSize < TILE_SIZE todo se escala igual (vistas de varias
+ *   sesiones).
+ *
+ * @param state    Estado de la sesión a dibujar.
+ * @param offsetX  Esquina superior izquierda del mapa en pantalla (X).
+ * @param offsetY  Esquina superior izquierda del mapa en pantalla (Y).
+ * @param tileSize Lado en pantalla de cada tile.
+ */
+void
+render_world(const ClientState *state, float offsetX, float offsetY, float tileSize)
+{
+    /* Márgenes de cada sprite, pensados para TILE_SIZE y escalados */
+    const float unit = tileSize / TILE_SIZE;
+
+    /* Dibujar tiles: capa estática ya dibujada, una sola copia por frame */
+    render_tile_layer(&state->map, offsetX, offsetY, tileSize);
+
+    /* ===== Entidades: un solo lote de quads del atlas (un draw call) =====
+     * El orden dentro del lote es el orden de dibujo: enemigos, frutas y
+     * el jugador encima de todo. */
+    render_sprites_begin(state->numEnemies + state->numFruits + 1);
+
+    /* Enemigos (cocodrilos), en su posición interpolada entre ticks */
+    for (int i = 0; i < state->numEnemies; i++) {
+        float ex = state->interp.enemyX[i];
+        float ey = state->interp.enemyY[i];
+
+        float drawX = offsetX + ex * tileSize;
+        float drawY = offsetY + (state->map.height - 1 - ey) * tileSize;
+
+        int type   = state->enemies[i].type;
+        int sprite = (type == SPRITE_ENEMY_RED || type == SPRITE_ENEMY_BLUE)
+                         ? type : SPRITE_ENEMY_GENERIC;
+
+        /* Rectángulo más “alargado” para sugerir un cocodrilo horizontal */
+        render_sprite(sprite,
+                      drawX + 4 * unit, drawY + 10 * unit,
+                      tileSize - 8 * unit, tileSize - 20 * unit);
+    }
+
+    /* Frutas: cuadrado más pequeño, color llamativo */
+    for (int i = 0; i < state->numFruits; i++) {
+        int fx = state->fruits[i].x;
+        int fy = state->fruits[i].y;
+
+        float drawX = offsetX + fx * tileSize;
+        float drawY = offsetY + (state->map.height - 1 - fy) * tileSize;
+
+        render_sprite(SPRITE_FRUIT, drawX + 8 * unit, drawY + 8 * unit,
+                      tileSize - 16 * unit, tileSize - 16 * unit);
+    }
+
+    /* Jugador (si tenemos posición válida) */
+    if (state->playerId != 0) {
+        float px = state->interp.playerX;
+        float py = state->interp.playerY;
+
+        float drawX = offsetX + px * tileSize;
+        float drawY = offsetY + (state->map.height - 1 - py) * tileSize;
+
+        render_sprite(SPRITE_PLAYER, drawX + 5 * unit, drawY + 5 * unit,
+                      tileSize - 10 * unit, tileSize - 10 * unit);
+    }
+
+    render_sprites_end();
+}
+
+/**
+ * Dibuja el mapa y la posición del jugador utilizando raylib.
+ *
+ * - El mapa y las entidades se dibujan centrados con render_world().
+ * - Encima va el HUD y, si corresponde, el overlay de GAME OVER.
+ *
+ * @param state Puntero al estado actual del cliente (mapa + posición jugador).
+ */
+void
+render_game_scene(const ClientState *state)
+{
+    const int tileSize = TILE_SIZE;  /* tamaño en píxeles de cada tile */
+
+    /* Calcular offset para centrar el mapa en la ventana */
+    int mapPixelWidth  = state->map.width  * tileSize;
+    int mapPixelHeight = state->map.height * tileSize;
+
+    int offsetX = (WINDOW_WIDTH  - mapPixelWidth)  / 2;
+    int offsetY = (WINDOW_HEIGHT - mapPixelHeight) / 2;
+
+    /* Dibujar fondo */
+    ClearBackground((Color){ 10, 10, 30, 255 });
+
+    render_world(state, (float)offsetX, (float)offsetY, (float)tileSize);
+
+    /* HUD sencillo (abajo a la izquierda) */
+    DrawText("DonCEy Kong Jr - Cliente", 10, 10, 20, RAYWHITE);
+
+    char hud[128];
+    snprintf(hud, sizeof(hud),
+             "ID: %d  Nivel: %d  Vidas: %d  Score: %d  GameOver: %s",
+             state->playerId,
+             state->level,
+             state->lives,
+             state->score,
+             state->gameOver ? "SI" : "NO");
+    DrawText(hud, 10, WINDOW_HEIGHT - 30, 16, LIGHTGRAY);
+    /* === Overlay de GAME OVER === */
+    if (state->gameOver) {
+        /* Fondo oscuro semitransparente encima de todo */
+        DrawRectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
+                    (Color){ 0, 0, 0, 200 });
+
+        /* Título grande "Perdiste" */
+        const char *msg     = "¡HAS PERDIDO!";
+        int         titleFont = 40;
+        int         msgWidth  = MeasureText(msg, titleFont);
+        int         msgX      = (WINDOW_WIDTH - msgWidth) / 2;
+        int         msgY      = WINDOW_HEIGHT / 2 - 100;
+        DrawText(msg, msgX, msgY, titleFont, RAYWHITE);
+
+        /* Score final en grande debajo del título */
+        const char *scoreMsg = TextFormat("Puntuación final: %d", state->score);
+        int         scoreFont  = 30;
+        int         scoreWidth = MeasureText(scoreMsg, scoreFont);
+        int         scoreX     = (WINDOW_WIDTH - scoreWidth) / 2;
+        int         scoreY     = msgY + titleFont + 10;
+        DrawText(scoreMsg, scoreX, scoreY, scoreFont, RAYWHITE);
+
+        /* Botón "Volver a jugar" debajo del score */
+        const char *btnText   = "Volver a jugar";
+        int         btnFont   = 24;
+        int         btnWidth  = MeasureText(btnText, btnFont) + 40;
+        int         btnHeight = 50;
+        int         btnX      = (WINDOW_WIDTH - btnWidth) / 2;
+        int         btnY      = scoreY + scoreFont + 30;
+
+        DrawRectangle(btnX, btnY, btnWidth, btnHeight,
+                    (Color){ 50, 80, 130, 255 });
+        DrawRectangleLines(btnX, btnY, btnWidth, btnHeight, RAYWHITE);
+
+        int textX = btnX + (btnWidth  - MeasureText(btnText, btnFont)) / 2;
+        int textY = btnY + (btnHeight - btnFont) / 2;
+        DrawText(btnText, textX, textY, btnFont, RAYWHITE);
+    }
+
+}
+
+
+/**
+ * Libera la textura de la capa de tiles y el atlas. Debe llamarse antes
+ * de CloseWindow().
+ */
+void render_shutdown(void)
+{
+    for (int i = 0; i < TILE_LAYER_SLOTS; i++) {
+        if (tileLayers[i].loaded) {
+            UnloadRenderTexture(tileLayers[i].texture);
+            tileLayers[i].loaded = 0;
+        }
+    }
+
+    if (atlasLoaded) {
+        UnloadTexture(atlas);
+        atlasLoaded = 0;
+    }
+}
@@ -0,0 +1,296 @@
+#include "client_constants.h"
+
+/* ============================
+ *  G R A B A C I Ó N
+ * ============================
+ *
+ * Formato del archivo (todo little-endian):
+ *
+ *   cabecera : "DKREC1" | u8 rol (ROLE_*) | u8 reservado
+ *   registro : u32 ms desde el inicio | u32 len | len bytes recibidos
+ *
+ * Cada registro es exactamente lo que devolvió un recv(), así que la
+ * reproducción pasa por el mismo LineReader y el mismo protocolo (texto o
+ * binario) que una sesión en vivo.
+ */
+
+/** Búfer de stdio del archivo de grabación: un fwrite por recv sin syscall. */
+#define RECORDER_BUFFER_SIZE (64 * 1024)
+
+static const char REPLAY_MAGIC[REPLAY_MAGIC_LENGTH] = { 'D', 'K', 'R', 'E', 'C', '1' };
+
+static void put_u32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v);
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static unsigned int get_u32(const unsigned char *p)
+{
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+           ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/**
+ * Abre (o trunca) el archivo de grabación y escribe la cabecera.
+ */
+int recorder_open(Recorder *rec, const char *path, int role)
+{
+    rec->file = fopen(path, "wb");
+    if (rec->file == NULL) {
+        printf("[REC] No se pudo abrir %s\n", path);
+        return -1;
+    }
+    setvbuf(rec->file, NULL, _IOFBF, RECORDER_BUFFER_SIZE);
+
+    unsigned char header[REPLAY_HEADER_SIZE] = { 0 };
+    memcpy(header, REPLAY_MAGIC, REPLAY_MAGIC_LENGTH);
+    header[REPLAY_MAGIC_LENGTH] = (unsigned char)role;
+    fwrite(header, 1, sizeof(header), rec->file);
+
+    rec->startMs = client_now_ms();
+    printf("[REC] Grabando en %s\n", path);
+    return 0;
+}
+
+/**
+ * Ruta de la partida `game`: "-<n>" antes de la extensión desde la segunda.
+ */
+void recorder_game_path(char *out, size_t size, const char *path, int game)
+{
+    if (game <= 1) {
+        snprintf(out, size, "%s", path);
+        return;
+    }
+
+    /* La extensión es el último '.' del nombre, no de un directorio */
+    const char *dot = strrchr(path, '.');
+    const char *sep = strrchr(path, '/');
+    const char *bsl = strrchr(path, '\\');
+    if (bsl != NULL && (sep == NULL || bsl > sep)) {
+        sep = bsl;
+    }
+    if (dot == NULL || (sep != NULL && dot < sep)) {
+        snprintf(out, size, "%s-%d", path, game);
+    } else {
+        snprintf(out, size, "%.*s-%d%s", (int)(dot - path), path, game, dot);
+    }
+}
+
+/**
+ * Agrega un bloque recibido con su marca de tiempo.
+ */
+void recorder_write(Recorder *rec, const char *data, int len)
+{
+    if (rec->file == NULL || len <= 0) {
+        return;
+    }
+
+    unsigned char header[REPLAY_RECORD_HEADER];
+    double elapsed = client_now_ms() - rec->startMs;
+    put_u32(header, (unsigned int)(elapsed > 0.0 ? elapsed : 0.0));
+    put_u32(header + 4, (unsigned int)len);
+
+    fwrite(header, 1, sizeof(header), rec->file);
+    fwrite(data, 1, (size_t)len, rec->file);
+}
+
+/**
+ * Cierra el archivo de grabación (vacía el búfer de stdio).
+ */
+void recorder_close(Recorder *rec)
+{
+    if (rec->file != NULL) {
+        fclose(rec->file);
+        rec->file = NULL;
+    }
+}
+
+
+/* ============================
+ *  R E P R O D U C C I Ó N
+ * ============================
+ *
+ * El archivo se mapea en memoria: leer un registro es un memcpy desde la
+ * vista y saltar a otro punto es mover un índice, sin read() ni búferes
+ * intermedios aunque la sesión sea larga.
+ */
+
+/** Tiempo del registro que empieza en `offset`. */
+static double record_time(const ReplaySource *src, size_t offset)
+{
+    return (double)get_u32(src->base + offset);
+}
+
+/** Largo de los datos del registro que empieza en `offset`. */
+static size_t record_length(const ReplaySource *src, size_t offset)
+{
+    return (size_t)get_u32(src->base + offset + 4);
+}
+
+/** ¿Hay un registro completo a partir de `offset`? */
+static int record_valid(const ReplaySource *src, size_t offset)
+{
+    if (offset + REPLAY_RECORD_HEADER > src->size) {
+        return 0;
+    }
+    return record_length(src, offset) <= src->size - offset - REPLAY_RECORD_HEADER;
+}
+
+/**
+ * Valida la cabecera de src->base y calcula rol, fin y duración.
+ *
+ * @return 0 en éxito, -1 si no es una grabación.
+ */
+static int scan_records(ReplaySource *src)
+{
+    if (memcmp(src->base, REPLAY_MAGIC, REPLAY_MAGIC_LENGTH) != 0) {
+        return -1;
+    }
+    src->role = src->base[REPLAY_MAGIC_LENGTH];
+
+    /* Duración: recorrer solo las cabeceras de los registros. Un registro
+     * cortado al final (cliente cerrado a medias) marca el fin. */
+    size_t offset = REPLAY_HEADER_SIZE;
+    while (record_valid(src, offset)) {
+        src->durationMs = record_time(src, offset);
+        offset += REPLAY_RECORD_HEADER + record_length(src, offset);
+    }
+    src->end = offset;
+
+    replay_rewind(src);
+    return 0;
+}
+
+/**
+ * Mapea la grabación, valida la cabecera y calcula la duración total.
+ */
+int replay_open(ReplaySource *src, const char *path)
+{
+    memset(src, 0, sizeof(*src));
+    src->file    = INVALID_HANDLE_VALUE;
+    src->mapping = NULL;
+    src->speed   = 1.0;
+
+    src->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (src->file == INVALID_HANDLE_VALUE) {
+        printf("[REPLAY] No se pudo abrir %s\n", path);
+        return -1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(src->file, &size) || size.QuadPart < REPLAY_HEADER_SIZE) {
+        printf("[REPLAY] %s no es una grabación\n", path);
+        replay_close(src);
+        return -1;
+    }
+    src->size = (size_t)size.QuadPart;
+
+    src->mapping = CreateFileMappingA(src->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (src->mapping != NULL) {
+        src->base = MapViewOfFile(src->mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (src->base == NULL) {
+        printf("[REPLAY] No se pudo mapear %s\n", path);
+        replay_close(src);
+        return -1;
+    }
+
+    if (scan_records(src) != 0) {
+        printf("[REPLAY] %s no es una grabación\n", path);
+        replay_close(src);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Usa una grabación que ya está en memoria (mismo formato que el archivo).
+ */
+int replay_open_memory(ReplaySource *src, const unsigned char *data, size_t size)
+{
+    memset(src, 0, sizeof(*src));
+    src->file    = INVALID_HANDLE_VALUE;
+    src->mapping = NULL;
+    src->speed   = 1.0;
+    src->base    = data;
+    src->size    = size;
+
+    if (size < REPLAY_HEADER_SIZE || scan_records(src) != 0) {
+        src->base = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Desmapea y cierra la grabación.
+ */
+void replay_close(ReplaySource *src)
+{
+    if (src->mapping != NULL) {
+        if (src->base != NULL) {
+            UnmapViewOfFile((LPVOID)src->base);
+        }
+        CloseHandle(src->mapping);
+        src->mapping = NULL;
+    }
+    src->base = NULL; /* en memoria (replay_open_memory) el búfer es del llamador */
+    if (src->file != INVALID_HANDLE_VALUE) {
+        CloseHandle(src->file);
+        src->file = INVALID_HANDLE_VALUE;
+    }
+}
+
+/**
+ * Vuelve al primer registro con el reloj en 0.
+ */
+void replay_rewind(ReplaySource *src)
+{
+    src->pos     = REPLAY_HEADER_SIZE;
+    src->partial = 0;
+    src->clockMs = 0.0;
+}
+
+/**
+ * ¿El próximo registro ya debería haber llegado según el reloj?
+ */
+int replay_due(const ReplaySource *src)
+{
+    if (src->pos >= src->end) {
+        return 0;
+    }
+    return record_time(src, src->pos) <= src->clockMs;
+}
+
+/**
+ * Copia el siguiente registro (o lo que quepa de él) en `dest`, como un
+ * recv(). Si el registro era del futuro, el reloj avanza hasta él: las
+ * lecturas bloqueantes del handshake no esperan en tiempo real.
+ */
+int replay_read(ReplaySource *src, char *dest, int capacity)
+{
+    if (src->pos >= src->end || capacity <= 0) {
+        return 0; /* fin de la grabación: igual que un cierre del servidor */
+    }
+
+    double when = record_time(src, src->pos);
+    if (when > src->clockMs) {
+        src->clockMs = when;
+    }
+
+    size_t length = record_length(src, src->pos) - src->partial;
+    size_t count  = length < (size_t)capacity ? length : (size_t)capacity;
+    memcpy(dest, src->base + src->pos + REPLAY_RECORD_HEADER + src->partial, count);
+
+    if (count == length) {
+        src->pos    += REPLAY_RECORD_HEADER + record_length(src, src->pos);
+        src->partial = 0;
+    } else {
+        src->partial += count; /* el resto sale en la próxima lectura */
+    }
+    return (int)count;
+}
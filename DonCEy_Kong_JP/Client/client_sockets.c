@@ -40,83 +40,427 @@ SOCKET create_and_connect_socket(const char *ip, int port)
         return INVALID_SOCKET;
     }
 
+    /* Desactivar Nagle: los INPUT son pequeños y deben salir de inmediato.
+     * El agrupado por frame lo hace la SendQueue, no el kernel. */
+    int noDelay = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+                   (const char *)&noDelay, sizeof(noDelay)) == SOCKET_ERROR) {
+        printf("Aviso: no se pudo activar TCP_NODELAY: %ld\n", WSAGetLastError());
+    }
+
     printf("Conectado a %s:%d\n", ip, port);
     return fd;
 }
 
 /**
- * Envía una línea de texto al servidor.
+ * Crea un socket TCP en escucha en 127.0.0.1:port.
+ *
+ * @param port Puerto TCP local.
+ * @return     SOCKET en escucha, o INVALID_SOCKET en error.
+ */
+SOCKET create_listen_socket(int port)
+{
+    SOCKET fd;
+    struct sockaddr_in addr;
+
+    fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd == INVALID_SOCKET) {
+        printf("Error al crear socket: %ld\n", WSAGetLastError());
+        return INVALID_SOCKET;
+    }
+
+    /* Poder reabrir el puerto enseguida tras reiniciar el relay */
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((u_short)port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(fd, SOMAXCONN) == SOCKET_ERROR) {
+        printf("No se pudo escuchar en el puerto %d. Error: %ld\n", port, WSAGetLastError());
+        closesocket(fd);
+        return INVALID_SOCKET;
+    }
+    return fd;
+}
+
+/**
+ * Pone el socket en modo no bloqueante.
+ *
+ * @param socket_fd Socket a modificar.
+ * @return 0 en éxito, -1 en error.
+ */
+int socket_set_nonblocking(SOCKET socket_fd)
+{
+    u_long mode = 1;
+    return ioctlsocket(socket_fd, FIONBIO, &mode) == SOCKET_ERROR ? -1 : 0;
+}
+
+/**
+ * Envía lo que el socket no bloqueante acepte sin esperar.
+ *
+ * @param socket_fd Socket no bloqueante.
+ * @param data      Bytes a enviar.
+ * @param len       Cantidad de bytes.
+ * @return Bytes enviados (0 si el búfer del socket está lleno), o -1 si
+ *         la conexión falló.
+ */
+int socket_send_some(SOCKET socket_fd, const char *data, int len)
+{
+    for (;;) {
+        int ret = send(socket_fd, data, len, 0);
+        if (ret != SOCKET_ERROR) {
+            return ret;
+        }
+        int err = WSAGetLastError();
+        if (err == WSAEINTR) {
+            continue;
+        }
+        return err == WSAEWOULDBLOCK ? 0 : -1;
+    }
+}
+
+/**
+ * Envía un bloque completo de bytes, reintentando ante envíos parciales.
+ *
+ * @param socket_fd Descriptor de socket conectado.
+ * @param data      Bytes a enviar.
+ * @param len       Cantidad de bytes.
+ * @return 0 si se envió todo, -1 en error.
+ */
+static int send_all(SOCKET socket_fd, const char *data, int len)
+{
+    int total = 0;
+
+    while (total < len) {
+        int sent = send(socket_fd, data + total, len - total, 0);
+        if (sent == SOCKET_ERROR) {
+            if (WSAGetLastError() == WSAEINTR) {
+                continue;
+            }
+            printf("Error al enviar datos: %ld\n", WSAGetLastError());
+            return -1;
+        }
+        total += sent;
+    }
+
+    return 0;
+}
+
+/**
+ * Envía una línea de texto al servidor de inmediato.
  *
  * @param socket_fd Descriptor de socket conectado.
  * @param line      Cadena a enviar. No se agrega '\n' automáticamente.
  */
 void send_line(SOCKET socket_fd, const char *line)
+{
+    send_all(socket_fd, line, (int)strlen(line));
+}
+
+/**
+ * Inicializa una cola de salida vacía.
+ *
+ * @param queue     Cola a inicializar.
+ * @param socket_fd Socket destino.
+ */
+void send_queue_init(SendQueue *queue, SOCKET socket_fd)
+{
+    queue->socket_fd = socket_fd;
+    queue->length    = 0;
+}
+
+/**
+ * Encola una línea para el próximo send_queue_flush().
+ *
+ * @param queue Cola de salida.
+ * @param line  Línea a encolar (con '\n').
+ * @return 0 en éxito, -1 si el vaciado previo falló.
+ */
+int send_queue_push(SendQueue *queue, const char *line)
 {
     int len = (int)strlen(line);
-    int sent = send(socket_fd, line, len, 0);
-    if (sent == SOCKET_ERROR) {
-        printf("Error al enviar datos: %ld\n", WSAGetLastError());
+
+    if (queue->length + len > SEND_QUEUE_CAPACITY) {
+        if (send_queue_flush(queue) != 0) {
+            return -1;
+        }
+    }
+
+    if (len > SEND_QUEUE_CAPACITY) {
+        /* Línea más grande que la cola: se envía directo */
+        return send_all(queue->socket_fd, line, len);
     }
+
+    memcpy(queue->data + queue->length, line, len);
+    queue->length += len;
+    return 0;
 }
 
 /**
- * Recibe una línea de texto desde el servidor (terminada en '\n').
+ * Escribe de una vez todo lo acumulado en la cola.
  *
- * La función lee del socket carácter por carácter usando recv(), hasta
- * encontrar un salto de línea '\n' o hasta llenar el búfer menos uno
- * (para el terminador '\0').
+ * @param queue Cola de salida.
+ * @return 0 en éxito, -1 en error de socket.
+ */
+int send_queue_flush(SendQueue *queue)
+{
+    if (queue->length == 0) {
+        return 0;
+    }
+    if (queue->socket_fd == INVALID_SOCKET) {
+        /* Sin socket (reproducción de una grabación): se descarta */
+        queue->length = 0;
+        return 0;
+    }
+
+    int ret = send_all(queue->socket_fd, queue->data, queue->length);
+    queue->length = 0;
+    return ret;
+}
+
+/**
+ * Inicializa un lector vacío para el socket indicado.
  *
- * También elimina un posible '\r' final típico de líneas con "\r\n".
+ * @param reader    Lector a inicializar.
+ * @param socket_fd Socket del que leerá.
+ */
+void line_reader_init(LineReader *reader, SOCKET socket_fd)
+{
+    reader->socket_fd = socket_fd;
+    reader->start     = 0;
+    reader->end       = 0;
+    reader->blockedMs = 0.0;
+    reader->recorder  = NULL;
+    reader->replay    = NULL;
+}
+
+/**
+ * Sondeo sin espera: ¿hay algo nuevo para leer?
  *
- * @param socket_fd  Descriptor de socket WinSock desde el que se lee.
- * @param buffer     Búfer de destino donde se almacenará la línea.
- * @param bufferSize Tamaño total del búfer en bytes. Debe ser > 1.
- * @return Número de caracteres leídos (sin contar el '\0') en caso de éxito,
- *         o -1 si la conexión se cerró o se produjo un error.
+ * En reproducción depende del reloj de la grabación, no del socket.
  */
-int recv_line(SOCKET socket_fd, char *buffer, int bufferSize)
+static int line_reader_ready(const LineReader *reader)
 {
-    if (bufferSize <= 1) {
-        return -1;
+    if (reader->replay != NULL) {
+        return replay_due(reader->replay);
     }
+    /* Un error también cuenta como "listo": el recv() siguiente lo reporta */
+    return socket_wait_readable(reader->socket_fd, 0) != 0;
+}
 
-    int total = 0;
-    char c;
+/**
+ * Hace UN recv() grande sobre el espacio libre del búfer.
+ *
+ * Antes de leer compacta los bytes pendientes al inicio si no queda
+ * espacio al final.
+ *
+ * @param reader Lector a rellenar.
+ * @return Bytes leídos (> 0), 0 si el servidor cerró la conexión,
+ *         o -1 en caso de error.
+ */
+static int line_reader_fill(LineReader *reader)
+{
+    if (reader->start == reader->end) {
+        reader->start = 0;
+        reader->end   = 0;
+    } else if (reader->end == LINE_READER_CAPACITY && reader->start > 0) {
+        int pending = reader->end - reader->start;
+        memmove(reader->data, reader->data + reader->start, pending);
+        reader->start = 0;
+        reader->end   = pending;
+    }
+
+    if (reader->replay != NULL) {
+        /* Reproducción: el "recv" es el siguiente registro grabado */
+        int ret = replay_read(reader->replay, reader->data + reader->end,
+                              LINE_READER_CAPACITY - reader->end);
+        reader->end += ret;
+        return ret; /* 0 = fin de la grabación */
+    }
 
-    while (total < bufferSize - 1) {
-        int ret = recv(socket_fd, &c, 1, 0);
+    for (;;) {
+        /* Se mide cuánto se queda esperando aquí (overlay de estadísticas) */
+        double t0 = client_now_ms();
+        int ret = recv(reader->socket_fd, reader->data + reader->end,
+                       LINE_READER_CAPACITY - reader->end, 0);
+        reader->blockedMs += client_now_ms() - t0;
+
+        if (ret > 0) {
+            if (reader->recorder != NULL) {
+                recorder_write(reader->recorder, reader->data + reader->end, ret);
+            }
+            reader->end += ret;
+            return ret;
+        }
         if (ret == 0) {
             /* Conexión cerrada por el servidor */
-            return -1;
+            return 0;
+        }
+        if (WSAGetLastError() == WSAEINTR) {
+            continue; /* reintentar si fue interrumpido */
         }
-        if (ret < 0) {
-            /* Error en recv() */
-            int err = WSAGetLastError();
-            if (err == WSAEINTR) {
-                continue; /* reintentar si fue interrumpido */
+        return -1;
+    }
+}
+
+/**
+ * Entrega la siguiente línea del búfer sin copiarla.
+ *
+ * Se sustituye el '\n' (o el "\r\n") por '\0' dentro del propio búfer.
+ * Si el búfer se llena sin encontrar '\n', se entrega su contenido como
+ * una línea truncada para no quedar bloqueados.
+ *
+ * @param reader   Lector asociado al socket.
+ * @param line     Salida: inicio de la línea (válido hasta la próxima llamada).
+ * @param blocking 1 = esperar datos; 0 = devolver LINE_PENDING si no hay
+ *                 una línea completa.
+ * @return Longitud de la línea, LINE_PENDING o -1 (cierre / error).
+ */
+int line_reader_next(LineReader *reader, char **line, int blocking)
+{
+    for (;;) {
+        char *begin = reader->data + reader->start;
+        int   avail = reader->end - reader->start;
+        char *nl    = memchr(begin, '\n', avail);
+
+        if (nl != NULL) {
+            int len = (int)(nl - begin);
+            reader->start += len + 1;
+
+            /* Eliminar '\r' final si viene de "\r\n" */
+            if (len > 0 && begin[len - 1] == '\r') {
+                len--;
             }
+            begin[len] = '\0';
+            *line = begin;
+            return len;
+        }
+
+        if (avail == LINE_READER_CAPACITY) {
+            /* Línea más larga que el búfer: se entrega truncada */
+            reader->data[LINE_READER_CAPACITY] = '\0';
+            reader->start = reader->end;
+            *line = reader->data;
+            return avail;
+        }
+
+        if (!blocking && !line_reader_ready(reader)) {
+            return LINE_PENDING;
+        }
+
+        if (line_reader_fill(reader) <= 0) {
             return -1;
         }
+    }
+}
+
+/**
+ * Entrega la siguiente trama binaria sin copiarla.
+ *
+ * Lee el prefijo u16 de longitud y espera hasta tener la trama completa en
+ * el búfer. Una longitud 0 o mayor que el búfer se considera un error de
+ * protocolo.
+ *
+ * @param reader   Lector asociado al socket.
+ * @param frame    Salida: inicio de la trama (byte de tipo).
+ * @param blocking 1 = esperar datos; 0 = devolver LINE_PENDING si la trama
+ *                 no está completa.
+ * @return Longitud de la trama, LINE_PENDING o -1 (cierre / error).
+ */
+int line_reader_next_frame(LineReader *reader, unsigned char **frame, int blocking)
+{
+    for (;;) {
+        int avail = reader->end - reader->start;
+
+        if (avail >= 2) {
+            unsigned char *p = (unsigned char *)reader->data + reader->start;
+            int len = (p[0] << 8) | p[1];
+
+            if (len == 0 || len > LINE_READER_CAPACITY - 2) {
+                return -1; /* trama inválida */
+            }
+            if (avail >= 2 + len) {
+                reader->start += 2 + len;
+                *frame = p + 2;
+                return len;
+            }
+        }
+
+        if (!blocking && !line_reader_ready(reader)) {
+            return LINE_PENDING;
+        }
 
-        if (c == '\n') {
-            break; /* fin de línea */
+        if (line_reader_fill(reader) <= 0) {
+            return -1;
         }
+    }
+}
 
-        buffer[total++] = c;
+/**
+ * Recibe una línea de texto desde el servidor (terminada en '\n').
+ *
+ * Versión con copia de line_reader_next() en modo bloqueante. Mantiene el
+ * contrato original: sin '\r\n' final y -1 si la conexión se cerró.
+ *
+ * @param reader     Lector asociado al socket.
+ * @param buffer     Búfer de destino donde se almacenará la línea.
+ * @param bufferSize Tamaño total del búfer en bytes. Debe ser > 1.
+ * @return Número de caracteres copiados (sin contar el '\0') en caso de
+ *         éxito, o -1 si la conexión se cerró o se produjo un error.
+ */
+int recv_line(LineReader *reader, char *buffer, int bufferSize)
+{
+    if (bufferSize <= 1) {
+        return -1;
     }
 
-    buffer[total] = '\0';
+    char *line;
+    int len = line_reader_next(reader, &line, 1);
+    if (len < 0) {
+        return -1;
+    }
 
-    /* Eliminar '\r' final si viene de "\r\n" */
-    if (total > 0 && buffer[total - 1] == '\r') {
-        buffer[total - 1] = '\0';
-        total--;
+    if (len > bufferSize - 1) {
+        len = bufferSize - 1;
     }
+    memcpy(buffer, line, len);
+    buffer[len] = '\0';
 
-    return total;
+    return len;
 }
 
+/**
+ * Consulta con select() si el socket tiene datos pendientes de lectura.
+ *
+ * Un cierre de conexión también se reporta como "listo": el recv_line()
+ * siguiente devolverá -1 y el llamador podrá salir de su bucle.
+ *
+ * @param socket_fd Descriptor de socket WinSock.
+ * @param timeoutMs Milisegundos a esperar como máximo (0 = sondeo inmediato).
+ * @return 1 si hay datos, 0 si no hay nada pendiente, -1 en error.
+ */
+int socket_wait_readable(SOCKET socket_fd, int timeoutMs)
+{
+    fd_set readSet;
+    struct timeval tv;
 
+    FD_ZERO(&readSet);
+    FD_SET(socket_fd, &readSet);
+
+    tv.tv_sec  = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+    /* En WinSock el primer parámetro se ignora; se pasa por compatibilidad */
+    int ret = select((int)socket_fd + 1, &readSet, NULL, NULL, &tv);
+    if (ret == SOCKET_ERROR) {
+        return -1;
+    }
+    return (ret > 0 && FD_ISSET(socket_fd, &readSet)) ? 1 : 0;
+}
 
 /**
  * Cierra un socket WinSock.
@@ -0,0 +1,204 @@
+#include "client_constants.h"
+
+/* ============================
+ *  E S T A D Í S T I C A S
+ * ============================
+ *
+ * Números para saber de dónde viene un tirón: el render (tiempo de frame),
+ * el parseo (mensajes y bytes por tipo), la espera en recv() o el
+ * servidor (RTT entre un INPUT y su ack en STATE).
+ */
+
+/**
+ * Reloj monótono de alta resolución.
+ */
+double client_now_ms(void)
+{
+    static double msPerTick = 0.0;
+    LARGE_INTEGER now;
+
+    if (msPerTick == 0.0) {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        msPerTick = 1000.0 / (double)freq.QuadPart;
+    }
+
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * msPerTick;
+}
+
+/**
+ * Reinicia los contadores (conserva el overlay y el CSV abiertos).
+ */
+void stats_reset(ClientStats *stats)
+{
+    int   overlay = stats->overlay;
+    FILE *csv     = stats->csv;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->overlay       = overlay;
+    stats->csv           = csv;
+    stats->windowStartMs = client_now_ms();
+    stats->lastFrameMs   = stats->windowStartMs;
+    stats->rttP50        = -1.0;
+    stats->rttMax        = -1.0;
+}
+
+/**
+ * Cuenta un mensaje recibido.
+ */
+void stats_count(ClientStats *stats, int tag, int bytes)
+{
+    if (tag < 0 || tag >= STATS_TAG_COUNT) {
+        tag = STATS_TAG_OTHER;
+    }
+    stats->lines[tag]++;
+    stats->bytes[tag] += bytes;
+    stats->linesTotal[tag]++;
+    stats->bytesTotal[tag] += bytes;
+}
+
+/**
+ * Registra una muestra de RTT INPUT→ack.
+ */
+void stats_rtt(ClientStats *stats, double ms)
+{
+    stats->rttMs[stats->rttNext] = ms;
+    stats->rttNext = (stats->rttNext + 1) % STATS_RTT_SAMPLES;
+    if (stats->rttCount < STATS_RTT_SAMPLES) {
+        stats->rttCount++;
+    }
+    stats->rttTotal++;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Percentil p (0..1) de las primeras `count` muestras ya ordenadas.
+ */
+static double percentile(const double *sorted, int count, double p)
+{
+    if (count <= 0) {
+        return -1.0;
+    }
+    int i = (int)(p * (count - 1) + 0.5);
+    return sorted[i];
+}
+
+/**
+ * Agrega una fila al CSV con los valores del último segundo.
+ */
+static void write_csv_row(const ClientStats *stats, double nowMs)
+{
+    fprintf(stats->csv, "%.0f,%.2f,%.2f,%.2f,%.2f,%.1f,%.1f",
+            nowMs, stats->frameP50, stats->frameP95, stats->frameP99,
+            stats->blockedMsPerSec, stats->rttP50, stats->rttMax);
+    for (int t = 0; t < STATS_TAG_COUNT; t++) {
+        fprintf(stats->csv, ",%ld,%ld", stats->linesPerSec[t], stats->bytesPerSec[t]);
+    }
+    fputc('\n', stats->csv);
+    fflush(stats->csv);
+}
+
+/**
+ * Marca el fin de un frame y cierra la ventana de un segundo si toca.
+ */
+void stats_frame(ClientState *state)
+{
+    ClientStats *stats = &state->stats;
+    double now = client_now_ms();
+
+    stats->frameMs[stats->frameNext] = now - stats->lastFrameMs;
+    stats->frameNext = (stats->frameNext + 1) % STATS_FRAME_SAMPLES;
+    if (stats->frameCount < STATS_FRAME_SAMPLES) {
+        stats->frameCount++;
+    }
+    stats->lastFrameMs = now;
+
+    double elapsed = now - stats->windowStartMs;
+    if (elapsed < 1000.0) {
+        return;
+    }
+
+    /* Percentiles: se ordena una copia, una vez por segundo */
+    double sorted[STATS_FRAME_SAMPLES];
+    memcpy(sorted, stats->frameMs, sizeof(double) * stats->frameCount);
+    qsort(sorted, stats->frameCount, sizeof(double), cmp_double);
+    stats->frameP50 = percentile(sorted, stats->frameCount, 0.50);
+    stats->frameP95 = percentile(sorted, stats->frameCount, 0.95);
+    stats->frameP99 = percentile(sorted, stats->frameCount, 0.99);
+
+    memcpy(sorted, stats->rttMs, sizeof(double) * stats->rttCount);
+    qsort(sorted, stats->rttCount, sizeof(double), cmp_double);
+    stats->rttP50 = percentile(sorted, stats->rttCount, 0.50);
+    stats->rttMax = percentile(sorted, stats->rttCount, 1.0);
+
+    /* Tasas normalizadas a un segundo exacto */
+    double scale = 1000.0 / elapsed;
+    for (int t = 0; t < STATS_TAG_COUNT; t++) {
+        stats->linesPerSec[t] = (long)(stats->lines[t] * scale);
+        stats->bytesPerSec[t] = (long)(stats->bytes[t] * scale);
+        stats->lines[t] = 0;
+        stats->bytes[t] = 0;
+    }
+    stats->blockedMsPerSec = (state->reader.blockedMs - stats->blockedAtStart) * scale;
+    stats->blockedAtStart  = state->reader.blockedMs;
+    stats->windowStartMs   = now;
+
+    if (stats->csv != NULL) {
+        write_csv_row(stats, now);
+    }
+}
+
+/**
+ * Activa o desactiva el volcado CSV.
+ */
+void stats_toggle_csv(ClientStats *stats)
+{
+    if (stats->csv != NULL) {
+        fclose(stats->csv);
+        stats->csv = NULL;
+        printf("[STATS] CSV cerrado\n");
+        return;
+    }
+
+    stats->csv = fopen(STATS_CSV_PATH, "a");
+    if (stats->csv == NULL) {
+        printf("[STATS] No se pudo abrir %s\n", STATS_CSV_PATH);
+        return;
+    }
+
+    // En modo "a" se agrega al final: el encabezado va solo si el archivo
+    // está vacío, no en cada F4
+    fseek(stats->csv, 0, SEEK_END);
+    if (ftell(stats->csv) == 0) {
+        fprintf(stats->csv, "t_ms,frame_p50,frame_p95,frame_p99,recv_blocked_ms,rtt_p50,rtt_max,"
+                            "state_lines,state_bytes,fruit_lines,fruit_bytes,"
+                            "enemy_lines,enemy_bytes,map_lines,map_bytes,"
+                            "other_lines,other_bytes\n");
+    }
+    fflush(stats->csv);
+    printf("[STATS] Escribiendo %s\n", STATS_CSV_PATH);
+}
+
+/**
+ * Pide o cancela el bloque STATS del servidor según el overlay.
+ */
+void stats_sync_subscription(ClientState *state)
+{
+    ClientStats *stats = &state->stats;
+    if (stats->serverSubscribed == stats->overlay) {
+        return;
+    }
+    if (send_queue_push(&state->outbox, stats->overlay ? "STATS ON\n" : "STATS OFF\n") == 0) {
+        stats->serverSubscribed = stats->overlay;
+        if (!stats->overlay) {
+            stats->server.valid = 0;
+        }
+    }
+}
@@ -0,0 +1,493 @@
+#include "client_constants.h"
+
+/* ============================
+ *  A R E N A
+ * ============================
+ *
+ * Todo lo que depende del tamaño del mapa o de cuántas entidades hay se
+ * pide a una arena: reservar es avanzar un índice y liberar es vaciarla
+ * entera al cargar el mapa siguiente. Así no hay malloc()/free() por
+ * frame ni por lista recibida.
+ */
+
+/** Alineación de cada reserva (suficiente para double y punteros). */
+#define ARENA_ALIGN 16
+
+/** Inicio de los datos de un bloque (justo después de la cabecera). */
+static unsigned char *block_data(ArenaBlock *block)
+{
+    return (unsigned char *)(block + 1);
+}
+
+/**
+ * Pide a malloc() un bloque con al menos `capacity` bytes de datos.
+ */
+static ArenaBlock *new_block(size_t capacity)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->next     = NULL;
+    block->used     = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+/**
+ * Reserva memoria en la arena, alineada y puesta a cero.
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block = arena->head;
+
+    if (block != NULL) {
+        uintptr_t base  = (uintptr_t)block_data(block);
+        uintptr_t start = (base + block->used + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+        size_t    used  = (size_t)(start - base);
+
+        if (used + size <= block->capacity) {
+            block->used = used + size;
+            memset((void *)start, 0, size);
+            return (void *)start;
+        }
+    }
+
+    /* No cabe: bloque nuevo al frente (con margen para alinear) */
+    size_t capacity = size + ARENA_ALIGN;
+    if (capacity < ARENA_BLOCK_SIZE) {
+        capacity = ARENA_BLOCK_SIZE;
+    }
+    block = new_block(capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->next = arena->head;
+    arena->head = block;
+    return arena_alloc(arena, size);
+}
+
+/**
+ * Vacía la arena; si había varios bloques se funden en uno.
+ */
+void arena_reset(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    if (block == NULL) {
+        return;
+    }
+
+    if (block->next == NULL) {
+        block->used = 0;
+        return;
+    }
+
+    size_t total = 0;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        total += block->capacity;
+        free(block);
+        block = next;
+    }
+
+    /* Si malloc() falla aquí la arena queda vacía y se reintenta al reservar */
+    arena->head = new_block(total);
+}
+
+/**
+ * Devuelve toda la memoria de la arena.
+ */
+void arena_release(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+
+/* ============================
+ *  L I S T A S   D E L   C L I E N T E
+ * ============================ */
+
+/**
+ * Capacidad nueva para una lista que debe alojar `count` elementos:
+ * al menos el doble de la actual, para que crecer sea poco frecuente.
+ */
+static int grown_capacity(int current, int count, int minimum, int maximum)
+{
+    int capacity = current * 2;
+    if (capacity < minimum) capacity = minimum;
+    if (capacity < count)   capacity = count;
+    if (capacity > maximum) capacity = maximum;
+    return capacity;
+}
+
+/**
+ * Vacía mapa y listas junto con la arena.
+ */
+void storage_reset(ClientState *state)
+{
+    arena_reset(&state->arena);
+
+    state->map.width    = 0;
+    state->map.height   = 0;
+    state->map.capacity = 0;
+    state->map.tiles    = NULL;
+    state->map.flags    = NULL;
+
+    state->numPlayers     = 0;
+    state->playerCapacity = 0;
+    state->players        = NULL;
+
+    state->numFruits        = 0;
+    state->pendingNumFruits = 0;
+    state->fruitCapacity    = 0;
+    state->fruits           = NULL;
+    state->pendingFruits    = NULL;
+
+    state->numEnemies        = 0;
+    state->pendingNumEnemies = 0;
+    state->enemyCapacity     = 0;
+    state->enemies           = NULL;
+    state->pendingEnemies    = NULL;
+
+    state->interp.capacity = 0;
+    state->interp.enemies  = NULL;
+    state->interp.enemyX   = NULL;
+    state->interp.enemyY   = NULL;
+}
+
+/**
+ * Prepara el mapa y reserva las listas según su área.
+ */
+int storage_reserve_map(ClientState *state, int width, int height)
+{
+    GameMap *map = &state->map;
+
+    if (width <= 0 || height <= 0 ||
+        width > MAX_MAP_WIDTH || height > MAX_MAP_HEIGHT) {
+        map->width  = 0;
+        map->height = 0;
+        return -1;
+    }
+
+    int cells = width * height;
+    if (cells > map->capacity) {
+        char          *tiles = arena_alloc(&state->arena, (size_t)cells);
+        unsigned char *flags = arena_alloc(&state->arena, (size_t)cells);
+        if (tiles == NULL || flags == NULL) {
+            map->width  = 0;
+            map->height = 0;
+            return -1;
+        }
+        map->tiles    = tiles;
+        map->flags    = flags;
+        map->capacity = cells;
+    }
+
+    map->width  = width;
+    map->height = height;
+    memset(map->tiles, '.', (size_t)cells);
+    memset(map->flags, 0, (size_t)cells);
+
+    /* Listas de entidades: una sola reserva por mapa en el caso normal */
+    int entities = cells / ENTITY_TILES_PER_SLOT;
+    if (entities < ENTITY_MIN_CAPACITY) {
+        entities = ENTITY_MIN_CAPACITY;
+    }
+    if (storage_reserve_fruits(state, entities) != 0 ||
+        storage_reserve_enemies(state, entities) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Garantiza espacio para `count` frutas (lista visible y trasera).
+ */
+int storage_reserve_fruits(ClientState *state, int count)
+{
+    if (count <= state->fruitCapacity) {
+        return 0;
+    }
+    if (count > MAX_ENTITIES) {
+        return -1;
+    }
+
+    int capacity = grown_capacity(state->fruitCapacity, count,
+                                  ENTITY_MIN_CAPACITY, MAX_ENTITIES);
+    FruitInfo *fruits  = arena_alloc(&state->arena, sizeof(FruitInfo) * capacity);
+    FruitInfo *pending = arena_alloc(&state->arena, sizeof(FruitInfo) * capacity);
+    if (fruits == NULL || pending == NULL) {
+        return -1;
+    }
+
+    /* El bloque viejo queda en la arena hasta el próximo mapa */
+    if (state->fruitCapacity > 0) {
+        memcpy(fruits, state->fruits, sizeof(FruitInfo) * state->numFruits);
+        memcpy(pending, state->pendingFruits, sizeof(FruitInfo) * state->pendingNumFruits);
+    }
+    state->fruits        = fruits;
+    state->pendingFruits = pending;
+    state->fruitCapacity = capacity;
+    return 0;
+}
+
+/**
+ * Garantiza espacio para `count` enemigos (listas y pistas de interpolación).
+ */
+int storage_reserve_enemies(ClientState *state, int count)
+{
+    if (count <= state->enemyCapacity) {
+        return 0;
+    }
+    if (count > MAX_ENTITIES) {
+        return -1;
+    }
+
+    Interpolator *interp = &state->interp;
+    int capacity = grown_capacity(state->enemyCapacity, count,
+                                  ENTITY_MIN_CAPACITY, MAX_ENTITIES);
+
+    EnemyInfo   *enemies = arena_alloc(&state->arena, sizeof(EnemyInfo) * capacity);
+    EnemyInfo   *pending = arena_alloc(&state->arena, sizeof(EnemyInfo) * capacity);
+    InterpTrack *tracks  = arena_alloc(&state->arena, sizeof(InterpTrack) * capacity);
+    float       *xs      = arena_alloc(&state->arena, sizeof(float) * capacity);
+    float       *ys      = arena_alloc(&state->arena, sizeof(float) * capacity);
+    if (enemies == NULL || pending == NULL || tracks == NULL || xs == NULL || ys == NULL) {
+        return -1;
+    }
+
+    if (state->enemyCapacity > 0) {
+        memcpy(enemies, state->enemies, sizeof(EnemyInfo) * state->numEnemies);
+        memcpy(pending, state->pendingEnemies, sizeof(EnemyInfo) * state->pendingNumEnemies);
+    }
+    if (interp->capacity > 0) {
+        memcpy(tracks, interp->enemies, sizeof(InterpTrack) * interp->capacity);
+        memcpy(xs, interp->enemyX, sizeof(float) * interp->capacity);
+        memcpy(ys, interp->enemyY, sizeof(float) * interp->capacity);
+    }
+
+    state->enemies        = enemies;
+    state->pendingEnemies = pending;
+    state->enemyCapacity  = capacity;
+    interp->enemies  = tracks;
+    interp->enemyX   = xs;
+    interp->enemyY   = ys;
+    interp->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Garantiza espacio para `count` jugadores en la lista del espectador.
+ */
+int storage_reserve_players(ClientState *state, int count)
+{
+    if (count <= state->playerCapacity) {
+        return 0;
+    }
+
+    int capacity = grown_capacity(state->playerCapacity, count,
+                                  PLAYER_MIN_CAPACITY, MAX_ENTITIES);
+    PlayerInfo *players = arena_alloc(&state->arena, sizeof(PlayerInfo) * capacity);
+    if (players == NULL) {
+        return -1;
+    }
+
+    if (state->playerCapacity > 0) {
+        memcpy(players, state->players, sizeof(PlayerInfo) * state->numPlayers);
+    }
+    state->players        = players;
+    state->playerCapacity = capacity;
+    return 0;
+}
+
+
+/* ============================
+ *  C A C H É   D E   M A P A S
+ * ============================
+ *
+ * El servidor anuncia la huella de su mapa en WELCOME; si ya está aquí el
+ * cliente la menciona en JOIN/SPECTATE y el servidor responde MAP_CACHED
+ * en lugar de mandar todas las filas. Los mapas viven fuera de la arena
+ * (que se vacía con cada mapa) y en un archivo por huella:
+ *
+ *   DKMAP <ancho> <alto>
+ *   <fila y=0>
+ *   ...
+ */
+
+/** Un mapa guardado: tiles fila por fila, como GameMap.tiles. */
+typedef struct {
+    unsigned int hash;
+    int          width;
+    int          height;
+    char        *tiles;    /* NULL = hueco libre */
+    unsigned int lastUse;  /* para reemplazar el menos usado */
+} CachedMap;
+
+static CachedMap    mapCache[MAP_CACHE_SLOTS];
+static unsigned int mapCacheClock = 0;
+
+/**
+ * Mapa en memoria con esa huella, o NULL.
+ */
+static CachedMap *cache_find(unsigned int hash)
+{
+    for (int i = 0; i < MAP_CACHE_SLOTS; i++) {
+        if (mapCache[i].tiles != NULL && mapCache[i].hash == hash) {
+            mapCache[i].lastUse = ++mapCacheClock;
+            return &mapCache[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Guarda una copia de los tiles en un hueco libre o en el menos usado.
+ * Toma posesión de `tiles` (reservado con malloc()).
+ */
+static CachedMap *cache_put(unsigned int hash, int width, int height, char *tiles)
+{
+    CachedMap *victim = &mapCache[0];
+    for (int i = 0; i < MAP_CACHE_SLOTS; i++) {
+        if (mapCache[i].tiles == NULL) {
+            victim = &mapCache[i];
+            break;
+        }
+        if (mapCache[i].lastUse < victim->lastUse) {
+            victim = &mapCache[i];
+        }
+    }
+
+    free(victim->tiles);
+    victim->hash    = hash;
+    victim->width   = width;
+    victim->height  = height;
+    victim->tiles   = tiles;
+    victim->lastUse = ++mapCacheClock;
+    return victim;
+}
+
+/**
+ * Carga a memoria el archivo de esa huella. Se descarta si está truncado
+ * o si su contenido no da la misma huella (archivo viejo o editado).
+ */
+static CachedMap *cache_read_file(unsigned int hash)
+{
+    char path[64];
+    snprintf(path, sizeof(path), MAP_CACHE_FILE_FORMAT, hash);
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    int width = 0, height = 0;
+    if (fscanf(f, "DKMAP %d %d ", &width, &height) != 2 ||
+        width <= 0 || height <= 0 || width > MAX_MAP_WIDTH || height > MAX_MAP_HEIGHT) {
+        fclose(f);
+        return NULL;
+    }
+
+    size_t         cells = (size_t)width * (size_t)height;
+    char          *tiles = malloc(cells);
+    unsigned char *flags = malloc(cells);
+    char           row[MAX_MAP_WIDTH + 2];
+    int            ok    = (tiles != NULL && flags != NULL);
+
+    for (int y = 0; ok && y < height; y++) {
+        ok = fgets(row, sizeof(row), f) != NULL && (int)strcspn(row, "\r\n") == width;
+        if (ok) {
+            memcpy(tiles + (size_t)y * width, row, (size_t)width);
+        }
+    }
+    fclose(f);
+
+    if (ok) {
+        /* Misma huella que si hubiera llegado por la red */
+        GameMap check = { width, height, 0, 0, (int)cells, tiles, flags };
+        map_build_flags(&check);
+        ok = (check.hash == hash);
+    }
+    free(flags);
+
+    if (!ok) {
+        free(tiles);
+        return NULL;
+    }
+    return cache_put(hash, width, height, tiles);
+}
+
+/**
+ * Escribe el archivo del mapa; si falla (carpeta de solo lectura) el mapa
+ * sigue en memoria y la próxima ejecución lo vuelve a pedir.
+ */
+static void cache_write_file(const CachedMap *entry)
+{
+    char path[64];
+    snprintf(path, sizeof(path), MAP_CACHE_FILE_FORMAT, entry->hash);
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return;
+    }
+    fprintf(f, "DKMAP %d %d\n", entry->width, entry->height);
+    for (int y = 0; y < entry->height; y++) {
+        fwrite(entry->tiles + (size_t)y * entry->width, 1, (size_t)entry->width, f);
+        fputc('\n', f);
+    }
+    fclose(f);
+}
+
+/**
+ * Indica si el mapa está en la caché (en memoria o en disco).
+ */
+int map_cache_contains(unsigned int hash)
+{
+    if (hash == 0) {
+        return 0;
+    }
+    return cache_find(hash) != NULL || cache_read_file(hash) != NULL;
+}
+
+/**
+ * Copia a state->map el mapa guardado con esa huella.
+ */
+int map_cache_load(ClientState *state, unsigned int hash)
+{
+    CachedMap *entry = cache_find(hash);
+    if (entry == NULL) {
+        entry = cache_read_file(hash);
+    }
+    if (entry == NULL || storage_reserve_map(state, entry->width, entry->height) != 0) {
+        return -1;
+    }
+
+    memcpy(state->map.tiles, entry->tiles, (size_t)entry->width * entry->height);
+    map_build_flags(&state->map);
+    state->map.version++;
+    return 0;
+}
+
+/**
+ * Guarda un mapa recién recibido en memoria y en disco.
+ */
+void map_cache_store(const GameMap *map)
+{
+    if (map->width <= 0 || map->height <= 0 || cache_find(map->hash) != NULL) {
+        return;
+    }
+
+    size_t cells = (size_t)map->width * map->height;
+    char  *tiles = malloc(cells);
+    if (tiles == NULL) {
+        return;
+    }
+    memcpy(tiles, map->tiles, cells);
+    cache_write_file(cache_put(map->hash, map->width, map->height, tiles));
+}
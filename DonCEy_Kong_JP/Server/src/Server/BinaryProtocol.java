@@ -0,0 +1,306 @@
+package Server;
+
+import Server.entities.Enemy;
+import Server.entities.Fruit;
+
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.List;
+
+/**
+ * Codificación del protocolo binario opcional del servidor.
+ * <p>
+ * Un cliente lo solicita agregando la opción {@code +BIN} a
+ * {@code JOIN} o {@code SPECTATE}; el servidor lo confirma respondiendo
+ * {@code JOINED <id> +BIN} / {@code SPECTATE_OK <id> +BIN} en texto y, a
+ * partir de ahí, todo lo que recibe ese cliente son tramas binarias.
+ * </p>
+ *
+ * <p>Formato de cada trama (big-endian, campos de ancho fijo):</p>
+ * <pre>
+ *   u16 longitud   (bytes de tipo + carga útil)
+ *   u8  tipo       (MSG_*)
+ *   ... carga útil
+ *
+ *   MSG_TEXT    : bytes UTF-8 de una línea, sin '\n'
+ *   MSG_STATE   : u32 seq, u16 id, i16 x, i16 y, i32 score,
+ *                 u16 nivel, u16 vidas, u8 gameOver, u32 lastAckSeq
+ *   MSG_MAP     : u16 ancho, u16 alto, ancho*alto bytes (fila y=0 primero)
+ *   MSG_FRUITS  : u16 id, u32 seq, u16 n, n * (u16 eid, i16 x, i16 y, i32 puntos)
+ *   MSG_ENEMIES : u16 id, u32 seq, u16 n, n * (u16 eid, u8 tipo, i16 x, i16 y)
+ *   MSG_FRUITS_DELTA  : u16 id, u32 seq, u16 n,
+ *                       n * (u8 op, u16 eid, i16 x, i16 y, i32 puntos)
+ *   MSG_ENEMIES_DELTA : u16 id, u32 seq, u16 n,
+ *                       n * (u8 op, u16 eid, u8 tipo, i16 x, i16 y)
+ * </pre>
+ * <p>{@code seq} es el número de snapshot de la sesión y {@code eid} el id
+ * estable de la entidad; {@code op} toma los valores
+ * {@link GameSession#OP_ADD}, {@link GameSession#OP_MOVE} u
+ * {@link GameSession#OP_REMOVE}.</p>
+ * <p>Debe mantenerse sincronizado con los {@code BIN_*} de
+ * {@code client_constants.h}.</p>
+ */
+public final class BinaryProtocol {
+
+    /** Línea de texto encapsulada (END, BYE, ERR ...). */
+    public static final byte MSG_TEXT    = 1;
+    /** Estado del jugador (equivalente a STATE). */
+    public static final byte MSG_STATE   = 2;
+    /** Mapa completo (equivalente a MAP_SIZE + MAP_ROW* + MAP_END). */
+    public static final byte MSG_MAP     = 3;
+    /** Lista completa de frutas (equivalente a FRUITS_BEGIN ... FRUITS_END). */
+    public static final byte MSG_FRUITS  = 4;
+    /** Lista completa de enemigos (equivalente a ENEMIES_BEGIN ... ENEMIES_END). */
+    public static final byte MSG_ENEMIES = 5;
+    /** Cambios de frutas respecto al snapshot anterior. */
+    public static final byte MSG_FRUITS_DELTA  = 6;
+    /** Cambios de enemigos respecto al snapshot anterior. */
+    public static final byte MSG_ENEMIES_DELTA = 7;
+
+    /** Códigos de tipo de enemigo (coinciden con EnemyInfo.type del cliente). */
+    public static final byte ENEMY_GENERIC = 0;
+    public static final byte ENEMY_RED     = 1;
+    public static final byte ENEMY_BLUE    = 2;
+
+    /**
+     * Tamaño máximo de tipo + carga útil. El cliente lee las tramas en un
+     * búfer de 8 KB: las listas completas nunca lo exceden porque
+     * {@link GameSession} no admite más entidades de las que caben
+     * ({@link #MAX_KEYFRAME_FRUITS}, {@link #MAX_KEYFRAME_ENEMIES}), y un
+     * delta que no cabe se envía como lista completa.
+     */
+    public static final int MAX_FRAME = 8190;
+
+    /** Frutas que caben en una trama {@link #MSG_FRUITS} (10 bytes cada una). */
+    public static final int MAX_KEYFRAME_FRUITS  = (MAX_FRAME - 9) / 10;
+    /** Enemigos que caben en una trama {@link #MSG_ENEMIES} (7 bytes cada uno). */
+    public static final int MAX_KEYFRAME_ENEMIES = (MAX_FRAME - 9) / 7;
+    /** Operaciones que caben en una trama {@link #MSG_FRUITS_DELTA} (11 bytes cada una). */
+    public static final int MAX_FRUIT_DELTA_OPS  = (MAX_FRAME - 9) / 11;
+    /** Operaciones que caben en una trama {@link #MSG_ENEMIES_DELTA} (8 bytes cada una). */
+    public static final int MAX_ENEMY_DELTA_OPS  = (MAX_FRAME - 9) / 8;
+    /** Mayor id de entidad que viaja en los campos u16 {@code eid}. */
+    public static final int MAX_ENTITY_ID = 0xFFFF;
+
+    /** Clase de utilidad: no se instancia. */
+    private BinaryProtocol() {}
+
+    /**
+     * Reserva una trama y escribe su cabecera.
+     *
+     * @param type        tipo de mensaje (MSG_*)
+     * @param payloadSize bytes de carga útil
+     * @return búfer posicionado al inicio de la carga útil
+     */
+    private static ByteBuffer frame(byte type, int payloadSize) {
+        ByteBuffer b = ByteBuffer.allocate(3 + payloadSize);
+        b.putShort((short) (1 + payloadSize));
+        b.put(type);
+        return b;
+    }
+
+    /**
+     * Codifica una o más líneas de texto como tramas {@link #MSG_TEXT}.
+     *
+     * @param text texto a enviar; cada línea ({@code '\n'}) va en su propia trama
+     * @return bytes listos para escribir en el socket
+     */
+    public static byte[] encodeText(String text) {
+        String[] lines = text.split("\n");
+        int total = 0;
+        byte[][] encoded = new byte[lines.length][];
+        for (int i = 0; i < lines.length; i++) {
+            encoded[i] = lines[i].replace("\r", "").getBytes(StandardCharsets.UTF_8);
+            if (encoded[i].length > MAX_FRAME - 1) {
+                encoded[i] = java.util.Arrays.copyOf(encoded[i], MAX_FRAME - 1);
+            }
+            total += 3 + encoded[i].length;
+        }
+
+        ByteBuffer b = ByteBuffer.allocate(total);
+        for (byte[] line : encoded) {
+            b.putShort((short) (1 + line.length));
+            b.put(MSG_TEXT);
+            b.put(line);
+        }
+        return b.array();
+    }
+
+    /**
+     * Codifica el estado de un jugador.
+     *
+     * @param seq        número de tick
+     * @param id         identificador del jugador
+     * @param x          posición horizontal
+     * @param y          posición vertical
+     * @param score      puntaje
+     * @param round      nivel
+     * @param lives      vidas
+     * @param gameOver   si la partida terminó
+     * @param lastAckSeq último INPUT aplicado
+     * @return trama {@link #MSG_STATE}
+     */
+    public static byte[] encodeState(Integer seq, Integer id, int x, int y, int score,
+                                     int round, int lives, boolean gameOver, int lastAckSeq) {
+        ByteBuffer b = frame(MSG_STATE, 23);
+        b.putInt(seq);
+        b.putShort(id.shortValue());
+        b.putShort((short) x);
+        b.putShort((short) y);
+        b.putInt(score);
+        b.putShort((short) round);
+        b.putShort((short) lives);
+        b.put((byte) (gameOver ? 1 : 0));
+        b.putInt(lastAckSeq);
+        return b.array();
+    }
+
+    /**
+     * Codifica el mapa lógico completo.
+     *
+     * @param map    matriz de tiles indexada como {@code map[y][x]}
+     * @param width  columnas a enviar
+     * @param height filas a enviar
+     * @return trama {@link #MSG_MAP}
+     */
+    public static byte[] encodeMap(char[][] map, Integer width, Integer height) {
+        ByteBuffer b = frame(MSG_MAP, 4 + width * height);
+        b.putShort(width.shortValue());
+        b.putShort(height.shortValue());
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                b.put((byte) map[y][x]);
+            }
+        }
+        return b.array();
+    }
+
+    /**
+     * Codifica la lista completa de frutas de una sesión (keyframe).
+     *
+     * @param playerId jugador dueño de la sesión
+     * @param seq      número de snapshot de frutas
+     * @param fruits   frutas activas (a lo sumo {@link #MAX_KEYFRAME_FRUITS})
+     * @return trama {@link #MSG_FRUITS}
+     * @throws IllegalStateException si la lista no cabe en una trama
+     */
+    public static byte[] encodeFruits(Integer playerId, Integer seq, List<Fruit> fruits) {
+        int count = fruits.size();
+        if (count > MAX_KEYFRAME_FRUITS) {
+            throw new IllegalStateException("FRUITS de " + count + " no cabe en una trama");
+        }
+        ByteBuffer b = frame(MSG_FRUITS, 8 + count * 10);
+        b.putShort(playerId.shortValue());
+        b.putInt(seq);
+        b.putShort((short) count);
+        for (int i = 0; i < count; i++) {
+            Fruit f = fruits.get(i);
+            b.putShort(f.getId().shortValue());
+            b.putShort(f.getX().shortValue());
+            b.putShort(f.getY().shortValue());
+            b.putInt(f.getPoints());
+        }
+        return b.array();
+    }
+
+    /**
+     * Codifica la lista completa de enemigos de una sesión (keyframe).
+     *
+     * @param playerId jugador dueño de la sesión
+     * @param seq      número de snapshot de enemigos
+     * @param enemies  enemigos activos (a lo sumo {@link #MAX_KEYFRAME_ENEMIES})
+     * @return trama {@link #MSG_ENEMIES}
+     * @throws IllegalStateException si la lista no cabe en una trama
+     */
+    public static byte[] encodeEnemies(Integer playerId, Integer seq, List<Enemy> enemies) {
+        int count = enemies.size();
+        if (count > MAX_KEYFRAME_ENEMIES) {
+            throw new IllegalStateException("ENEMIES de " + count + " no cabe en una trama");
+        }
+        ByteBuffer b = frame(MSG_ENEMIES, 8 + count * 7);
+        b.putShort(playerId.shortValue());
+        b.putInt(seq);
+        b.putShort((short) count);
+        for (int i = 0; i < count; i++) {
+            Enemy e = enemies.get(i);
+            b.putShort(e.getId().shortValue());
+            b.put(enemyTypeCode(e.getType()));
+            b.putShort(e.getX().shortValue());
+            b.putShort(e.getY().shortValue());
+        }
+        return b.array();
+    }
+
+    /**
+     * Codifica un delta de frutas. Si las operaciones no caben en una trama
+     * se codifica en su lugar la lista completa con el mismo {@code seq}:
+     * el cliente la acepta siempre y queda en el mismo estado que con el
+     * delta, sin perder operaciones ni saltar números de snapshot.
+     *
+     * @param playerId jugador dueño de la sesión
+     * @param seq      número de snapshot que resulta de aplicar el delta
+     * @param ops      operaciones calculadas por {@link GameSession#diffFruits()}
+     * @param fruits   frutas de la sesión después de aplicar {@code ops}
+     * @return trama {@link #MSG_FRUITS_DELTA}, o {@link #MSG_FRUITS}
+     */
+    public static byte[] encodeFruitsDelta(Integer playerId, Integer seq,
+                                           List<GameSession.DeltaOp> ops, List<Fruit> fruits) {
+        if (ops.size() > MAX_FRUIT_DELTA_OPS) return encodeFruits(playerId, seq, fruits);
+        int count = ops.size();
+        ByteBuffer b = frame(MSG_FRUITS_DELTA, 8 + count * 11);
+        b.putShort(playerId.shortValue());
+        b.putInt(seq);
+        b.putShort((short) count);
+        for (int i = 0; i < count; i++) {
+            GameSession.DeltaOp op = ops.get(i);
+            b.put(op.op.byteValue());
+            b.putShort(op.id.shortValue());
+            b.putShort(op.x.shortValue());
+            b.putShort(op.y.shortValue());
+            b.putInt(op.points);
+        }
+        return b.array();
+    }
+
+    /**
+     * Codifica un delta de enemigos; como
+     * {@link #encodeFruitsDelta(Integer, Integer, List, List)}, si no cabe
+     * va la lista completa con el mismo {@code seq}.
+     *
+     * @param playerId jugador dueño de la sesión
+     * @param seq      número de snapshot que resulta de aplicar el delta
+     * @param ops      operaciones calculadas por {@link GameSession#diffEnemies()}
+     * @param enemies  enemigos de la sesión después de aplicar {@code ops}
+     * @return trama {@link #MSG_ENEMIES_DELTA}, o {@link #MSG_ENEMIES}
+     */
+    public static byte[] encodeEnemiesDelta(Integer playerId, Integer seq,
+                                            List<GameSession.DeltaOp> ops, List<Enemy> enemies) {
+        if (ops.size() > MAX_ENEMY_DELTA_OPS) return encodeEnemies(playerId, seq, enemies);
+        int count = ops.size();
+        ByteBuffer b = frame(MSG_ENEMIES_DELTA, 8 + count * 8);
+        b.putShort(playerId.shortValue());
+        b.putInt(seq);
+        b.putShort((short) count);
+        for (int i = 0; i < count; i++) {
+            GameSession.DeltaOp op = ops.get(i);
+            b.put(op.op.byteValue());
+            b.putShort(op.id.shortValue());
+            b.put(enemyTypeCode(op.type));
+            b.putShort(op.x.shortValue());
+            b.putShort(op.y.shortValue());
+        }
+        return b.array();
+    }
+
+    /**
+     * Traduce el tipo textual de un enemigo a su código binario.
+     *
+     * @param type {@code "RED"}, {@code "BLUE"} u otro
+     * @return código ENEMY_*
+     */
+    public static byte enemyTypeCode(String type) {
+        if ("RED".equalsIgnoreCase(type))  return ENEMY_RED;
+        if ("BLUE".equalsIgnoreCase(type)) return ENEMY_BLUE;
+        return ENEMY_GENERIC;
+    }
+}
@@ -0,0 +1,83 @@
+package Server;
+
+import java.nio.charset.StandardCharsets;
+import java.util.function.Supplier;
+
+/**
+ * Un mensaje que se envía a varios clientes, codificado una sola vez.
+ * <p>
+ * Guarda cómo construir el mensaje en texto y en {@link BinaryProtocol};
+ * cada formato se arma y se codifica la primera vez que algún destinatario
+ * lo pide y los demás reciben el mismo {@code byte[]} por referencia en su
+ * cola de salida. Con 10 espectadores de texto un STATE se formatea y se
+ * pasa a UTF-8 una vez, no once.
+ * </p>
+ * <p>
+ * Los constructores se evalúan de inmediato en el hilo que encola (dentro
+ * del {@code synchronized (session)} del llamador), así que pueden leer el
+ * estado de la sesión sin copiarlo. Los keyframes que guarda
+ * {@link GameSession} pueden codificarse más tarde, al llegar el primer
+ * espectador de ese formato: siempre con el monitor de la sesión y antes de
+ * que la sesión cambie, porque cualquier cambio los reemplaza. Los bytes
+ * devueltos no se modifican.
+ * </p>
+ */
+public final class Broadcast {
+
+    /** Construye la versión en texto (con {@code '\n'}), o {@code null}. */
+    private final Supplier<String> text;
+    /** Construye la trama binaria, o {@code null}. */
+    private final Supplier<byte[]> frame;
+
+    /** Texto ya codificado en UTF-8. */
+    private byte[] textBytes;
+    /** Trama ya codificada. */
+    private byte[] frameBytes;
+
+    /**
+     * @param text  constructor de la versión en texto
+     * @param frame constructor de la trama binaria
+     */
+    public Broadcast(Supplier<String> text, Supplier<byte[]> frame) {
+        this.text = text;
+        this.frame = frame;
+    }
+
+    /**
+     * Mensaje cuyas dos versiones ya están armadas.
+     *
+     * @param text  versión en texto (con {@code '\n'}), o {@code null} si
+     *              solo se envía a clientes binarios
+     * @param frame trama binaria equivalente
+     * @return el mensaje
+     */
+    public static Broadcast of(String text, byte[] frame) {
+        return new Broadcast(() -> text, () -> frame);
+    }
+
+    /**
+     * Línea (o líneas) de control: en binario viaja como
+     * {@link BinaryProtocol#MSG_TEXT}.
+     *
+     * @param text líneas con {@code '\n'}
+     * @return el mensaje
+     */
+    public static Broadcast ofText(String text) {
+        return new Broadcast(() -> text, () -> BinaryProtocol.encodeText(text));
+    }
+
+    /**
+     * Bytes del mensaje en el formato de un cliente.
+     *
+     * @param binary {@code true} si el cliente negoció {@code +BIN}
+     * @return bytes compartidos; no deben modificarse
+     */
+    public synchronized byte[] bytes(Boolean binary) {
+        if (binary) {
+            if (frameBytes == null) frameBytes = frame.get();
+            return frameBytes;
+        }
+        if (textBytes == null) textBytes = text.get().getBytes(StandardCharsets.UTF_8);
+        return textBytes;
+    }
+}
@@ -3,6 +3,12 @@ package Server;
 import java.io.*;
 import java.net.Socket;
 import java.nio.charset.StandardCharsets;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Locale;
+import java.util.concurrent.atomic.AtomicBoolean;
+import java.util.concurrent.atomic.AtomicLong;
 
 /**
  * Maneja la comunicación de un único cliente conectado al servidor.
@@ -11,6 +17,13 @@ import java.nio.charset.StandardCharsets;
  * se encarga de leer comandos de texto enviados por el cliente, interpretarlos
  * y delegar la lógica correspondiente al {@link Server}.
  * </p>
+ * <p>
+ * Lo que se le envía no se escribe en el socket desde el hilo que llama:
+ * {@link #sendLine(String)}, {@link #send(Broadcast)} y
+ * {@link #sendState(Broadcast)} solo encolan, y un segundo hilo
+ * ({@link #drainOutbound()}) escribe. Así el tick nunca espera a un
+ * cliente lento.
+ * </p>
  */
 public class ClientHandler implements Runnable {
     /** Socket TCP asociado a este cliente. */
@@ -19,8 +32,80 @@ public class ClientHandler implements Runnable {
     private final Server server;
     /** Lector de texto desde el socket del cliente. */
     private BufferedReader in;
-    /** Escritor de texto hacia el socket del cliente. */
-    private BufferedWriter out;
+    /** Flujo de salida con búfer hacia el socket del cliente. */
+    private BufferedOutputStream out;
+    /** El cliente pidió el protocolo binario ({@code +BIN}) en JOIN/SPECTATE. */
+    private volatile Boolean binaryRequested = false;
+    /** Si es {@code true}, todo lo que se envía a este cliente son tramas binarias. */
+    private volatile Boolean binary = false;
+    /** El cliente pidió deltas de enemigos/frutas ({@code +DELTA}) en vez de listas completas. */
+    private volatile Boolean delta = false;
+    /** Huella del mapa que el cliente ya tiene guardado ({@code +MAPCACHE=<hex>}), o {@code null}. */
+    private volatile String cachedMapHash = null;
+    /** El cliente necesita un keyframe (listas completas) en el próximo tick. */
+    private final AtomicBoolean keyframeRequested = new AtomicBoolean(false);
+    /** El cliente se suscribió a las estadísticas del servidor ({@code STATS ON}). */
+    private volatile Boolean statsSubscribed = false;
+    /**
+     * STATE por segundo que acepta el cliente ({@code +RATE=<n>}), o 0 si no
+     * lo pidió: entonces recibe uno por tick, cambie o no, como antes.
+     */
+    private volatile Integer stateRate = 0;
+
+    /* ===== Ritmo de STATE con +RATE (protegido por el monitor) ===== */
+    /** Primer tick en que puede salir el próximo STATE. */
+    private int nextStateTick = 0;
+    /** Cambio que llegó antes de tiempo y espera su turno, o {@code null}. */
+    private Broadcast heldState = null;
+
+    /* ===== Cola de salida ===== */
+    /** Bytes encolados a partir de los cuales se descartan los mensajes de juego. */
+    private static final Integer MAX_QUEUED_BYTES = 256 * 1024;
+    /** Cuánto espera {@link #close()} a que el escritor vacíe la cola (ms). */
+    private static final Integer CLOSE_DRAIN_MS = 200;
+
+    /** Un mensaje ya codificado en la cola de salida. */
+    private static final class Outgoing {
+        /** Bytes a escribir; un STATE más nuevo puede reemplazarlos. */
+        byte[] bytes;
+
+        Outgoing(byte[] bytes) { this.bytes = bytes; }
+    }
+
+    /**
+     * Mensajes pendientes de escribir, en orden. Se protege con el monitor
+     * de este objeto; el escritor ({@link #drainOutbound()}) espera en él.
+     */
+    private final ArrayDeque<Outgoing> outbound = new ArrayDeque<>();
+    /** Bytes en {@link #outbound}. */
+    private Integer queuedBytes = 0;
+    /**
+     * STATE encolado que todavía no salió. Un STATE nuevo reemplaza su
+     * contenido en la misma posición de la cola en lugar de agregarse.
+     */
+    private Outgoing queuedState = null;
+    /** Se pidió cerrar: el escritor vacía lo pendiente y termina. */
+    private Boolean closing = false;
+    /** El hilo escritor sigue vivo. */
+    private Boolean writerAlive = false;
+    /** El escritor tiene un lote tomado de la cola que todavía no terminó de escribir. */
+    private Boolean writing = false;
+
+    /* ===== Telemetría de envío (ventana de un segundo, bajo el monitor) ===== */
+    /** Mayor tamaño de {@link #outbound} en la ventana. */
+    private Integer queueDepthMax = 0;
+    /** STATE reemplazados por uno más nuevo antes de salir. */
+    private Integer coalescedStates = 0;
+    /** Mensajes de juego descartados por cola llena. */
+    private Integer droppedMessages = 0;
+    /** Lotes escritos (un flush por lote). */
+    private final AtomicLong sendCount = new AtomicLong(0);
+    /** Tiempo total de write+flush del escritor en la ventana (ns). */
+    private final AtomicLong sendNanos = new AtomicLong(0);
+    /** Lote más lento de la ventana (ns): cuánto tarda el socket en aceptar datos. */
+    private final AtomicLong sendNanosMax = new AtomicLong(0);
+    /** Bytes escritos en la ventana. */
+    private final AtomicLong sendBytes = new AtomicLong(0);
 
     /**
      * Crea un nuevo manejador de cliente a partir de un socket aceptado.
@@ -33,7 +118,7 @@ public class ClientHandler implements Runnable {
         this.server = server;
         try {
             this.in = new BufferedReader(new InputStreamReader(socket.getInputStream(), StandardCharsets.UTF_8));
-            this.out = new BufferedWriter(new OutputStreamWriter(socket.getOutputStream(), StandardCharsets.UTF_8));
+            this.out = new BufferedOutputStream(socket.getOutputStream());
         } catch (IOException e) {
             throw new RuntimeException(e);
         }
@@ -47,14 +132,22 @@ public class ClientHandler implements Runnable {
      * distintos métodos del servidor:
      * </p>
      * <ul>
-     *     <li>{@code JOIN &lt;nombre&gt;}
+     *     <li>{@code JOIN &lt;nombre&gt; [+BIN]}
      *         → {@link Server#onJoin(ClientHandler, String)}</li>
      *     <li>{@code INPUT &lt;seq&gt; &lt;dx&gt; &lt;dy&gt;}
-     *         → {@link Server#onInput(ClientHandler, Integer, Integer, Integer)}</li>
-     *     <li>{@code SPECTATE &lt;idJugador&gt;}
+     *         → {@link Server#onInput(ClientHandler, int, int, int)}</li>
+     *     <li>{@code SPECTATE &lt;idJugador&gt; [+BIN]}
      *         → {@link Server#onSpectate(ClientHandler, Integer)}</li>
+     *     <li>{@code REJOIN &lt;token&gt; [+BIN]}
+     *         → {@link Server#onRejoin(ClientHandler, String)}</li>
+     *     <li>{@code LEAVE} → deja de jugar o espectar sin cerrar la conexión
+     *         ({@link Server#onLeave(ClientHandler)})</li>
      *     <li>{@code LIST_PLAYERS}
      *         → {@link Server#onListPlayers(ClientHandler)}</li>
+     *     <li>{@code RESYNC} → pide listas completas de frutas y enemigos
+     *         (el cliente detectó un hueco en la secuencia de deltas)</li>
+     *     <li>{@code STATS ON|OFF} → activa o desactiva el envío de
+     *         {@code STATS}/{@code STATS_CLIENT} una vez por segundo</li>
      *     <li>{@code PING} → responde con {@code PONG}</li>
      *     <li>{@code QUIT} → responde con {@code BYE} y cierra la conexión</li>
      * </ul>
@@ -64,23 +157,28 @@ public class ClientHandler implements Runnable {
     @Override
     public void run() {
         try {
-            sendLine("WELCOME\n");
+            // La huella del mapa va en el saludo para que el cliente pueda
+            // decir en JOIN/SPECTATE si ya lo tiene
+            sendLine("WELCOME MAP_HASH " + Server.mapHash() + "\n");
 
             String line;
             //socket.setSoTimeout(20000); // 20 s de inactividad máx. 
             while ((line = in.readLine()) != null) {
-                System.out.println("[JAVA] <- " + line);
+                // INPUT llega una vez por tecla por jugador: solo se cuenta
+                // (y se muestrea), el resto de las líneas se registran
+                if (line.startsWith("INPUT ")) Log.input(line);
+                else Log.info("JAVA", "<- " + line);
 
                 if (line.startsWith("JOIN ")) {
-                    server.onJoin(this, line.substring(5).trim());
+                    server.onJoin(this, applyOptions(line.substring(5)));
 
                 } else if (line.startsWith("INPUT ")) {
                     // INPUT <seq> <dx> <dy>
                     String[] t = line.split("\\s+");
                     if (t.length >= 4) {
-                        Integer seq = Integer.parseInt(t[1]);
-                        Integer dx  = Integer.parseInt(t[2]);
-                        Integer dy  = Integer.parseInt(t[3]);
+                        int seq = Integer.parseInt(t[1]);
+                        int dx  = Integer.parseInt(t[2]);
+                        int dy  = Integer.parseInt(t[3]);
                         server.onInput(this, seq, dx, dy);
                     } else {
                         sendLine("ERR BAD_INPUT\n");
@@ -88,16 +186,31 @@ public class ClientHandler implements Runnable {
 
                 } else if (line.startsWith("SPECTATE ")) {
                     try {
-                        Integer pid = Integer.parseInt(line.substring(9).trim());
+                        Integer pid = Integer.parseInt(applyOptions(line.substring(9)));
                         server.onSpectate(this, pid);
                     } catch (NumberFormatException e) {
                         sendLine("ERR BAD_SPECTATE\n");
                     }
 
+                } else if (line.startsWith("REJOIN ")) {
+                    server.onRejoin(this, applyOptions(line.substring(7)));
+
+                } else if (line.equalsIgnoreCase("LEAVE")) {
+                    server.onLeave(this);
+
                 } else if (line.equalsIgnoreCase("LIST_PLAYERS")) {
                     // Nuevo comando: el cliente solicita la lista de jugadores activos
                     server.onListPlayers(this);
 
+                } else if (line.equalsIgnoreCase("RESYNC")) {
+                    requestKeyframe();
+
+                } else if (line.equalsIgnoreCase("STATS ON")) {
+                    statsSubscribed = true;
+
+                } else if (line.equalsIgnoreCase("STATS OFF")) {
+                    statsSubscribed = false;
+
                 } else if (line.equalsIgnoreCase("PING")) {
                     sendLine("PONG\n");
 
@@ -111,7 +224,7 @@ public class ClientHandler implements Runnable {
             }
 
         } catch (IOException e) {
-            System.out.println("[JAVA] Cliente desconectado: " + e.getMessage());
+            Log.info("JAVA", "Cliente desconectado: " + e.getMessage());
         } finally {
             close();
             server.removeClient(this);
@@ -119,16 +232,366 @@ public class ClientHandler implements Runnable {
     }
 
     /**
-     * Envía de forma thread-safe una línea de texto al cliente.
+     * Separa las opciones {@code +XXX} de los argumentos de JOIN/SPECTATE.
+     * <p>
+     * Opciones reconocidas: {@code +BIN} (protocolo binario), {@code +DELTA}
+     * (deltas de enemigos/frutas), {@code +MAPCACHE=<hex>} (el cliente ya
+     * tiene guardado el mapa con esa huella) y {@code +RATE=<n>} (STATE solo
+     * cuando cambia, como mucho {@code n} por segundo). Las opciones
+     * desconocidas o mal formadas se ignoran para que clientes más nuevos
+     * sigan funcionando.
+     * </p>
+     *
+     * @param args argumentos del comando tal como llegaron
+     * @return los argumentos sin las opciones, separados por un espacio
+     */
+    private String applyOptions(String args) {
+        StringBuilder rest = new StringBuilder();
+        for (String tok : args.trim().split("\\s+")) {
+            if (tok.equalsIgnoreCase("+BIN")) {
+                binaryRequested = true;
+            } else if (tok.equalsIgnoreCase("+DELTA")) {
+                delta = true;
+            } else if (tok.regionMatches(true, 0, "+MAPCACHE=", 0, 10)) {
+                cachedMapHash = tok.substring(10).toLowerCase(Locale.ROOT);
+            } else if (tok.regionMatches(true, 0, "+RATE=", 0, 6)) {
+                try {
+                    Integer rate = Integer.parseInt(tok.substring(6));
+                    stateRate = Math.max(1, Math.min(rate, Server.TICKS_PER_SECOND));
+                } catch (NumberFormatException ignored) {}
+            } else if (!tok.startsWith("+") && !tok.isEmpty()) {
+                if (rest.length() > 0) rest.append(' ');
+                rest.append(tok);
+            }
+        }
+        return rest.toString();
+    }
+
+    /**
+     * Sufijo que confirma en {@code JOINED}/{@code SPECTATE_OK} el protocolo
+     * que usará este cliente.
+     *
+     * @return {@code " +BIN"} si se pidió el protocolo binario, o cadena vacía
+     */
+    public String protocolSuffix() {
+        return binaryRequested ? " +BIN" : "";
+    }
+
+    /**
+     * Activa el protocolo negociado. Debe llamarse justo después de enviar
+     * la confirmación de JOIN/SPECTATE: desde aquí todo sale en ese formato.
+     */
+    public synchronized void activateNegotiatedProtocol() {
+        binary = binaryRequested;
+    }
+
+    /**
+     * Cierra el rol actual (después de {@code LEAVE}): confirma con
+     * {@code LEFT} en el formato que el cliente todavía espera y vuelve a
+     * texto sin opciones, como una conexión recién abierta. El próximo
+     * JOIN/REJOIN/SPECTATE negocia de nuevo.
+     */
+    public synchronized void leaveSession() {
+        sendLine("LEFT\n");
+        // Lo que se encole desde aquí va detrás de LEFT: un STATE tardío no
+        // debe reemplazar al que ya está en la cola en el formato anterior
+        queuedState = null;
+        binary = false;
+        binaryRequested = false;
+        delta = false;
+        cachedMapHash = null;
+        stateRate = 0;
+        nextStateTick = 0;
+        heldState = null;
+        keyframeRequested.set(false);
+    }
+
+    /**
+     * Indica si este cliente recibe tramas binarias.
+     *
+     * @return {@code true} si el protocolo binario está activo
+     */
+    public Boolean isBinary() {
+        return binary;
+    }
+
+    /**
+     * Indica si el cliente ya tiene guardado el mapa con esa huella, de
+     * modo que basta con confirmarlo en lugar de enviar las filas.
+     *
+     * @param hash huella del mapa actual ({@link Server#mapHash()})
+     * @return {@code true} si la anunció con {@code +MAPCACHE}
+     */
+    public Boolean hasCachedMap(String hash) {
+        return hash.equals(cachedMapHash);
+    }
+
+    /**
+     * Indica si este cliente recibe deltas de enemigos y frutas.
+     *
+     * @return {@code true} si pidió {@code +DELTA}
+     */
+    public Boolean wantsDelta() {
+        return delta;
+    }
+
+    /**
+     * Marca que este cliente debe recibir listas completas en el próximo tick.
+     */
+    public void requestKeyframe() {
+        keyframeRequested.set(true);
+    }
+
+    /**
+     * Consume la marca de keyframe pendiente.
+     *
+     * @return {@code true} si había un keyframe pendiente (y se limpió)
+     */
+    public Boolean takeKeyframeRequest() {
+        return keyframeRequested.getAndSet(false);
+    }
+
+    /**
+     * Indica si este cliente pidió las estadísticas del servidor.
+     *
+     * @return {@code true} después de {@code STATS ON}
+     */
+    public Boolean wantsStats() {
+        return statsSubscribed;
+    }
+
+    /**
+     * Reinicia la telemetría de envío sin resumirla, como
+     * {@link #takeSendStatsLine(Integer)} cuando nadie pidió STATS.
+     */
+    public void resetSendStats() {
+        synchronized (this) {
+            queueDepthMax = outbound.size();
+            coalescedStates = 0;
+            droppedMessages = 0;
+        }
+        sendCount.set(0);
+        sendNanos.set(0);
+        sendNanosMax.set(0);
+        sendBytes.set(0);
+    }
+
+    /**
+     * Resume y reinicia la telemetría de envío de este cliente
+     * (tiempos en microsegundos):
+     * <pre>
+     * STATS_CLIENT &lt;id&gt; &lt;cola&gt; &lt;colaMax&gt; &lt;lotes&gt;
+     *              &lt;loteProm&gt; &lt;loteMax&gt; &lt;bytes&gt;
+     *              &lt;statesFusionados&gt; &lt;descartados&gt;
+     * </pre>
+     * Un {@code loteMax} alto o una cola que crece indican que el socket de
+     * este cliente no acepta datos; desde que hay cola de salida eso ya no
+     * frena al tick, solo a este cliente.
+     *
+     * @param id jugador observado por este cliente (0 si todavía no tiene)
+     * @return la línea con {@code '\n'}
+     */
+    public String takeSendStatsLine(Integer id) {
+        Integer depth, depthMax, coalesced, dropped;
+        synchronized (this) {
+            depth = outbound.size();
+            depthMax = queueDepthMax;
+            coalesced = coalescedStates;
+            dropped = droppedMessages;
+            queueDepthMax = depth;
+            coalescedStates = 0;
+            droppedMessages = 0;
+        }
+        long count = sendCount.getAndSet(0);
+        long nanos = sendNanos.getAndSet(0);
+        long max   = sendNanosMax.getAndSet(0);
+        long bytes = sendBytes.getAndSet(0);
+        return String.format(Locale.ROOT, "STATS_CLIENT %d %d %d %d %d %d %d %d %d\n",
+                id, depth, depthMax, count,
+                count > 0 ? nanos / count / 1000L : 0L, max / 1000L, bytes,
+                coalesced, dropped);
+    }
+
+    /**
+     * Encola de forma thread-safe una línea de texto para el cliente.
+     * <p>
+     * Si el cliente usa el protocolo binario, cada línea se encapsula en
+     * una trama {@link BinaryProtocol#MSG_TEXT}. Las líneas de control
+     * nunca se descartan.
+     * </p>
      *
      * @param s cadena a enviar; debe incluir el carácter de nueva línea
      *          {@code '\\n'} si se requiere terminar la línea.
      */
-    public synchronized void sendLine(String s) {
+    public void sendLine(String s) {
+        synchronized (this) {
+            enqueue(binary ? BinaryProtocol.encodeText(s) : s.getBytes(StandardCharsets.UTF_8));
+        }
+    }
+
+    /**
+     * Encola un mensaje de control compartido (por ejemplo el bloque STATS
+     * o el mapa), que nunca se descarta.
+     *
+     * @param msg mensaje codificado una sola vez para todos los destinatarios
+     */
+    public void sendReliable(Broadcast msg) {
+        synchronized (this) {
+            enqueue(msg.bytes(binary));
+        }
+    }
+
+    /**
+     * Encola un mensaje de juego en el formato negociado por este cliente.
+     * <p>
+     * Si la cola ya supera {@link #MAX_QUEUED_BYTES} el mensaje se descarta
+     * y se pide un keyframe: cuando el cliente se ponga al día recibe listas
+     * completas en lugar de los deltas que se perdió.
+     * </p>
+     *
+     * @param msg mensaje codificado una sola vez para todos los destinatarios
+     */
+    public void send(Broadcast msg) {
+        synchronized (this) {
+            if (queuedBytes >= MAX_QUEUED_BYTES) {
+                droppedMessages++;
+                requestKeyframe();
+                return;
+            }
+            enqueue(msg.bytes(binary));
+        }
+    }
+
+    /**
+     * Encola un STATE. Como cada STATE es una foto completa, si el anterior
+     * todavía no salió se reemplaza por este: un cliente lento recibe
+     * siempre el último estado, nunca una fila de estados viejos.
+     *
+     * @param msg línea {@code STATE} / trama {@link BinaryProtocol#MSG_STATE}
+     */
+    public void sendState(Broadcast msg) {
+        synchronized (this) {
+            byte[] bytes = msg.bytes(binary);
+            if (queuedState != null) {
+                queuedBytes += bytes.length - queuedState.bytes.length;
+                queuedState.bytes = bytes;
+                coalescedStates++;
+                return;
+            }
+            queuedState = enqueue(bytes);
+        }
+    }
+
+    /**
+     * Ofrece el STATE de un tick según lo que negoció el cliente. Sin
+     * {@code +RATE} se encola siempre (uno por tick). Con {@code +RATE} una
+     * sesión quieta no le manda nada: solo sale un STATE que cambió, y como
+     * mucho uno cada {@code TICKS_PER_SECOND / n} ticks. Un cambio que llega
+     * antes de tiempo queda retenido (siempre el más reciente) y sale en el
+     * primer tick permitido aunque la sesión ya no cambie.
+     *
+     * @param state   STATE de la sesión en este tick
+     * @param changed si difiere del último que se difundió
+     * @param tick    número de tick en curso
+     */
+    public synchronized void offerState(Broadcast state, boolean changed, int tick) {
+        Integer rate = stateRate;
+        if (rate == 0) {
+            sendState(state);
+            return;
+        }
+        if (changed) heldState = state;
+        if (heldState != null && tick >= nextStateTick) {
+            sendState(heldState);
+            heldState = null;
+            nextStateTick = tick + (Server.TICKS_PER_SECOND + rate - 1) / rate;
+        }
+    }
+
+    /**
+     * Olvida el STATE retenido por {@code +RATE}: lo que viene es la foto de
+     * otra sesión (o de la misma desde cero) y su STATE sale de inmediato.
+     */
+    public synchronized void restartStatePacing() {
+        heldState = null;
+        nextStateTick = 0;
+    }
+
+    /**
+     * Agrega bytes ya codificados al final de la cola y despierta al
+     * escritor. Debe llamarse con el monitor tomado.
+     *
+     * @param bytes mensaje completo
+     * @return la entrada encolada, o {@code null} si la conexión se está cerrando
+     */
+    private Outgoing enqueue(byte[] bytes) {
+        if (closing) return null;
+        Outgoing msg = new Outgoing(bytes);
+        outbound.addLast(msg);
+        queuedBytes += bytes.length;
+        if (outbound.size() > queueDepthMax) queueDepthMax = outbound.size();
+        notifyAll();
+        return msg;
+    }
+
+    /**
+     * Bucle del hilo escritor: toma todo lo encolado, lo escribe y hace un
+     * solo flush por lote. Es el único hilo que toca {@link #out}, así que
+     * un socket lento solo demora a este cliente.
+     * <p>Termina al cerrar la conexión (tras vaciar lo pendiente) o ante un
+     * error de escritura, que también cierra el socket para que el lector
+     * lo detecte.</p>
+     */
+    public void drainOutbound() {
+        List<Outgoing> batch = new ArrayList<>();
+        synchronized (this) { writerAlive = true; }
         try {
-            out.write(s);
-            out.flush();
-        } catch (IOException ignored) {}
+            while (true) {
+                synchronized (this) {
+                    while (outbound.isEmpty() && !closing) {
+                        wait();
+                    }
+                    if (outbound.isEmpty()) break;
+                    batch.addAll(outbound);
+                    outbound.clear();
+                    queuedBytes = 0;
+                    queuedState = null;
+                    writing = true;
+                }
+
+                long t0 = System.nanoTime();
+                Integer length = 0;
+                for (Outgoing msg : batch) {
+                    out.write(msg.bytes);
+                    length += msg.bytes.length;
+                }
+                out.flush();
+                batch.clear();
+
+                long took = System.nanoTime() - t0;
+                sendCount.incrementAndGet();
+                sendNanos.addAndGet(took);
+                sendNanosMax.accumulateAndGet(took, Math::max);
+                sendBytes.addAndGet(length);
+                synchronized (this) {
+                    writing = false;
+                    notifyAll(); // close() espera que la cola se vacíe
+                }
+            }
+        } catch (IOException e) {
+            try { socket.close(); } catch (IOException ignored) {}
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        } finally {
+            synchronized (this) {
+                writerAlive = false;
+                writing = false;
+                outbound.clear();
+                queuedBytes = 0;
+                queuedState = null;
+                notifyAll();
+            }
+        }
     }
 
     /**
@@ -140,6 +603,22 @@ public class ClientHandler implements Runnable {
      * </p>
      */
     public void close() {
+        // Dar al escritor un momento para sacar lo pendiente (p.ej. BYE)
+        synchronized (this) {
+            closing = true;
+            notifyAll();
+            long deadline = System.currentTimeMillis() + CLOSE_DRAIN_MS;
+            while (writerAlive && (writing || !outbound.isEmpty())) {
+                long left = deadline - System.currentTimeMillis();
+                if (left <= 0) break;
+                try {
+                    wait(left);
+                } catch (InterruptedException e) {
+                    Thread.currentThread().interrupt();
+                    break;
+                }
+            }
+        }
         try { if (in != null) in.close(); } catch (IOException ignored) {}
         try { if (out != null) out.close(); } catch (IOException ignored) {}
         try { if (socket != null && !socket.isClosed()) socket.close(); } catch (IOException ignored) {}
@@ -0,0 +1,232 @@
+package Server;
+
+import java.util.Arrays;
+import java.util.BitSet;
+
+/**
+ * Enemigos o frutas de una sesión en estructura de arreglos, más una grilla
+ * de ocupación por tile.
+ * <p>
+ * Cada fila {@code i} corresponde al elemento {@code i} de la lista de
+ * objetos de {@link GameSession} (mismo orden, mismas altas y bajas): los
+ * objetos siguen teniendo el comportamiento ({@code tick()}) y lo que se
+ * codifica en los keyframes, y aquí quedan copiados id, posición y puntos en
+ * {@code int[]} para que el tick y los deltas recorran primitivos. La grilla
+ * cuenta cuántas entidades hay en cada tile del mapa, así que "¿hay algo en
+ * la casilla del jugador?" es una lectura, sin importar cuántas haya.
+ * </p>
+ * <p>
+ * También lleva lo último enviado a los clientes (posición y si ya se
+ * envió) y los ids ya enviados que se dieron de baja, que es lo que
+ * necesitan {@link GameSession#diffEnemies()} y
+ * {@link GameSession#diffFruits()}. Se usa con el monitor de la sesión.
+ * </p>
+ * <p>
+ * Libera los ids en el conjunto de ocupados de la sesión cuando ya no los
+ * tiene ningún cliente: al quitar una fila que nunca se envió, o cuando el
+ * REMOVE de una enviada ya salió en un delta ({@link #clearRemoved()}).
+ * </p>
+ */
+final class EntityTable {
+
+    /** Capacidad inicial en filas. */
+    private static final int INITIAL_CAPACITY = 16;
+
+    /** Límites del área de juego del servidor, sin desempaquetar en cada consulta. */
+    private static final int MIN_X = Server.MIN_X, MAX_X = Server.MAX_X;
+    private static final int MIN_Y = Server.MIN_Y, MAX_Y = Server.MAX_Y;
+    /** Ancho y alto de la grilla. */
+    private static final int GRID_W = MAX_X - MIN_X + 1;
+    private static final int GRID_H = MAX_Y - MIN_Y + 1;
+
+    private int[]     ids    = new int[INITIAL_CAPACITY];
+    private int[]     xs     = new int[INITIAL_CAPACITY];
+    private int[]     ys     = new int[INITIAL_CAPACITY];
+    private int[]     points = new int[INITIAL_CAPACITY];
+    /** Posición incluida en el último delta. */
+    private int[]     sentX  = new int[INITIAL_CAPACITY];
+    private int[]     sentY  = new int[INITIAL_CAPACITY];
+    /** La fila ya se anunció con un ADD. */
+    private boolean[] sent   = new boolean[INITIAL_CAPACITY];
+    private int       count  = 0;
+
+    /** Entidades por tile ({@code y * GRID_W + x}). */
+    private final int[] grid = new int[GRID_W * GRID_H];
+
+    /** Ids ya enviados que se dieron de baja desde el último delta. */
+    private int[] removedIds = new int[INITIAL_CAPACITY];
+    private int   removedCount = 0;
+
+    /** Ids ocupados de la sesión (compartido entre enemigos y frutas). */
+    private final BitSet idsInUse;
+
+    /**
+     * @param idsInUse ids ocupados de la sesión; la sesión los marca al
+     *                 asignarlos y la tabla los libera
+     */
+    EntityTable(BitSet idsInUse) {
+        this.idsInUse = idsInUse;
+    }
+
+    /**
+     * Índice de un tile en la grilla.
+     *
+     * @return índice, o -1 si la posición está fuera del área de juego
+     */
+    private static int tile(int x, int y) {
+        if (x < MIN_X || x > MAX_X || y < MIN_Y || y > MAX_Y) return -1;
+        return (y - MIN_Y) * GRID_W + (x - MIN_X);
+    }
+
+    /** @return cantidad de filas */
+    int size() { return count; }
+
+    /** @return id de la fila {@code i} */
+    int id(int i) { return ids[i]; }
+
+    /** @return X de la fila {@code i} */
+    int x(int i) { return xs[i]; }
+
+    /** @return Y de la fila {@code i} */
+    int y(int i) { return ys[i]; }
+
+    /** @return puntos de la fila {@code i} (0 para enemigos) */
+    int points(int i) { return points[i]; }
+
+    /**
+     * Cuántas entidades hay en un tile.
+     *
+     * @return cantidad, o 0 fuera del área de juego
+     */
+    int countAt(int x, int y) {
+        int t = tile(x, y);
+        return t < 0 ? 0 : grid[t];
+    }
+
+    /**
+     * Agrega una fila al final (la entidad se agregó al final de la lista).
+     */
+    void add(int id, int x, int y, int pts) {
+        if (count == ids.length) {
+            int n = count * 2;
+            ids    = Arrays.copyOf(ids, n);
+            xs     = Arrays.copyOf(xs, n);
+            ys     = Arrays.copyOf(ys, n);
+            points = Arrays.copyOf(points, n);
+            sentX  = Arrays.copyOf(sentX, n);
+            sentY  = Arrays.copyOf(sentY, n);
+            sent   = Arrays.copyOf(sent, n);
+        }
+        ids[count] = id;
+        xs[count] = x;
+        ys[count] = y;
+        points[count] = pts;
+        sent[count] = false;
+        int t = tile(x, y);
+        if (t >= 0) grid[t]++;
+        count++;
+    }
+
+    /**
+     * Actualiza la posición de la fila {@code i} (la entidad se movió).
+     */
+    void move(int i, int x, int y) {
+        if (xs[i] == x && ys[i] == y) return;
+        int t = tile(xs[i], ys[i]);
+        if (t >= 0) grid[t]--;
+        t = tile(x, y);
+        if (t >= 0) grid[t]++;
+        xs[i] = x;
+        ys[i] = y;
+    }
+
+    /**
+     * Quita la fila {@code i} corriendo las siguientes una posición, como
+     * {@code List.remove(int)}.
+     */
+    void removeAt(int i) {
+        forget(i);
+        int tail = count - i - 1;
+        if (tail > 0) {
+            System.arraycopy(ids,    i + 1, ids,    i, tail);
+            System.arraycopy(xs,     i + 1, xs,     i, tail);
+            System.arraycopy(ys,     i + 1, ys,     i, tail);
+            System.arraycopy(points, i + 1, points, i, tail);
+            System.arraycopy(sentX,  i + 1, sentX,  i, tail);
+            System.arraycopy(sentY,  i + 1, sentY,  i, tail);
+            System.arraycopy(sent,   i + 1, sent,   i, tail);
+        }
+        count--;
+    }
+
+    /** Quita todas las filas; las ya enviadas quedan como bajas del próximo delta. */
+    void clear() {
+        for (int i = 0; i < count; i++) {
+            if (sent[i]) recordRemoved(ids[i]);
+            else idsInUse.clear(ids[i]);
+        }
+        count = 0;
+        Arrays.fill(grid, 0);
+    }
+
+    /**
+     * Olvida lo enviado: el próximo delta anuncia todas las filas como
+     * nuevas y ninguna baja anterior (partida nueva desde cero).
+     */
+    void forgetSent() {
+        Arrays.fill(sent, 0, count, false);
+        clearRemoved();
+    }
+
+    /**
+     * Marca la fila {@code i} como anunciada con su posición actual.
+     *
+     * @return {@code true} si todavía no se había anunciado (va un ADD)
+     */
+    boolean markAdded(int i) {
+        if (sent[i]) return false;
+        sent[i] = true;
+        sentX[i] = xs[i];
+        sentY[i] = ys[i];
+        return true;
+    }
+
+    /**
+     * Registra la posición actual de una fila ya anunciada.
+     *
+     * @return {@code true} si se movió desde el último delta (va un MOVE)
+     */
+    boolean markMoved(int i) {
+        if (sentX[i] == xs[i] && sentY[i] == ys[i]) return false;
+        sentX[i] = xs[i];
+        sentY[i] = ys[i];
+        return true;
+    }
+
+    /** @return cantidad de bajas pendientes de enviar */
+    int removedCount() { return removedCount; }
+
+    /** @return id de la baja pendiente {@code k} */
+    int removedId(int k) { return removedIds[k]; }
+
+    /** Da por enviadas las bajas pendientes: sus ids quedan libres. */
+    void clearRemoved() {
+        for (int k = 0; k < removedCount; k++) idsInUse.clear(removedIds[k]);
+        removedCount = 0;
+    }
+
+    /** Saca la fila {@code i} de la grilla y anota su baja si ya se había enviado. */
+    private void forget(int i) {
+        int t = tile(xs[i], ys[i]);
+        if (t >= 0) grid[t]--;
+        if (sent[i]) recordRemoved(ids[i]);
+        else idsInUse.clear(ids[i]);
+    }
+
+    private void recordRemoved(int id) {
+        if (removedCount == removedIds.length) {
+            removedIds = Arrays.copyOf(removedIds, removedCount * 2);
+        }
+        removedIds[removedCount++] = id;
+    }
+}
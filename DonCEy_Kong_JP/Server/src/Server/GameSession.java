@@ -1,8 +1,9 @@
 package Server;
 
-//import java.util.Iterator; NO SE ESTA USANDO
 import java.util.List;
 import java.util.ArrayList;
+import java.util.BitSet;
+import java.util.Collections;
 
 import Server.entities.Enemy;
 import Server.entities.Fruit;
@@ -20,20 +21,68 @@ import Server.entities.SimpleFruit;
  * </p>
  */
 public class GameSession {
+
+    /** Operación de delta: la entidad aparece (o se reenvía completa). */
+    public static final Integer OP_ADD    = 1;
+    /** Operación de delta: la entidad cambió de posición. */
+    public static final Integer OP_MOVE   = 2;
+    /** Operación de delta: la entidad desapareció. */
+    public static final Integer OP_REMOVE = 3;
+
+    /**
+     * Un cambio sobre una entidad entre dos snapshots consecutivos.
+     * <p>Todas las operaciones son absolutas (posición final, no incremento),
+     * así que aplicarlas dos veces no rompe el estado del cliente.</p>
+     */
+    public static final class DeltaOp {
+        /** OP_ADD, OP_MOVE u OP_REMOVE. */
+        public final Integer op;
+        /** Identificador estable de la entidad. */
+        public final Integer id;
+        /** Tipo de enemigo ("RED"/"BLUE") o {@code null} para frutas. */
+        public final String type;
+        /** Posición final de la entidad. */
+        public final Integer x, y;
+        /** Puntos (solo frutas). */
+        public final Integer points;
+
+        DeltaOp(Integer op, Integer id, String type, Integer x, Integer y, Integer points) {
+            this.op = op; this.id = id; this.type = type;
+            this.x = x; this.y = y; this.points = points;
+        }
+    }
+
     /** ID del jugador al que pertenece esta sesión. */
     public final Integer playerId;
     /** Coordenadas de aparición (spawn) del jugador en el mapa. */
     public Integer spawnX, spawnY;
     /** Coordenadas de la meta (goal) para el jugador. */
     public Integer goalX, goalY;
-    /** Lista de enemigos activos en la sesión de este jugador. */
+    /**
+     * Lista de enemigos activos en la sesión de este jugador. Fuera de esta
+     * clase es de solo lectura: altas y bajas van por los métodos de la
+     * sesión, que mantienen alineadas sus columnas ({@link EntityTable}).
+     */
     public final List<Enemy> enemies = new ArrayList<>();
-    /** Lista de frutas activas en la sesión de este jugador. */
+    /** Lista de frutas activas en la sesión de este jugador (solo lectura, como {@link #enemies}). */
     public final List<Fruit> fruits  = new ArrayList<>();
+    /** Máximo de frutas por sesión: la lista completa debe caber en una trama binaria. */
+    public static final int MAX_FRUITS  = BinaryProtocol.MAX_KEYFRAME_FRUITS;
+    /** Máximo de enemigos por sesión, por el mismo motivo. */
+    public static final int MAX_ENEMIES = BinaryProtocol.MAX_KEYFRAME_ENEMIES;
+
+    /**
+     * Ids de entidad ocupados: los de entidades vivas y los de bajas cuyo
+     * REMOVE todavía no salió. Un id se reutiliza recién cuando los
+     * clientes ya lo dieron de baja.
+     */
+    private final BitSet idsInUse = new BitSet(BinaryProtocol.MAX_ENTITY_ID + 1);
+    /** Posiciones de {@link #enemies} en arreglos, con grilla de ocupación y lo ya enviado. */
+    private final EntityTable enemyTable = new EntityTable(idsInUse);
+    /** Posiciones y puntos de {@link #fruits}, con grilla de ocupación y lo ya enviado. */
+    private final EntityTable fruitTable = new EntityTable(idsInUse);
     /** Hay enemigos o no */
     public Boolean hasEnemyChanges = false;
-    /** Indica si hay cambios pendientes de enemigos para mandar al cliente */
-    public Boolean enemiesDirty = false;
 
     /**
      * “Velocidad lógica” de enemigos para este jugador (pasos por tick).
@@ -41,6 +90,39 @@ public class GameSession {
      */
     public Integer enemySpeedSteps = 1;
 
+    /**
+     * Próximo id a probar para enemigos y frutas. Recorre 1..{@link
+     * BinaryProtocol#MAX_ENTITY_ID} en círculo (los ids viajan como u16)
+     * saltando los de {@link #idsInUse}.
+     */
+    private int nextEntityId = 1;
+    /** Número de snapshot de enemigos (sube con cada delta no vacío). */
+    public Integer enemySeq = 0;
+    /** Número de snapshot de frutas (sube con cada delta no vacío). */
+    public Integer fruitSeq = 0;
+
+    /*
+     * Foto de la sesión para quien entra a mitad de partida (espectador
+     * nuevo o RESYNC). Las listas completas se reemplazan solo cuando un
+     * delta no está vacío, así que mientras la sesión no cambia cada
+     * formato se codifica una vez y se reusa. Protegidas por el monitor de
+     * la sesión.
+     */
+    /** Lista completa de frutas al día, o {@code null} antes del primer envío. */
+    Broadcast fruitsKeyframe;
+    /** Lista completa de enemigos al día, o {@code null} antes del primer envío. */
+    Broadcast enemiesKeyframe;
+    /** Último STATE difundido del jugador (lo escribe el tick). */
+    volatile Broadcast lastState;
+
+    /*
+     * Valores del último STATE difundido, para armar uno nuevo solo cuando
+     * algo cambia. Los usa únicamente el shard de la sesión.
+     */
+    private boolean stateRecorded = false;
+    private int stateX, stateY, stateScore, stateRound, stateLives, stateAck;
+    private boolean stateGameOver;
+
     /**
      * Crea una nueva sesión de juego para el jugador indicado,
      * inicializando las posiciones de spawn y meta por defecto.
@@ -68,17 +150,239 @@ public class GameSession {
      */
     public void loadFromTemplates(List<Enemy> tplEnemies, List<Fruit> tplFruits) {
         enemies.clear();
-        fruits.clear();
+        enemyTable.clear();
+        clearFruits();
 
         for (Enemy e : tplEnemies) {
             String type = e.getType();
             // usar nombres simples gracias a los imports
-            enemies.add("RED".equalsIgnoreCase(type)
+            addEnemy("RED".equalsIgnoreCase(type)
                     ? new RedCroc(e.getX(), e.getY())
                     : new BlueCroc(e.getX(), e.getY()));
         }
         for (Fruit f : tplFruits) {
-            fruits.add(new SimpleFruit(f.getX(), f.getY(), f.getPoints()));
+            addFruit(new SimpleFruit(f.getX(), f.getY(), f.getPoints()));
+        }
+    }
+
+    /**
+     * Reinicia la sesión en el lugar para una partida nueva del mismo
+     * jugador ({@code REJOIN}): enemigos y frutas de las plantillas y
+     * snapshots en 0, como una sesión recién creada, sin reservar otra.
+     * Debe llamarse con el monitor de la sesión.
+     *
+     * @param tplEnemies lista plantilla de enemigos definida a nivel de servidor
+     * @param tplFruits  lista plantilla de frutas definida a nivel de servidor
+     */
+    public void restart(List<Enemy> tplEnemies, List<Fruit> tplFruits) {
+        loadFromTemplates(tplEnemies, tplFruits);
+        enemySeq = 0;
+        fruitSeq = 0;
+        enemyTable.forgetSent();
+        fruitTable.forgetSent();
+        hasEnemyChanges = false;
+        stateRecorded = false;
+        fruitsKeyframe = null;
+        enemiesKeyframe = null;
+        lastState = null;
+    }
+
+    /**
+     * Compara al jugador con el último STATE difundido y, si algo cambió
+     * (posición, puntaje, nivel, vidas, fin de partida o INPUT reconocido),
+     * lo registra como el nuevo. Después de {@link #restart} siempre hay
+     * cambio.
+     *
+     * @param p jugador dueño de la sesión
+     * @return {@code true} si hay que difundir un STATE nuevo
+     */
+    boolean takeStateChange(Player p) {
+        if (stateRecorded
+                && p.x == stateX && p.y == stateY
+                && p.score == stateScore && p.round == stateRound
+                && p.lives == stateLives && p.gameOver == stateGameOver
+                && p.lastAckSeq == stateAck) {
+            return false;
+        }
+        stateRecorded = true;
+        stateX = p.x;
+        stateY = p.y;
+        stateScore = p.score;
+        stateRound = p.round;
+        stateLives = p.lives;
+        stateGameOver = p.gameOver;
+        stateAck = p.lastAckSeq;
+        return true;
+    }
+
+    /**
+     * Agrega un enemigo a la sesión asignándole un id estable.
+     *
+     * @param e enemigo a agregar
+     * @return {@code false} si la sesión ya tiene {@link #MAX_ENEMIES}
+     */
+    public Boolean addEnemy(Enemy e) {
+        if (enemies.size() >= MAX_ENEMIES) return false;
+        e.setId(allocateId());
+        enemies.add(e);
+        enemyTable.add(e.getId(), e.getX(), e.getY(), 0);
+        return true;
+    }
+
+    /**
+     * Agrega una fruta a la sesión asignándole un id estable.
+     *
+     * @param f fruta a agregar
+     * @return {@code false} si la sesión ya tiene {@link #MAX_FRUITS}
+     */
+    public Boolean addFruit(Fruit f) {
+        if (fruits.size() >= MAX_FRUITS) return false;
+        f.setId(allocateId());
+        fruits.add(f);
+        fruitTable.add(f.getId(), f.getX(), f.getY(), f.getPoints());
+        return true;
+    }
+
+    /**
+     * Toma el siguiente id libre. Con los topes de entidades por sesión
+     * siempre hay uno: vivas más bajas pendientes quedan muy por debajo de
+     * los 65535 disponibles.
+     *
+     * @return id entre 1 y {@link BinaryProtocol#MAX_ENTITY_ID}
+     */
+    private int allocateId() {
+        for (int tries = 0; tries < BinaryProtocol.MAX_ENTITY_ID; tries++) {
+            int id = nextEntityId;
+            nextEntityId = (id == BinaryProtocol.MAX_ENTITY_ID) ? 1 : id + 1;
+            if (!idsInUse.get(id)) {
+                idsInUse.set(id);
+                return id;
+            }
+        }
+        throw new IllegalStateException("Sin ids de entidad libres en la sesión " + playerId);
+    }
+
+    /** Quita todas las frutas de la sesión. */
+    public void clearFruits() {
+        fruits.clear();
+        fruitTable.clear();
+    }
+
+    /**
+     * Copia a las columnas la posición del enemigo {@code i} después de su
+     * {@code tick()}.
+     *
+     * @param i índice en {@link #enemies}
+     */
+    public void enemyMoved(int i) {
+        Enemy e = enemies.get(i);
+        enemyTable.move(i, e.getX(), e.getY());
+    }
+
+    /** Quita los enemigos que dejaron de estar activos. */
+    public void removeInactiveEnemies() {
+        for (int i = enemies.size() - 1; i >= 0; i--) {
+            if (!enemies.get(i).isActive()) {
+                enemies.remove(i);
+                enemyTable.removeAt(i);
+            }
+        }
+    }
+
+    /**
+     * @return {@code true} si hay algún enemigo en el tile (O(1), por la grilla)
+     */
+    public boolean enemyAt(int x, int y) {
+        return enemyTable.countAt(x, y) > 0;
+    }
+
+    /**
+     * @return {@code true} si hay alguna fruta en el tile (O(1), por la grilla)
+     */
+    public boolean fruitAt(int x, int y) {
+        return fruitTable.countAt(x, y) > 0;
+    }
+
+    /**
+     * Quita las frutas de un tile.
+     *
+     * @return suma de los puntos de las frutas quitadas (0 si no había)
+     */
+    public int takeFruitsAt(int x, int y) {
+        int pts = 0;
+        if (!fruitAt(x, y)) return pts;
+        for (int i = fruitTable.size() - 1; i >= 0; i--) {
+            if (fruitTable.x(i) == x && fruitTable.y(i) == y) {
+                pts += fruitTable.points(i);
+                fruits.remove(i);
+                fruitTable.removeAt(i);
+            }
+        }
+        return pts;
+    }
+
+    /**
+     * Calcula qué cambió en los enemigos desde el último delta y marca el
+     * estado actual como enviado.
+     * <p>Debe llamarse una sola vez por difusión; el resultado se envía a
+     * todos los clientes que usan deltas. Se llama en cada tick, así que si
+     * nada cambió no crea objetos: compara las columnas de posición con lo
+     * último enviado y las bajas ya quedaron anotadas al quitar cada
+     * enemigo.</p>
+     *
+     * @return operaciones ADD/MOVE/REMOVE (vacía si no hubo cambios)
+     */
+    public List<DeltaOp> diffEnemies() {
+        List<DeltaOp> ops = null;
+
+        for (int i = 0, n = enemyTable.size(); i < n; i++) {
+            Integer op;
+            if (enemyTable.markAdded(i))      op = OP_ADD;
+            else if (enemyTable.markMoved(i)) op = OP_MOVE;
+            else continue;
+            ops = append(ops, new DeltaOp(op, enemyTable.id(i), enemies.get(i).getType(),
+                    enemyTable.x(i), enemyTable.y(i), 0));
+        }
+        for (int k = 0, n = enemyTable.removedCount(); k < n; k++) {
+            ops = append(ops, new DeltaOp(OP_REMOVE, enemyTable.removedId(k), null, 0, 0, 0));
+        }
+        enemyTable.clearRemoved();
+        return ops == null ? Collections.emptyList() : ops;
+    }
+
+    /**
+     * Calcula qué frutas aparecieron o desaparecieron desde el último delta
+     * y marca el estado actual como enviado. Como {@link #diffEnemies()},
+     * no crea objetos si nada cambió.
+     *
+     * @return operaciones ADD/REMOVE (vacía si no hubo cambios)
+     */
+    public List<DeltaOp> diffFruits() {
+        List<DeltaOp> ops = null;
+
+        for (int i = 0, n = fruitTable.size(); i < n; i++) {
+            if (fruitTable.markAdded(i)) {
+                ops = append(ops, new DeltaOp(OP_ADD, fruitTable.id(i), null,
+                        fruitTable.x(i), fruitTable.y(i), fruitTable.points(i)));
+            }
         }
+        for (int k = 0, n = fruitTable.removedCount(); k < n; k++) {
+            ops = append(ops, new DeltaOp(OP_REMOVE, fruitTable.removedId(k), null, 0, 0, 0));
+        }
+        fruitTable.clearRemoved();
+        return ops == null ? Collections.emptyList() : ops;
+    }
+
+    /**
+     * Agrega una operación creando la lista con la primera.
+     *
+     * @param ops lista actual, o {@code null} si todavía no hay operaciones
+     * @param op  operación a agregar
+     * @return la lista con {@code op}
+     */
+    private static List<DeltaOp> append(List<DeltaOp> ops, DeltaOp op) {
+        if (ops == null) ops = new ArrayList<>();
+        ops.add(op);
+        return ops;
     }
 }
@@ -0,0 +1,103 @@
+package Server;
+
+import java.util.Arrays;
+
+/**
+ * Inputs pendientes de un shard de simulación, sin un objeto por evento.
+ * <p>
+ * Los hilos de los clientes encolan con {@link #offer(Player, int, int, int)}
+ * y el shard, una vez por tick, toma todo lo acumulado con {@link #drain()}
+ * y lo recorre por índice. Son dos juegos de arreglos que se intercambian
+ * en cada {@code drain()}: mientras el shard lee uno, los clientes escriben
+ * en el otro, y ninguno de los dos se vuelve a reservar salvo que un tick
+ * traiga más inputs que nunca (entonces crece al doble y se queda así).
+ * </p>
+ * <p>
+ * Los lados de escritura se protegen con el monitor del buffer; el de
+ * lectura lo usa solo el shard dueño, después de {@code drain()}.
+ * </p>
+ */
+public final class InputBuffer {
+
+    /** Capacidad inicial en eventos. */
+    private static final int INITIAL_CAPACITY = 64;
+
+    /* ===== Lado de escritura (clientes) ===== */
+    private Player[] writePlayers = new Player[INITIAL_CAPACITY];
+    private int[]    writeSeqs    = new int[INITIAL_CAPACITY];
+    private int[]    writeDx      = new int[INITIAL_CAPACITY];
+    private int[]    writeDy      = new int[INITIAL_CAPACITY];
+    private int      writeCount   = 0;
+
+    /* ===== Lado de lectura (shard) ===== */
+    private Player[] readPlayers = new Player[INITIAL_CAPACITY];
+    private int[]    readSeqs    = new int[INITIAL_CAPACITY];
+    private int[]    readDx      = new int[INITIAL_CAPACITY];
+    private int[]    readDy      = new int[INITIAL_CAPACITY];
+    private int      readCount   = 0;
+
+    /**
+     * Encola un input ya validado.
+     *
+     * @param p   jugador que lo envió
+     * @param seq número de secuencia del input
+     * @param dx  desplazamiento horizontal (0 si quedó anulado)
+     * @param dy  desplazamiento vertical (0 si quedó anulado)
+     */
+    public synchronized void offer(Player p, int seq, int dx, int dy) {
+        if (writeCount == writePlayers.length) {
+            int n = writeCount * 2;
+            writePlayers = Arrays.copyOf(writePlayers, n);
+            writeSeqs    = Arrays.copyOf(writeSeqs, n);
+            writeDx      = Arrays.copyOf(writeDx, n);
+            writeDy      = Arrays.copyOf(writeDy, n);
+        }
+        writePlayers[writeCount] = p;
+        writeSeqs[writeCount]    = seq;
+        writeDx[writeCount]      = dx;
+        writeDy[writeCount]      = dy;
+        writeCount++;
+    }
+
+    /**
+     * Toma todos los inputs encolados hasta ahora; quedan accesibles por
+     * índice hasta el próximo {@code drain()}.
+     *
+     * @return cantidad de inputs tomados
+     */
+    public int drain() {
+        // Suelta las referencias del lote anterior antes de reusar los arreglos
+        Arrays.fill(readPlayers, 0, readCount, null);
+
+        synchronized (this) {
+            Player[] players = readPlayers; readPlayers = writePlayers; writePlayers = players;
+            int[] seqs = readSeqs; readSeqs = writeSeqs; writeSeqs = seqs;
+            int[] dx   = readDx;   readDx   = writeDx;   writeDx   = dx;
+            int[] dy   = readDy;   readDy   = writeDy;   writeDy   = dy;
+            readCount  = writeCount;
+            writeCount = 0;
+            // Un lado pudo crecer más que el otro: la escritura necesita al
+            // menos lo que ya pidió un tick
+            if (writePlayers.length < readPlayers.length) {
+                int n = readPlayers.length;
+                writePlayers = new Player[n];
+                writeSeqs    = new int[n];
+                writeDx      = new int[n];
+                writeDy      = new int[n];
+            }
+        }
+        return readCount;
+    }
+
+    /** @return jugador del input {@code i} del último lote */
+    public Player player(int i) { return readPlayers[i]; }
+
+    /** @return número de secuencia del input {@code i} del último lote */
+    public int seq(int i) { return readSeqs[i]; }
+
+    /** @return desplazamiento horizontal del input {@code i} del último lote */
+    public int dx(int i) { return readDx[i]; }
+
+    /** @return desplazamiento vertical del input {@code i} del último lote */
+    public int dy(int i) { return readDy[i]; }
+}
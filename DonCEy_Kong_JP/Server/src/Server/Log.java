@@ -0,0 +1,272 @@
+package Server;
+
+import java.io.PrintWriter;
+import java.io.StringWriter;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.atomic.AtomicLongArray;
+import java.util.concurrent.atomic.LongAdder;
+import java.util.concurrent.locks.LockSupport;
+
+/**
+ * Registro asíncrono del servidor, con niveles.
+ * <p>
+ * Quien registra (hilos de clientes, ticker, shards, consola) solo deja la
+ * línea en un buffer circular sin locks y sigue; un hilo propio,
+ * {@code Logger}, la escribe en la consola junto con las demás pendientes en
+ * una sola escritura. Así ningún lector de socket espera por el
+ * {@code System.out} sincronizado de otro. Si el buffer se llena la línea se
+ * descarta y se cuenta: es preferible perder registro que frenar inputs.
+ * </p>
+ * <p>
+ * Las líneas entrantes de INPUT (una por tecla por jugador) no se registran
+ * por defecto: se cuentan, y {@code ADMIN LOG INPUT <n>} registra una de
+ * cada {@code n}. Los contadores de la ventana salen al final de la línea
+ * {@code STATS} (ver {@link #statsFields()}).
+ * </p>
+ */
+public final class Log {
+
+    /** Niveles, de más a menos detallado. */
+    public static final int DEBUG = 0;
+    public static final int INFO  = 1;
+    public static final int WARN  = 2;
+    public static final int ERROR = 3;
+
+    private static final String[] LEVEL_NAMES = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+    /** Capacidad del buffer en líneas (potencia de 2). */
+    private static final int CAPACITY = 8192;
+    private static final int MASK = CAPACITY - 1;
+    /** Siesta del escritor cuando no hay nada pendiente. */
+    private static final long IDLE_NANOS = 2_000_000L;
+
+    /** Nivel mínimo que se registra. */
+    private static volatile int level = INFO;
+    /** INPUT entrantes: 0 = ninguno, 1 = todos, n = uno de cada n. */
+    private static volatile int inputSample = 0;
+
+    /*
+     * Buffer circular de varios productores y un consumidor: cada casilla
+     * tiene un número de secuencia que dice si está libre para la vuelta
+     * {@code pos} ({@code seq == pos}) o escrita ({@code seq == pos + 1}).
+     * Los productores reservan con CAS sobre {@code tail}; el escritor es el
+     * único que avanza {@code head}.
+     */
+    private static final String[] slots = new String[CAPACITY];
+    private static final AtomicLongArray slotSeq = new AtomicLongArray(CAPACITY);
+    private static final AtomicLong tail = new AtomicLong();
+    private static long head = 0;
+
+    /* Contadores de la ventana de STATS (se reinician al publicarla). */
+    private static final LongAdder inputLines = new LongAdder();
+    private static final LongAdder written    = new LongAdder();
+    private static final LongAdder dropped    = new LongAdder();
+    /** Cuenta de INPUT para el muestreo. */
+    private static final AtomicLong inputSeen = new AtomicLong();
+
+    /** El escritor terminó: se escribe directo en la consola. */
+    private static volatile boolean stopped = false;
+    private static final Thread writer;
+
+    static {
+        for (int i = 0; i < CAPACITY; i++) slotSeq.set(i, i);
+        writer = new Thread(Log::drainLoop, "Logger");
+        writer.setDaemon(true);
+        writer.start();
+    }
+
+    private Log() {}
+
+    /** @return {@code true} si los mensajes de ese nivel se registran */
+    public static boolean enabled(int lvl) {
+        return lvl >= level;
+    }
+
+    public static void debug(String tag, String msg) { log(DEBUG, tag, msg); }
+    public static void info(String tag, String msg)  { log(INFO, tag, msg); }
+    public static void warn(String tag, String msg)  { log(WARN, tag, msg); }
+    public static void error(String tag, String msg) { log(ERROR, tag, msg); }
+
+    /**
+     * Error con la traza de la excepción.
+     *
+     * @param tag etiqueta de origen ({@code "JAVA"}, {@code "ADMIN"}...)
+     * @param msg descripción
+     * @param t   excepción a volcar
+     */
+    public static void error(String tag, String msg, Throwable t) {
+        if (!enabled(ERROR)) return;
+        StringWriter sw = new StringWriter();
+        t.printStackTrace(new PrintWriter(sw));
+        log(ERROR, tag, msg + System.lineSeparator() + sw.toString().trim());
+    }
+
+    /**
+     * Registra un mensaje como {@code [tag] msg}; los que no son INFO llevan
+     * el nivel delante del texto.
+     *
+     * @param lvl DEBUG, INFO, WARN o ERROR
+     * @param tag etiqueta de origen
+     * @param msg texto
+     */
+    public static void log(int lvl, String tag, String msg) {
+        if (!enabled(lvl)) return;
+        String line = lvl == INFO
+                ? "[" + tag + "] " + msg
+                : "[" + tag + "] " + LEVEL_NAMES[lvl] + " " + msg;
+        if (stopped) {
+            System.out.println(line);
+            written.increment();
+        } else if (!offer(line)) {
+            dropped.increment();
+        }
+    }
+
+    /**
+     * Una línea de INPUT recibida de un cliente: se cuenta siempre y se
+     * registra según el muestreo configurado. No arma el texto si no va.
+     *
+     * @param line línea tal cual llegó
+     */
+    public static void input(String line) {
+        inputLines.increment();
+        int n = inputSample;
+        if (n <= 0 || !enabled(INFO)) return;
+        if (n == 1 || inputSeen.getAndIncrement() % n == 0) {
+            info("JAVA", "<- " + line);
+        }
+    }
+
+    /**
+     * Cambia el nivel mínimo.
+     *
+     * @param name DEBUG, INFO, WARN o ERROR (sin distinguir mayúsculas)
+     * @return {@code false} si el nombre no es un nivel
+     */
+    public static boolean setLevel(String name) {
+        for (int i = 0; i < LEVEL_NAMES.length; i++) {
+            if (LEVEL_NAMES[i].equalsIgnoreCase(name)) {
+                level = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Cambia el muestreo de las líneas de INPUT entrantes.
+     *
+     * @param n 0 = ninguna, 1 = todas, n = una de cada n
+     */
+    public static void setInputSample(int n) {
+        inputSample = Math.max(0, n);
+    }
+
+    /**
+     * Contadores de la ventana para el final de la línea {@code STATS}, y
+     * los reinicia:
+     * <pre>
+     *  &lt;inputsRecibidos&gt; &lt;lineasRegistradas&gt; &lt;lineasDescartadas&gt;
+     * </pre>
+     *
+     * @return los campos con un espacio inicial, sin {@code '\n'}
+     */
+    static String statsFields() {
+        return " " + inputLines.sumThenReset()
+             + " " + written.sumThenReset()
+             + " " + dropped.sumThenReset();
+    }
+
+    /** Reinicia los contadores de la ventana sin armar los campos (nadie los pidió). */
+    static void resetStats() {
+        inputLines.reset();
+        written.reset();
+        dropped.reset();
+    }
+
+    /**
+     * Escribe lo pendiente y detiene el escritor; lo que se registre después
+     * va directo a la consola. Lo llama {@link Server#stop()}.
+     * <p>Un productor que leyó {@code stopped} antes del cambio puede dejar su
+     * línea después de la última pasada del escritor; por eso, con el
+     * escritor ya terminado, este hilo vacía las casillas que quedan (es el
+     * único consumidor). Si el escritor no terminó a tiempo no se toca el
+     * buffer: {@link #poll()} admite un solo consumidor.</p>
+     */
+    static void shutdown() {
+        stopped = true;
+        LockSupport.unpark(writer);
+        try {
+            writer.join(500);
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        }
+        if (writer.isAlive()) return;
+
+        // Hasta head == tail: una casilla tomada y sin publicar es un offer en curso
+        while (head != tail.get()) {
+            String line = poll();
+            if (line == null) {
+                Thread.yield();
+                continue;
+            }
+            System.out.println(line);
+            written.increment();
+        }
+    }
+
+    /** Reserva una casilla y deja la línea; {@code false} si el buffer está lleno. */
+    private static boolean offer(String line) {
+        while (true) {
+            long pos = tail.get();
+            int i = (int) (pos & MASK);
+            long dif = slotSeq.get(i) - pos;
+            if (dif == 0) {
+                if (tail.compareAndSet(pos, pos + 1)) {
+                    slots[i] = line;
+                    slotSeq.set(i, pos + 1);   // publica la línea al escritor
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;                  // el escritor no liberó esta vuelta
+            }
+            // otro productor tomó pos: reintentar con el tail nuevo
+        }
+    }
+
+    /** Toma la siguiente línea publicada, o {@code null}. Solo el escritor, o {@link #shutdown()} cuando ya terminó. */
+    private static String poll() {
+        int i = (int) (head & MASK);
+        if (slotSeq.get(i) != head + 1) return null;
+        String line = slots[i];
+        slots[i] = null;
+        slotSeq.set(i, head + CAPACITY);       // libre para la próxima vuelta
+        head++;
+        return line;
+    }
+
+    /** Hilo {@code Logger}: junta lo pendiente y lo escribe de una vez. */
+    private static void drainLoop() {
+        StringBuilder batch = new StringBuilder(4096);
+        String nl = System.lineSeparator();
+        while (true) {
+            boolean finishing = stopped;
+            int lines = 0;
+            String line;
+            while ((line = poll()) != null) {
+                batch.append(line).append(nl);
+                lines++;
+            }
+            if (lines > 0) {
+                System.out.print(batch);
+                System.out.flush();
+                written.add(lines);
+                batch.setLength(0);
+            } else if (finishing) {
+                return;
+            } else {
+                LockSupport.parkNanos(IDLE_NANOS);
+            }
+        }
+    }
+}
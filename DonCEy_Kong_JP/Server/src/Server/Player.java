@@ -7,6 +7,11 @@ package Server;
  * puntaje acumulado, ronda actual y si la partida ha terminado para él.
  * Esta clase no contiene lógica de red; únicamente modela los datos del jugador.
  * </p>
+ * <p>
+ * Los campos que el tick lee y escribe en cada pasada son primitivos para
+ * que simular no cree objetos (un {@code Integer} de más de 127, como la
+ * secuencia reconocida o el puntaje, se reservaría en cada asignación).
+ * </p>
  */
 public class Player {
     /** Identificador único del jugador dentro del servidor. */
@@ -14,17 +19,35 @@ public class Player {
     /** Nombre o alias del jugador. */
     public final String name;
     /** Coordenadas actuales del jugador en el mapa (x, y). */
-    public Integer x, y;
+    public int x, y;
     /** Vidas del jugador */
-    public Integer lives;
+    public int lives;
     /** Último número de secuencia de input reconocido/acknowledgeado por el servidor. */
-    public Integer lastAckSeq;
+    public int lastAckSeq;
     /** Puntaje acumulado por el jugador. */
-    public Integer score;
+    public int score;
     /** Ronda o nivel actual del jugador. */
-    public Integer round;
+    public int round;
     /** Indica si el juego ha terminado para este jugador. */
-    public Boolean gameOver;   
+    public boolean gameOver;
+    /** Token para volver a esta misma sesión con {@code REJOIN}. */
+    public String rejoinToken;
+
+    /*
+     * Borrador del tick: la coalescencia de inputs se guarda en el propio
+     * jugador en lugar de en mapas por tick. Solo lo toca el shard de su
+     * sesión, durante el paso de simulación.
+     */
+    /** Ya tiene inputs en el tick en curso (está en la lista del shard). */
+    boolean tickSeen;
+    /** Mayor seq consumida en el tick en curso. */
+    int tickMaxSeq;
+    /** Hay un movimiento elegido para el tick en curso. */
+    boolean tickHasMove;
+    /** Movimiento elegido: el "mejor" input del tick. */
+    int tickDx, tickDy;
+    /** Subió al menos una casilla en este tick (no se le aplica gravedad). */
+    boolean tickJumped;
 
     /**
      * Crea un nuevo jugador.
@@ -53,5 +76,23 @@ public class Player {
         /** @return cantidad de vidas del jugador */
         this.lives = 3;
     }
+
+    /**
+     * Deja al jugador como recién unido (para {@code REJOIN}): vidas,
+     * puntaje y ronda iniciales en el spawn de su sesión. El último INPUT
+     * reconocido vuelve a 0 porque el cliente reinicia su secuencia.
+     *
+     * @param spawnX posición inicial X
+     * @param spawnY posición inicial Y
+     */
+    public void restart(int spawnX, int spawnY) {
+        this.x = spawnX;
+        this.y = spawnY;
+        this.lastAckSeq = 0;
+        this.score = 0;
+        this.round = 1;
+        this.gameOver = false;
+        this.lives = 3;
+    }
 }
 
@@ -5,6 +5,7 @@ import Server.factory.*;
 
 import java.io.IOException;
 import java.net.*;
+import java.security.SecureRandom;
 import java.util.*;
 import java.util.concurrent.*;
 import java.util.concurrent.atomic.AtomicInteger;
@@ -19,27 +20,6 @@ import java.util.concurrent.atomic.AtomicInteger;
  */
 public class Server {
 
-    /**
-     * Representa un evento de entrada (input) del jugador.
-     * <p>Contiene la información necesaria para procesar una acción de movimiento
-     * del cliente y su número de secuencia para reconciliación.</p>
-     */
-    static final class InputEvent {
-        final Integer playerId, seq, dx, dy;
-
-        /**
-         * Crea un nuevo evento de entrada para un jugador.
-         *
-         * @param playerId identificador del jugador que generó el input
-         * @param seq      número de secuencia del input para reconciliación
-         * @param dx       desplazamiento horizontal solicitado por el cliente
-         * @param dy       desplazamiento vertical solicitado por el cliente
-         */
-        InputEvent(Integer playerId, Integer seq, Integer dx, Integer dy) {
-            this.playerId = playerId; this.seq = seq; this.dx = dx; this.dy = dy;
-        }
-    }
-
     /* ========= Singleton ========= */
     /**
      * La única instancia de la clase {@code Server} (patrón Singleton).
@@ -49,7 +29,15 @@ public class Server {
     /**
      * Constructor privado para prevenir la instanciación externa.
      */
-    private Server() {}
+    private Server() {
+        for (int i = 0; i < shards.length; i++) shards[i] = new Shard();
+        for (int i = 1; i < shards.length; i++) {
+            Thread t = new Thread(new SimWorker(shards[i]), "SimWorker-" + i);
+            t.setDaemon(true);
+            simWorkers[i - 1] = t;
+            t.start();
+        }
+    }
 
     /**
      * Obtiene la única instancia de la clase {@code Server}.
@@ -82,7 +70,35 @@ public class Server {
     private final AtomicInteger tickSeq = new AtomicInteger(0);
     final ConcurrentHashMap<Integer, Player> players = new ConcurrentHashMap<>();
     final ConcurrentHashMap<ClientHandler, Integer> byClient = new ConcurrentHashMap<>();
-    private final ConcurrentLinkedQueue<InputEvent> inputQueue = new ConcurrentLinkedQueue<>();
+    /** Índice inverso de {@link #byClient}: el cliente jugador de cada id. */
+    private final ConcurrentHashMap<Integer, ClientHandler> clientByPlayer = new ConcurrentHashMap<>();
+
+    /* ========= Reingreso (REJOIN) ========= */
+    /** Cuánto se guarda la sesión de un jugador que salió, esperando su REJOIN (ms). */
+    private static final Long PARKED_TTL_MS = 5L * 60L * 1000L;
+
+    /** Jugador y sesión que quedaron sin cliente tras LEAVE o una desconexión. */
+    private static final class ParkedSession {
+        final Player player;
+        final GameSession session;
+        /** Momento en que se guardó ({@code System.currentTimeMillis()}). */
+        final Long parkedAt;
+
+        ParkedSession(Player player, GameSession session, Long parkedAt) {
+            this.player = player;
+            this.session = session;
+            this.parkedAt = parkedAt;
+        }
+    }
+
+    /**
+     * Sesiones guardadas por token de reingreso. Un {@code REJOIN} las
+     * reinicia en el lugar (mismo id, mismos objetos) en vez de crear
+     * {@link Player} y {@link GameSession} nuevos.
+     */
+    private final ConcurrentHashMap<String, ParkedSession> parked = new ConcurrentHashMap<>();
+    /** Genera los tokens de reingreso (no deben poder adivinarse). */
+    private final SecureRandom tokenRandom = new SecureRandom();
 
     /* ========= Jugadores vs espectadores ========= */
     /** Conjunto de {@link ClientHandler} que actualmente están actuando como jugadores. */
@@ -101,10 +117,12 @@ public class Server {
      * lista asociada se comportan como <em>observadores</em>. En cada ciclo
      * de juego ({@link #tick()}), el servidor notifica el nuevo estado del
      * jugador a todos sus observadores mediante
-     * {@link #sendToPlayerAndSpectators(Integer, String)}.</p>
+     * {@link #sendToPlayerAndSpectators(Integer, Broadcast, boolean, int)}.</p>
      */
     private final ConcurrentHashMap<Integer, CopyOnWriteArrayList<ClientHandler>> spectatorsByPlayer =
             new ConcurrentHashMap<>();
+    /** Índice inverso de {@link #spectatorsByPlayer}: jugador que observa cada espectador. */
+    private final ConcurrentHashMap<ClientHandler, Integer> spectatedPlayer = new ConcurrentHashMap<>();
     private final ConcurrentHashMap<Integer, CopyOnWriteArrayList<ClientHandler>> waitingSpectatorsByPlayer =
             new ConcurrentHashMap<>();
 
@@ -140,79 +158,87 @@ public class Server {
 
 
     /**
-     * Obtiene el carácter de la celda del mapa en las coordenadas dadas.
-     * <p>Si las coordenadas están fuera de los límites del mapa, se devuelve
-     * el carácter {@code '.'} para indicar vacío.</p>
-     *
-     * @param x coordenada horizontal en el mapa
-     * @param y coordenada vertical en el mapa
-     * @return carácter que representa el contenido de la celda del mapa
+     * Flags {@link TileFlags} de cada celda lógica, calculados una sola vez
+     * a partir de {@link #MAP}. Indexado como {@code FLAGS[y][x]}.
      */
-    private static Character tileAt(Integer x, Integer y) {
-        if (x < MIN_X || x > MAX_X || y < MIN_Y || y > MAX_Y) return '.';
-        return MAP[y][x];
-    }
+    private static final byte[][] FLAGS =
+            TileFlags.build(MAP, MAX_X - MIN_X + 1, MAX_Y - MIN_Y + 1);
 
     /**
-     * Indica si la celda en las coordenadas especificadas corresponde a agua.
-     *
-     * @param x coordenada horizontal en el mapa
-     * @param y coordenada vertical en el mapa
-     * @return {@code true} si la celda contiene agua, {@code false} en caso contrario
+     * Huella del mapa en hexadecimal: FNV-1a de 32 bits sobre ancho, alto y
+     * los tiles fila por fila desde y=0, la misma que calcula
+     * {@code map_build_flags()} en el cliente.
      */
-    private static Boolean isWater(Integer x, Integer y) {
-        return tileAt(x, y) == 'W';
+    private static final String MAP_HASH = computeMapHash();
+
+    private static String computeMapHash() {
+        int width  = MAX_X - MIN_X + 1;
+        int height = MAX_Y - MIN_Y + 1;
+
+        int hash = 0x811C9DC5;
+        hash = (hash ^ width)  * 0x01000193;
+        hash = (hash ^ height) * 0x01000193;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                hash = (hash ^ (MAP[y][x] & 0xFF)) * 0x01000193;
+            }
+        }
+        return String.format(Locale.ROOT, "%08x", hash);
     }
 
-    // Donde el jugador PUEDE estar de pie / colgado
     /**
-     * Determina si un carácter de mapa se considera una superficie sólida
-     * sobre la cual el jugador puede estar de pie o colgado.
+     * Huella del mapa que se anuncia en {@code WELCOME}; un cliente que ya
+     * lo tiene guardado la repite con {@code +MAPCACHE=<hex>} y recibe
+     * {@code MAP_CACHED} en lugar de las filas.
      *
-     * @param t carácter del mapa a evaluar
-     * @return {@code true} si el carácter representa una superficie sólida,
-     *         {@code false} en caso contrario
+     * @return huella en hexadecimal (8 dígitos)
      */
-    private static Boolean isSolidTile(Character t) {
-        return t == 'T'   // tierra que sale del agua
-            || t == '='   // plataforma
-            || t == '|'   // liana (colgado)
-            || t == 'S';   // spawn
+    public static String mapHash() {
+        return MAP_HASH;
     }
 
-     /**
-     * Tiles que bloquean al subir (techo).
-     * OJO: aquí NO incluimos 'G' para que la zona de ganar no bloquee el paso.
+    /**
+     * Obtiene los flags de la celda del mapa en las coordenadas dadas.
+     * <p>Si las coordenadas están fuera de los límites del mapa, se devuelve
+     * {@code 0} (vacío).</p>
+     *
+     * @param x coordenada horizontal en el mapa
+     * @param y coordenada vertical en el mapa
+     * @return máscara {@link TileFlags} de la celda
      */
-    private static Boolean isBlockingCeiling(Character t) {
-        return t == 'T'   // tierra
-            || t == '='   // plataforma
-            || t == 'S';  // spawn (por si hay uno encima)
-        // 'G' (meta) a propósito NO se incluye
+    private static int flagsAt(int x, int y) {
+        if (x < MIN_X || x > MAX_X || y < MIN_Y || y > MAX_Y) return 0;
+        return FLAGS[y][x];
     }
 
-    /** Indica si el jugador se encuentra en una casilla que sea liana "|" */
-    private static Boolean isLiana(Character t) {
-        return t != null && t == '|';
+    /**
+     * Indica si la celda en las coordenadas especificadas tiene el flag dado.
+     *
+     * @param x    coordenada horizontal en el mapa
+     * @param y    coordenada vertical en el mapa
+     * @param flag uno o más {@link TileFlags} combinados
+     * @return {@code true} si la celda tiene alguno de los flags
+     */
+    private static boolean hasFlag(int x, int y, int flag) {
+        return (flagsAt(x, y) & flag) != 0;
     }
 
     /**
      * Indica si en la posición (x, y) del mapa hay una liana ('|').
      */
-    public static Boolean isLianaAt(Integer x, Integer y) {
-        return tileAt(x, y) == '|';
+    public static boolean isLianaAt(int x, int y) {
+        return hasFlag(x, y, TileFlags.LIANA);
     }
 
 
      /**
      * Devuelve true si el jugador tiene un bloque "sólido" justo debajo
-     * (plataforma, tierra, liana, spawn o meta).
+     * (plataforma, tierra, liana o spawn).
      * Ojo: el jugador está en (x, y) pero el bloque de apoyo está en (x, y-1).
      */
-    private static Boolean hasSolidBelow(Integer x, Integer y) {
+    private static boolean hasSolidBelow(int x, int y) {
         if (y <= MIN_Y) return false; // no hay nada más abajo
-        Character below = tileAt(x, y - 1);
-        return isSolidTile(below);
+        return hasFlag(x, y - 1, TileFlags.SOLID);
     }
 
     /**
@@ -224,36 +250,24 @@ public class Server {
      *  - De pie sobre plataformas (jugador en '.', plataforma en y-1)
      *  - Colgado de lianas (jugador en '|')
      */
-    private static Boolean isSupported(Integer x, Integer y) {
-        Character here = tileAt(x, y);
-        // Si estoy parado en un tile sólido, ya con eso basta
-        if (isSolidTile(here)) {
-            return true;
-        }
-
-        // O si tengo un sólido justo debajo (estoy 1 casilla por encima de la plataforma)
-        return hasSolidBelow(x, y);
-    }
-
-    private static Boolean isPlatformLike(Character t) {
-        return t != null && (t == '=' || t == 'T' || t == 'S');
+    private static boolean isSupported(int x, int y) {
+        // Si estoy parado en un tile sólido, ya con eso basta; si no, basta
+        // un sólido justo debajo (estoy 1 casilla por encima de la plataforma)
+        return hasFlag(x, y, TileFlags.SOLID) || hasSolidBelow(x, y);
     }
 
     /**
      * Indica si el jugador puede moverse una casilla hacia arriba desde (x,y),
      * sin atravesar un techo.
      */
-    private static Boolean canMoveUpFrom(Integer x, Integer y) {
-        Character here  = tileAt(x, y);
-        Character above = tileAt(x, y + 1);
-
+    private static boolean canMoveUpFrom(int x, int y) {
         // Techo: cualquier tile sólido arriba que NO sea liana
-        if (isSolidTile(above) && !isLiana(above)) {
+        if (hasFlag(x, y + 1, TileFlags.CEILING)) {
             return false;
         }
 
         // Solo se puede subir si estás en liana o en una superficie sólida
-        return isLiana(here) || isPlatformLike(here);
+        return hasFlag(x, y, TileFlags.LIANA | TileFlags.CEILING);
     }
 
 
@@ -268,7 +282,13 @@ public class Server {
     private final ConcurrentHashMap<Integer, GameSession> sessions = new ConcurrentHashMap<>();
 
     /* ========= Game Loop / Scheduler ========= */
+    /** Período del bucle de juego en milisegundos. */
+    private static final Integer TICK_MS = 125;
+    /** Ticks por segundo: el máximo de STATE por segundo que pide {@code +RATE}. */
+    static final Integer TICKS_PER_SECOND = 1000 / TICK_MS;
     private final ScheduledExecutorService ticker = Executors.newSingleThreadScheduledExecutor();
+    /** Tiempos por fase y overruns del tick; se publican como {@code STATS}. */
+    private final TickProfiler profiler = new TickProfiler(TICK_MS);
 
     /**
      * Inicializa el socket del servidor, lo enlaza al puerto y comienza a escuchar
@@ -282,237 +302,439 @@ public class Server {
 
         serverSocket = new ServerSocket();
         serverSocket.bind(new InetSocketAddress("127.0.0.1", port));
-        System.out.println("[JAVA] Servidor escuchando en puerto " + port + " ...");
+        Log.info("JAVA", "Servidor escuchando en puerto " + port + " ...");
 
-        ticker.scheduleAtFixedRate(this::tick, 125, 125, TimeUnit.MILLISECONDS);
+        ticker.scheduleAtFixedRate(this::tick, TICK_MS, TICK_MS, TimeUnit.MILLISECONDS);
         new Thread(this::adminLoop, "AdminConsole").start();
 
         while (!serverSocket.isClosed()) {
             try {
                 Socket socket = serverSocket.accept();
                 socket.setTcpNoDelay(true);
-                System.out.println("[JAVA] Cliente conectado: " + socket.getRemoteSocketAddress());
+                Log.info("JAVA", "Cliente conectado: " + socket.getRemoteSocketAddress());
                 ClientHandler handler = new ClientHandler(socket, this);
                 clients.add(handler);
                 pool.submit(handler);
+                pool.submit(handler::drainOutbound);
             } catch (SocketException se) {
-                System.out.println("[JAVA] Aceptación detenida: " + se.getMessage());
+                Log.info("JAVA", "Aceptación detenida: " + se.getMessage());
                 break;
             }
         }
     }
 
-    /** Contador de enemigos  */
-    private Integer enemiesBroadcastCounter = 0;
-    private static final Integer ENEMIES_BROADCAST_EVERY = 2;
-
-    /* ========= TICK: procesa inputs, simula enemigos y notifica ========= */
+    /* ========= Simulación en paralelo ========= */
     /**
-     * El ciclo principal de simulación del juego (Game Loop).
-     *
-     * <p>Se ejecuta a una tasa fija (controlada por {@link #ticker}) y realiza
-     * tres pasos principales:</p>
-     * <ol>
-     * <li>Procesar los inputs de la {@link #inputQueue} y actualizar la posición de los {@link Player}.</li>
-     * <li>Simular los enemigos y chequear eventos de juego (colisiones, recoger frutas, meta).</li>
-     * <li>Enviar el nuevo estado del juego a los jugadores y espectadores.</li>
-     * </ol>
+     * Cantidad de shards de simulación. Las sesiones y sus inputs se reparten
+     * por {@code playerId} ({@link #shardOf(Integer)}); el shard 0 corre en el
+     * hilo del ticker y el resto en {@link #simWorkers}.
      */
-    private void tick() {
-        // 1) De TODOS los inputs pendientes, nos quedamos con el "mejor" de cada jugador:
-        //    - Preferimos saltos (dy > 0) sobre movimientos normales.
-        //    - A igual dy, preferimos el de mayor |dx| (p.ej. dx=±2 para salto horizontal).
-        Map<Integer, InputEvent> bestInputByPlayer = new HashMap<>();
+    private static final Integer SIM_SHARDS = Math.max(1, Runtime.getRuntime().availableProcessors());
+    /** Hilos fijos que simulan los shards 1..n-1 de cada tick, uno por shard. */
+    private final Thread[] simWorkers = new Thread[SIM_SHARDS - 1];
+    /** Shards de simulación; cada sesión pertenece siempre al mismo. */
+    private final Shard[] shards = new Shard[SIM_SHARDS];
+    /*
+     * Barreras del tick, reusadas en todos: el ticker avanza simStart para
+     * soltar a los workers y espera en simDone a que lleguen todos (él
+     * incluido). Un Phaser no se recrea por tick, a diferencia de un latch
+     * o de las tareas de un ExecutorService.
+     */
+    private final Phaser simStart = new Phaser(1);
+    private final Phaser simDone  = new Phaser(SIM_SHARDS);
 
-        InputEvent ev;
-        while ((ev = inputQueue.poll()) != null) {
-            if (ev == null) continue;
+    /**
+     * Bucle de un worker de simulación: espera cada tick, simula su shard y
+     * avisa que terminó. Sale cuando {@link #stop()} lo interrumpe.
+     */
+    private final class SimWorker implements Runnable {
+        private final Shard shard;
 
-            InputEvent prev = bestInputByPlayer.get(ev.playerId);
+        SimWorker(Shard shard) {
+            this.shard = shard;
+        }
 
-            if (prev == null) {
-                bestInputByPlayer.put(ev.playerId, ev);
-            } else {
-                // 1) Si el nuevo tiene más "dy" (es salto y el otro no), gana el nuevo
-                if (ev.dy > prev.dy) {
-                    bestInputByPlayer.put(ev.playerId, ev);
-                }
-                // 2) Si tienen el mismo dy, preferimos el que tenga |dx| más grande
-                else if (ev.dy.equals(prev.dy)
-                        && Math.abs(ev.dx) > Math.abs(prev.dx)) {
-                    bestInputByPlayer.put(ev.playerId, ev);
+        @Override
+        public void run() {
+            int phase = 0;   // fase inicial del Phaser: no se pierde un tick que ya empezó
+            try {
+                while (true) {
+                    simStart.awaitAdvanceInterruptibly(phase);
+                    phase = (phase + 1) & Integer.MAX_VALUE;
+                    try {
+                        shard.run();
+                    } finally {
+                        simDone.arrive();
+                    }
                 }
-                // 3) En cualquier otro caso, mantenemos el anterior
+            } catch (InterruptedException e) {
+                // Servidor detenido
             }
         }
+    }
 
-        // Set para saber quién saltó en este tick (para la gravedad)
-        Set<Integer> jumpedThisTick = new HashSet<>();
-
-        // Aplicamos SOLO un movimiento por jugador en este tick
-        for (InputEvent input : bestInputByPlayer.values()) {
-            Player p = players.get(input.playerId);
-            if (p == null) continue;
-
-            Integer oldY = p.y;
-            Integer nx   = p.x + input.dx;
-            Integer ny   = p.y + input.dy;
-
-            // Límites del mapa
-            if (nx < MIN_X) nx = MIN_X;
-            if (nx > MAX_X) nx = MAX_X;
-            if (ny < MIN_Y) ny = MIN_Y;
-            if (ny > MAX_Y) ny = MAX_Y;
-
-            // Colisión con paredes (T y =)
-            Character dest = tileAt(nx, ny);
-            if (dest != null && (dest == 'T' || dest == '=')) {
-                nx = p.x;
-                ny = p.y;
-            }
-
-            p.x = nx;
-            p.y = ny;
-            p.lastAckSeq = Math.max(p.lastAckSeq, input.seq);
+    /**
+     * Un grupo de sesiones que se simula completo en un solo hilo: inputs,
+     * gravedad, enemigos, colisiones, frutas, meta y el envío de STATE y
+     * keyframes.
+     * <p>Las sesiones son independientes entre sí, así que los shards corren
+     * en paralelo sin más estado compartido que los mapas concurrentes de
+     * registro y las colas de salida de los clientes. Una sesión cambia con
+     * el monitor tomado igual que antes, por lo que un espectador o la
+     * consola de administración siguen viendo cada sesión entre ticks.</p>
+     */
+    private final class Shard implements Runnable {
+        /** Inputs de los jugadores de este shard (los encola {@link #onInput}). */
+        final InputBuffer inputs = new InputBuffer();
+        /** Sesiones del tick en curso; el ticker las copia de {@link #owned} antes del paso. */
+        final List<GameSession> sessions = new ArrayList<>();
+        /**
+         * Sesiones en juego de este shard; cambian al admitir o guardar una
+         * sesión, desde los hilos de los clientes, con su monitor tomado.
+         */
+        private final List<GameSession> owned = new ArrayList<>();
 
-            // Si en este tick subió al menos 1 casilla, marcamos que "saltó"
-            if (ny > oldY) {
-                jumpedThisTick.add(input.playerId);
+        void addSession(GameSession session) {
+            synchronized (owned) {
+                owned.add(session);
             }
         }
 
-        // 1b) GRAVEDAD + agua
-        sessions.forEach((pid, session) -> {
-            Player p = players.get(pid);
-            if (p == null) return;
-
-            // Tile actual donde está parado el jugador
-            Character here = tileAt(p.x, p.y);
-            Boolean onLiana = isLiana(here);
-
-            // Si NO saltó hacia arriba en este tick, se le aplica gravedad normal,
-            // PERO no cae si está colgado de una liana.
-            if (!jumpedThisTick.contains(pid)) {
-                // Gravedad: si NO hay nada sólido justo debajo Y no está en liana, cae una casilla
-                if (!onLiana && p.y > MIN_Y && !hasSolidBelow(p.x, p.y)) {
-                    p.y -= 1;  // y-- = cae hacia abajo
-                }
+        void removeSession(GameSession session) {
+            synchronized (owned) {
+                owned.remove(session);
             }
+        }
 
-            // Agua: cuenta como golpe → pierde vida y respawn / gameOver
-            if (isWater(p.x, p.y)) {
-                handlePlayerHit(session, p);
+        /** Copia las sesiones en juego a {@link #sessions} para el tick en curso. */
+        void takeSessions() {
+            sessions.clear();
+            synchronized (owned) {
+                for (int i = 0; i < owned.size(); i++) sessions.add(owned.get(i));
             }
-        });
-
+        }
 
+        /*
+         * Borradores reusados en cada tick: el paso recorre todo por índice
+         * y no crea colecciones, así que simular no genera basura mientras
+         * nada cambie (solo lo que se envía: STATE, deltas y listas).
+         */
+        /** Jugadores con inputs en el tick en curso. */
+        final List<Player> touched = new ArrayList<>();
+        /** Tiempo de cada fase en el último paso ({@code TickProfiler.PHASE_*}). */
+        final long[] phaseNanos = new long[TickProfiler.PHASE_COUNT];
 
-        // 2) Simulación de enemigos + colisiones
-        sessions.forEach((pid, session) -> {
-            Player p = players.get(pid);
-            if (p == null) return;
+        /** Número de STATE del tick en curso. */
+        Integer seq;
 
-            Boolean hitThisTick = false;
+        /**
+         * Un paso de simulación de las sesiones del shard. Una excepción se
+         * registra y no detiene el tick de los demás shards.
+         */
+        @Override
+        public void run() {
+            try {
+                step();
+            } catch (RuntimeException e) {
+                Log.error("JAVA", "Error en shard de simulación: " + e, e);
+            }
+        }
 
-            // Lista temporal para eliminar blue crocs que llegan a y=0
-            List<Enemy> toRemove = new ArrayList<>();
-            Boolean enemiesChangedThisTick = false;
+        private void step() {
+            long phaseStart = System.nanoTime();
+
+            // 1) De TODOS los inputs pendientes, nos quedamos con el "mejor" de cada jugador:
+            //    - Preferimos saltos (dy > 0) sobre movimientos normales.
+            //    - A igual dy, preferimos el de mayor |dx| (p.ej. dx=±2 para salto horizontal).
+            // Todo input consumido queda reconocido (aunque se descarte), para
+            // que la predicción del cliente deje de reproducirlo. La elección
+            // se guarda en el borrador de cada Player y los jugadores con
+            // inputs quedan en touched, así que no se arma ningún mapa.
+            touched.clear();
+            int count = inputs.drain();
+            for (int i = 0; i < count; i++) {
+                Player p  = inputs.player(i);
+                int    dx = inputs.dx(i);
+                int    dy = inputs.dy(i);
+
+                if (!p.tickSeen) {
+                    p.tickSeen    = true;
+                    p.tickMaxSeq  = inputs.seq(i);
+                    p.tickHasMove = false;
+                    touched.add(p);
+                } else if (inputs.seq(i) > p.tickMaxSeq) {
+                    p.tickMaxSeq = inputs.seq(i);
+                }
+                if (dx == 0 && dy == 0) continue; // anulado en onInput: solo se reconoce
+
+                // 1) El primero gana si no hay otro
+                // 2) Si el nuevo tiene más "dy" (es salto y el otro no), gana el nuevo
+                // 3) Si tienen el mismo dy, preferimos el que tenga |dx| más grande
+                // 4) En cualquier otro caso, mantenemos el anterior
+                if (!p.tickHasMove
+                        || dy > p.tickDy
+                        || (dy == p.tickDy && Math.abs(dx) > Math.abs(p.tickDx))) {
+                    p.tickHasMove = true;
+                    p.tickDx = dx;
+                    p.tickDy = dy;
+                }
+            }
 
-            for (Enemy e : session.enemies) {
-                Integer oldEx = e.getX();
-                Integer oldEy = e.getY();
+            // Aplicamos SOLO un movimiento por jugador en este tick
+            for (int i = 0, n = touched.size(); i < n; i++) {
+                Player p = touched.get(i);
+                p.tickSeen = false;
+                if (p.tickMaxSeq > p.lastAckSeq) p.lastAckSeq = p.tickMaxSeq;
+                if (!p.tickHasMove) continue;
+
+                int oldY = p.y;
+                int nx   = p.x + p.tickDx;
+                int ny   = p.y + p.tickDy;
+
+                // Límites del mapa
+                if (nx < MIN_X) nx = MIN_X;
+                if (nx > MAX_X) nx = MAX_X;
+                if (ny < MIN_Y) ny = MIN_Y;
+                if (ny > MAX_Y) ny = MAX_Y;
+
+                // Colisión con paredes (T y =)
+                if (hasFlag(nx, ny, TileFlags.WALL)) {
+                    nx = p.x;
+                    ny = p.y;
+                }
 
-                e.tick(MIN_Y, MAX_Y, p.round);
+                p.x = nx;
+                p.y = ny;
 
-                // Si el enemigo dejó de estar activo (BlueCroc que llegó a y=0)
-                if (!e.isActive()) {
-                    toRemove.add(e);
-                    enemiesChangedThisTick = true;
-                    continue;
+                // Si en este tick subió al menos 1 casilla, marcamos que "saltó"
+                // (para la gravedad)
+                if (ny > oldY) {
+                    p.tickJumped = true;
                 }
-
-                if (e.getX() != oldEx || e.getY() != oldEy){
-                    enemiesChangedThisTick = true;
+            }
+            phaseStart = endPhase(TickProfiler.PHASE_INPUT, phaseStart);
+
+            // 1b) GRAVEDAD + agua
+            for (int i = 0, n = sessions.size(); i < n; i++) {
+                GameSession session = sessions.get(i);
+                Player p = players.get(session.playerId);
+                if (p == null) continue;
+
+                // Tile actual donde está parado el jugador
+                boolean onLiana = hasFlag(p.x, p.y, TileFlags.LIANA);
+
+                // Si NO saltó hacia arriba en este tick, se le aplica gravedad normal,
+                // PERO no cae si está colgado de una liana.
+                if (!p.tickJumped) {
+                    // Gravedad: si NO hay nada sólido justo debajo Y no está en liana, cae una casilla
+                    if (!onLiana && p.y > MIN_Y && !hasSolidBelow(p.x, p.y)) {
+                        p.y -= 1;  // y-- = cae hacia abajo
+                    }
                 }
 
-                // Colisión exacta con el jugador (misma casilla)
-                if (!hitThisTick
-                        && e.getX().equals(p.x)
-                        && e.getY().equals(p.y)) {
+                // Agua: cuenta como golpe → pierde vida y respawn / gameOver
+                if (hasFlag(p.x, p.y, TileFlags.WATER)) {
                     handlePlayerHit(session, p);
-                    hitThisTick = true;
                 }
             }
+            // Solo saltó quien tuvo input, y solo en este tick
+            for (int i = 0, n = touched.size(); i < n; i++) touched.get(i).tickJumped = false;
+            phaseStart = endPhase(TickProfiler.PHASE_GRAVITY, phaseStart);
+
+
+
+            // 2) Simulación de enemigos + colisiones
+            for (int i = 0, n = sessions.size(); i < n; i++) {
+                GameSession session = sessions.get(i);
+                Integer pid = session.playerId;
+                Player p = players.get(pid);
+                if (p == null) continue;
+
+                // Con el monitor de la sesión: un espectador que entra a mitad
+                // del tick no puede tomar la foto entre el movimiento y su envío
+                synchronized (session) {
+                    // Mover cada enemigo y copiar su posición a las columnas
+                    // de la sesión (y a la grilla de ocupación)
+                    boolean anyInactive = false;
+                    for (int k = 0, m = session.enemies.size(); k < m; k++) {
+                        Enemy e = session.enemies.get(k);
+                        e.tick(MIN_Y, MAX_Y, p.round);
+                        session.enemyMoved(k);
+                        // BlueCroc que llegó a y=0
+                        if (!e.isActive()) anyInactive = true;
+                    }
+                    if (anyInactive) {
+                        session.removeInactiveEnemies();
+                    }
 
-            if (!toRemove.isEmpty()) {
-                session.enemies.removeAll(toRemove);
-            }
+                    // Colisión exacta con el jugador (misma casilla): una
+                    // lectura de la grilla, sin recorrer los enemigos
+                    if (session.enemyAt(p.x, p.y)) {
+                        handlePlayerHit(session, p);
+                    }
 
-            if (enemiesChangedThisTick){
-                session.enemiesDirty = true;
-            }
+                    // FRUTAS: igual, solo se recorren si hay alguna en el tile
+                    if (session.fruitAt(p.x, p.y)) {
+                        p.score += session.takeFruitsAt(p.x, p.y);
+                        sendFruitsForPlayer(pid, session);
+                    }
 
-            // FRUTAS (tu código tal cual)
-            Boolean fruitsChanged = false;
-            Iterator<Fruit> it = session.fruits.iterator();
-            while (it.hasNext()) {
-                Fruit f = it.next();
-                if (f.getX().equals(p.x) && f.getY().equals(p.y)) {
-                    p.score += f.getPoints();
-                    it.remove();
-                    fruitsChanged = true;
+                    // META por tile...
+                    if (hasFlag(p.x, p.y, TileFlags.GOAL)) {
+                        p.round++;
+                        p.lives++;
+                        p.x = session.spawnX;
+                        p.y = session.spawnY;
+                        p.gameOver = false;
+                        resetFruitsFromTemplates(pid, session);
+                    }
+
+                    // Enemigos: solo sale algo si se movieron, aparecieron o
+                    // desaparecieron (ver sendEnemiesForPlayer)
+                    sendEnemiesForPlayer(pid, session);
                 }
             }
-            if (fruitsChanged) {
-                sendFruitsForPlayer(pid, session);
-            }
+            phaseStart = endPhase(TickProfiler.PHASE_ENEMIES, phaseStart);
+
+
+
+            // 3) Notificar estado a los clientes. Solo se arma un STATE nuevo
+            //    si cambió algo; si no, se reusa el último (mismos bytes y
+            //    seq) para los clientes sin +RATE, que reciben uno por tick
+            Integer seq = this.seq;
+            for (int i = 0, n = sessions.size(); i < n; i++) {
+                GameSession session = sessions.get(i);
+                Integer id = session.playerId;
+                Player p = players.get(id);
+                if (p == null) continue;
+
+                boolean changed = session.takeStateChange(p);
+                Broadcast state = session.lastState;
+                if (changed || state == null) {
+                    state = stateMessage(seq, p);
+                    // Último STATE de la foto que recibe un espectador nuevo
+                    session.lastState = state;
+                }
+                sendToPlayerAndSpectators(id, state, changed, seq);
 
-            // META por tile...
-            Character tileHere = tileAt(p.x, p.y);
-            if (tileHere != null && tileHere == 'G') {
-                p.round++;
-                p.lives++;
-                p.x = session.spawnX;
-                p.y = session.spawnY;
-                p.gameOver = false;
-                resetFruitsFromTemplates(pid, session);
+                // 4) Listas completas para quien las pidió (RESYNC o espectador nuevo)
+                serveKeyframeRequests(id, session);
             }
+            endPhase(TickProfiler.PHASE_BROADCAST, phaseStart);
+        }
 
-            sendEnemiesForPlayer(pid, session);
-        });
+        /**
+         * Cierra una fase del paso.
+         *
+         * @param phase      una de las constantes {@code TickProfiler.PHASE_*}
+         * @param phaseStart fin de la fase anterior
+         * @return el momento actual, inicio de la fase siguiente
+         */
+        private long endPhase(int phase, long phaseStart) {
+            long now = System.nanoTime();
+            phaseNanos[phase] = now - phaseStart;
+            return now;
+        }
+    }
 
+    /**
+     * Devuelve el shard al que pertenecen la sesión y los inputs de un jugador.
+     *
+     * @param playerId identificador del jugador
+     * @return su shard; siempre el mismo para el mismo id
+     */
+    private Shard shardOf(Integer playerId) {
+        return shards[Math.floorMod(playerId, SIM_SHARDS)];
+    }
 
+    /* ========= TICK: procesa inputs, simula enemigos y notifica ========= */
+    /**
+     * El ciclo principal de simulación del juego (Game Loop).
+     *
+     * <p>Se ejecuta a una tasa fija (controlada por {@link #ticker}). Reparte
+     * las sesiones entre los {@link Shard} y los simula en paralelo; cada
+     * uno realiza, para sus sesiones, tres pasos principales:</p>
+     * <ol>
+     * <li>Procesar sus inputs pendientes y actualizar la posición de los {@link Player}.</li>
+     * <li>Simular los enemigos y chequear eventos de juego (colisiones, recoger frutas, meta).</li>
+     * <li>Enviar el nuevo estado del juego a los jugadores y espectadores.</li>
+     * </ol>
+     * <p>El tick termina cuando terminan todos los shards (barrera), así que
+     * dos ticks nunca se solapan. Los shards 1..n-1 corren en hilos fijos
+     * que se sincronizan con dos {@link Phaser} reusados, así que el reparto
+     * no crea tareas ni futures; lo único propio del tick que se crea es el
+     * {@code Integer} del número de STATE. Cada fase se mide con {@link #profiler};
+     * una vez por segundo el resumen se envía a los clientes suscritos
+     * ({@link #publishStats()}).</p>
+     */
+    private void tick() {
+        profiler.beginTick();
 
-        // 2.5) Enviar enemigos solo cada ENEMIES_BROADCAST_EVERY ticks
-        enemiesBroadcastCounter++;
-        if (enemiesBroadcastCounter % ENEMIES_BROADCAST_EVERY == 0) {
-            sessions.forEach((pid, session) -> {
-                if (session.enemiesDirty) {
-                    sendEnemiesForPlayer(pid, session);
-                    session.enemiesDirty = false;
-                }
-            });
+        // Parámetros comunes del tick y sesiones en juego de cada shard
+        Integer seq = tickSeq.incrementAndGet();
+        for (Shard shard : shards) {
+            shard.seq = seq;
+            shard.takeSessions();
         }
 
+        // Paso paralelo: los shards 1..n-1 en los workers y el 0 en este hilo
+        simStart.arrive();
+        shards[0].run();
 
+        // Barrera: el tick no termina hasta que termina el último shard
+        try {
+            simDone.awaitAdvanceInterruptibly(simDone.arrive());
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            return;
+        }
+        for (Shard shard : shards) profiler.recordShardPhases(shard.phaseNanos);
 
-        // 3) Notificar estado a los clientes
-        Integer seq = tickSeq.incrementAndGet();
-        players.forEach((id, p) -> {
-            String state = String.format(
-                    Locale.ROOT,
-                    "STATE %d %d %d %d %d %d %d %b%n",
-                    seq, id,
-                    p.x, p.y,
-                    p.score,
-                    p.round,   // nivel
-                    p.lives,   // vidas
-                    p.gameOver
-            );
-            sendToPlayerAndSpectators(id, state);
-        });
+        long overrunMs = profiler.endTick();
+        if (overrunMs >= 0) {
+            Log.warn("JAVA", "Tick de " + overrunMs + " ms (período " + TICK_MS
+                    + " ms): " + profiler.phaseMaxSummary());
+        }
+        if (profiler.windowComplete()) {
+            publishStats();
+            profiler.resetWindow();
+        }
+    }
+
+    /**
+     * Envía el resumen de la ventana del {@link #profiler} a los clientes
+     * suscritos con {@code STATS ON}: una línea {@code STATS}, una
+     * {@code STATS_CLIENT} por cliente conectado y {@code STATS_END}.
+     * <p>La telemetría de envío de cada cliente se reinicia aunque nadie
+     * esté suscrito, para que cada ventana cubra un solo segundo; en ese
+     * caso no se arma ninguna línea.</p>
+     */
+    private void publishStats() {
+        boolean subscribed = false;
+        for (ClientHandler ch : clients) {
+            if (ch.wantsStats()) {
+                subscribed = true;
+                break;
+            }
+        }
+        if (!subscribed) {
+            for (ClientHandler ch : clients) ch.resetSendStats();
+            Log.resetStats();
+            return;
+        }
 
+        StringBuilder report = new StringBuilder(profiler.statsLine(clients.size(), Log.statsFields()));
+        for (ClientHandler ch : clients) {
+            Integer id = byClient.get(ch);
+            if (id == null) id = spectatedPlayer.getOrDefault(ch, 0);
+            report.append(ch.takeSendStatsLine(id));
+        }
+        report.append("STATS_END\n");
 
+        Broadcast stats = Broadcast.ofText(report.toString());
+        for (ClientHandler ch : clients) {
+            if (ch.wantsStats()) ch.sendReliable(stats);
+        }
     }
 
 
@@ -545,6 +767,7 @@ public class Server {
     public void onJoin(ClientHandler c, String name) {
     Integer id = nextId.getAndIncrement();
     Player p = new Player(id, name);
+    p.rejoinToken = newRejoinToken();
 
     // Crear sesión de juego (aún no registrada globalmente)
     GameSession session = new GameSession(id);
@@ -557,22 +780,98 @@ public class Server {
     // (p.round y p.lives ya los inicializaste en el constructor)
     // ==============================
 
-    // 1) Notificar al cliente que se ha unido correctamente
-    c.sendLine("JOINED " + id + "\n");
+    admitPlayer(c, p, session);
+    Log.info("JAVA", "JOIN -> id=" + id + " name=" + name);
+}
 
-    // 2) Enviar la descripción del mapa lógico antes de que empiecen los STATE
-    sendMapTo(c);
+    /**
+     * Maneja {@code REJOIN <token>}: el cliente vuelve a jugar con la
+     * sesión que dejó con {@code LEAVE} (o al desconectarse).
+     * <p>El {@link Player} y la {@link GameSession} guardados se reinician
+     * en el lugar (vidas, puntaje, spawn, enemigos y frutas de las
+     * plantillas) y se registran con el mismo id, con el mismo flujo que
+     * {@link #onJoin(ClientHandler, String)}. Si el token no existe o
+     * expiró se responde {@code ERR BAD_TOKEN} y el cliente hace JOIN.</p>
+     *
+     * @param c     manejador del cliente
+     * @param token token recibido en {@code JOINED ... TOKEN <token>}
+     */
+    public void onRejoin(ClientHandler c, String token) {
+        if (byClient.containsKey(c)) {
+            c.sendLine("ERR ALREADY_PLAYING\n");
+            return;
+        }
+        // La poda de parked solo corre al guardar otra sesión: un token
+        // vencido puede seguir en el mapa y no debe aceptarse
+        ParkedSession ps = parked.remove(token);
+        if (ps == null || System.currentTimeMillis() - ps.parkedAt > PARKED_TTL_MS) {
+            c.sendLine("ERR BAD_TOKEN\n");
+            return;
+        }
 
-    // 3) Registrar al jugador en las estructuras globales
-    players.put(id, p);
-    byClient.put(c, id);
-    playerClients.add(c);
-    sessions.put(id, session);
-    sendFruitsForPlayer(id, session);
-    sendEnemiesForPlayer(id, session);
+        Player p = ps.player;
+        GameSession session = ps.session;
+        synchronized (session) {
+            session.restart(templateEnemies, templateFruits);
+        }
+        p.restart(session.spawnX, session.spawnY);
 
-    System.out.println("[JAVA] JOIN -> id=" + id + " name=" + name);
-}
+        admitPlayer(c, p, session);
+        Log.info("JAVA", "REJOIN -> id=" + p.id + " name=" + p.name);
+    }
+
+    /**
+     * Confirma a un jugador y lo registra para que el tick empiece a
+     * simular su sesión: {@code JOINED}, mapa, estructuras globales y
+     * listas iniciales.
+     *
+     * @param c       manejador del cliente
+     * @param p       jugador ya posicionado en el spawn
+     * @param session su sesión, con enemigos y frutas cargados
+     */
+    private void admitPlayer(ClientHandler c, Player p, GameSession session) {
+        Integer id = p.id;
+
+        // 1) Notificar al cliente que se ha unido correctamente (y confirmar
+        //    el protocolo pedido con +BIN; desde aquí se usa ese formato).
+        //    El token permite volver a esta sesión con REJOIN.
+        c.sendLine("JOINED " + id + c.protocolSuffix() + " TOKEN " + p.rejoinToken + "\n");
+        c.activateNegotiatedProtocol();
+
+        // 2) Enviar la descripción del mapa lógico antes de que empiecen los STATE
+        sendMapTo(c);
+
+        // 3) Registrar al jugador en las estructuras globales
+        players.put(id, p);
+        byClient.put(c, id);
+        clientByPlayer.put(id, c);
+        playerClients.add(c);
+        sessions.put(id, session);
+        shardOf(id).addSession(session);
+        sendFruitsForPlayer(id, session);
+        sendEnemiesForPlayer(id, session);
+    }
+
+    /**
+     * Maneja {@code LEAVE}: el cliente deja de jugar o de espectar pero
+     * mantiene la conexión para la próxima partida.
+     * <p>Si era jugador, su sesión se guarda para {@code REJOIN}. Se
+     * responde {@code LEFT} en el formato actual y la conexión vuelve a
+     * texto sin opciones, como recién conectada.</p>
+     *
+     * @param c manejador del cliente
+     */
+    public void onLeave(ClientHandler c) {
+        detachClient(c);
+        c.leaveSession();
+    }
+
+    /**
+     * Token aleatorio de reingreso (64 bits en hexadecimal).
+     */
+    private String newRejoinToken() {
+        return String.format(Locale.ROOT, "%016x", tokenRandom.nextLong());
+    }
 
 
 
@@ -585,7 +884,7 @@ public class Server {
      * @param dx  desplazamiento horizontal (-1, 0 o +1)
      * @param dy  desplazamiento vertical (-1, 0 o +1)
      */
-    public void onInput(ClientHandler c, Integer seq, Integer dx, Integer dy) {
+    public void onInput(ClientHandler c, int seq, int dx, int dy) {
         Integer id = byClient.get(c);
         if (id == null) {
             c.sendLine("ERR NOT_PLAYER\n");
@@ -615,19 +914,16 @@ public class Server {
                 dy = 0;
             } else {
                 // 2) No puede haber un “techo” sólido justo encima
-                Character above = tileAt(p.x, p.y + 1);
-                if (isSolidTile(above) && !isLiana(above)) {
+                if (hasFlag(p.x, p.y + 1, TileFlags.CEILING)) {
                     dx = 0;
                     dy = 0;
                 }
             }
         }
 
-        if (dx == 0 && dy == 0) {
-            return;
-        }
-
-        inputQueue.offer(new InputEvent(id, seq, dx, dy));
+        // Aunque quede anulado se encola igual (como 0,0): así su seq se
+        // reconoce en el próximo STATE y el cliente corrige su predicción
+        shardOf(id).inputs.offer(p, seq, dx, dy);
     }   
 
 
@@ -649,8 +945,11 @@ public class Server {
      *
      * <p>Si el jugador ya existe, el cliente se añade directamente a la lista
      * de espectadores y se le envía la confirmación
-     * <code>SPECTATE_OK &lt;playerId&gt;</code>, seguida del mapa lógico
-     * mediante {@link #sendMapTo(ClientHandler)}. Si el jugador aún no existe,
+     * <code>SPECTATE_OK &lt;playerId&gt; [+BIN]</code>, seguida en la misma
+     * ráfaga del mapa lógico y de la foto de la sesión
+     * ({@link #sendSnapshotTo(ClientHandler, GameSession)}): el espectador
+     * dibuja frutas, enemigos y al jugador sin esperar al próximo envío.
+     * Si el jugador aún no existe,
      * el cliente se inserta en {@link #waitingSpectatorsByPlayer} y se le
      * responde <code>SPECTATE_WAIT &lt;playerId&gt;</code>.</p>
      *
@@ -661,14 +960,22 @@ public class Server {
      */
     public void onSpectate(ClientHandler c, Integer playerId) {
         Player p = players.get(playerId);
-        if (p != null) {
-            spectatorsByPlayer
-                .computeIfAbsent(playerId, k -> new CopyOnWriteArrayList<>())
-                .add(c);
-            c.sendLine("SPECTATE_OK " + playerId + "\n");
-
-            // Enviar la descripción del mapa lógico al nuevo espectador
-            sendMapTo(c);
+        GameSession session = sessions.get(playerId);
+        if (p != null && session != null) {
+            c.sendLine("SPECTATE_OK " + playerId + c.protocolSuffix() + "\n");
+            c.activateNegotiatedProtocol();
+
+            // Foto y registro con el monitor de la sesión: ningún delta de
+            // frutas o enemigos queda entre el keyframe y la suscripción
+            synchronized (session) {
+                sendSnapshotTo(c, session);
+
+                // Se registra al final para que ningún STATE se adelante al mapa
+                spectatorsByPlayer
+                    .computeIfAbsent(playerId, k -> new CopyOnWriteArrayList<>())
+                    .add(c);
+                spectatedPlayer.put(c, playerId);
+            }
 
         } else {
             waitingSpectatorsByPlayer
@@ -685,7 +992,7 @@ public class Server {
      * listado de jugadores:</p>
      *
      * <pre>
-     * PLAYERS_BEGIN
+     * PLAYERS_BEGIN &lt;n&gt;
      * PLAYER &lt;id&gt; &lt;name&gt;
      * PLAYER &lt;id&gt; &lt;name&gt;
      * ...
@@ -707,7 +1014,10 @@ public class Server {
             return;
         }
 
-        clientHandler.sendLine("PLAYERS_BEGIN\n");
+        // n es orientativo (la lista puede cambiar mientras se recorre);
+        // el cliente lo usa para reservar la lista de una vez
+        clientHandler.sendLine(String.format(java.util.Locale.ROOT,
+                "PLAYERS_BEGIN %d%n", players.size()));
 
         // Recorremos el mapa de jugadores activos y enviamos un renglón por cada uno
         players.forEach((id, player) -> {
@@ -735,49 +1045,59 @@ public class Server {
      * @param c manejador de cliente que se está desconectando
      */
     public void onQuit(ClientHandler c) {
+        detachClient(c);
+    }
+
+    /**
+     * Quita a un cliente de su rol actual: si era jugador su sesión se
+     * guarda para {@code REJOIN}; si era espectador deja de recibir la
+     * sesión que observaba.
+     *
+     * @param c manejador del cliente
+     */
+    private void detachClient(ClientHandler c) {
         Integer id = byClient.remove(c);
 
         if (id != null) {
-            endPlayerSession(id);
+            clientByPlayer.remove(id, c);
+            playerClients.remove(c);
+            parkPlayerSession(id);
         } else {
             spectatorsByPlayer.forEach((pid, ls) -> ls.remove(c));
+            spectatedPlayer.remove(c);
             waitingSpectatorsByPlayer.forEach((pid, ls) -> ls.remove(c));
         }
     }
 
     /* ========= Utilidades ========= */
     /**
-     * Finaliza la sesión de juego de un jugador específico.
-     * <p>Elimina el {@link Player} y la {@link GameSession}, notifica a sus
-     * espectadores, y fuerza el cierre de la conexión del {@link ClientHandler}
-     * asociado si aún está conectado.</p>
+     * Saca del juego la sesión de un jugador que se fue.
+     * <p>Quita el {@link Player} y la {@link GameSession} de las estructuras
+     * del tick y notifica a sus espectadores con {@code END}. Ambos objetos
+     * se guardan en {@link #parked} por {@link #PARKED_TTL_MS} para que el
+     * mismo cliente vuelva con {@code REJOIN} sin crear una sesión nueva.</p>
      *
      * @param playerId El ID del jugador cuya sesión debe terminar.
      */
-    private void endPlayerSession(Integer playerId) {
-        GameSession s = sessions.get(playerId);
-        if (s != null) {
-            CopyOnWriteArrayList<ClientHandler> specs = spectatorsByPlayer.remove(playerId);
-            if (specs != null) {
-                for (ClientHandler ch : specs) {
-                    ch.sendLine("END " + playerId + "\n");
-                }
+    private void parkPlayerSession(Integer playerId) {
+        Player p = players.remove(playerId);
+        GameSession s = sessions.remove(playerId);
+        if (s != null) shardOf(playerId).removeSession(s);
+
+        CopyOnWriteArrayList<ClientHandler> specs = spectatorsByPlayer.remove(playerId);
+        if (specs != null) {
+            for (ClientHandler ch : specs) {
+                ch.sendLine("END " + playerId + "\n");
+                spectatedPlayer.remove(ch, playerId);
             }
         }
-        // cerrar también el clientHandler asociado, si existe
-        ClientHandler toClose = null;
-        for (Map.Entry<ClientHandler,Integer> e : byClient.entrySet()) {
-            if (e.getValue() == playerId) { toClose = e.getKey(); break; }
-        }
-        if (toClose != null) {
-            playerClients.remove(toClose);
-            toClose.sendLine("BYE\n");
-            toClose.close();
-            clients.remove(toClose);
+
+        Long now = System.currentTimeMillis();
+        parked.values().removeIf(old -> now - old.parkedAt > PARKED_TTL_MS);
+        if (p != null && s != null) {
+            parked.put(p.rejoinToken, new ParkedSession(p, s, now));
         }
-        players.remove(playerId);
-        sessions.remove(playerId);
-        System.out.println("[JAVA] Fin de sesión -> id=" + playerId);
+        Log.info("JAVA", "Fin de sesión -> id=" + playerId + " (guardada para REJOIN)");
     }
 
     /**
@@ -788,9 +1108,9 @@ public class Server {
         private void resetFruitsFromTemplates(Integer playerId, GameSession session) {
         if (session == null) return;
 
-        session.fruits.clear();
+        session.clearFruits();
         for (Fruit tf : templateFruits) {
-            session.fruits.add(
+            session.addFruit(
                 factory.createFruit(tf.getX(), tf.getY(), tf.getPoints())
             );
         }
@@ -833,29 +1153,128 @@ public class Server {
      * patrón de diseño <b>Observador</b>. Para el {@code playerId} indicado,
      * se localiza:</p>
      * <ul>
-     *     <li>El cliente jugador asociado, usando el mapa {@link #byClient}.</li>
+     *     <li>El cliente jugador asociado, usando el índice {@link #clientByPlayer}.</li>
      *     <li>Todos los clientes espectadores registrados en
      *         {@link #spectatorsByPlayer}.</li>
      * </ul>
      *
-     * <p>A cada uno de estos observadores se le envía la misma línea
-     * de texto, que típicamente corresponde a un mensaje de estado como
-     * <code>STATE ...</code>. De esta forma, el jugador y sus espectadores
-     * reciben una vista consistente del estado de la partida.</p>
+     * <p>A cada uno de estos observadores se le envía el mismo mensaje
+     * de estado <code>STATE ...</code>, codificado una sola vez por formato.
+     * De esta forma, el jugador y sus espectadores reciben una vista
+     * consistente del estado de la partida.</p>
+     *
+     * <p>Cada observador decide según su {@code +RATE}
+     * ({@link ClientHandler#offerState(Broadcast, boolean, int)}): sin él lo
+     * encola siempre, con él solo si cambió y sin pasarse de su ritmo. Solo
+     * se encola: si un observador todavía no recibió el STATE anterior, se
+     * reemplaza por este. Se llama en cada tick por sesión, así que recorre
+     * los observadores sin armar una lista.</p>
      *
      * @param playerId
      *     Identificador del jugador cuya sesión es la fuente de la actualización.
-     * @param line
-     *     Línea de texto a enviar (debe incluir el salto de línea si se requiere).
+     * @param state
+     *     Mensaje STATE en texto y en {@link BinaryProtocol}; cada cliente
+     *     recibe los bytes del formato que negoció.
+     * @param changed
+     *     Si el STATE difiere del último difundido.
+     * @param tick
+     *     Número de tick en curso.
      */
-    private void sendToPlayerAndSpectators(Integer playerId, String line) {
-        // a jugador:
-        for (Map.Entry<ClientHandler,Integer> e : byClient.entrySet()) {
-            if (e.getValue() == playerId) e.getKey().sendLine(line);
+    private void sendToPlayerAndSpectators(Integer playerId, Broadcast state, boolean changed, int tick) {
+        ClientHandler owner = clientByPlayer.get(playerId);
+        if (owner != null) owner.offerState(state, changed, tick);
+
+        CopyOnWriteArrayList<ClientHandler> ls = spectatorsByPlayer.get(playerId);
+        if (ls != null) {
+            for (ClientHandler ch : ls) ch.offerState(state, changed, tick);
         }
-        // a espectadores:
+    }
+
+    /**
+     * Arma el STATE de un jugador con sus valores de este momento. Se copian
+     * en lugar de leerse al codificar: el mismo mensaje se reusa en los ticks
+     * siguientes mientras nada cambie.
+     *
+     * @param seq número de tick
+     * @param p   jugador
+     * @return el mensaje, que se formatea o codifica al primer destinatario
+     */
+    private static Broadcast stateMessage(Integer seq, Player p) {
+        Integer id       = p.id;
+        int     x        = p.x;
+        int     y        = p.y;
+        int     score    = p.score;
+        int     round    = p.round;
+        int     lives    = p.lives;
+        boolean gameOver = p.gameOver;
+        int     ack      = p.lastAckSeq;
+        return new Broadcast(() -> String.format(
+                Locale.ROOT,
+                "STATE %d %d %d %d %d %d %d %b %d%n",
+                seq, id,
+                x, y,
+                score,
+                round,   // nivel
+                lives,   // vidas
+                gameOver,
+                ack      // último INPUT aplicado (reconciliación)
+        ), () -> BinaryProtocol.encodeState(seq, id, x, y, score, round, lives, gameOver, ack));
+    }
+
+    /**
+     * Encola una actualización de lista al jugador de una sesión y a sus
+     * espectadores: el delta a quien negoció {@code +DELTA} y la lista
+     * completa al resto. Como {@link #sendToPlayerAndSpectators}, recorre
+     * los observadores sin armar una lista.
+     *
+     * @param playerId identificador del jugador dueño de la sesión
+     * @param full     lista completa (keyframe)
+     * @param delta    cambios, o {@code null} si no hubo
+     */
+    private void sendListUpdate(Integer playerId, Broadcast full, Broadcast delta) {
+        ClientHandler owner = clientByPlayer.get(playerId);
+        if (owner != null) sendListUpdate(owner, full, delta);
+
         CopyOnWriteArrayList<ClientHandler> ls = spectatorsByPlayer.get(playerId);
-        if (ls != null) for (ClientHandler ch : ls) ch.sendLine(line);
+        if (ls != null) {
+            for (ClientHandler ch : ls) sendListUpdate(ch, full, delta);
+        }
+    }
+
+    private static void sendListUpdate(ClientHandler ch, Broadcast full, Broadcast delta) {
+        if (ch.wantsDelta()) {
+            if (delta != null) ch.send(delta);
+        } else {
+            ch.send(full);
+        }
+    }
+
+    /**
+     * Envía a un espectador nuevo la foto de la sesión en una sola ráfaga:
+     * mapa, listas completas de frutas y enemigos y el último STATE.
+     * <p>Todo sale de lo ya armado ({@link #mapMessage} y los keyframes de
+     * {@link GameSession}), así que entrar o cambiar de jugador observado no
+     * formatea nada si otro cliente ya recibió esos bytes. Si la sesión
+     * todavía no difundió sus listas se pide un keyframe para el próximo
+     * tick, como antes. Debe llamarse con el monitor de {@code session}.</p>
+     *
+     * @param c       espectador que acaba de recibir {@code SPECTATE_OK}
+     * @param session sesión observada
+     */
+    private void sendSnapshotTo(ClientHandler c, GameSession session) {
+        sendMapTo(c);
+
+        if (session.fruitsKeyframe == null || session.enemiesKeyframe == null) {
+            // Sus deltas solo tienen sentido sobre un keyframe
+            c.requestKeyframe();
+        } else {
+            c.sendReliable(session.fruitsKeyframe);
+            c.sendReliable(session.enemiesKeyframe);
+        }
+
+        Broadcast state = session.lastState;
+        c.restartStatePacing();
+        if (state != null) c.sendState(state);
     }
 
     /**
@@ -872,6 +1291,10 @@ public class Server {
      *     <li><code>MAP_END</code>: marca el final de la descripción del mapa.</li>
      * </ul>
      *
+     * <p>Si el cliente anunció con {@code +MAPCACHE} que ya tiene este mapa
+     * ({@link #mapHash()}), se envía solo <code>MAP_CACHED &lt;hex&gt;</code>
+     * y el cliente lo toma de su caché local.</p>
+     *
      * <p>La intención es que el cliente (jugador o espectador) reciba toda la
      * información necesaria para dibujar el escenario utilizando los mismos
      * caracteres que el servidor usa internamente:</p>
@@ -894,35 +1317,43 @@ public class Server {
             return;
         }
 
+        // El cliente ya lo tiene (misma huella): basta con confirmarlo
+        if (clientHandler.hasCachedMap(MAP_HASH)) {
+            clientHandler.sendLine("MAP_CACHED " + MAP_HASH + "\n");
+            return;
+        }
+        clientHandler.sendReliable(mapMessage);
+    }
+
+    /**
+     * El mapa no cambia durante la partida: se arma (en texto o en una sola
+     * trama {@link BinaryProtocol#MSG_MAP}) la primera vez que alguien lo
+     * pide y los siguientes JOIN/SPECTATE reciben los mismos bytes.
+     */
+    private final Broadcast mapMessage = new Broadcast(
+            Server::mapText,
+            () -> BinaryProtocol.encodeMap(MAP, MAX_X - MIN_X + 1, MAX_Y - MIN_Y + 1));
+
+    /**
+     * Mapa completo en texto:
+     * <pre>
+     * MAP_SIZE &lt;ancho&gt; &lt;alto&gt;
+     * MAP_ROW &lt;y&gt; &lt;fila&gt;
+     * MAP_END
+     * </pre>
+     */
+    private static String mapText() {
         // Dimensiones del mapa en coordenadas lógicas (tiles)
         Integer width  = MAX_X - MIN_X + 1;
         Integer height = MAX_Y - MIN_Y + 1;
 
-        // Línea inicial con el tamaño del mapa
-        clientHandler.sendLine(
-                String.format(
-                        java.util.Locale.ROOT,
-                        "MAP_SIZE %d %d%n",
-                        width,
-                        height
-                )
-        );
-
-        // Una línea por cada fila del mapa lógico
+        StringBuilder sb = new StringBuilder();
+        sb.append("MAP_SIZE ").append(width).append(' ').append(height).append('\n');
         for (Integer y = MIN_Y; y <= MAX_Y; y++) {
-            String row = new String(MAP[y]);
-            clientHandler.sendLine(
-                    String.format(
-                            java.util.Locale.ROOT,
-                            "MAP_ROW %d %s%n",
-                            y,
-                            row
-                    )
-            );
+            sb.append("MAP_ROW ").append(y).append(' ').append(MAP[y]).append('\n');
         }
-
-        // Marcador de fin de mapa
-        clientHandler.sendLine("MAP_END\n");
+        sb.append("MAP_END\n");
+        return sb.toString();
     }
 
 
@@ -932,7 +1363,8 @@ public class Server {
      * @param line línea de texto a enviar (debe incluir el salto de línea si se requiere)
      */
     public void broadcast(String line) {
-        for (ClientHandler ch : clients) ch.sendLine(line);
+        Broadcast msg = Broadcast.ofText(line);
+        for (ClientHandler ch : clients) ch.sendReliable(msg);
     }
 
     /**
@@ -943,7 +1375,7 @@ public class Server {
     void removeClient(ClientHandler c) {
         clients.remove(c);
         onQuit(c);
-        System.out.println("[JAVA] Cliente removido. Conectados: " + clients.size());
+        Log.info("JAVA", "Cliente removido. Conectados: " + clients.size());
     }
 
     /**
@@ -960,11 +1392,13 @@ public class Server {
         } catch (IOException ignored) {}
 
         ticker.shutdownNow();
+        for (Thread t : simWorkers) t.interrupt();
         pool.shutdownNow();
         for (ClientHandler ch : clients) {
             ch.close();
         }
-        System.out.println("[JAVA] Servidor detenido.");
+        Log.info("JAVA", "Servidor detenido.");
+        Log.shutdown();
     }
 
     /* ========= Consola Admin (Abstract Factory) ========= */
@@ -997,6 +1431,8 @@ public class Server {
      * ADMIN CROCODILE &lt;type&gt; &lt;liana&gt; [y] [playerId]
      * ADMIN FRUIT CREATE &lt;liana&gt; &lt;y&gt; &lt;pts&gt; [playerId]
      * ADMIN FRUIT DELETE &lt;liana&gt; &lt;y&gt; [playerId]
+     * ADMIN LOG LEVEL &lt;DEBUG|INFO|WARN|ERROR&gt;
+     * ADMIN LOG INPUT &lt;n&gt;   (0 = no registrar INPUT, n = uno de cada n)
      * </pre>
      *
      * Si no se proporciona <code>playerId</code>, el cambio se aplica a las plantillas
@@ -1013,14 +1449,14 @@ public class Server {
 
             String[] t = line.trim().split("\\s+");
             if (t.length < 2 || !"ADMIN".equalsIgnoreCase(t[0])) {
-                System.out.println("[ADMIN] Comando inválido: " + line);
+                Log.warn("ADMIN", "Comando inválido: " + line);
                 return;
             }
 
             // ================== CROCODILE ==================
             if ("CROCODILE".equalsIgnoreCase(t[1])) {
                 if (t.length < 4) {
-                    System.out.println("[ADMIN] Uso: ADMIN CROCODILE <type> <liana> [y] [playerId]");
+                    Log.info("ADMIN", "Uso: ADMIN CROCODILE <type> <liana> [y] [playerId]");
                     return;
                 }
 
@@ -1042,9 +1478,13 @@ public class Server {
                 }
 
                 if (playerId == null) {
-                    // Plantilla global
+                    // Plantilla global (con el mismo tope que una sesión)
+                    if (templateEnemies.size() >= GameSession.MAX_ENEMIES) {
+                        Log.warn("ADMIN", "La plantilla ya tiene " + GameSession.MAX_ENEMIES + " enemigos.");
+                        return;
+                    }
                     templateEnemies.add(factory.createCrocodile(type, liana, y));
-                    System.out.println("[ADMIN] CROCODILE " + type + " @" + liana + "," + y + " (plantilla)");
+                    Log.info("ADMIN", "CROCODILE " + type + " @" + liana + "," + y + " (plantilla)");
                 } else {
                     // Solo para ese jugador
                     addEnemyToPlayerSession(playerId, type, liana, y);
@@ -1059,7 +1499,7 @@ public class Server {
                 // ---------- CREATE ----------
                 if ("CREATE".equalsIgnoreCase(sub)) {
                     if (t.length < 6) {
-                        System.out.println("[ADMIN] Uso: ADMIN FRUIT CREATE <liana> <y> <pts> [playerId]");
+                        Log.info("ADMIN", "Uso: ADMIN FRUIT CREATE <liana> <y> <pts> [playerId]");
                         return;
                     }
                     Integer l   = Integer.parseInt(t[3]);
@@ -1068,16 +1508,19 @@ public class Server {
                     Integer playerId = (t.length >= 7) ? Integer.parseInt(t[6]) : null;
 
                     // Validar que la fruta se coloca en una casilla "pisable"
-                    Character tile = tileAt(l, y);
-                    if (tile != '.' && tile != '|' && tile != 'S' && tile != 'G') {
-                        System.out.println("[ADMIN] No se puede crear fruta en un tile bloqueante (agua, tierra o plataforma).");
+                    if (hasFlag(l, y, TileFlags.WALL | TileFlags.WATER)) {
+                        Log.warn("ADMIN", "No se puede crear fruta en un tile bloqueante (agua, tierra o plataforma).");
                         return;
                     }
 
 
                     if (playerId == null) {
+                        if (templateFruits.size() >= GameSession.MAX_FRUITS) {
+                            Log.warn("ADMIN", "La plantilla ya tiene " + GameSession.MAX_FRUITS + " frutas.");
+                            return;
+                        }
                         templateFruits.add(factory.createFruit(l, y, pts));
-                        System.out.println("[ADMIN] FRUIT +" + l + "," + y + " pts=" + pts + " (plantilla)");
+                        Log.info("ADMIN", "FRUIT +" + l + "," + y + " pts=" + pts + " (plantilla)");
                     } else {
                         addFruitToPlayerSession(playerId, l, y, pts);
                     }
@@ -1087,7 +1530,7 @@ public class Server {
                 // ---------- DELETE ----------
                 if ("DELETE".equalsIgnoreCase(sub)) {
                     if (t.length < 5) {
-                        System.out.println("[ADMIN] Uso: ADMIN FRUIT DELETE <liana> <y> [playerId]");
+                        Log.info("ADMIN", "Uso: ADMIN FRUIT DELETE <liana> <y> [playerId]");
                         return;
                     }
                     Integer l = Integer.parseInt(t[3]);
@@ -1096,7 +1539,7 @@ public class Server {
 
                     if (playerId == null) {
                         templateFruits.removeIf(f -> f.getX() == l && f.getY() == y);
-                        System.out.println("[ADMIN] FRUIT -" + l + "," + y + " (plantilla)");
+                        Log.info("ADMIN", "FRUIT -" + l + "," + y + " (plantilla)");
                     } else {
                         removeFruitFromPlayerSession(playerId, l, y);
                     }
@@ -1104,10 +1547,22 @@ public class Server {
                 }
             }
 
-            System.out.println("[ADMIN] Comando no reconocido: " + line);
+            // ================== LOG ==================
+            if ("LOG".equalsIgnoreCase(t[1])) {
+                if (t.length >= 4 && "LEVEL".equalsIgnoreCase(t[2]) && Log.setLevel(t[3])) {
+                    Log.warn("ADMIN", "LOG LEVEL " + t[3].toUpperCase(Locale.ROOT));
+                } else if (t.length >= 4 && "INPUT".equalsIgnoreCase(t[2])) {
+                    Log.setInputSample(Integer.parseInt(t[3]));
+                    Log.warn("ADMIN", "LOG INPUT 1/" + t[3]);
+                } else {
+                    Log.info("ADMIN", "Uso: ADMIN LOG LEVEL <DEBUG|INFO|WARN|ERROR> | ADMIN LOG INPUT <n>");
+                }
+                return;
+            }
+
+            Log.warn("ADMIN", "Comando no reconocido: " + line);
         } catch (Exception ex) {
-            System.out.println("[ADMIN] Error al procesar comando: " + line);
-            ex.printStackTrace();
+            Log.error("ADMIN", "Error al procesar comando: " + line, ex);
         }
     }
 
@@ -1127,16 +1582,21 @@ public class Server {
     private void addEnemyToPlayerSession(Integer playerId, String type, Integer liana, Integer y) {
         GameSession session = sessions.get(playerId);
         if (session == null) {
-            System.out.println("[ADMIN] No existe sesión para jugador " + playerId);
+            Log.info("ADMIN", "No existe sesión para jugador " + playerId);
             return;
         }
 
         Enemy enemy = factory.createCrocodile(type, liana, y);
-        session.enemies.add(enemy);
-        System.out.println("[ADMIN] CROCODILE " + type + " @" + liana + "," + y +
+        // La consola corre en su propio hilo: cambio y difusión juntos
+        synchronized (session) {
+            if (!session.addEnemy(enemy)) {
+                Log.warn("ADMIN", "La sesión de " + playerId + " ya tiene " + GameSession.MAX_ENEMIES + " enemigos.");
+                return;
+            }
+            sendEnemiesForPlayer(playerId, session);
+        }
+        Log.info("ADMIN", "CROCODILE " + type + " @" + liana + "," + y +
                 " → jugador " + playerId);
-
-        sendEnemiesForPlayer(playerId, session);
     }
 
     /**
@@ -1150,16 +1610,20 @@ public class Server {
     private void addFruitToPlayerSession(Integer playerId, Integer l, Integer y, Integer pts) {
         GameSession session = sessions.get(playerId);
         if (session == null) {
-            System.out.println("[ADMIN] No existe sesión para jugador " + playerId);
+            Log.info("ADMIN", "No existe sesión para jugador " + playerId);
             return;
         }
 
         Fruit fruit = factory.createFruit(l, y, pts);
-        session.fruits.add(fruit);
-        System.out.println("[ADMIN] FRUIT +" + l + "," + y + " pts=" + pts +
+        synchronized (session) {
+            if (!session.addFruit(fruit)) {
+                Log.warn("ADMIN", "La sesión de " + playerId + " ya tiene " + GameSession.MAX_FRUITS + " frutas.");
+                return;
+            }
+            sendFruitsForPlayer(playerId, session);
+        }
+        Log.info("ADMIN", "FRUIT +" + l + "," + y + " pts=" + pts +
                 " → jugador " + playerId);
-        
-        sendFruitsForPlayer(playerId, session);
     }
 
     /**
@@ -1172,44 +1636,149 @@ public class Server {
     private void removeFruitFromPlayerSession(Integer playerId, Integer l, Integer y) {
         GameSession session = sessions.get(playerId);
         if (session == null) {
-            System.out.println("[ADMIN] No existe sesión para jugador " + playerId);
+            Log.info("ADMIN", "No existe sesión para jugador " + playerId);
             return;
         }
 
-        session.fruits.removeIf(f -> f.getX() == l && f.getY() == y);
-        System.out.println("[ADMIN] FRUIT -" + l + "," + y + " → jugador " + playerId);
-
-        sendFruitsForPlayer(playerId, session);
+        synchronized (session) {
+            session.takeFruitsAt(l, y);
+            sendFruitsForPlayer(playerId, session);
+        }
+        Log.info("ADMIN", "FRUIT -" + l + "," + y + " → jugador " + playerId);
     }
 
     /**
-     * Envía al jugador (y sus espectadores) la lista completa de frutas
-     * de su sesión actual.
+     * Difunde los cambios de frutas de una sesión a su jugador y espectadores.
+     * <p>Los clientes que pidieron {@code +DELTA} reciben solo las
+     * operaciones ADD/REMOVE desde el envío anterior (nada si no hubo
+     * cambios); el resto recibe la lista completa como siempre.</p>
      */
     private void sendFruitsForPlayer(Integer playerId, GameSession session) {
         if (session == null) return;
 
+        synchronized (session) {
+            List<GameSession.DeltaOp> ops = session.diffFruits();
+            if (!ops.isEmpty()) session.fruitSeq++;
+
+            // Cada variante se arma una vez y todos reciben los mismos bytes;
+            // la lista completa solo se rehace si cambió y queda como keyframe
+            if (!ops.isEmpty() || session.fruitsKeyframe == null) {
+                session.fruitsKeyframe = new Broadcast(
+                        () -> fruitsText(playerId, session),
+                        () -> BinaryProtocol.encodeFruits(playerId, session.fruitSeq, session.fruits));
+            }
+            Broadcast full = session.fruitsKeyframe;
+            Broadcast delta = ops.isEmpty() ? null : new Broadcast(
+                    () -> fruitsDeltaText(playerId, session.fruitSeq, ops),
+                    () -> BinaryProtocol.encodeFruitsDelta(playerId, session.fruitSeq, ops, session.fruits));
+            sendListUpdate(playerId, full, delta);
+        }
+    }
+
+    /**
+     * Difunde los cambios de enemigos de una sesión a su jugador y
+     * espectadores, con el mismo criterio que
+     * {@link #sendFruitsForPlayer(Integer, GameSession)} (ADD/MOVE/REMOVE).
+     */
+    private void sendEnemiesForPlayer(Integer playerId, GameSession session) {
+        if (session == null) return;
+
+        synchronized (session) {
+            List<GameSession.DeltaOp> ops = session.diffEnemies();
+            // Sin cambios no hay nada que difundir: quien recibe listas
+            // completas ya tiene esta, y quien llega la toma del keyframe
+            if (ops.isEmpty() && session.enemiesKeyframe != null) return;
+            if (!ops.isEmpty()) session.enemySeq++;
+
+            // Cada variante se arma una vez y todos reciben los mismos bytes;
+            // la lista completa queda como keyframe
+            session.enemiesKeyframe = new Broadcast(
+                    () -> enemiesText(playerId, session),
+                    () -> BinaryProtocol.encodeEnemies(playerId, session.enemySeq, session.enemies));
+            Broadcast full = session.enemiesKeyframe;
+            Broadcast delta = ops.isEmpty() ? null : new Broadcast(
+                    () -> enemiesDeltaText(playerId, session.enemySeq, ops),
+                    () -> BinaryProtocol.encodeEnemiesDelta(playerId, session.enemySeq, ops, session.enemies));
+            sendListUpdate(playerId, full, delta);
+        }
+    }
+
+    /**
+     * Envía listas completas (keyframes) de frutas y enemigos a los clientes
+     * que las pidieron con {@code RESYNC} o que acaban de empezar a espectar.
+     * <p>El keyframe lleva el número de snapshot actual, así que los deltas
+     * siguientes encajan sin huecos. Son los keyframes que la sesión ya
+     * mantiene al día en cada difusión: quien los pide recibe los mismos
+     * bytes que el resto. Lo llama el {@link Shard} de la sesión, justo
+     * después de su STATE; como {@link #sendToPlayerAndSpectators}, recorre
+     * los observadores sin armar una lista.</p>
+     *
+     * @param pid     identificador del jugador dueño de la sesión
+     * @param session sesión cuyos observadores se revisan
+     */
+    private void serveKeyframeRequests(Integer pid, GameSession session) {
+        ClientHandler owner = clientByPlayer.get(pid);
+        if (owner != null) serveKeyframeRequest(owner, session);
+
+        CopyOnWriteArrayList<ClientHandler> ls = spectatorsByPlayer.get(pid);
+        if (ls != null) {
+            for (ClientHandler ch : ls) serveKeyframeRequest(ch, session);
+        }
+    }
+
+    /**
+     * Envía los keyframes de la sesión a un observador si los pidió.
+     *
+     * @param ch      jugador o espectador de la sesión
+     * @param session sesión observada
+     */
+    private void serveKeyframeRequest(ClientHandler ch, GameSession session) {
+        if (!ch.takeKeyframeRequest()) return;
+        synchronized (session) {
+            if (session.fruitsKeyframe == null || session.enemiesKeyframe == null) {
+                // Sesión que todavía no difundió sus listas: al próximo tick
+                ch.requestKeyframe();
+                return;
+            }
+            ch.send(session.fruitsKeyframe);
+            ch.send(session.enemiesKeyframe);
+        }
+    }
+
+    /**
+     * Lista completa de frutas en texto:
+     * <pre>
+     * FRUITS_BEGIN &lt;playerId&gt; &lt;seq&gt; &lt;n&gt;
+     * FRUIT &lt;x&gt; &lt;y&gt; &lt;puntos&gt; &lt;id&gt;
+     * FRUITS_END &lt;playerId&gt;
+     * </pre>
+     * Los campos nuevos van al final para no romper a clientes anteriores.
+     */
+    private String fruitsText(Integer playerId, GameSession session) {
         StringBuilder sb = new StringBuilder();
-        sb.append(String.format(Locale.ROOT, "FRUITS_BEGIN %d%n", playerId));
+        sb.append(String.format(Locale.ROOT, "FRUITS_BEGIN %d %d %d%n",
+                playerId, session.fruitSeq, session.fruits.size()));
         for (Fruit f : session.fruits) {
             sb.append(String.format(Locale.ROOT,
-                    "FRUIT %d %d %d%n",
-                    f.getX(), f.getY(), f.getPoints()));
+                    "FRUIT %d %d %d %d%n",
+                    f.getX(), f.getY(), f.getPoints(), f.getId()));
         }
         sb.append(String.format(Locale.ROOT, "FRUITS_END %d%n", playerId));
-
-        sendToPlayerAndSpectators(playerId, sb.toString());
+        return sb.toString();
     }
 
     /**
-     * Envía al jugador (y sus espectadores) la lista completa de enemigos
-     * (cocodrilos) de su sesión actual.
+     * Lista completa de enemigos en texto:
+     * <pre>
+     * ENEMIES_BEGIN &lt;playerId&gt; &lt;seq&gt; &lt;n&gt;
+     * ENEMY &lt;tipo&gt; &lt;x&gt; &lt;y&gt; &lt;id&gt;
+     * ENEMIES_END &lt;playerId&gt;
+     * </pre>
      */
-    private void sendEnemiesForPlayer(Integer playerId, GameSession session) {
-        if (session == null) return;
-
+    private String enemiesText(Integer playerId, GameSession session) {
         StringBuilder sb = new StringBuilder();
-        sb.append(String.format(Locale.ROOT, "ENEMIES_BEGIN %d%n", playerId));
+        sb.append(String.format(Locale.ROOT, "ENEMIES_BEGIN %d %d %d%n",
+                playerId, session.enemySeq, session.enemies.size()));
 
         for (Enemy e : session.enemies) {
             String type = e.getType();  // "RED" o "BLUE", según tu implementación
@@ -1217,16 +1786,67 @@ public class Server {
 
             sb.append(String.format(
                     Locale.ROOT,
-                    "ENEMY %s %d %d%n",
+                    "ENEMY %s %d %d %d%n",
                     type,
                     e.getX(),
-                    e.getY()
+                    e.getY(),
+                    e.getId()
             ));
         }
 
         sb.append(String.format(Locale.ROOT, "ENEMIES_END %d%n", playerId));
+        return sb.toString();
+    }
 
-        sendToPlayerAndSpectators(playerId, sb.toString());
+    /**
+     * Delta de frutas en texto:
+     * <pre>
+     * FRUITS_DELTA &lt;playerId&gt; &lt;seq&gt; &lt;n&gt;
+     * FRUIT_ADD &lt;id&gt; &lt;x&gt; &lt;y&gt; &lt;puntos&gt;
+     * FRUIT_REMOVE &lt;id&gt;
+     * FRUITS_DELTA_END &lt;playerId&gt;
+     * </pre>
+     */
+    private String fruitsDeltaText(Integer playerId, Integer seq, List<GameSession.DeltaOp> ops) {
+        StringBuilder sb = new StringBuilder();
+        sb.append(String.format(Locale.ROOT, "FRUITS_DELTA %d %d %d%n", playerId, seq, ops.size()));
+        for (GameSession.DeltaOp op : ops) {
+            if (op.op.equals(GameSession.OP_REMOVE)) {
+                sb.append(String.format(Locale.ROOT, "FRUIT_REMOVE %d%n", op.id));
+            } else {
+                sb.append(String.format(Locale.ROOT, "FRUIT_ADD %d %d %d %d%n",
+                        op.id, op.x, op.y, op.points));
+            }
+        }
+        sb.append(String.format(Locale.ROOT, "FRUITS_DELTA_END %d%n", playerId));
+        return sb.toString();
+    }
+
+    /**
+     * Delta de enemigos en texto:
+     * <pre>
+     * ENEMIES_DELTA &lt;playerId&gt; &lt;seq&gt; &lt;n&gt;
+     * ENEMY_ADD &lt;id&gt; &lt;tipo&gt; &lt;x&gt; &lt;y&gt;
+     * ENEMY_MOVE &lt;id&gt; &lt;x&gt; &lt;y&gt;
+     * ENEMY_REMOVE &lt;id&gt;
+     * ENEMIES_DELTA_END &lt;playerId&gt;
+     * </pre>
+     */
+    private String enemiesDeltaText(Integer playerId, Integer seq, List<GameSession.DeltaOp> ops) {
+        StringBuilder sb = new StringBuilder();
+        sb.append(String.format(Locale.ROOT, "ENEMIES_DELTA %d %d %d%n", playerId, seq, ops.size()));
+        for (GameSession.DeltaOp op : ops) {
+            if (op.op.equals(GameSession.OP_ADD)) {
+                sb.append(String.format(Locale.ROOT, "ENEMY_ADD %d %s %d %d%n",
+                        op.id, op.type == null ? "GENERIC" : op.type, op.x, op.y));
+            } else if (op.op.equals(GameSession.OP_MOVE)) {
+                sb.append(String.format(Locale.ROOT, "ENEMY_MOVE %d %d %d%n", op.id, op.x, op.y));
+            } else {
+                sb.append(String.format(Locale.ROOT, "ENEMY_REMOVE %d%n", op.id));
+            }
+        }
+        sb.append(String.format(Locale.ROOT, "ENEMIES_DELTA_END %d%n", playerId));
+        return sb.toString();
     }
 
 
@@ -1242,7 +1862,7 @@ public class Server {
      */
     public static void main(String[] args) {
         Runtime.getRuntime().addShutdownHook(new Thread(() -> {
-            System.out.println("[JAVA] Shutdown hook → cerrando servidor...");
+            Log.info("JAVA", "Shutdown hook → cerrando servidor...");
             Server.getInstance().stop();
         }));
         try { Server.getInstance().start(); } catch (IOException e) { e.printStackTrace(); }
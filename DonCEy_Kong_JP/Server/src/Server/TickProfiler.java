@@ -0,0 +1,192 @@
+package Server;
+
+import java.util.Locale;
+
+/**
+ * Mide cuánto tarda cada fase de {@link Server#tick()} y si el bucle de
+ * juego mantiene su período.
+ * <p>
+ * El tick marca el inicio con {@link #beginTick()}, entrega los tiempos por
+ * fase de cada shard de simulación con {@link #recordShardPhases(long[])} y
+ * cierra con {@link #endTick()}. Como los shards corren en paralelo, el
+ * tiempo de una fase en un tick es el del shard más lento en ella. Los
+ * tiempos se acumulan en una ventana de {@link #WINDOW_TICKS} ticks (un
+ * segundo); al completarse, {@link #statsLine(Integer, String)} la resume en un
+ * mensaje {@code STATS} y {@link #resetWindow()} empieza la siguiente.
+ * </p>
+ * <p>
+ * Solo lo usa el hilo del ticker (los shards miden por su cuenta y el
+ * ticker lee sus tiempos después de la barrera), así que no necesita
+ * sincronización. Usa {@code long} primitivos: se actualiza varias veces
+ * por tick y no debe crear objetos.
+ * </p>
+ */
+public final class TickProfiler {
+
+    /** Fase 1: coalescencia de inputs, movimiento y ack. */
+    public static final int PHASE_INPUT     = 0;
+    /** Fase 1b: gravedad y agua. */
+    public static final int PHASE_GRAVITY   = 1;
+    /** Fase 2: enemigos, colisiones, frutas y meta (incluye sus envíos). */
+    public static final int PHASE_ENEMIES   = 2;
+    /** Fases 3 y 4: STATE y keyframes. */
+    public static final int PHASE_BROADCAST = 3;
+    /** Cantidad de fases medidas. */
+    public static final int PHASE_COUNT     = 4;
+
+    /** Ticks por ventana de estadísticas (un segundo a 125 ms). */
+    public static final int WINDOW_TICKS = 8;
+
+    /** Período nominal del tick en nanosegundos. */
+    private final long periodNanos;
+
+    /** Inicio programado del primer tick; base para medir el atraso. */
+    private long scheduleBase = -1;
+    /** Ticks desde {@link #scheduleBase}. */
+    private long ticksSinceBase = 0;
+    /** Inicio del tick en curso. */
+    private long tickStart;
+    /** Tiempo de cada fase en el tick en curso (máximo entre shards). */
+    private final long[] tickPhase = new long[PHASE_COUNT];
+
+    /* ===== Ventana actual ===== */
+    private int  windowTicks = 0;
+    private long windowTickSum = 0;
+    private long windowTickMax = 0;
+    private long windowLateMax = 0;
+    private final long[] windowPhaseSum = new long[PHASE_COUNT];
+    private final long[] windowPhaseMax = new long[PHASE_COUNT];
+    private int  windowOverruns = 0;
+
+    /* ===== Totales desde el arranque ===== */
+    private long totalTicks = 0;
+    private long totalOverruns = 0;
+
+    /**
+     * @param periodMillis período nominal del tick
+     */
+    public TickProfiler(long periodMillis) {
+        this.periodNanos = periodMillis * 1_000_000L;
+    }
+
+    /**
+     * Marca el inicio de un tick y mide cuánto se atrasó respecto del
+     * calendario de {@code scheduleAtFixedRate}.
+     */
+    public void beginTick() {
+        tickStart = System.nanoTime();
+
+        if (scheduleBase < 0) {
+            scheduleBase = tickStart;
+            ticksSinceBase = 0;
+        }
+        long late = tickStart - (scheduleBase + ticksSinceBase * periodNanos);
+        ticksSinceBase++;
+        if (late > windowLateMax) windowLateMax = late;
+    }
+
+    /**
+     * Entrega los tiempos por fase de un shard en el tick en curso; de cada
+     * fase se conserva el del shard más lento. La espera en la barrera no
+     * se atribuye a ninguna fase: solo cuenta en el total del tick.
+     *
+     * @param phaseNanos nanosegundos por fase, indexados por {@code PHASE_*}
+     */
+    public void recordShardPhases(long[] phaseNanos) {
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            if (phaseNanos[i] > tickPhase[i]) tickPhase[i] = phaseNanos[i];
+        }
+    }
+
+    /**
+     * Cierra el tick.
+     *
+     * @return duración del tick en milisegundos si se pasó del período
+     *         (overrun), o -1 si entró a tiempo
+     */
+    public long endTick() {
+        long took = System.nanoTime() - tickStart;
+
+        windowTicks++;
+        windowTickSum += took;
+        if (took > windowTickMax) windowTickMax = took;
+        totalTicks++;
+
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            windowPhaseSum[i] += tickPhase[i];
+            if (tickPhase[i] > windowPhaseMax[i]) windowPhaseMax[i] = tickPhase[i];
+            tickPhase[i] = 0;
+        }
+
+        if (took > periodNanos) {
+            windowOverruns++;
+            totalOverruns++;
+            return took / 1_000_000L;
+        }
+        return -1;
+    }
+
+    /**
+     * @return {@code true} si la ventana actual ya tiene {@link #WINDOW_TICKS} ticks
+     */
+    public boolean windowComplete() {
+        return windowTicks >= WINDOW_TICKS;
+    }
+
+    /**
+     * Resume la ventana actual (tiempos en microsegundos):
+     * <pre>
+     * STATS &lt;ticks&gt; &lt;overruns&gt; &lt;overrunsVentana&gt; &lt;atrasoMax&gt;
+     *       &lt;tickProm&gt; &lt;tickMax&gt;
+     *       &lt;input&gt; &lt;gravedad&gt; &lt;enemigos&gt; &lt;broadcast&gt; &lt;clientes&gt;
+     *       &lt;inputsRecibidos&gt; &lt;lineasLog&gt; &lt;lineasLogDescartadas&gt;
+     * </pre>
+     * Las fases son promedios por tick; el máximo de cada una va a la consola
+     * del servidor solo cuando hay un overrun.
+     *
+     * @param clients cantidad de clientes conectados
+     * @param log     contadores del registro en la ventana ({@link Log#statsFields()})
+     * @return la línea con {@code '\n'}
+     */
+    public String statsLine(Integer clients, String log) {
+        int n = Math.max(1, windowTicks);
+        return String.format(Locale.ROOT,
+                "STATS %d %d %d %d %d %d %d %d %d %d %d%s\n",
+                totalTicks, totalOverruns, windowOverruns,
+                windowLateMax / 1000L,
+                windowTickSum / n / 1000L, windowTickMax / 1000L,
+                windowPhaseSum[PHASE_INPUT]     / n / 1000L,
+                windowPhaseSum[PHASE_GRAVITY]   / n / 1000L,
+                windowPhaseSum[PHASE_ENEMIES]   / n / 1000L,
+                windowPhaseSum[PHASE_BROADCAST] / n / 1000L,
+                clients, log);
+    }
+
+    /**
+     * Desglose del peor caso de cada fase en la ventana, para la consola.
+     *
+     * @return texto del tipo {@code "input=0.1 grav=0.0 enem=0.3 bcast=140.2 ms"}
+     */
+    public String phaseMaxSummary() {
+        return String.format(Locale.ROOT, "input=%.1f grav=%.1f enem=%.1f bcast=%.1f ms",
+                windowPhaseMax[PHASE_INPUT]     / 1e6,
+                windowPhaseMax[PHASE_GRAVITY]   / 1e6,
+                windowPhaseMax[PHASE_ENEMIES]   / 1e6,
+                windowPhaseMax[PHASE_BROADCAST] / 1e6);
+    }
+
+    /**
+     * Empieza una ventana nueva (los totales se conservan).
+     */
+    public void resetWindow() {
+        windowTicks = 0;
+        windowTickSum = 0;
+        windowTickMax = 0;
+        windowLateMax = 0;
+        windowOverruns = 0;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            windowPhaseSum[i] = 0;
+            windowPhaseMax[i] = 0;
+        }
+    }
+}
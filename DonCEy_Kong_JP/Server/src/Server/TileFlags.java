@@ -0,0 +1,70 @@
+package Server;
+
+/**
+ * Propiedades de los tiles del mapa como máscara de bits.
+ * <p>
+ * Cada carácter del mapa se traduce una sola vez a sus flags al cargar el
+ * mapa ({@link #build(char[][], int, int)}); a partir de ahí, cada consulta
+ * de vecinos (apoyo, techo, liana, agua ...) es una prueba de bits sobre un
+ * {@code byte[][]}, sin comparar caracteres ni crear objetos.
+ * </p>
+ * <p>Debe mantenerse sincronizado con los {@code TILE_FLAG_*} de
+ * {@code client_constants.h}.</p>
+ */
+public final class TileFlags {
+
+    /** Se puede estar de pie o colgado ('T', '=', '|', 'S'). */
+    public static final int SOLID   = 0x01;
+    /** Se puede trepar ('|'). */
+    public static final int LIANA   = 0x02;
+    /** Quita una vida ('W'). */
+    public static final int WATER   = 0x04;
+    /** No deja subir a través ('T', '=', 'S'); la meta 'G' a propósito no. */
+    public static final int CEILING = 0x08;
+    /** Meta del nivel ('G'). */
+    public static final int GOAL    = 0x10;
+    /** Punto de aparición ('S'). */
+    public static final int SPAWN   = 0x20;
+    /** No se puede entrar al moverse ('T', '='). */
+    public static final int WALL    = 0x40;
+
+    /** Clase de utilidad: no se instancia. */
+    private TileFlags() {}
+
+    /**
+     * Flags de un carácter de tile.
+     *
+     * @param t carácter del mapa
+     * @return máscara de flags (0 para vacío o desconocido)
+     */
+    public static int of(char t) {
+        switch (t) {
+            case 'T':
+            case '=': return SOLID | CEILING | WALL;
+            case '|': return SOLID | LIANA;
+            case 'S': return SOLID | CEILING | SPAWN;
+            case 'W': return WATER;
+            case 'G': return GOAL;
+            default:  return 0;
+        }
+    }
+
+    /**
+     * Precalcula la grilla de flags de un mapa.
+     *
+     * @param map    matriz de tiles indexada como {@code map[y][x]}
+     * @param width  columnas a incluir
+     * @param height filas a incluir
+     * @return grilla {@code [height][width]}; las celdas que faltan en
+     *         {@code map} quedan en 0
+     */
+    public static byte[][] build(char[][] map, int width, int height) {
+        byte[][] flags = new byte[height][width];
+        for (int y = 0; y < height && y < map.length; y++) {
+            for (int x = 0; x < width && x < map[y].length; x++) {
+                flags[y][x] = (byte) of(map[y][x]);
+            }
+        }
+        return flags;
+    }
+}
@@ -10,6 +10,28 @@ package Server.entities;
  */
 public abstract class Enemy {
 
+    /** Identificador estable del enemigo dentro de su sesión (0 = sin asignar). */
+    private Integer id = 0;
+
+    /**
+     * Obtiene el identificador estable usado en los mensajes delta.
+     *
+     * @return id asignado por la sesión, o 0 si aún no pertenece a ninguna
+     */
+    public Integer getId() {
+        return id;
+    }
+
+    /**
+     * Asigna el identificador estable. Lo llama {@code GameSession} al
+     * agregar la entidad a la sesión.
+     *
+     * @param id identificador único dentro de la sesión
+     */
+    public void setId(Integer id) {
+        this.id = id;
+    }
+
     /**
      * Actualiza el estado y/o posición del enemigo dentro de los límites permitidos.
      *
@@ -1,5 +1,6 @@
 package Server.entities;
 
+import Server.Log;
 import Server.Server;
 
 /**
@@ -49,7 +50,7 @@ public class RedCroc extends Enemy {
             // No hay liana -> rango trivial
             minLianaY = y;
             maxLianaY = y;
-            System.out.println("[RED] No se encontró liana en x=" + x);
+            Log.warn("RED", "No se encontró liana en x=" + x);
         } else {
             minLianaY = minY;
             maxLianaY = maxY;